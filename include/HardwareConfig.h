@@ -13,6 +13,13 @@ extern "C" {
 #define HAREWARE_CONFIG_BT_DEVICE_NAME "SLCAN-BT-Adapter"
 #define HARDWARE_CONFIG_SPP_SERVICE_NAME "SLCAN"
 #define HARDWARE_CONFIG_SPP_CHANNEL 0
+#define HARDWARE_CONFIG_SPP_MAX_CLIENTS 2 // Not more than CONFIG_BTDM_CTRL_BR_EDR_MAX_ACL_CONN
+
+// SLCAN over TCP (Wi-Fi access point), SPP is still used for OTA updates and downloads
+#define HARDWARE_CONFIG_TCP_ENABLED 0
+#define HARDWARE_CONFIG_WIFI_SSID "SLCAN-WiFi-Adapter"
+#define HARDWARE_CONFIG_WIFI_PASSWORD "slcan-adapter" // At least 8 characters, empty for an open network
+#define HARDWARE_CONFIG_TCP_PORT 3333
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,41 @@
+#ifndef BOOT_TIMELINE_H
+#define BOOT_TIMELINE_H
+
+// Some standard header
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+// Milestones of the boot process
+typedef enum {
+    BOOT_EVENT_APP_MAIN = 0,
+    BOOT_EVENT_NVS_READY,
+    BOOT_EVENT_CONFIG_RESTORED,
+    BOOT_EVENT_CAN_OPEN,
+    BOOT_EVENT_FIRST_FRAME,
+    BOOT_EVENT_BT_STACK_READY,
+    BOOT_EVENT_SPP_READY,
+    BOOT_EVENT_FIRST_CLIENT,
+    BOOT_EVENT_COUNT
+} boot_event_t;
+
+
+// Record the time of a milestone (only the first call per event counts)
+void boot_timeline_mark(const boot_event_t event);
+
+// Get the time of a milestone in ms since startup (-1 if not reached yet)
+int32_t boot_timeline_get_ms(const boot_event_t event);
+
+// Print all milestones reached so far
+void boot_timeline_report();
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BOOT_TIMELINE_H
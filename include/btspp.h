@@ -5,6 +5,9 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+// Transport interface
+#include "transport.h"
+
 
 #ifdef __cplusplus
 extern "C" {
@@ -45,16 +48,52 @@ int btspp_recv_data(uint8_t* data, const uint32_t bufsize, const uint32_t timeou
 int btspp_recv_msg(char* msg, const uint32_t bufsize, const char* delimiter, const uint32_t timeout_ms, const uint32_t delay_ms);
 
 
+// Size of the ring buffer for received data
+uint32_t btspp_get_recv_buffer_size();
+
+// Most bytes held in the ring buffer for received data at the same time since startup
+uint32_t btspp_get_recv_buffer_high_water_mark();
+
+
+// Check if a SPP client is connected
+// Safe to call before btspp_init()
+bool btspp_is_connected();
+
+// Wait until all clients have received the data sent so far
+bool btspp_flush(const uint32_t timeout_ms);
+
+// Number of connected SPP clients (up to HARDWARE_CONFIG_SPP_MAX_CLIENTS)
+// Everything sent with btspp_send() goes to all clients, a client that can't keep up misses messages
+uint32_t btspp_get_client_count();
+
+// Send data only to the client that sent the data read last (the answer to its command)
+bool btspp_reply(const uint8_t* const data, const uint32_t len, const uint32_t timeout_ms);
+
+// Give the client that sent the data read last the link to itself (true) or share it again (false)
+// While it is exclusive, everything sent goes only to that client (waiting for it instead of
+// dropping messages) and data of other clients is held back. Used for OTA updates and file transfers.
+void btspp_set_exclusive(const bool exclusive);
+
+
 // Register a callback that gets called when new data arrives
 typedef void (btspp_da_cb_t) (void* const ctx, const uint8_t* data, const uint32_t len);
 void btspp_register_data_available_callback(btspp_da_cb_t* const callback, void* const ctx);
 
 
+// Bluetooth SPP as transport for the SLCAN engine
+extern const transport_t btspp_transport;
+
 // Do a OTA updade via Bluetooth SPP
 // You need my custom python script for that
 bool btspp_do_ota_update();
 
 
+// Download a file from the storage partition via Bluetooth SPP
+// Uses a sliding window with per-block CRC, selective retransmit and resume-from-offset
+// You need my custom python script for that
+bool btspp_do_file_download(const char* filename);
+
+
 
 #ifdef __cplusplus
 }
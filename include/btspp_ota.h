@@ -0,0 +1,29 @@
+#ifndef BTSPP_OTA_H
+#define BTSPP_OTA_H
+
+// Some standard header
+#include <stdint.h>
+#include <stdbool.h>
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+// Command that starts the windowed OTA update (the legacy one is "START BT-OTA\r")
+#define BTSPP_OTA_WINDOWED_START_CMD "START BT-OTA WINDOWED\r"
+
+
+// Do a OTA updade via Bluetooth SPP with a sliding window
+// Chunk size and window depth are negotiated with the host and the flash writes
+// are done by a separate task, so receiving and writing overlap.
+// You need my custom python script for that (with '--protocol windowed')
+bool btspp_do_windowed_ota_update();
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BTSPP_OTA_H
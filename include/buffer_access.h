@@ -49,6 +49,74 @@ extern "C" {
 
 
 
+// Specialized accessors for every byte order
+// The digits in the name give the position of each byte of the value in the buffer
+// (1 = least significant byte), e.g. parse_uint32_4321 reads a big endian value.
+// They only use byte loads and shifts, so they work on unaligned data and
+// the compiler turns them into plain loads and byte swaps where possible.
+
+#define BUFFER_ACCESS_BYTE(value, n) ((uint8_t) ((value) >> (8 * ((n) - 1))))
+
+#define BUFFER_ACCESS_DEFINE_16(ORDER, b0, b1) \
+static inline uint16_t parse_uint16_##ORDER(const uint8_t* const data) { \
+    return (uint16_t) (((uint16_t) data[0] << (8 * ((b0) - 1))) | ((uint16_t) data[1] << (8 * ((b1) - 1)))); \
+} \
+static inline void copy_uint16_into_buffer_##ORDER(const uint16_t value, uint8_t* const data) { \
+    data[0] = BUFFER_ACCESS_BYTE(value, b0); \
+    data[1] = BUFFER_ACCESS_BYTE(value, b1); \
+}
+
+#define BUFFER_ACCESS_DEFINE_32(ORDER, b0, b1, b2, b3) \
+static inline uint32_t parse_uint32_##ORDER(const uint8_t* const data) { \
+    return ((uint32_t) data[0] << (8 * ((b0) - 1))) | ((uint32_t) data[1] << (8 * ((b1) - 1))) \
+         | ((uint32_t) data[2] << (8 * ((b2) - 1))) | ((uint32_t) data[3] << (8 * ((b3) - 1))); \
+} \
+static inline void copy_uint32_into_buffer_##ORDER(const uint32_t value, uint8_t* const data) { \
+    data[0] = BUFFER_ACCESS_BYTE(value, b0); \
+    data[1] = BUFFER_ACCESS_BYTE(value, b1); \
+    data[2] = BUFFER_ACCESS_BYTE(value, b2); \
+    data[3] = BUFFER_ACCESS_BYTE(value, b3); \
+}
+
+#define BUFFER_ACCESS_DEFINE_64(ORDER, b0, b1, b2, b3, b4, b5, b6, b7) \
+static inline uint64_t parse_uint64_##ORDER(const uint8_t* const data) { \
+    return ((uint64_t) data[0] << (8 * ((b0) - 1))) | ((uint64_t) data[1] << (8 * ((b1) - 1))) \
+         | ((uint64_t) data[2] << (8 * ((b2) - 1))) | ((uint64_t) data[3] << (8 * ((b3) - 1))) \
+         | ((uint64_t) data[4] << (8 * ((b4) - 1))) | ((uint64_t) data[5] << (8 * ((b5) - 1))) \
+         | ((uint64_t) data[6] << (8 * ((b6) - 1))) | ((uint64_t) data[7] << (8 * ((b7) - 1))); \
+} \
+static inline void copy_uint64_into_buffer_##ORDER(const uint64_t value, uint8_t* const data) { \
+    data[0] = BUFFER_ACCESS_BYTE(value, b0); \
+    data[1] = BUFFER_ACCESS_BYTE(value, b1); \
+    data[2] = BUFFER_ACCESS_BYTE(value, b2); \
+    data[3] = BUFFER_ACCESS_BYTE(value, b3); \
+    data[4] = BUFFER_ACCESS_BYTE(value, b4); \
+    data[5] = BUFFER_ACCESS_BYTE(value, b5); \
+    data[6] = BUFFER_ACCESS_BYTE(value, b6); \
+    data[7] = BUFFER_ACCESS_BYTE(value, b7); \
+}
+
+BUFFER_ACCESS_DEFINE_16(12, 1, 2)
+BUFFER_ACCESS_DEFINE_16(21, 2, 1)
+
+BUFFER_ACCESS_DEFINE_32(1234, 1, 2, 3, 4)
+BUFFER_ACCESS_DEFINE_32(4321, 4, 3, 2, 1)
+BUFFER_ACCESS_DEFINE_32(2143, 2, 1, 4, 3)
+BUFFER_ACCESS_DEFINE_32(3412, 3, 4, 1, 2)
+
+BUFFER_ACCESS_DEFINE_64(12345678, 1, 2, 3, 4, 5, 6, 7, 8)
+BUFFER_ACCESS_DEFINE_64(87654321, 8, 7, 6, 5, 4, 3, 2, 1)
+BUFFER_ACCESS_DEFINE_64(56781234, 5, 6, 7, 8, 1, 2, 3, 4)
+BUFFER_ACCESS_DEFINE_64(43218765, 4, 3, 2, 1, 8, 7, 6, 5)
+BUFFER_ACCESS_DEFINE_64(34127856, 3, 4, 1, 2, 7, 8, 5, 6)
+BUFFER_ACCESS_DEFINE_64(65872143, 6, 5, 8, 7, 2, 1, 4, 3)
+BUFFER_ACCESS_DEFINE_64(78563412, 7, 8, 5, 6, 3, 4, 1, 2)
+BUFFER_ACCESS_DEFINE_64(21436587, 2, 1, 4, 3, 6, 5, 8, 7)
+
+
+
+// Generic accessors, select the byte order at runtime
+
 uint8_t  parse_uint8 (const uint8_t* const data);
 uint16_t parse_uint16(const uint8_t* const data, const int endianness);
 uint32_t parse_uint32(const uint8_t* const data, const int endianness);
@@ -66,6 +134,23 @@ void copy_double_into_buffer(const double   value, uint8_t* data, const int endi
 
 
 
+// Bulk accessors, convert 'count' consecutive values with one call
+
+void parse_uint16_array(const uint8_t* const data, uint16_t* const values, const uint32_t count, const int endianness);
+void parse_uint32_array(const uint8_t* const data, uint32_t* const values, const uint32_t count, const int endianness);
+void parse_uint64_array(const uint8_t* const data, uint64_t* const values, const uint32_t count, const int endianness);
+void parse_float_array (const uint8_t* const data, float*    const values, const uint32_t count, const int endianness);
+void parse_double_array(const uint8_t* const data, double*   const values, const uint32_t count, const int endianness);
+
+void copy_uint16_array_into_buffer(const uint16_t* const values, uint8_t* data, const uint32_t count, const int endianness);
+void copy_uint32_array_into_buffer(const uint32_t* const values, uint8_t* data, const uint32_t count, const int endianness);
+void copy_uint64_array_into_buffer(const uint64_t* const values, uint8_t* data, const uint32_t count, const int endianness);
+void copy_float_array_into_buffer (const float*    const values, uint8_t* data, const uint32_t count, const int endianness);
+void copy_double_array_into_buffer(const double*   const values, uint8_t* data, const uint32_t count, const int endianness);
+
+
+
+
 void convert_endianess_16(const uint8_t* const in, uint8_t* const out, const int endianness);
 void convert_endianess_32(const uint8_t* const in, uint8_t* const out, const int endianness);
 void convert_endianess_64(const uint8_t* const in, uint8_t* const out, const int endianness);
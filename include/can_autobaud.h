@@ -0,0 +1,53 @@
+#ifndef CAN_AUTOBAUD_H
+#define CAN_AUTOBAUD_H
+
+#include "stdint.h"
+#include "stdbool.h"
+
+// CAN API
+#include "driver/twai.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+
+// Automatic bitrate detection
+// Each candidate timing is tried in listen only mode (so a wrong bitrate doesn't disturb the bus)
+// for up to 'dwell_ms' and scored by the valid frames received against the bus errors counted by the driver.
+// Early stops:
+// - CAN_AUTOBAUD_MIN_FRAMES frames without a single bus error: the candidate wins, the detection ends
+// - CAN_AUTOBAUD_MAX_BUS_ERRORS bus errors without a single frame: the candidate is dropped
+// Otherwise the candidate with the most frames beyond its bus errors wins.
+// The TWAI driver must not be installed.
+
+#define CAN_AUTOBAUD_MIN_FRAMES 4
+#define CAN_AUTOBAUD_MAX_BUS_ERRORS 8
+#define CAN_AUTOBAUD_DWELL_DEFAULT 100 // ms
+#define CAN_AUTOBAUD_DWELL_MAX 5000 // ms
+
+// Result of a candidate
+typedef struct {
+    bool tested; // false if the driver refused the timing or the detection stopped before
+    uint32_t frames;
+    uint32_t bus_errors;
+} can_autobaud_score_t;
+
+
+// Try the candidates in order, 'general_config' provides the pins (the mode is replaced)
+// scores: one per candidate (or NULL)
+// Returns the index of the detected candidate or -1 if none received frames
+int32_t can_autobaud_detect(
+    const twai_general_config_t* const general_config, 
+    const twai_timing_config_t* const candidates, const uint32_t count, 
+    const uint32_t dwell_ms, can_autobaud_score_t* const scores
+);
+
+
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif // CAN_AUTOBAUD_H
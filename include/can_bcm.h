@@ -0,0 +1,70 @@
+#ifndef CAN_BCM_H
+#define CAN_BCM_H
+
+#include "stdint.h"
+#include "stdbool.h"
+
+// CAN API
+#include "driver/twai.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+
+// Broadcast manager (like the SocketCAN BCM, used by the socketcand mode)
+// TX jobs: A frame is sent cyclically by an esp_timer, its data can be updated while it runs.
+// RX filters: Received frames are only forwarded if they are subscribed. A content filter
+// only forwards frames whose masked data (or DLC) changed. With a throttle interval, a frame
+// is forwarded at most once per interval, the last change held back is forwarded when the
+// interval ends (see 'can_bcm_take_throttled_frame').
+// Jobs and filters are identified by the identifier and the frame format (standard/extended).
+
+#define CAN_BCM_MAX_TX_JOBS 16
+#define CAN_BCM_MAX_RX_FILTERS 32
+
+
+// Initialize the broadcast manager (call once before everything else)
+void can_bcm_init();
+
+// Delete all TX jobs and RX filters
+void can_bcm_reset();
+
+// Start sending a frame every 'interval_us' microseconds (first frame after one interval)
+// An existing job for the same identifier is replaced
+bool can_bcm_add_tx_job(const uint64_t interval_us, const twai_message_t* const message);
+
+// Change the data of a running TX job (the timing is kept)
+bool can_bcm_update_tx_job(const twai_message_t* const message);
+
+// Stop a TX job
+bool can_bcm_delete_tx_job(const uint32_t identifier, const bool extended);
+
+// Subscribe an identifier
+// content_mask == NULL: every frame is forwarded, else only frames whose data changed in the masked bits (or whose DLC changed)
+// throttle_us: minimum time between two forwarded frames (0 = no throttling)
+// An existing filter for the same identifier is replaced
+bool can_bcm_add_rx_filter(const uint64_t throttle_us, const uint32_t identifier, const bool extended, const uint8_t* const content_mask);
+
+// Remove a filter
+bool can_bcm_delete_rx_filter(const uint32_t identifier, const bool extended);
+
+// Check a received frame against the RX filters
+// Returns true if the frame should be forwarded now
+bool can_bcm_filter_frame(const int64_t now_us, const twai_message_t* const message);
+
+// Get a frame held back by a throttle that is due now
+// Returns false if there is none
+bool can_bcm_take_throttled_frame(const int64_t now_us, twai_message_t* const message);
+
+// Time when the next held back frame is due (INT64_MAX if there is none)
+int64_t can_bcm_get_next_throttle_end();
+
+
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif // CAN_BCM_H
@@ -0,0 +1,91 @@
+#ifndef CAN_CAPTURE_H
+#define CAN_CAPTURE_H
+
+#include "stdint.h"
+#include "stdbool.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+
+// Triggered capture of CAN frames (like a logic analyzer)
+// The last 'pre' frames are kept in a RAM ring. When the trigger matches,
+// 'post' more frames are captured and the whole window is saved as a file.
+//
+// Capture file format (all values little endian):
+// Header (16 bytes):
+//  0: magic 'C' 'A' 'P' '1'
+//  4: number of frames (uint16)
+//  6: size of a frame record (uint16, 20)
+//  8: number of frames before the trigger (uint16), the trigger frame follows them
+// 10: trigger source (uint8), see CAN_CAPTURE_SOURCE_*
+// 11: reserved (1 byte)
+// 12: TWAI alerts that fired the trigger (uint32), 0 for frame triggers
+// Frame record (20 bytes):
+//  0: RX timestamp in microseconds (uint32, wraps after ~71 minutes)
+//  4: CAN identifier (uint32), bit 31 set for extended frames, bit 30 set for RTR frames
+//  8: DLC (uint8)
+//  9: reserved (3 bytes)
+// 12: data (8 bytes)
+
+#define CAN_CAPTURE_MAGIC "CAP1"
+#define CAN_CAPTURE_HEADER_SIZE 16
+#define CAN_CAPTURE_RECORD_SIZE 20
+#define CAN_CAPTURE_MAX_FRAMES 1024 // pre + 1 + post
+
+#define CAN_CAPTURE_EXTENDED_ID_FLAG 0x80000000u
+#define CAN_CAPTURE_RTR_FLAG 0x40000000u
+
+#define CAN_CAPTURE_SOURCE_FRAME 1
+#define CAN_CAPTURE_SOURCE_ALERT 2
+
+
+// A trigger condition
+// Frame trigger: (identifier ^ frame identifier) & identifier_mask == 0
+// and (data[i] ^ frame data[i]) & data_mask[i] == 0 for all bytes (bytes missing in the frame must be masked out)
+// Alert trigger: alerts != 0, fires on any of these TWAI alerts (frames are not checked)
+typedef struct {
+    uint32_t identifier; // Bit 31 set for extended frames, bit 30 for RTR frames
+    uint32_t identifier_mask;
+    uint8_t data[8];
+    uint8_t data_mask[8];
+    uint32_t alerts;
+} can_capture_trigger_t;
+
+
+// Initialize the capture (call once before everything else)
+void can_capture_init();
+
+// Start a new capture, a running capture is discarded
+bool can_capture_arm(const uint32_t pre, const uint32_t post, const can_capture_trigger_t* const trigger);
+
+// Stop the capture and free the buffer
+void can_capture_disarm();
+
+// Check if a capture is waiting for the trigger or capturing the post trigger frames
+bool can_capture_is_active();
+
+// Check if a capture waits for TWAI alerts
+bool can_capture_uses_alerts();
+
+// Add a received frame
+// Returns true if the capture is complete
+bool can_capture_add_frame(const uint32_t timestamp, const uint32_t identifier, const bool extended, const bool rtr, const uint8_t dlc, const uint8_t* const data);
+
+// Check TWAI alerts against the trigger
+// Returns true if the capture is complete
+bool can_capture_add_alerts(const uint32_t alerts);
+
+// Save a complete capture into a file (see file format above) and free the buffer
+// Returns the number of frames or -1 on error
+int can_capture_save(const char* filename);
+
+
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif // CAN_CAPTURE_H
@@ -0,0 +1,100 @@
+#ifndef CAN_RX_RING_H
+#define CAN_RX_RING_H
+
+#include "stdint.h"
+#include "stdbool.h"
+
+// FreeRTOS
+#include "freertos/FreeRTOS.h"
+
+// CAN API
+#include "driver/twai.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+
+// Ring of received CAN frames in compact 16 byte records (statically allocated)
+// The RX task drains the TWAI driver queue into the ring and timestamps the frames,
+// a single consumer (auto-poll task or 'P'/'A' commands) reads them by index:
+//   index = can_rx_ring_wait(timeout) -> can_rx_ring_get(index) -> can_rx_ring_release(index)
+// A full ring drops new frames (like the driver queue) and reports an overflow.
+//
+// Record (16 bytes):
+//  0: CAN identifier (uint32), bit 31 set for extended frames, bit 30 set for RTR frames,
+//     bit 29 selects the epoch of the timestamp
+//  4: bits 0-27 RX timestamp in microseconds since the epoch, bits 28-31 DLC
+//  8: data (8 bytes)
+//
+// Timestamps: The ring has two epochs, a new one is started when the current one is
+// older than ~134 s and the other one isn't used by a buffered frame anymore. So a frame
+// keeps its exact timestamp however long it is buffered. A frame that can't be stored
+// relative to either epoch (~268 s after a frame that is still buffered) is dropped like
+// with a full ring.
+
+// 1240 records and a small driver queue take the memory of the former 1024 entry
+// twai_message_t driver queue (1024 * 20 bytes)
+#define CAN_RX_RING_SIZE 1240
+
+#define CAN_RX_RECORD_EXTENDED_ID_FLAG 0x80000000u
+#define CAN_RX_RECORD_RTR_FLAG 0x40000000u
+#define CAN_RX_RECORD_EPOCH_FLAG 0x20000000u
+#define CAN_RX_RECORD_TIMESTAMP_MASK 0x0FFFFFFFu
+#define CAN_RX_RING_EPOCH_SWITCH_US (CAN_RX_RECORD_TIMESTAMP_MASK / 2)
+
+typedef struct {
+    uint32_t identifier;
+    uint32_t timestamp_dlc;
+    uint8_t data[8];
+} can_rx_record_t;
+
+
+// Initialize the ring (call once before everything else)
+void can_rx_ring_init();
+
+// Remove all frames
+void can_rx_ring_clear();
+
+// Producer: Add a received frame, returns false if the ring is full (or the timestamp can't be stored)
+bool can_rx_ring_push(const twai_message_t* const message, const int64_t timestamp_us);
+
+// Consumer: Wait for a frame, returns the index of the oldest frame or -1 on timeout
+// (or if woken by 'can_rx_ring_wake()' while there is no frame)
+int32_t can_rx_ring_wait(const TickType_t timeout);
+
+// Wake the consumer from 'can_rx_ring_wait()' (e.g. to stop it)
+void can_rx_ring_wake();
+
+// Consumer: Access a frame
+const can_rx_record_t* can_rx_ring_get(const int32_t index);
+
+// Consumer: Free the oldest frame (after it has been processed)
+void can_rx_ring_release(const int32_t index);
+
+// Unpack a record
+void can_rx_record_to_message(const can_rx_record_t* const record, twai_message_t* const message);
+
+// Consumer: Timestamp of a frame (in microseconds since startup)
+int64_t can_rx_ring_get_timestamp(const int32_t index);
+
+// Number of buffered frames
+uint32_t can_rx_ring_get_count();
+
+// Most frames buffered at the same time since startup
+uint32_t can_rx_ring_get_high_water_mark();
+
+// Number of frames dropped because the ring was full since startup
+uint32_t can_rx_ring_get_dropped_count();
+
+// Check if frames were dropped since the last call
+bool can_rx_ring_take_overflow();
+
+
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif // CAN_RX_RING_H
@@ -0,0 +1,97 @@
+#ifndef CAN_SIGNALS_H
+#define CAN_SIGNALS_H
+
+#include "stdint.h"
+#include "stdbool.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+
+// Decoding of signals (physical values) from CAN frames
+//
+// Binary signal database (all values little endian):
+// Header (12 bytes):
+//  0: magic 'S' 'D' 'B' '1'
+//  4: number of signals (uint16)
+//  6: size of a signal entry (uint16, 20)
+//  8: CRC32 of all signal entries (uint32)
+// Signal entry (20 bytes):
+//  0: CAN identifier (uint32, bit 31 set for extended frames)
+//  4: signal id (uint16), used to tag the decoded values
+//  6: start bit (uint8), LSB for Intel, MSB for Motorola (DBC numbering)
+//  7: length in bits (uint8, 1 - 64)
+//  8: flags (uint8), bit 0: Motorola byte order, bit 1: signed
+//  9: reserved (3 bytes)
+// 12: scale (float)
+// 16: offset (float)
+// physical value = raw value * scale + offset
+// (Raw byte fields are signals with a length of 8 bits, scale 1 and offset 0)
+
+#define CAN_SIGNALS_MAGIC "SDB1"
+#define CAN_SIGNALS_HEADER_SIZE 12
+#define CAN_SIGNALS_ENTRY_SIZE 20
+#define CAN_SIGNALS_MAX_SIGNALS 256
+#define CAN_SIGNALS_MAX_DATABASE_SIZE (CAN_SIGNALS_HEADER_SIZE + CAN_SIGNALS_MAX_SIGNALS * CAN_SIGNALS_ENTRY_SIZE)
+
+#define CAN_SIGNALS_EXTENDED_ID_FLAG 0x80000000u
+#define CAN_SIGNALS_FLAG_MOTOROLA 0x01
+#define CAN_SIGNALS_FLAG_SIGNED 0x02
+
+
+// A decoded value
+typedef struct {
+    uint16_t signal_id;
+    float value;
+} can_signal_value_t;
+
+// Statistics of a signal over a window
+typedef struct {
+    uint16_t signal_id;
+    uint32_t count; // Number of values, min, max and last are only valid if not 0
+    float min;
+    float max;
+    float last;
+    double sum; // mean = sum / count
+} can_signal_stats_t;
+
+// Callback for the statistics of a window
+typedef void can_signals_stats_cb_t(void* ctx, const can_signal_stats_t* stats);
+
+
+// Check a signal database and replace the current one with it
+// The signals are compiled into one extraction plan per CAN identifier
+// The current database is kept if the new one is invalid
+bool can_signals_load_database(const uint8_t* const data, const uint32_t size);
+
+// Remove all signals
+void can_signals_clear_database();
+
+// Number of signals in the database
+uint32_t can_signals_get_count();
+
+// Decode all signals of a CAN frame (in upload order)
+// Returns the number of values written to 'values'
+uint32_t can_signals_decode_frame(const uint32_t identifier, const bool extended, const uint8_t* const data, const uint8_t dlc, can_signal_value_t* const values, const uint32_t max_values);
+
+
+// Add all signals of a CAN frame to the statistics of the current window
+// Returns the number of values added
+uint32_t can_signals_aggregate_frame(const uint32_t identifier, const bool extended, const uint8_t* const data, const uint8_t dlc);
+
+// Pass the statistics of every signal with values in the current window to 'callback'
+// and start a new window. Returns the number of signals passed
+uint32_t can_signals_flush_window(can_signals_stats_cb_t* const callback, void* const ctx);
+
+// Start a new window without reporting the current one
+void can_signals_reset_window();
+
+
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif // CAN_SIGNALS_H
@@ -0,0 +1,64 @@
+#ifndef CAN_TIMING_H
+#define CAN_TIMING_H
+
+#include "stdint.h"
+#include "stdbool.h"
+
+// CAN API
+#include "driver/twai.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+
+// Bit timing calculations for the TWAI controller
+// The controller counts time quanta of brp APB clock cycles, a bit consists of
+// 1 (sync) + tseg_1 + tseg_2 time quanta and is sampled after 1 + tseg_1 of them:
+//   bitrate = CAN_TIMING_CLOCK_HZ / (brp * (1 + tseg_1 + tseg_2))
+//   sample point = (1 + tseg_1) / (1 + tseg_1 + tseg_2)
+
+#define CAN_TIMING_CLOCK_HZ 80000000 // APB clock
+#define CAN_TIMING_SJA1000_CLOCK_HZ 16000000 // Oscillator the BTR values of the CAN232 's' command refer to
+#define CAN_TIMING_TSEG_1_MIN 1
+#define CAN_TIMING_TSEG_1_MAX 16
+#define CAN_TIMING_TSEG_2_MIN 1
+#define CAN_TIMING_TSEG_2_MAX 8
+#define CAN_TIMING_SJW_MAX 4
+#define CAN_TIMING_BITRATE_MAX 1000000 // bit/s
+#define CAN_TIMING_SAMPLE_POINT_DEFAULT 875 // permille (CiA recommendation)
+#define CAN_TIMING_MAX_BITRATE_ERROR 10 // permille, the oscillator tolerance of the other nodes must cover it
+#define CAN_TIMING_SAMPLE_POINT_TOLERANCE 25 // permille, within it more time quanta are preferred over a closer sample point
+
+
+// Check if the controller supports a timing
+bool can_timing_is_valid(const twai_timing_config_t* const timing);
+
+// Bitrate of a timing (bit/s)
+uint32_t can_timing_get_bitrate(const twai_timing_config_t* const timing);
+
+// Sample point of a timing (permille)
+uint32_t can_timing_get_sample_point(const twai_timing_config_t* const timing);
+
+// Find the timing closest to a bitrate (bit/s) and sample point (permille)
+// The bitrate error is minimized first. Among the sample points within CAN_TIMING_SAMPLE_POINT_TOLERANCE
+// the one with the most time quanta is taken (like the ESP-IDF TWAI_TIMING_CONFIG_* macros),
+// if there is none the closest sample point.
+// Returns false if no timing is within CAN_TIMING_MAX_BITRATE_ERROR (or the bitrate is above CAN_TIMING_BITRATE_MAX)
+bool can_timing_calculate(const uint32_t bitrate, const uint32_t sample_point, twai_timing_config_t* const timing);
+
+// Translate SJA1000 bus timing registers (16 MHz oscillator)
+// BTR0: bits 6-7 SJW - 1, bits 0-5 BRP - 1
+// BTR1: bit 7 SAM (triple sampling), bits 4-6 TSEG2 - 1, bits 0-3 TSEG1 - 1
+// The segments are kept if the prescaler fits the controller, else the closest timing
+// for the same bitrate and sample point is calculated. Returns false if there is none.
+bool can_timing_from_btr(const uint8_t btr0, const uint8_t btr1, twai_timing_config_t* const timing);
+
+
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif // CAN_TIMING_H
@@ -0,0 +1,75 @@
+#ifndef DELTA_PATCH_H
+#define DELTA_PATCH_H
+
+#include "stdint.h"
+#include "stdbool.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+
+// Streaming applier for binary delta patches (used for delta OTA images)
+// The new image is built from ranges of the base image and inserted data.
+//
+// Patch format (all values little endian):
+// Header: 'D' 'L' 'T' '1' | target size (uint32) | app_elf_sha256 of the base (32 bytes) | SHA-256 of the target image (32 bytes)
+// Body: a sequence of operations with a 9 byte header:
+//       'C' | base offset (uint32) | length (uint32)  - copy 'length' bytes from the base image
+//       'I' | 0 (uint32)           | length (uint32)  - insert the following 'length' bytes
+
+#define DELTA_PATCH_MAGIC "DLT1"
+#define DELTA_PATCH_HASH_SIZE 32
+#define DELTA_PATCH_HEADER_SIZE (8 + 2 * DELTA_PATCH_HASH_SIZE)
+#define DELTA_PATCH_OP_HEADER_SIZE 9
+#define DELTA_PATCH_OP_COPY 'C'
+#define DELTA_PATCH_OP_INSERT 'I'
+#define DELTA_PATCH_COPY_BUFFER_SIZE 512
+
+
+// Reads a range of the base image
+typedef bool (delta_patch_read_cb_t) (void* const ctx, const uint32_t offset, uint8_t* data, const uint32_t len);
+
+// Gets called with blocks of the target image (return false to stop)
+typedef bool (delta_patch_output_cb_t) (void* const ctx, const uint8_t* data, const uint32_t len);
+
+
+// State of the patch applier
+typedef struct {
+    uint8_t header[DELTA_PATCH_HEADER_SIZE];
+    uint32_t header_len;
+    uint8_t op_header[DELTA_PATCH_OP_HEADER_SIZE];
+    uint32_t op_header_len;
+    uint32_t insert_remaining; // Bytes left of the current insert operation
+    uint32_t target_size;
+    uint32_t total_out;
+    bool error;
+    uint8_t copy_buffer[DELTA_PATCH_COPY_BUFFER_SIZE];
+} delta_patch_t;
+
+
+// Reset the applier for a new patch
+void delta_patch_init(delta_patch_t* const patch);
+
+// Apply the next block of the patch
+bool delta_patch_apply(delta_patch_t* const patch, const uint8_t* const in, const uint32_t len, delta_patch_read_cb_t* const read_base, delta_patch_output_cb_t* const callback, void* const ctx);
+
+// Check if the header was received
+bool delta_patch_has_header(const delta_patch_t* const patch);
+
+// Values from the header (valid once delta_patch_has_header returns true)
+uint32_t delta_patch_get_target_size(const delta_patch_t* const patch);
+const uint8_t* delta_patch_get_base_hash(const delta_patch_t* const patch);
+const uint8_t* delta_patch_get_target_hash(const delta_patch_t* const patch);
+
+// Check if the whole target image was built without errors
+bool delta_patch_finished(const delta_patch_t* const patch);
+
+
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif // DELTA_PATCH_H
@@ -15,6 +15,7 @@ extern "C" {
 bool mount_filesystem();
 
 // ummount the SPIFFS filesystem
+// Note: The '*_storage' functions keep the filesystem mounted for the life of the app
 bool unmount_filesystem();
 
 
@@ -38,6 +39,17 @@ int read_data_from_file(FILE* const file, uint8_t* const buffer, const int bufsi
 // write data to file (using fwrite)
 int write_data_to_file(FILE* const file, const uint8_t* const buffer, const int bufsize);
 
+// set the file position to an offset from the beginning of the file (using fseek)
+int seek_in_file(FILE* const file, const long offset);
+
+
+
+// Delete a file on the SPIFFS filesystem
+bool remove_file_from_filesystem(const char* filename);
+
+// Rename a file on the SPIFFS filesystem (the new name must not exist)
+bool rename_file_on_filesystem(const char* old_filename, const char* new_filename);
+
 
 
 // Open file, read string from file (using fgets), close file
@@ -52,18 +64,30 @@ bool read_data_from_filesystem(const char* filename, uint8_t* const buffer, cons
 // Open file, write data to file (using fwrite), close file
 bool write_data_to_filesystem(const char* filename, const uint8_t* const buffer, const int bufsize);
 
+// Write data to a temporary file and rename it, so a crash never leaves a half written file
+bool write_data_to_filesystem_atomic(const char* filename, const uint8_t* const buffer, const int bufsize);
+
+// Finish or roll back an interrupted 'write_data_to_filesystem_atomic'
+bool recover_file_on_filesystem(const char* filename);
 
 
-// Mount the filesystem, open file, read string from file (using fgets), close file, unmount the filesystem
+
+// Mount the filesystem (if not mounted yet), open file, read string from file (using fgets), close file
 bool read_file_from_storage(const char* filename, char* const buffer, const int bufsize);
 
-// Mount the filesystem, open file, write string to file (using fputs), close file, unmount the filesystem
+// Mount the filesystem (if not mounted yet), open file, write string to file (using fputs), close file
 bool write_file_to_storage(const char* filename, const char* const buffer);
 
-// Mount the filesystem, open file, read data from file (using fread), close file, unmount the filesystem
+// Mount the filesystem (if not mounted yet), open file, read data from file (using fread), close file
+// Small files are kept in an in-RAM shadow, so repeated reads don't touch the flash
 bool read_data_from_storage(const char* filename, uint8_t* const buffer, const int bufsize);
 
-// Mount the filesystem, open file, write data to file (using fwrite), close file, unmount the filesystem
+// Mount the filesystem (if not mounted yet), read up to 'bufsize' bytes from file (using fread), close file
+// Returns the number of bytes read or -1 if the file doesn't exist
+int read_available_data_from_storage(const char* filename, uint8_t* const buffer, const int bufsize);
+
+// Mount the filesystem (if not mounted yet), write data to file atomically (see 'write_data_to_filesystem_atomic')
+// Writes of unchanged data to a shadowed file are skipped
 bool write_data_to_storage(const char* filename, const uint8_t* const buffer, const int bufsize);
 
 
@@ -71,7 +95,7 @@ bool write_data_to_storage(const char* filename, const uint8_t* const buffer, co
 // Check if file exists
 bool does_file_exist_on_filesystem(const char* filename);
 
-// Mount the filesystem, check if file exists, unmount the filesystem
+// Mount the filesystem (if not mounted yet), check if file exists
 bool does_file_exist_in_storage(const char* filename);
 
 
@@ -79,10 +103,10 @@ bool does_file_exist_in_storage(const char* filename);
 // Get the size of a file
 int get_file_size_from_filesystem(const char* filename);
 
-// Mount the filesystem, get the size of a file, unmount the filesystem
+// Mount the filesystem (if not mounted yet), get the size of a file
 int get_file_size_from_storage(const char* filename);
 
-// Alias for 'get_file_size_from_storage' (Mount the filesystem, get the size of a file, unmount the filesystem)
+// Alias for 'get_file_size_from_storage' (Mount the filesystem (if not mounted yet), get the size of a file)
 int get_file_size(const char* filename);
 
 
@@ -92,10 +116,9 @@ int get_file_size(const char* filename);
 // The returned pointer needs to be freed after use.
 bool read_data_file_from_filesysteme(const char* filename, uint8_t** buffer, int* filesize);
 
-// Mount the filesystem
+// Mount the filesystem (if not mounted yet)
 // Use get_file_size to determine the needed buffer size.
 // Allocate a buffer an read the file from the filesystem
-// Unmount the filesystem
 // The returned pointer needs to be freed after use.
 bool read_data_file_from_storage(const char* filename, uint8_t** buffer, int* filesize);
 
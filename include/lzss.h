@@ -0,0 +1,72 @@
+#ifndef LZSS_H
+#define LZSS_H
+
+#include "stdint.h"
+#include "stdbool.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+
+// Streaming LZSS decompressor with a 4 KB window (used for compressed OTA images)
+//
+// Stream format:
+// Header: 'L' 'Z' 'S' '1' | decompressed size (uint32, little endian)
+// Body: groups of a flag byte followed by up to 8 items.
+//       Flag bit n (LSB first) describes item n:
+//       1 - literal: one byte
+//       0 - match: two bytes 'b0 b1', copy 'length' bytes from 'distance' bytes back
+//           distance = (b0 | (b1 & 0xF0) << 4) + 1   (1 - 4096)
+//           length   = (b1 & 0x0F) + 3                (3 - 18)
+
+#define LZSS_MAGIC "LZS1"
+#define LZSS_HEADER_SIZE 8
+#define LZSS_WINDOW_SIZE 4096
+#define LZSS_MIN_MATCH 3
+#define LZSS_MAX_MATCH 18
+
+
+// Gets called with blocks of decompressed data (return false to stop decoding)
+typedef bool (lzss_output_cb_t) (void* const ctx, const uint8_t* data, const uint32_t len);
+
+
+// State of the decompressor (about 4.1 KB, allocate it on the heap)
+typedef struct {
+    uint8_t window[LZSS_WINDOW_SIZE]; // The last 4 KB of output, also used as output buffer
+    uint32_t window_pos; // Next write position in the window
+    uint32_t flush_pos; // Window position up to which the output was handed to the callback
+    uint32_t pending; // Bytes from 'flush_pos' on that were not handed to the callback yet
+    uint32_t total_out; // Number of decompressed bytes so far
+    uint32_t expected_size; // Decompressed size from the header
+    uint8_t header[LZSS_HEADER_SIZE];
+    uint32_t header_len;
+    uint8_t flags; // Remaining flag bits of the current group
+    uint32_t flag_bits_left;
+    uint8_t match_byte; // First byte of a match split across two input blocks
+    bool match_pending;
+    bool error;
+} lzss_decoder_t;
+
+
+// Reset the decompressor for a new stream
+void lzss_decoder_init(lzss_decoder_t* const decoder);
+
+// Decompress the next block of the stream
+// The output is handed to 'callback' in blocks of up to 4 KB
+bool lzss_decode(lzss_decoder_t* const decoder, const uint8_t* const in, const uint32_t len, lzss_output_cb_t* const callback, void* const ctx);
+
+// Decompressed size from the header (0 until the header was received)
+uint32_t lzss_decoder_get_expected_size(const lzss_decoder_t* const decoder);
+
+// Check if the whole stream was decompressed without errors
+bool lzss_decoder_finished(const lzss_decoder_t* const decoder);
+
+
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif // LZSS_H
@@ -4,14 +4,27 @@
 // Some standard header
 #include <stdbool.h>
 
+// Transport interface
+#include "transport.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 
 // Init everything needed for slcan
+// Restores the configs and opens the CAN channel if auto-startup is enabled.
+// Doesn't need bluetooth, received frames stay buffered until a SPP client is connected.
 bool slcan_init();
 
+// Select the byte stream for the SLCAN commands (call before slcan_start())
+// Bluetooth SPP (btspp_transport) is used by default, with another transport the
+// bluetooth OTA update and file download stay available via SPP
+bool slcan_set_transport(const transport_t* const new_transport);
+
+// Start processing SLCAN commands (call after btspp_init())
+bool slcan_start();
+
 
 
 
@@ -0,0 +1,62 @@
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+// Some standard header
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+// A byte stream the SLCAN engine talks over (Bluetooth SPP, loopback, ...)
+typedef struct {
+    const char* name;
+
+    // Send data, returns false on timeout or if nobody is connected
+    bool (*send)(const uint8_t* const data, const uint32_t len, const uint32_t timeout_ms);
+
+    // Wait for and read up to 'bufsize' bytes
+    // Returns the number of bytes read or a negative value on timeout (-2) or error (-1)
+    int (*recv)(uint8_t* data, const uint32_t bufsize, const uint32_t timeout_ms);
+
+    // Hand buffered data to the link and wait up to 'timeout_ms' until it has been sent
+    // Returns false if data is still pending
+    bool (*flush)(const uint32_t timeout_ms);
+
+    // Check if the other side is connected
+    bool (*is_connected)();
+
+    // Optional, only for transports with several clients (NULL otherwise):
+    // Send data only to the client that sent the data read last (the answer to its command)
+    bool (*reply)(const uint8_t* const data, const uint32_t len, const uint32_t timeout_ms);
+
+    // Give the client that sent the data read last the link to itself (true) or share it again (false)
+    // While it is exclusive, 'send' only goes to that client and only its data is received.
+    // Used for transfers that span several messages (file transfers, uploads)
+    void (*set_exclusive)(const bool exclusive);
+} transport_t;
+
+
+// Send a string
+bool transport_send_msg(const transport_t* const transport, const char* const msg, const uint32_t timeout_ms);
+
+// Send a string to the client that sent the data read last ('send' if the transport has no 'reply')
+bool transport_send_reply(const transport_t* const transport, const char* const msg, const uint32_t timeout_ms);
+
+// Give the client that sent the data read last the link to itself or share it again (if supported)
+void transport_set_exclusive(const transport_t* const transport, const bool exclusive);
+
+// Read single characters until a delimiter string is detected (same as 'btspp_recv_msg')
+// Returns the message length, -2 on timeout on the first character, -3 on timeout
+// on an intermediate character, -4 if the buffer is full
+int transport_recv_msg(const transport_t* const transport, char* msg, const uint32_t bufsize, const char* delimiter, const uint32_t timeout_ms, const uint32_t delay_ms);
+
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TRANSPORT_H
@@ -0,0 +1,41 @@
+#ifndef TRANSPORT_LOOPBACK_H
+#define TRANSPORT_LOOPBACK_H
+
+// Some standard header
+#include <stdint.h>
+#include <stdbool.h>
+
+// Transport interface
+#include "transport.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+// In-memory transport, runs the SLCAN engine without a radio (e.g. for benchmarks)
+// The "host" side writes commands with 'loopback_transport_write()'
+// and reads the responses with 'loopback_transport_read()'.
+
+// Create the buffers for both directions
+bool loopback_transport_init(const uint32_t bufsize);
+
+// Host side: send data to the SLCAN engine
+bool loopback_transport_write(const uint8_t* const data, const uint32_t len, const uint32_t timeout_ms);
+
+// Host side: read data sent by the SLCAN engine
+int loopback_transport_read(uint8_t* data, const uint32_t bufsize, const uint32_t timeout_ms);
+
+// Host side: connect or disconnect (connected after init)
+void loopback_transport_set_connected(const bool connected);
+
+// The transport for the SLCAN engine
+extern const transport_t loopback_transport;
+
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TRANSPORT_LOOPBACK_H
@@ -0,0 +1,43 @@
+#ifndef TRANSPORT_TCP_H
+#define TRANSPORT_TCP_H
+
+// Some standard header
+#include <stdint.h>
+#include <stdbool.h>
+
+// Transport interface
+#include "transport.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+// SLCAN over TCP
+// Serves up to TCP_TRANSPORT_MAX_CLIENTS sockets at the same time. Everything sent
+// goes to all clients, replies only go to the client that sent the command and
+// during a transfer (transport_set_exclusive) only that client is served. Nagle is disabled and sent data is batched per client
+// until a segment is full or the transport is flushed.
+// Only uses BSD sockets and pthreads, so it also builds on a Linux host
+// (e.g. for benchmarks against a local socket).
+#define TCP_TRANSPORT_MAX_CLIENTS 4
+
+// Open the server socket
+bool tcp_transport_start(const uint16_t port);
+
+// Close the server and all client sockets
+void tcp_transport_stop();
+
+// Number of connected clients
+uint32_t tcp_transport_get_client_count();
+
+// The transport for the SLCAN engine
+extern const transport_t tcp_transport;
+
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TRANSPORT_TCP_H
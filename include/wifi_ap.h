@@ -0,0 +1,23 @@
+#ifndef WIFI_AP_H
+#define WIFI_AP_H
+
+// Some standard header
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+// Start a Wi-Fi access point (for the TCP transport)
+// An empty password (or one shorter than 8 characters) opens the network without encryption.
+bool wifi_ap_init(const char* const ssid, const char* const password, const uint8_t max_connections);
+
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // WIFI_AP_H
@@ -0,0 +1,235 @@
+import sys, os, time
+import argparse
+import statistics
+import bluetooth
+
+
+
+def get_cli_args():
+
+    # Set up the parser
+    parser = argparse.ArgumentParser()
+    parser.add_argument("-n", "--cycles", type=int, help="Number of C/S/O cycles", default=100)
+    parser.add_argument("-b", "--bitrates", type=str, help="Bitrates to cycle through (S command codes)", default="6,4")
+    parser.add_argument("-d", "--device_name", type=str, help="Bluetooth Device", default="SLCAN-BT-Adapter")
+    parser.add_argument("-a", "--device_address", type=str, help="Device Address", default=None)
+    parser.add_argument("-c", "--service_channel", type=int, help="Service Channel", default=None)
+
+
+    # parse the arguments (uses sys.argv by default)
+    args = parser.parse_args()
+    print(args)
+    return args
+
+def find_device_address(device_name):
+
+    print(f'Searching for device "{device_name}"....')
+    nearby_devices = bluetooth.discover_devices(duration=8, lookup_names=True, flush_cache=True, lookup_class=False)
+
+    try:
+        # check if device was found
+        idx = [x[1] for x in nearby_devices].index(device_name)
+        addr, name = nearby_devices[idx]
+        print(f'Device "{device_name}" was found at {addr}')
+        return addr, name
+
+    except ValueError:
+        num_devices_found = len(nearby_devices)
+        print(f'Device "{device_name}" was not found')
+        print(f"Found {num_devices_found} devices")
+
+        if num_devices_found <= 0:
+            print("Aborting...")
+            sys.exit()
+        else:
+            # Print a list of all found devices
+            for i, device in enumerate(nearby_devices):
+                addr, name = device
+                try:
+                    print(f"{i+1}.   {addr} - {name}")
+                except UnicodeEncodeError:
+                    print(f"{i+1}.   {addr} - {name.encode('utf-8', 'replace')}")
+            
+            while True:
+                try:
+                    choice = input("Choose a device: ")
+                    choice = int(choice)
+                    if choice == 0:
+                        print("Aborting...")
+                        sys.exit()
+                    elif choice > 0 and choice <= num_devices_found:
+                        addr, name = nearby_devices[choice-1]
+                        print(f'Device {addr} - {name} selected')
+                        return addr, name
+                    else:
+                        print("Invalid choice")
+
+                except ValueError:
+                    print("Aborting...")
+                    sys.exit()
+
+def find_spp_service(device):
+
+    # search for SPP service
+    addr, _ = device
+    service_matches = bluetooth.find_service(name=None, uuid="1101", address=addr) 
+
+    if len(service_matches) == 0:
+        print(f'Couldn\'t find a SSP service.')
+        sys.exit()
+    else:
+        print(f'Found {len(service_matches)} SSP service{"s" if len(service_matches) > 1 else ""}.')
+        for i, svc in enumerate(service_matches):
+            # svc = service_matches[0] # First match
+            print(f"{i+1}. Service Name:", svc["name"])
+            print("\t", "Host:       ", svc["host"])
+            print("\t", "Description:", svc["description"])
+            print("\t", "Provided By:", svc["provider"])
+            print("\t", "Protocol:   ", svc["protocol"])
+            print("\t", "channel/PSM:", svc["port"])
+            print("\t", "svc classes:", svc["service-classes"])
+            print("\t", "profiles:   ", svc["profiles"])
+            print("\t", "service id: ", svc["service-id"])
+
+        while True:
+            try:
+                choice = input("Choose a service: ")
+                choice = int(choice)
+                if choice == 0:
+                    print("Aborting...")
+                    sys.exit()
+                elif choice > 0 and choice <= len(service_matches):
+                    svc = service_matches[choice-1]
+                    print(f'Service {svc["name"]} selected')
+                    return svc
+                else:
+                    print("Invalid choice")
+
+            except ValueError:
+                print("Aborting...")
+                sys.exit()
+
+
+
+
+def recv_response(sock, buffer):
+
+    # Read until the bare CR (OK) or BELL (ERROR) answer, skip the frames sent by auto-poll
+    while True:
+        ends = [i for i in (buffer.find(b"\r"), buffer.find(b"\b")) if i >= 0]
+        if not ends:
+            data = sock.recv(4096)
+            if not data:
+                raise bluetooth.BluetoothError("Connection closed")
+            buffer += data
+            continue
+        end = min(ends)
+        line, terminator, buffer = buffer[:end], buffer[end:end + 1], buffer[end + 1:]
+        if terminator == b"\b":
+            return False, buffer
+        if not line:
+            return True, buffer
+
+
+def timed_command(sock, buffer, command):
+
+    start = time.perf_counter()
+    sock.send(command + "\r")
+    ok, buffer = recv_response(sock, buffer)
+    return ok, (time.perf_counter() - start) * 1000.0, buffer
+
+
+def print_timings(name, timings):
+
+    timings = sorted(timings)
+    print(f"{name:>6}: min {timings[0]:8.2f} ms   median {statistics.median(timings):8.2f} ms   max {timings[-1]:8.2f} ms")
+
+
+def do_bitrate_cycles(device, service, cycles, bitrates):
+
+    _, name = device
+    host, port = service["host"], service["port"]
+
+    try:
+        # Create the client socket
+        print(f"Connecting to \"{name}\" on {host} channel {port}")
+        sock = bluetooth.BluetoothSocket(bluetooth.RFCOMM)
+        sock.connect((host, port))
+        buffer = b""
+
+        try:
+            print("Connected.")
+
+            # Start from a closed channel (answer is CR or BELL)
+            sock.send("C\r")
+            time.sleep(1.5)
+            sock.recv(1024)
+
+            # Round trip of a command that doesn't touch the channel
+            baseline = []
+            for _ in range(10):
+                sock.send("V\r")
+                start = time.perf_counter()
+                while b"\r" not in buffer:
+                    buffer += sock.recv(4096)
+                _, _, buffer = buffer.partition(b"\r")
+                baseline.append((time.perf_counter() - start) * 1000.0)
+            print_timings("V", baseline)
+
+            # Close, change the bitrate and reopen the channel
+            timings = {"C": [], "S": [], "O": [], "cycle": []}
+            for i in range(cycles):
+                bitrate = bitrates[i % len(bitrates)]
+                cycle = 0.0
+                for command in ("C", f"S{bitrate}", "O"):
+                    ok, elapsed, buffer = timed_command(sock, buffer, command)
+                    # The first close may find the channel already closed
+                    if not ok and not (i == 0 and command == "C"):
+                        print(f"Cycle {i+1}: {command} failed")
+                        return False
+                    timings[command[0]].append(elapsed)
+                    cycle += elapsed
+                timings["cycle"].append(cycle)
+
+            for key, values in timings.items():
+                print_timings(key, values)
+
+            sock.send("C\r")
+            return True
+
+        finally:
+            sock.close()
+            print("Connection closed")
+
+    except bluetooth.BluetoothError as err:
+        print(err)
+        raise
+
+
+
+def main():
+
+    args = get_cli_args()
+    bitrates = [int(x) for x in args.bitrates.split(",")]
+
+    if not args.device_address:
+        device = find_device_address(args.device_name)
+    else:
+        device = args.device_address, args.device_name
+
+
+    if not args.service_channel or args.service_channel <= 0:
+        service = find_spp_service(device)
+    else:
+        service = {"host": args.device_address, "port": args.service_channel}
+
+
+    print("Starting bitrate cycles...")
+    do_bitrate_cycles(device, service, args.cycles, bitrates)
+
+
+
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,75 @@
+import sys, os
+import argparse
+import struct
+
+
+
+def get_cli_args():
+
+    # Set up the parser
+    parser = argparse.ArgumentParser()
+    parser.add_argument("-f", "--filename", type=str, help="Capture file (downloaded with btspp_download.py)", default="capture.bin")
+
+
+    # parse the arguments (uses sys.argv by default)
+    args = parser.parse_args()
+    return args
+
+
+
+# Capture file format as in include/can_capture.h
+CAPTURE_MAGIC = b"CAP1"
+CAPTURE_HEADER_SIZE = 16
+EXTENDED_ID_FLAG = 0x80000000
+RTR_FLAG = 0x40000000
+SOURCE_NAMES = {1: "frame", 2: "alert"}
+
+
+def read_capture(filename):
+
+    with open(filename, "rb") as file:
+        data = file.read()
+
+    magic, count, record_size, pre_trigger_count, source, _, alerts = struct.unpack_from("<4sHHHBBI", data, 0)
+    if magic != CAPTURE_MAGIC:
+        raise ValueError("Not a capture file")
+
+    frames = []
+    for i in range(count):
+        timestamp, identifier, dlc, payload = struct.unpack_from("<IIB3x8s", data, CAPTURE_HEADER_SIZE + i * record_size)
+        frames.append({
+            "timestamp": timestamp,
+            "identifier": identifier & 0x1FFFFFFF,
+            "extended": bool(identifier & EXTENDED_ID_FLAG),
+            "rtr": bool(identifier & RTR_FLAG),
+            "dlc": dlc,
+            "data": payload[:min(dlc, 8)] if not identifier & RTR_FLAG else b"",
+        })
+    return {"pre_trigger_count": pre_trigger_count, "source": source, "alerts": alerts, "frames": frames}
+
+
+
+def main():
+
+    args = get_cli_args()
+    capture = read_capture(args.filename)
+    frames = capture["frames"]
+    print(f'{len(frames)} frames, trigger: {SOURCE_NAMES.get(capture["source"], "?")}, alerts: 0x{capture["alerts"]:08X}')
+
+    # Timestamps relative to the trigger (first frame after an alert)
+    trigger = capture["pre_trigger_count"]
+    reference = frames[min(trigger, len(frames) - 1)]["timestamp"] if frames else 0
+    for i, frame in enumerate(frames):
+        if i == trigger:
+            print("---- trigger ----")
+        delta = ((frame["timestamp"] - reference + 0x80000000) & 0xFFFFFFFF) - 0x80000000
+        identifier = f'{frame["identifier"]:08X}' if frame["extended"] else f'{frame["identifier"]:03X}'
+        content = "remote request" if frame["rtr"] else frame["data"].hex(" ").upper()
+        print(f'({delta / 1e6:+11.6f}) {identifier:>8}  [{frame["dlc"]}]  {content}')
+
+
+
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,295 @@
+import sys, os, time
+import argparse
+import zlib
+import bluetooth
+
+
+
+def get_cli_args():
+
+    # Set up the parser
+    parser = argparse.ArgumentParser()
+    parser.add_argument("-f", "--filename", type=str, help="File on the device", default="capture.bin")
+    parser.add_argument("-o", "--output", type=str, help="Output File", default=None)
+    parser.add_argument("-r", "--resume", help="Resume a partial download", action="store_true")
+    parser.add_argument("-d", "--device_name", type=str, help="Bluetooth Device", default="SLCAN-BT-Adapter")
+    parser.add_argument("-a", "--device_address", type=str, help="Device Address", default=None)
+    parser.add_argument("-c", "--service_channel", type=int, help="Service Channel", default=None)
+
+
+    # parse the arguments (uses sys.argv by default)
+    args = parser.parse_args()
+    if not args.output:
+        args.output = args.filename
+    print(args)
+    return args
+
+def find_device_address(device_name):
+
+    print(f'Searching for device "{device_name}"....')
+    nearby_devices = bluetooth.discover_devices(duration=8, lookup_names=True, flush_cache=True, lookup_class=False)
+
+    try:
+        # check if device was found
+        idx = [x[1] for x in nearby_devices].index(device_name)
+        addr, name = nearby_devices[idx]
+        print(f'Device "{device_name}" was found at {addr}')
+        return addr, name
+
+    except ValueError:
+        num_devices_found = len(nearby_devices)
+        print(f'Device "{device_name}" was not found')
+        print(f"Found {num_devices_found} devices")
+
+        if num_devices_found <= 0:
+            print("Aborting...")
+            sys.exit()
+        else:
+            # Print a list of all found devices
+            for i, device in enumerate(nearby_devices):
+                addr, name = device
+                try:
+                    print(f"{i+1}.   {addr} - {name}")
+                except UnicodeEncodeError:
+                    print(f"{i+1}.   {addr} - {name.encode('utf-8', 'replace')}")
+            
+            while True:
+                try:
+                    choice = input("Choose a device: ")
+                    choice = int(choice)
+                    if choice == 0:
+                        print("Aborting...")
+                        sys.exit()
+                    elif choice > 0 and choice <= num_devices_found:
+                        addr, name = nearby_devices[choice-1]
+                        print(f'Device {addr} - {name} selected')
+                        return addr, name
+                    else:
+                        print("Invalid choice")
+
+                except ValueError:
+                    print("Aborting...")
+                    sys.exit()
+
+def find_spp_service(device):
+
+    # search for SPP service
+    addr, _ = device
+    service_matches = bluetooth.find_service(name=None, uuid="1101", address=addr) 
+
+    if len(service_matches) == 0:
+        print(f'Couldn\'t find a SSP service.')
+        sys.exit()
+    else:
+        print(f'Found {len(service_matches)} SSP service{"s" if len(service_matches) > 1 else ""}.')
+        for i, svc in enumerate(service_matches):
+            # svc = service_matches[0] # First match
+            print(f"{i+1}. Service Name:", svc["name"])
+            print("\t", "Host:       ", svc["host"])
+            print("\t", "Description:", svc["description"])
+            print("\t", "Provided By:", svc["provider"])
+            print("\t", "Protocol:   ", svc["protocol"])
+            print("\t", "channel/PSM:", svc["port"])
+            print("\t", "svc classes:", svc["service-classes"])
+            print("\t", "profiles:   ", svc["profiles"])
+            print("\t", "service id: ", svc["service-id"])
+
+        while True:
+            try:
+                choice = input("Choose a service: ")
+                choice = int(choice)
+                if choice == 0:
+                    print("Aborting...")
+                    sys.exit()
+                elif choice > 0 and choice <= len(service_matches):
+                    svc = service_matches[choice-1]
+                    print(f'Service {svc["name"]} selected')
+                    return svc
+                else:
+                    print("Invalid choice")
+
+            except ValueError:
+                print("Aborting...")
+                sys.exit()
+
+
+
+
+BLOCK_MAGIC = b"DB"
+BLOCK_HEADER_SIZE = 12
+
+
+def recv_line(sock, buffer):
+
+    # Read until a complete line is in the buffer
+    while b"\r\n" not in buffer:
+        data = sock.recv(4096)
+        if not data:
+            raise bluetooth.BluetoothError("Connection closed")
+        buffer += data
+    line, _, rest = buffer.partition(b"\r\n")
+    return str(line, encoding="utf8").strip(), rest
+
+
+def parse_file_info(msg):
+
+    # "FILESIZE = <n>, CRC = <crc32>, BLOCK SIZE = <b>, WINDOW = <w>"
+    info = {}
+    for field in msg.split(","):
+        key, _, value = field.partition("=")
+        info[key.strip()] = value.strip()
+    return int(info["FILESIZE"]), int(info["CRC"], 16), int(info["BLOCK SIZE"]), int(info["WINDOW"])
+
+
+def do_file_download(filename, output_filename, resume, device, service):
+
+    _, name = device
+    host, port = service["host"], service["port"]
+
+    try:
+        # Create the client socket
+        print(f"Connecting to \"{name}\" on {host} channel {port}")
+        sock = bluetooth.BluetoothSocket(bluetooth.RFCOMM)
+        sock.connect((host, port))
+
+        data, offset = None, 0
+        try:
+            print("Connected.")
+
+            # Start download process
+            print(f"START BT-DOWNLOAD {filename}")
+            sock.send(f"START BT-DOWNLOAD {filename}\r")
+
+            # Get file info
+            buffer = b""
+            msg, buffer = recv_line(sock, buffer)
+            print(msg)
+            if not msg.startswith("FILESIZE = "):
+                print("ABORT!")
+                return False
+            filesize, file_crc, block_size, window = parse_file_info(msg)
+            print(f"Filesize {filesize}, block size {block_size}, window {window}")
+
+            # Keep already received bytes if resuming
+            data = bytearray(filesize)
+            if resume and os.path.exists(output_filename):
+                with open(output_filename, "rb") as partial:
+                    existing = partial.read(filesize)
+                offset = len(existing) - (len(existing) % block_size)
+                data[:offset] = existing[:offset]
+            print(f"RESUME {offset}")
+            sock.send(f"RESUME {offset}\r\n")
+
+            # Receive blocks
+            received = {}
+            start_time = time.time()
+            start_offset = offset
+            while offset < filesize:
+
+                # Wait for a complete header
+                while len(buffer) < BLOCK_HEADER_SIZE:
+                    chunk = sock.recv(4096)
+                    if not chunk:
+                        raise bluetooth.BluetoothError("Connection closed")
+                    buffer += chunk
+
+                # Text message instead of a block
+                if buffer[:2] != BLOCK_MAGIC:
+                    if b"\r\n" in buffer[:32] or buffer.startswith(b"ABORT"):
+                        msg, buffer = recv_line(sock, buffer)
+                        print(msg)
+                        if msg.startswith("ABORT"):
+                            return False
+                        continue
+                    # Lost sync: skip to the next block and request the missing one
+                    idx = buffer.find(BLOCK_MAGIC, 1)
+                    buffer = buffer[idx:] if idx > 0 else b""
+                    sock.send(f"NAK {offset}\r\n")
+                    continue
+
+                length = int.from_bytes(buffer[2:4], "little")
+                block_offset = int.from_bytes(buffer[4:8], "little")
+                crc = int.from_bytes(buffer[8:12], "little")
+                header_crc = zlib.crc32(buffer[:8])
+                while len(buffer) < BLOCK_HEADER_SIZE + length:
+                    chunk = sock.recv(4096)
+                    if not chunk:
+                        raise bluetooth.BluetoothError("Connection closed")
+                    buffer += chunk
+                payload = buffer[BLOCK_HEADER_SIZE:BLOCK_HEADER_SIZE + length]
+                buffer = buffer[BLOCK_HEADER_SIZE + length:]
+
+                # Check block
+                if zlib.crc32(payload, header_crc) != crc or block_offset + length > filesize:
+                    print(f"CRC error in block at offset {block_offset}")
+                    sock.send(f"NAK {block_offset}\r\n")
+                    continue
+                received[block_offset] = payload
+
+                # Advance over all contiguous blocks and acknowledge them
+                while offset in received:
+                    payload = received.pop(offset)
+                    data[offset:offset + len(payload)] = payload
+                    offset += len(payload)
+                sock.send(f"ACK {offset}\r\n")
+
+                elapsed = time.time() - start_time
+                rate = (offset - start_offset) / elapsed if elapsed > 0 else 0.0
+                print(f"Received {offset}/{filesize} ({100*offset/filesize:.2f}%) at {rate/1024:.1f} KiB/s", end="\r")
+
+            print()
+            with open(output_filename, "wb") as output:
+                output.write(data)
+
+            # Check download end
+            msg, buffer = recv_line(sock, buffer)
+            print(msg)
+            if zlib.crc32(data) != file_crc:
+                print("CRC of the downloaded file does not match!")
+                return False
+            return msg == "DOWNLOAD COMPLETE!"
+
+        except Exception as err:
+            print(err)
+            raise
+
+        finally:
+            sock.close()
+            print("Connection closed")
+
+            # Keep the received part for a later resume
+            if data is not None and offset < len(data):
+                with open(output_filename, "wb") as output:
+                    output.write(data[:offset])
+                print(f"Saved {offset} bytes, use --resume to continue")
+
+    except bluetooth.BluetoothError as err:
+        print(err)
+        raise
+
+
+
+def main():
+
+    args = get_cli_args()
+    if not args.device_address:
+        device = find_device_address(args.device_name)
+    else:
+        device = args.device_address, args.device_name
+
+
+    if not args.service_channel or args.service_channel <= 0:
+        service = find_spp_service(device)
+    else:
+        service = {"host": args.device_address, "port": args.service_channel}
+
+
+    print("Starting file download...")
+    do_file_download(args.filename, args.output, args.resume, device, service)
+
+
+
+
+
+if __name__ == "__main__":
+    main()
@@ -1,6 +1,9 @@
 from math import ceil
 import sys, os, time
 import argparse
+import hashlib
+import zlib
+import collections
 import bluetooth
 
 
@@ -13,6 +16,12 @@ def get_cli_args():
     parser.add_argument("-d", "--device_name", type=str, help="Bluetooth Device", default="myESP32")
     parser.add_argument("-a", "--device_address", type=str, help="Device Address", default=None)
     parser.add_argument("-c", "--service_channel", type=int, help="Service Channel", default=None)
+    parser.add_argument("-p", "--protocol", type=str, help="OTA Protocol", choices=["legacy", "windowed"], default="windowed")
+    parser.add_argument("--chunk_size", type=int, help="Chunk Size (windowed protocol)", default=2048)
+    parser.add_argument("--window", type=int, help="Window Depth (windowed protocol)", default=8)
+    parser.add_argument("--compress", action="store_true", help="Send a LZSS compressed image (windowed protocol)")
+    parser.add_argument("--retries", type=int, help="Reconnect and resume after a lost connection (windowed protocol)", default=3)
+    parser.add_argument("--delta_base", type=str, help="Firmware running on the device, send a delta patch against it (windowed protocol)", default=None)
 
 
     # parse the arguments (uses sys.argv by default)
@@ -244,6 +253,370 @@ def do_firmware_update(firmware_filename, device, service):
 
 
 
+# LZSS stream format as in include/lzss.h
+LZSS_MAGIC = b"LZS1"
+LZSS_WINDOW_SIZE = 4096
+LZSS_MIN_MATCH = 3
+LZSS_MAX_MATCH = 18
+LZSS_MAX_CANDIDATES = 32
+
+
+def lzss_compress(data):
+
+    out = bytearray(LZSS_MAGIC + len(data).to_bytes(4, "little"))
+    candidates = {} # 3 byte prefix -> recent positions
+    n = len(data)
+    i = 0
+    while i < n:
+        flags_pos = len(out)
+        out.append(0)
+        flags = 0
+        for bit in range(8):
+            if i >= n:
+                break
+
+            # Find the longest match within the window
+            best_len, best_dist = 0, 0
+            max_len = min(LZSS_MAX_MATCH, n - i)
+            if max_len >= LZSS_MIN_MATCH:
+                for p in reversed(candidates.get(data[i:i + LZSS_MIN_MATCH], [])):
+                    dist = i - p
+                    if dist > LZSS_WINDOW_SIZE:
+                        break
+                    length = LZSS_MIN_MATCH
+                    while length < max_len and data[p + length] == data[i + length]:
+                        length += 1
+                    if length > best_len:
+                        best_len, best_dist = length, dist
+                        if length == max_len:
+                            break
+
+            if best_len >= LZSS_MIN_MATCH:
+                d = best_dist - 1
+                out.append(d & 0xFF)
+                out.append(((d >> 8) << 4) | (best_len - LZSS_MIN_MATCH))
+                step = best_len
+            else:
+                flags |= 1 << bit
+                out.append(data[i])
+                step = 1
+
+            # Remember the positions we passed
+            for k in range(i, min(i + step, n - LZSS_MIN_MATCH + 1)):
+                positions = candidates.setdefault(data[k:k + LZSS_MIN_MATCH], [])
+                positions.append(k)
+                if len(positions) > LZSS_MAX_CANDIDATES:
+                    del positions[0]
+            i += step
+        out[flags_pos] = flags
+    return bytes(out)
+
+
+def lzss_decompress(stream):
+
+    if stream[:4] != LZSS_MAGIC:
+        raise ValueError("Not a LZSS stream")
+    size = int.from_bytes(stream[4:8], "little")
+    out = bytearray()
+    i = 8
+    while len(out) < size:
+        flags = stream[i]
+        i += 1
+        for bit in range(8):
+            if len(out) >= size:
+                break
+            if flags & (1 << bit):
+                out.append(stream[i])
+                i += 1
+            else:
+                b0, b1 = stream[i], stream[i + 1]
+                i += 2
+                dist = (b0 | ((b1 & 0xF0) << 4)) + 1
+                for _ in range((b1 & 0x0F) + LZSS_MIN_MATCH):
+                    out.append(out[-dist])
+    return bytes(out)
+
+
+
+# Delta patch format as in include/delta_patch.h
+DELTA_MAGIC = b"DLT1"
+DELTA_BLOCK_SIZE = 16 # Length of the keys used to find matches
+DELTA_INDEX_STEP = 4 # Index every 4th position of the base
+DELTA_MIN_COPY = 32 # Shorter matches are inserted
+APP_DESC_OFFSET = 24 + 8 # esp_image_header_t + esp_image_segment_header_t
+APP_DESC_MAGIC = 0xABCD5432
+APP_ELF_SHA256_OFFSET = APP_DESC_OFFSET + 144
+
+
+def get_app_elf_sha256(image):
+
+    if int.from_bytes(image[APP_DESC_OFFSET:APP_DESC_OFFSET + 4], "little") != APP_DESC_MAGIC:
+        raise ValueError("No app description in the base image")
+    return image[APP_ELF_SHA256_OFFSET:APP_ELF_SHA256_OFFSET + 32]
+
+
+def delta_make_patch(base, image):
+
+    # Index the base image
+    index = {}
+    for j in range(0, len(base) - DELTA_BLOCK_SIZE + 1, DELTA_INDEX_STEP):
+        index.setdefault(base[j:j + DELTA_BLOCK_SIZE], j)
+
+    ops = []
+    insert_start = 0
+    i = 0
+    n = len(image)
+    while i <= n - DELTA_BLOCK_SIZE:
+        j = index.get(image[i:i + DELTA_BLOCK_SIZE])
+        if j is None:
+            i += 1
+            continue
+
+        # Extend the match forwards (in blocks first) and backwards into the pending insert
+        length = DELTA_BLOCK_SIZE
+        while i + length + 64 <= n and j + length + 64 <= len(base) and image[i + length:i + length + 64] == base[j + length:j + length + 64]:
+            length += 64
+        while i + length < n and j + length < len(base) and image[i + length] == base[j + length]:
+            length += 1
+        while i > insert_start and j > 0 and image[i - 1] == base[j - 1]:
+            i, j, length = i - 1, j - 1, length + 1
+
+        if length < DELTA_MIN_COPY:
+            i += 1
+            continue
+        if i > insert_start:
+            ops.append(("I", insert_start, i - insert_start))
+        ops.append(("C", j, length))
+        i += length
+        insert_start = i
+    if insert_start < n:
+        ops.append(("I", insert_start, n - insert_start))
+
+    patch = bytearray(DELTA_MAGIC + n.to_bytes(4, "little") + get_app_elf_sha256(base) + hashlib.sha256(image).digest())
+    for op, offset, length in ops:
+        if op == "C":
+            patch += b"C" + offset.to_bytes(4, "little") + length.to_bytes(4, "little")
+        else:
+            patch += b"I" + bytes(4) + length.to_bytes(4, "little") + image[offset:offset + length]
+    return bytes(patch)
+
+
+def delta_apply_patch(base, patch):
+
+    if patch[:4] != DELTA_MAGIC:
+        raise ValueError("Not a delta patch")
+    size = int.from_bytes(patch[4:8], "little")
+    out = bytearray()
+    i = 72
+    while i < len(patch):
+        op, offset, length = patch[i:i + 1], int.from_bytes(patch[i + 1:i + 5], "little"), int.from_bytes(patch[i + 5:i + 9], "little")
+        i += 9
+        if op == b"C":
+            out += base[offset:offset + length]
+        else:
+            out += patch[i:i + length]
+            i += length
+    if len(out) != size or hashlib.sha256(out).digest() != patch[40:72]:
+        raise ValueError("Patched image doesn't match")
+    return bytes(out)
+
+
+
+class LineReader:
+
+    def __init__(self, sock):
+        self.sock = sock
+        self.buffer = b""
+
+    def readline(self):
+
+        # Read until a complete line is in the buffer
+        while b"\r\n" not in self.buffer:
+            data = self.sock.recv(1024)
+            if not data:
+                raise bluetooth.BluetoothError("Connection closed")
+            self.buffer += data
+        line, _, self.buffer = self.buffer.partition(b"\r\n")
+        return str(line, encoding="utf8").strip()
+
+
+def do_windowed_firmware_update(firmware_filename, device, service, chunk_size, window, compress=False, delta_base=None):
+
+    _, name = device
+    host, port = service["host"], service["port"]
+
+    try:
+        # Create the client socket
+        print(f"Connecting to \"{name}\" on {host} channel {port}")
+        sock = bluetooth.BluetoothSocket(bluetooth.RFCOMM)
+        sock.connect((host, port))
+        reader = LineReader(sock)
+
+        try:
+            print("Connected.")
+
+            with open(firmware_filename, "rb") as firmware:
+                image = firmware.read()
+
+            # The SHA-256 of the firmware is checked by the device and identifies the image when resuming
+            image_sha256 = hashlib.sha256(image).hexdigest()
+
+            # Build a patch against the running firmware and make sure it applies
+            image_format = "RAW"
+            if delta_base:
+                with open(delta_base, "rb") as base_file:
+                    base = base_file.read()
+                start_time = time.time()
+                patch = delta_make_patch(base, image)
+                print(f"Delta patch has {len(patch)} bytes ({100*len(patch)/len(image):.1f}% of {len(image)}), built in {time.time() - start_time:.1f} s")
+                delta_apply_patch(base, patch)
+                image = patch
+                image_format = "DELTA"
+
+            # Compress the image and make sure it decompresses to the original
+            elif compress:
+                start_time = time.time()
+                compressed = lzss_compress(image)
+                print(f"Compressed {len(image)} to {len(compressed)} bytes ({100*len(compressed)/len(image):.1f}%) in {time.time() - start_time:.1f} s")
+                if lzss_decompress(compressed) != image:
+                    print("Compression check failed!")
+                    return False
+                image = compressed
+                image_format = "LZSS"
+
+            # Start update process
+            print("Starting windowed OTA-Update....")
+            print("START BT-OTA WINDOWED")
+            sock.send("START BT-OTA WINDOWED\r")
+
+            # Initial Handshake
+            msg = reader.readline()
+            print(msg)
+            if msg != "DO FIRMWARE UPLOAD?":
+                print("ABORT!")
+                sock.send("ABORT!\r\n")
+                return False
+            print("YES")
+            sock.send("YES\r\n")
+
+            # Send firmware filesize
+            msg = reader.readline()
+            print(msg)
+            if msg != "FIRMWARE FILESIZE?":
+                print("ABORT!")
+                sock.send("ABORT!\r\n")
+                return False
+            print(f"{len(image)}, SHA256 = {image_sha256}")
+            sock.send(f"{len(image)}, SHA256 = {image_sha256}\r\n")
+
+            # Negotiate chunk size and window
+            msg = reader.readline()
+            print(msg)
+            if not msg.startswith("MAX CHUNK SIZE = "):
+                print("ABORT!")
+                sock.send("ABORT!\r\n")
+                return False
+            limits = dict(field.split(" = ") for field in msg.split(", "))
+            chunk_size = min(chunk_size, int(limits["MAX CHUNK SIZE"]))
+            window = min(window, int(limits["MAX WINDOW"]))
+            use_crc = "CRC32" in limits.get("CHECKS", "").split()
+            answer = f"CHUNK SIZE = {chunk_size}, WINDOW = {window}"
+            if image_format != "RAW":
+                if image_format not in limits.get("FORMATS", "").split():
+                    print(f"Device doesn't support {image_format} images")
+                    print("ABORT!")
+                    sock.send("ABORT!\r\n")
+                    return False
+                answer += f", FORMAT = {image_format}"
+            if use_crc:
+                answer += ", CHECKS = CRC32"
+            print(answer)
+            sock.send(answer + "\r\n")
+
+            msg = reader.readline()
+            print(msg)
+            if msg == "START UPLOAD!":
+                offset = 0
+            elif msg.startswith("RESUME UPLOAD AT ") and msg.endswith("!"):
+                offset = int(msg[17:-1])
+            else:
+                return False
+
+            # Stream chunks, keep at most 'window' chunks unacknowledged
+            # The device answers every chunk with one ACK or NAK (except chunks hidden by a corrupted header)
+            # and repeats its NAK while it waits for the chunk it asked for
+            start_time = time.time()
+            start_offset = offset
+            acked_offset = offset
+            pending = collections.deque()  # End offsets of the chunks sent since the last go-back
+            stale = 0  # Answers still due for chunks sent before the last go-back
+            go_back_offset = None
+            retransmissions = 0
+            while acked_offset < len(image):
+
+                # Fill the window
+                while offset < len(image) and len(pending) < window:
+                    chunk = image[offset:offset + chunk_size]
+                    if use_crc:
+                        header = b"OD" + len(chunk).to_bytes(2, "little") + offset.to_bytes(4, "little")
+                        header += zlib.crc32(chunk, zlib.crc32(header)).to_bytes(4, "little")
+                        header += zlib.crc32(header).to_bytes(4, "little")
+                    else:
+                        header = b"OC" + len(chunk).to_bytes(2, "little") + offset.to_bytes(4, "little")
+                    sock.send(header + chunk)
+                    offset += len(chunk)
+                    pending.append(offset)
+
+                # Wait for the next acknowledge
+                msg = reader.readline()
+                if msg.startswith("NAK "):
+                    nak_offset = int(msg[4:])
+                    if stale > 0 and nak_offset == go_back_offset:
+                        # A chunk sent before we went back, the device dropped it
+                        stale -= 1
+                    else:
+                        # Go back to the rejected chunk once, the chunks still in flight are dropped by the device
+                        stale += len(pending) - 1 if pending else 0
+                        pending.clear()
+                        offset = nak_offset
+                        go_back_offset = nak_offset
+                        retransmissions += 1
+                elif msg.startswith("ACK "):
+                    # Answers come in order, so all chunks sent before the go-back were answered
+                    stale = 0
+                    acked_offset = max(acked_offset, int(msg[4:]))
+                    while pending and pending[0] <= acked_offset:
+                        pending.popleft()
+                    elapsed = time.time() - start_time
+                    rate = (acked_offset - start_offset) / elapsed if elapsed > 0 else 0.0
+                    print(f"Uploaded {acked_offset}/{len(image)} ({100*acked_offset/len(image):.2f}%) at {rate/1024:.1f} KiB/s", end="\r")
+                else:
+                    print()
+                    print(msg)
+                    return False
+
+            print()
+            print(f"Upload took {time.time() - start_time:.1f} s ({retransmissions} retransmissions)")
+
+            # check OTA end
+            msg = reader.readline()
+            print(msg)
+            return msg == "OK!"
+
+        except Exception as err:
+            print(err)
+            raise
+
+        finally:
+            sock.close()
+            print("Connection closed")
+
+    except bluetooth.BluetoothError as err:
+        print(err)
+        raise
+
+
+
 def main():
 
     args = get_cli_args()
@@ -261,7 +634,19 @@ def main():
 
     print("Starting firmware update...")
     time.sleep(5.0)
-    do_firmware_update(args.firmware, device, service)
+    if args.protocol == "legacy":
+        do_firmware_update(args.firmware, device, service)
+    else:
+        for attempt in range(args.retries + 1):
+            try:
+                do_windowed_firmware_update(args.firmware, device, service, args.chunk_size, args.window, args.compress, args.delta_base)
+                break
+            except bluetooth.BluetoothError:
+                if attempt == args.retries:
+                    raise
+                # Give the device time to notice the lost connection
+                print("Connection lost, retrying...")
+                time.sleep(10.0)
 
 
     
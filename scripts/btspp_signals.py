@@ -0,0 +1,269 @@
+import sys, os, time
+import argparse
+import csv
+import struct
+import zlib
+import bluetooth
+
+
+
+def get_cli_args():
+
+    # Set up the parser
+    parser = argparse.ArgumentParser()
+    parser.add_argument("-s", "--signals", type=str, help="Signal definitions (CSV)", default="signals.csv")
+    parser.add_argument("-o", "--output", type=str, help="Only write the binary signal database to this file", default=None)
+    parser.add_argument("--clear", help="Remove all signals from the device", action="store_true")
+    parser.add_argument("-d", "--device_name", type=str, help="Bluetooth Device", default="SLCAN-BT-Adapter")
+    parser.add_argument("-a", "--device_address", type=str, help="Device Address", default=None)
+    parser.add_argument("-c", "--service_channel", type=int, help="Service Channel", default=None)
+
+
+    # parse the arguments (uses sys.argv by default)
+    args = parser.parse_args()
+    print(args)
+    return args
+
+def find_device_address(device_name):
+
+    print(f'Searching for device "{device_name}"....')
+    nearby_devices = bluetooth.discover_devices(duration=8, lookup_names=True, flush_cache=True, lookup_class=False)
+
+    try:
+        # check if device was found
+        idx = [x[1] for x in nearby_devices].index(device_name)
+        addr, name = nearby_devices[idx]
+        print(f'Device "{device_name}" was found at {addr}')
+        return addr, name
+
+    except ValueError:
+        num_devices_found = len(nearby_devices)
+        print(f'Device "{device_name}" was not found')
+        print(f"Found {num_devices_found} devices")
+
+        if num_devices_found <= 0:
+            print("Aborting...")
+            sys.exit()
+        else:
+            # Print a list of all found devices
+            for i, device in enumerate(nearby_devices):
+                addr, name = device
+                try:
+                    print(f"{i+1}.   {addr} - {name}")
+                except UnicodeEncodeError:
+                    print(f"{i+1}.   {addr} - {name.encode('utf-8', 'replace')}")
+            
+            while True:
+                try:
+                    choice = input("Choose a device: ")
+                    choice = int(choice)
+                    if choice == 0:
+                        print("Aborting...")
+                        sys.exit()
+                    elif choice > 0 and choice <= num_devices_found:
+                        addr, name = nearby_devices[choice-1]
+                        print(f'Device {addr} - {name} selected')
+                        return addr, name
+                    else:
+                        print("Invalid choice")
+
+                except ValueError:
+                    print("Aborting...")
+                    sys.exit()
+
+def find_spp_service(device):
+
+    # search for SPP service
+    addr, _ = device
+    service_matches = bluetooth.find_service(name=None, uuid="1101", address=addr) 
+
+    if len(service_matches) == 0:
+        print(f'Couldn\'t find a SSP service.')
+        sys.exit()
+    else:
+        print(f'Found {len(service_matches)} SSP service{"s" if len(service_matches) > 1 else ""}.')
+        for i, svc in enumerate(service_matches):
+            # svc = service_matches[0] # First match
+            print(f"{i+1}. Service Name:", svc["name"])
+            print("\t", "Host:       ", svc["host"])
+            print("\t", "Description:", svc["description"])
+            print("\t", "Provided By:", svc["provider"])
+            print("\t", "Protocol:   ", svc["protocol"])
+            print("\t", "channel/PSM:", svc["port"])
+            print("\t", "svc classes:", svc["service-classes"])
+            print("\t", "profiles:   ", svc["profiles"])
+            print("\t", "service id: ", svc["service-id"])
+
+        while True:
+            try:
+                choice = input("Choose a service: ")
+                choice = int(choice)
+                if choice == 0:
+                    print("Aborting...")
+                    sys.exit()
+                elif choice > 0 and choice <= len(service_matches):
+                    svc = service_matches[choice-1]
+                    print(f'Service {svc["name"]} selected')
+                    return svc
+                else:
+                    print("Invalid choice")
+
+            except ValueError:
+                print("Aborting...")
+                sys.exit()
+
+
+
+
+# Signal database format as in include/can_signals.h
+SIGNALS_MAGIC = b"SDB1"
+SIGNALS_ENTRY_SIZE = 20
+SIGNALS_MAX_SIGNALS = 256
+EXTENDED_ID_FLAG = 0x80000000
+FLAG_MOTOROLA = 0x01
+FLAG_SIGNED = 0x02
+
+
+def read_signal_definitions(filename):
+
+    # CSV columns: can_id, extended, signal_id, start_bit, length, byte_order (intel/motorola), signed, scale, offset
+    signals = []
+    with open(filename, newline="") as file:
+        for row in csv.DictReader(file):
+            signals.append({
+                "can_id": int(row["can_id"], 0),
+                "extended": row["extended"].strip().lower() in ("1", "true", "yes"),
+                "signal_id": int(row["signal_id"], 0),
+                "start_bit": int(row["start_bit"]),
+                "length": int(row["length"]),
+                "motorola": row["byte_order"].strip().lower() == "motorola",
+                "signed": row["signed"].strip().lower() in ("1", "true", "yes"),
+                "scale": float(row["scale"]),
+                "offset": float(row["offset"]),
+            })
+    return signals
+
+
+def build_signal_database(signals):
+
+    if len(signals) > SIGNALS_MAX_SIGNALS:
+        raise ValueError(f"Too many signals ({len(signals)} > {SIGNALS_MAX_SIGNALS})")
+    entries = b""
+    for signal in signals:
+        identifier = signal["can_id"] | (EXTENDED_ID_FLAG if signal["extended"] else 0)
+        flags = (FLAG_MOTOROLA if signal["motorola"] else 0) | (FLAG_SIGNED if signal["signed"] else 0)
+        entries += struct.pack("<IHBBB3xff", identifier, signal["signal_id"], signal["start_bit"], signal["length"], flags, signal["scale"], signal["offset"])
+    return SIGNALS_MAGIC + struct.pack("<HHI", len(signals), SIGNALS_ENTRY_SIZE, zlib.crc32(entries)) + entries
+
+
+def decode_signal(signal, data):
+
+    # Reference decoder, walks the bits like a DBC tool
+    raw = 0
+    bit = signal["start_bit"]
+    for i in range(signal["length"]):
+        if bit // 8 >= len(data):
+            return None
+        value = (data[bit // 8] >> (bit % 8)) & 1
+        if signal["motorola"]:
+            # MSB first, sawtooth numbering
+            raw = (raw << 1) | value
+            bit = bit - 1 if bit % 8 != 0 else bit + 15
+        else:
+            raw |= value << i
+            bit += 1
+    if signal["signed"] and raw >> (signal["length"] - 1):
+        raw -= 1 << signal["length"]
+    return raw * signal["scale"] + signal["offset"]
+
+
+def recv_line(sock, buffer):
+
+    # Read until a complete line is in the buffer
+    while b"\r\n" not in buffer:
+        data = sock.recv(4096)
+        if not data:
+            raise bluetooth.BluetoothError("Connection closed")
+        buffer += data
+    line, _, rest = buffer.partition(b"\r\n")
+    return str(line, encoding="utf8").strip(), rest
+
+
+def do_signal_upload(database, device, service):
+
+    _, name = device
+    host, port = service["host"], service["port"]
+
+    try:
+        # Create the client socket
+        print(f"Connecting to \"{name}\" on {host} channel {port}")
+        sock = bluetooth.BluetoothSocket(bluetooth.RFCOMM)
+        sock.connect((host, port))
+        buffer = b""
+
+        try:
+            print("Connected.")
+
+            # The CAN channel must be closed for the upload (answer is CR or BELL)
+            sock.send("C\r")
+            time.sleep(1.5)
+            sock.recv(1024)
+
+            print(f"START SIGNAL-UPLOAD {len(database)}")
+            sock.send(f"START SIGNAL-UPLOAD {len(database)}\r")
+            if database:
+                msg, buffer = recv_line(sock, buffer)
+                print(msg)
+                if msg != "READY":
+                    return False
+                sock.send(database)
+
+            msg, buffer = recv_line(sock, buffer)
+            print(msg)
+            return msg == "OK!"
+
+        finally:
+            sock.close()
+            print("Connection closed")
+
+    except bluetooth.BluetoothError as err:
+        print(err)
+        raise
+
+
+
+def main():
+
+    args = get_cli_args()
+    database = b""
+    if not args.clear:
+        signals = read_signal_definitions(args.signals)
+        database = build_signal_database(signals)
+        print(f"{len(signals)} signals, {len(database)} bytes")
+
+    if args.output:
+        with open(args.output, "wb") as file:
+            file.write(database)
+        return
+
+    if not args.device_address:
+        device = find_device_address(args.device_name)
+    else:
+        device = args.device_address, args.device_name
+
+
+    if not args.service_channel or args.service_channel <= 0:
+        service = find_spp_service(device)
+    else:
+        service = {"host": args.device_address, "port": args.service_channel}
+
+
+    print("Starting signal upload...")
+    do_signal_upload(database, device, service)
+
+
+
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,61 @@
+#include "boot_timeline.h"
+
+// Timer API
+#include "esp_timer.h" // esp_timer_get_time
+
+
+// Header for debug messages
+#define LOG_LOCAL_LEVEL ESP_LOG_INFO
+#include "esp_log.h"
+#define TAG "BOOT"
+
+
+// Time of each milestone in us since startup (0 if not reached yet)
+static int64_t boot_event_times_us[BOOT_EVENT_COUNT] = { 0 };
+
+static const char* const boot_event_names[BOOT_EVENT_COUNT] = {
+    [BOOT_EVENT_APP_MAIN] = "app_main",
+    [BOOT_EVENT_NVS_READY] = "NVS ready",
+    [BOOT_EVENT_CONFIG_RESTORED] = "Config restored",
+    [BOOT_EVENT_CAN_OPEN] = "CAN channel open",
+    [BOOT_EVENT_FIRST_FRAME] = "First CAN frame captured",
+    [BOOT_EVENT_BT_STACK_READY] = "Bluetooth stack ready",
+    [BOOT_EVENT_SPP_READY] = "SPP server ready",
+    [BOOT_EVENT_FIRST_CLIENT] = "First SPP client connected",
+};
+
+
+// Record the time of a milestone (only the first call per event counts)
+void boot_timeline_mark(const boot_event_t event) {
+    if (event >= BOOT_EVENT_COUNT) { return; }
+    if (boot_event_times_us[event] != 0) { return; }
+
+    boot_event_times_us[event] = esp_timer_get_time();
+    ESP_LOGI(TAG, "%s after %d ms", boot_event_names[event], boot_timeline_get_ms(event));
+
+    // Print the whole timeline once capture and bluetooth are both up
+    if (boot_event_times_us[BOOT_EVENT_SPP_READY] != 0 && boot_event_times_us[BOOT_EVENT_FIRST_FRAME] != 0 
+        && (event == BOOT_EVENT_SPP_READY || event == BOOT_EVENT_FIRST_FRAME)) {
+        boot_timeline_report();
+    }
+}
+
+// Get the time of a milestone in ms since startup (-1 if not reached yet)
+int32_t boot_timeline_get_ms(const boot_event_t event) {
+    if (event >= BOOT_EVENT_COUNT) { return -1; }
+    if (boot_event_times_us[event] == 0) { return -1; }
+    return (int32_t) (boot_event_times_us[event] / 1000);
+}
+
+// Print all milestones reached so far
+void boot_timeline_report() {
+    ESP_LOGI(TAG, "Boot timeline (ms since startup):");
+    for (uint32_t i = 0; i < BOOT_EVENT_COUNT; ++i) {
+        if (boot_event_times_us[i] != 0) {
+            ESP_LOGI(TAG, "  %6d ms  %s", boot_timeline_get_ms(i), boot_event_names[i]);
+        }
+        else {
+            ESP_LOGI(TAG, "       -     %s", boot_event_names[i]);
+        }
+    }
+}
@@ -1,10 +1,16 @@
 #include "btspp.h"
 
 #include "HardwareConfig.h"
+#include "boot_timeline.h"
 
 // Some standard header
+#include <stdio.h> // sscanf, snprintf
 #include <string.h> // memcpy
 
+// Helper for the file download
+#include "buffer_access.h"
+#include "file_access.h"
+
 
 // Bluetooth header
 #include "esp_bt.h"
@@ -21,8 +27,12 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/ringbuf.h"
 #include "freertos/event_groups.h"
+#include "freertos/semphr.h"
 #include "freertos/task.h" // vTaskDelay()
 
+// Timer API
+#include "esp_timer.h" // esp_timer_get_time
+
 
 
 // Header for debug messages
@@ -37,6 +47,9 @@
 #include "esp_ota_ops.h"
 #include "esp_partition.h"
 
+// CRC32 (ROM function)
+#include "esp_rom_crc.h"
+
 
 // Do a OTA uptade via Bluetooth SPP
 #define OTA_TAG "BT-OTA"
@@ -330,6 +343,200 @@ bool btspp_do_ota_update() {
 
 
 
+// Download a file via Bluetooth SPP
+//
+// Protocol (after the host sent "START BT-DOWNLOAD <filename>\r"):
+// 1. Device: "FILESIZE = <n>, CRC = <crc32>, BLOCK SIZE = <b>, WINDOW = <w>\r\n"
+// 2. Host:   "RESUME <offset>\r\n" (0 for a fresh download)
+// 3. Device streams up to <w> unacknowledged blocks. Each block has a 12 byte header:
+//    'D' 'B' | payload length (uint16) | file offset (uint32) | CRC32 (uint32)
+//    The CRC32 covers the first 8 header bytes and the payload. All header values are little endian.
+// 4. Host:   "ACK <offset>\r\n" (all bytes before <offset> received)
+//            "NAK <offset>\r\n" (retransmit only the block at <offset>)
+// 5. Device: "DOWNLOAD COMPLETE!\r\n" when all bytes are acknowledged
+#define DL_TAG "BT-DOWNLOAD"
+#define DOWNLOAD_BLOCK_MAGIC_0 'D'
+#define DOWNLOAD_BLOCK_MAGIC_1 'B'
+#define DOWNLOAD_BLOCK_HEADER_SIZE (12u)
+#define DOWNLOAD_BLOCK_SIZE (BTSPP_MSG_MAX_SIZE - 54u) // 896 bytes payload + 12 bytes header
+#define DOWNLOAD_WINDOW_SIZE (8u) // Can be more than SPP_CLIENT_SEND_CREDITS, the download has the link to itself and waits for credits
+#define DOWNLOAD_ACK_TIMEOUT_MS (2000u)
+#define DOWNLOAD_MAX_RETRIES (5u)
+#define DOWNLOAD_CTRL_MSG_MAX_SIZE (32u)
+static uint8_t download_block[DOWNLOAD_BLOCK_HEADER_SIZE + DOWNLOAD_BLOCK_SIZE] = { 0 };
+static char download_ctrl_msg[DOWNLOAD_CTRL_MSG_MAX_SIZE] = "";
+static uint32_t download_ctrl_msg_len = 0;
+
+
+// Read a single block from the file and send it with header and CRC
+static bool download_send_block(FILE* const file, const uint32_t offset, const uint32_t filesize) {
+
+    // Size of this block
+    const uint32_t remaining = filesize - offset;
+    const uint32_t len = (remaining < DOWNLOAD_BLOCK_SIZE ? remaining : DOWNLOAD_BLOCK_SIZE);
+
+    // Read payload
+    uint8_t* const payload = download_block + DOWNLOAD_BLOCK_HEADER_SIZE;
+    if (seek_in_file(file, offset) != 0) { return false; }
+    if (read_data_from_file(file, payload, len) != (int) len) { return false; }
+
+    // Build header
+    download_block[0] = DOWNLOAD_BLOCK_MAGIC_0;
+    download_block[1] = DOWNLOAD_BLOCK_MAGIC_1;
+    copy_uint16_into_buffer_12((uint16_t) len, download_block + 2);
+    copy_uint32_into_buffer_1234(offset, download_block + 4);
+    const uint32_t header_crc = esp_rom_crc32_le(0, download_block, 8);
+    copy_uint32_into_buffer_1234(esp_rom_crc32_le(header_crc, payload, len), download_block + 8);
+
+    ESP_LOGV(DL_TAG, "Sending block at offset %u (len = %u)", offset, len);
+    return btspp_send_data(download_block, DOWNLOAD_BLOCK_HEADER_SIZE + len, 2000);
+}
+
+// Collect control messages from the host without blocking the block stream
+// Partial messages are kept until the rest arrives
+// Returns true if a complete message is available in 'download_ctrl_msg'
+static bool download_recv_ctrl_msg(const uint32_t timeout_ms) {
+    uint8_t c = 0;
+    uint32_t time_to_wait_ms = timeout_ms;
+
+    while (btspp_recv(&c, 1, time_to_wait_ms) == 1) {
+        time_to_wait_ms = 0; // Only wait for the first character
+        if (c == '\n') {
+            download_ctrl_msg[download_ctrl_msg_len] = '\0';
+            download_ctrl_msg_len = 0;
+            return true;
+        }
+        else if (c != '\r' && download_ctrl_msg_len < DOWNLOAD_CTRL_MSG_MAX_SIZE - 1) {
+            download_ctrl_msg[download_ctrl_msg_len++] = (char) c;
+        }
+    }
+    return false;
+}
+
+// Download a file from the storage partition via Bluetooth SPP
+// You need my custom python script for that
+bool btspp_do_file_download(const char* filename) {
+
+    ESP_LOGI(DL_TAG, "Starting BT-Download of '%s'", filename);
+    char msg[96];
+
+    // Open the file
+    if (!mount_filesystem()) {
+        btspp_send_msg("ABORT!\r\n", 2000);
+        return false;
+    }
+    const int file_size = get_file_size_from_filesystem(filename);
+    FILE* file = (file_size >= 0 ? open_file(filename, "rb") : NULL);
+    if (file == NULL) {
+        ESP_LOGE(DL_TAG, "Error: File '%s' not found", filename);
+        btspp_send_msg("ABORT!\r\n", 2000);
+        return false;
+    }
+    const uint32_t filesize = (uint32_t) file_size;
+
+    // CRC over the whole file so the host can verify the result
+    uint32_t file_crc = 0;
+    uint8_t* const payload = download_block + DOWNLOAD_BLOCK_HEADER_SIZE;
+    int bytes_read = 0;
+    while ((bytes_read = read_data_from_file(file, payload, DOWNLOAD_BLOCK_SIZE)) > 0) {
+        file_crc = esp_rom_crc32_le(file_crc, payload, bytes_read);
+    }
+
+    // Announce file and transfer parameters
+    snprintf(msg, sizeof(msg), "FILESIZE = %u, CRC = %08X, BLOCK SIZE = %u, WINDOW = %u\r\n",
+        filesize, file_crc, DOWNLOAD_BLOCK_SIZE, DOWNLOAD_WINDOW_SIZE
+    );
+    bool success = btspp_send_msg(msg, 2000);
+
+    // Get the resume offset
+    uint32_t acked_offset = 0;
+    download_ctrl_msg_len = 0;
+    if (success) {
+        if (!download_recv_ctrl_msg(5000) || sscanf(download_ctrl_msg, "RESUME %u", &acked_offset) != 1 || acked_offset > filesize) {
+            ESP_LOGE(DL_TAG, "Error: SPP answer error");
+            btspp_send_msg("ABORT!\r\n", 2000);
+            success = false;
+        }
+        else {
+            ESP_LOGI(DL_TAG, "Resuming at offset %u of %u", acked_offset, filesize);
+        }
+    }
+
+    // Stream blocks
+    uint32_t next_offset = acked_offset;
+    uint32_t retries = 0;
+    const int64_t start_time = esp_timer_get_time();
+    while (success && acked_offset < filesize) {
+
+        // Fill the window
+        while (next_offset < filesize && next_offset < acked_offset + DOWNLOAD_WINDOW_SIZE * DOWNLOAD_BLOCK_SIZE) {
+            if (!download_send_block(file, next_offset, filesize)) {
+                ESP_LOGE(DL_TAG, "Error: Sending block at offset %u failed", next_offset);
+                success = false;
+                break;
+            }
+            next_offset += DOWNLOAD_BLOCK_SIZE;
+            if (next_offset > filesize) { next_offset = filesize; }
+        }
+        if (!success) { break; }
+
+        // Only block if the window is full (or everything has been sent)
+        const bool window_full = (next_offset >= filesize || next_offset >= acked_offset + DOWNLOAD_WINDOW_SIZE * DOWNLOAD_BLOCK_SIZE);
+        if (!download_recv_ctrl_msg(window_full ? DOWNLOAD_ACK_TIMEOUT_MS : 0)) {
+            if (window_full) {
+                // No answer: Go back to the last acknowledged block
+                if (++retries > DOWNLOAD_MAX_RETRIES) {
+                    ESP_LOGE(DL_TAG, "Timeout: No ACK from host");
+                    success = false;
+                }
+                else {
+                    ESP_LOGW(DL_TAG, "Timeout: Resending from offset %u", acked_offset);
+                    next_offset = acked_offset;
+                }
+            }
+            continue;
+        }
+
+        // Handle control message
+        uint32_t offset = 0;
+        if (sscanf(download_ctrl_msg, "ACK %u", &offset) == 1) {
+            if (offset > acked_offset && offset <= next_offset) {
+                acked_offset = offset;
+                retries = 0;
+            }
+        }
+        else if (sscanf(download_ctrl_msg, "NAK %u", &offset) == 1) {
+            // Selective retransmit of a single block
+            if (offset >= acked_offset && offset < next_offset) {
+                ESP_LOGW(DL_TAG, "NAK: Resending block at offset %u", offset);
+                success = download_send_block(file, offset, filesize);
+            }
+        }
+        else if (strncmp(download_ctrl_msg, "ABORT", 5) == 0) {
+            ESP_LOGW(DL_TAG, "Aborted by host");
+            success = false;
+        }
+        else {
+            ESP_LOGW(DL_TAG, "Unknown control message '%s'", download_ctrl_msg);
+        }
+    }
+
+    close_file(file);
+
+    if (!success) {
+        btspp_send_msg("ABORT!\r\n", 2000);
+        return false;
+    }
+
+    const int64_t duration_us = esp_timer_get_time() - start_time;
+    ESP_LOGI(DL_TAG, "Download complete: %u bytes in %lld ms", filesize, duration_us / 1000);
+    btspp_send_msg("DOWNLOAD COMPLETE!\r\n", 2000);
+    return true;
+}
+
+
+
+
 
 // Bluetooth parameter
 #define SPP_SERVER_NAME HARDWARE_CONFIG_SPP_SERVICE_NAME
@@ -339,13 +546,50 @@ static char BT_DEVICE_NAME[BT_DEVICE_NAME_MAX_LEN+1] = HAREWARE_CONFIG_BT_DEVICE
 static const esp_spp_mode_t esp_spp_mode = ESP_SPP_MODE_CB; // When data is coming, a callback will come with data
 static const esp_spp_sec_t sec_mask = ESP_SPP_SEC_AUTHENTICATE;
 static const esp_spp_role_t role_slave = ESP_SPP_ROLE_SLAVE;
-static uint32_t spp_connection_handle = 0;
+
+// Connected SPP clients
+// Every client has its own handle, receive framing state and send credits.
+// Data sent with 'btspp_send()' goes to all clients, a client that can't keep up
+// misses messages instead of stalling the others. Answers ('btspp_reply()') only go
+// to the client that sent the data read last. During a transfer ('btspp_set_exclusive()')
+// the requesting client has the link to itself.
+#define SPP_MAX_CLIENTS HARDWARE_CONFIG_SPP_MAX_CLIENTS
+#define SPP_CLIENT_SEND_CREDITS 4 // Writes in flight per client
+#define SPP_CLIENT_PENDING_SIZE BTSPP_MSG_MAX_SIZE
+#define SPP_RX_SEGMENTS 16 // Runs of received data from one client, that are in the ring buffer
+typedef struct {
+    uint32_t handle; // 0 if the slot is free
+    bool congested;
+    uint32_t credits;
+    uint32_t dropped_msgs; // Messages the client missed because it was too slow
+    // Received data is held back while another client is in the middle of a command,
+    // so the commands of different clients never get mixed up in the ring buffer
+    uint8_t pending[SPP_CLIENT_PENDING_SIZE];
+    uint32_t pending_len;
+} spp_client_t;
+
+// A run of bytes in the ring buffer that was sent by one client
+typedef struct {
+    uint32_t handle;
+    uint32_t len;
+} spp_rx_segment_t;
+
+// All client state is guarded by 'spp_clients_lock'
+static spp_client_t spp_clients[SPP_MAX_CLIENTS] = {};
+static int spp_input_owner = -1; // Client whose partial command is in the ring buffer
+static uint32_t spp_exclusive_handle = 0; // Client that has the link to itself (0 if none)
+static spp_rx_segment_t spp_rx_segments[SPP_RX_SEGMENTS] = {};
+static uint32_t spp_rx_segment_first = 0;
+static uint32_t spp_rx_segment_count = 0;
+static uint32_t spp_rx_handle = 0; // Client that sent the data read last
+static SemaphoreHandle_t spp_clients_lock = NULL;
 
 // Ringbuffer and EventGroup for Sending and Receiving Data
-#define SPP_CTS_STATUS_EVENTBIT ((EventBits_t) 0x01)
-#define SPP_WRITE_COMPLETE_STATUS_EVENTBIT ((EventBits_t) 0x02)
 #define SPP_DATA_AVAILABLE_STATUS_EVENTBIT ((EventBits_t) 0x04)
+#define SPP_CLIENT_WRITABLE_EVENTBIT(client) ((EventBits_t) (0x08 << (client))) // Client not congested and has credits
 static RingbufHandle_t xSppBuffer = NULL;
+static uint32_t xSppBufferSize = 0;
+static uint32_t xSppBufferHighWaterMark = 0;
 static EventGroupHandle_t xSppEventGroup = NULL;
 static btspp_da_cb_t* da_callback = NULL;
 static void* da_ctx = NULL;
@@ -353,6 +597,147 @@ static void* da_ctx = NULL;
 
 
 
+// Find the client of a handle, returns -1 if unknown
+static int find_spp_client(const uint32_t handle) {
+    for (int i = 0; i < SPP_MAX_CLIENTS; ++i) {
+        if (handle != 0 && spp_clients[i].handle == handle) { return i; }
+    }
+    return -1;
+}
+
+// Update the writable event bit of a client (call with the lock held)
+static void update_spp_client_writable(const int client) {
+    const spp_client_t* const c = &spp_clients[client];
+    if (c->handle != 0 && !c->congested && c->credits > 0) {
+        xEventGroupSetBits(xSppEventGroup, SPP_CLIENT_WRITABLE_EVENTBIT(client));
+    }
+    else {
+        xEventGroupClearBits(xSppEventGroup, SPP_CLIENT_WRITABLE_EVENTBIT(client));
+    }
+}
+
+// Put received data into the ring buffer, the client owns the input until it sends a line end
+// (call with the lock held)
+static void forward_spp_data(const int client, const uint8_t* const data, const uint32_t len) {
+    if (len == 0) { return; }
+    if (xRingbufferSend(xSppBuffer, data, len, 0) != pdTRUE) {
+        ESP_LOGW(SPP_TAG, "Client %d: ring buffer full, %u bytes dropped", client, len);
+        return;
+    }
+
+    // Remember the sender, runs of the same client are merged
+    // (if all segments are in use, the data is counted to the newest one)
+    spp_rx_segment_t* const last = &spp_rx_segments[(spp_rx_segment_first + spp_rx_segment_count + SPP_RX_SEGMENTS - 1) % SPP_RX_SEGMENTS];
+    if (spp_rx_segment_count > 0 && (last->handle == spp_clients[client].handle || spp_rx_segment_count == SPP_RX_SEGMENTS)) {
+        last->len += len;
+    }
+    else {
+        spp_rx_segment_t* const segment = &spp_rx_segments[(spp_rx_segment_first + spp_rx_segment_count) % SPP_RX_SEGMENTS];
+        segment->handle = spp_clients[client].handle;
+        segment->len = len;
+        spp_rx_segment_count += 1;
+    }
+
+    const uint32_t used = xSppBufferSize - xRingbufferGetCurFreeSize(xSppBuffer);
+    if (used > xSppBufferHighWaterMark) { xSppBufferHighWaterMark = used; }
+    xEventGroupSetBits(xSppEventGroup, SPP_DATA_AVAILABLE_STATUS_EVENTBIT);
+    const uint8_t last_byte = data[len - 1];
+    spp_input_owner = (last_byte == '\r' || last_byte == '\n' ? -1 : client);
+}
+
+// Client that may put data into the ring buffer right now (-1: any client, -2: none)
+// During a transfer only the transferring client (binary data has no line ends)
+static int get_spp_input_owner() {
+    if (spp_exclusive_handle != 0) {
+        const int client = find_spp_client(spp_exclusive_handle);
+        return (client >= 0 ? client : -2);
+    }
+    return spp_input_owner;
+}
+
+// Forward the data held back for other clients (if no client owns the input, call with the lock held)
+static void forward_pending_spp_data() {
+    for (int i = 0; i < SPP_MAX_CLIENTS && get_spp_input_owner() == -1; ++i) {
+        if (spp_clients[i].pending_len > 0) {
+            forward_spp_data(i, spp_clients[i].pending, spp_clients[i].pending_len);
+            spp_clients[i].pending_len = 0;
+        }
+    }
+}
+
+// Handle received data of a client (call with the lock held)
+static void receive_spp_data(const int client, const uint8_t* const data, const uint32_t len) {
+    const int owner = get_spp_input_owner();
+    if (owner != -1 && owner != client) {
+        // Another client is in the middle of a command or a transfer
+        spp_client_t* const c = &spp_clients[client];
+        const uint32_t space = SPP_CLIENT_PENDING_SIZE - c->pending_len;
+        if (len > space) { ESP_LOGW(SPP_TAG, "Client %d: %u bytes dropped", client, len - space); }
+        memcpy(c->pending + c->pending_len, data, (len > space ? space : len));
+        c->pending_len += (len > space ? space : len);
+        return;
+    }
+    forward_spp_data(client, data, len);
+    forward_pending_spp_data();
+}
+
+// Return an item to the ring buffer and remember the client that sent it
+static void return_spp_item(void* const item, const uint32_t len) {
+    vRingbufferReturnItem(xSppBuffer, item);
+    xSemaphoreTake(spp_clients_lock, portMAX_DELAY);
+    uint32_t remaining = len;
+    while (remaining > 0 && spp_rx_segment_count > 0) {
+        spp_rx_segment_t* const segment = &spp_rx_segments[spp_rx_segment_first];
+        spp_rx_handle = segment->handle;
+        const uint32_t n = (remaining < segment->len ? remaining : segment->len);
+        segment->len -= n;
+        remaining -= n;
+        if (segment->len == 0) {
+            spp_rx_segment_first = (spp_rx_segment_first + 1) % SPP_RX_SEGMENTS;
+            spp_rx_segment_count -= 1;
+        }
+    }
+    xSemaphoreGive(spp_clients_lock);
+}
+
+// Take a send credit of a client and write the data (the lock must not be held)
+// The credit is returned if the stack doesn't take the data
+static bool write_spp_client(const int client, const uint32_t handle, const uint8_t* const data, const uint32_t len) {
+    if (esp_spp_write(handle, len, (uint8_t*) data) == ESP_OK) { return true; }
+    ESP_LOGW(SPP_TAG, "Client %d: write failed", client);
+    xSemaphoreTake(spp_clients_lock, portMAX_DELAY);
+    if (spp_clients[client].handle == handle) {
+        spp_clients[client].credits += 1;
+        update_spp_client_writable(client);
+    }
+    xSemaphoreGive(spp_clients_lock);
+    return false;
+}
+
+// Send data to a single client, waits until the client can take it
+static bool send_to_spp_client(const uint32_t handle, const uint8_t* const data, const uint32_t len, const uint32_t timeout_ms) {
+    const int client = find_spp_client(handle);
+    if (client < 0) { return false; }
+    const EventBits_t status = xEventGroupWaitBits(
+        xSppEventGroup, SPP_CLIENT_WRITABLE_EVENTBIT(client),
+        0, pdTRUE, (timeout_ms == portMAX_DELAY ? portMAX_DELAY : pdMS_TO_TICKS(timeout_ms))
+    );
+    if (!(status & SPP_CLIENT_WRITABLE_EVENTBIT(client))) { return false; } // Timeout
+
+    xSemaphoreTake(spp_clients_lock, portMAX_DELAY);
+    spp_client_t* const c = &spp_clients[client];
+    const bool writable = (c->handle == handle && !c->congested && c->credits > 0);
+    if (writable) {
+        c->credits -= 1;
+        update_spp_client_writable(client);
+    }
+    xSemaphoreGive(spp_clients_lock);
+    return writable && write_spp_client(client, handle, data, len);
+}
+
+
+
+
 // Callback function for GAP (Generic Access Profile) events
 // Based on the expressif SPP acceptor example
 static void esp_bt_gap_cb(esp_bt_gap_cb_event_t event, esp_bt_gap_cb_param_t *param)
@@ -422,6 +807,7 @@ static void esp_spp_cb(esp_spp_cb_event_t event, esp_spp_cb_param_t *param)
             ESP_LOGI(SPP_TAG, "ESP_SPP_INIT_EVT");
 
             // Start SPP Server
+            boot_timeline_mark(BOOT_EVENT_BT_STACK_READY);
             esp_spp_start_srv(sec_mask, role_slave, SPP_CHANNEL, SPP_SERVER_NAME);
 
             break;
@@ -434,14 +820,26 @@ static void esp_spp_cb(esp_spp_cb_event_t event, esp_spp_cb_param_t *param)
             ESP_LOGI(SPP_TAG, "ESP_SPP_OPEN_EVT handle=%d", param->open.handle); // param->open.rem_bda
             break;
 
-        case ESP_SPP_CLOSE_EVT: // When SPP connection closed, the event comes
-            ESP_LOGI(SPP_TAG, "ESP_SPP_CLOSE_EVT");
-
-            // reset handle used in btspp_send()
-            spp_connection_handle = 0;
-            break;
-
+        case ESP_SPP_CLOSE_EVT: { // When SPP connection closed, the event comes
+            ESP_LOGI(SPP_TAG, "ESP_SPP_CLOSE_EVT handle=%d", param->close.handle);
+
+            // Free the client slot used in btspp_send()
+            const int client = find_spp_client(param->close.handle);
+            if (client < 0) { break; }
+            xSemaphoreTake(spp_clients_lock, portMAX_DELAY);
+            ESP_LOGI(SPP_TAG, "Client %d disconnected (%u messages dropped)", client, spp_clients[client].dropped_msgs);
+            spp_clients[client].handle = 0;
+            update_spp_client_writable(client);
+
+            // Data of a closed client is lost
+            spp_clients[client].pending_len = 0;
+            if (spp_input_owner == client) {
+                spp_input_owner = -1;
+                forward_pending_spp_data();
+            }
+            xSemaphoreGive(spp_clients_lock);
             break;
+        }
 
         case ESP_SPP_START_EVT: // When SPP server started, the event comes
             ESP_LOGI(SPP_TAG, "ESP_SPP_START_EVT");
@@ -451,6 +849,7 @@ static void esp_spp_cb(esp_spp_cb_event_t event, esp_spp_cb_param_t *param)
 
             // Make Bluetooth device discoverable and connectable
             esp_bt_gap_set_scan_mode(ESP_BT_CONNECTABLE, ESP_BT_GENERAL_DISCOVERABLE);
+            boot_timeline_mark(BOOT_EVENT_SPP_READY);
 
             break;
 
@@ -458,7 +857,7 @@ static void esp_spp_cb(esp_spp_cb_event_t event, esp_spp_cb_param_t *param)
             ESP_LOGI(SPP_TAG, "ESP_SPP_CL_INIT_EVT");
             break;
 
-        case ESP_SPP_DATA_IND_EVT: // When SPP connection received data, the event comes, only for ESP_SPP_MODE_CB
+        case ESP_SPP_DATA_IND_EVT: { // When SPP connection received data, the event comes, only for ESP_SPP_MODE_CB
             ESP_LOGD(SPP_TAG, "ESP_SPP_DATA_IND_EVT len=%d handle=%d", param->data_ind.len, param->data_ind.handle);
             // esp_log_buffer_hex("",param->data_ind.data,param->data_ind.len);
 
@@ -475,40 +874,58 @@ static void esp_spp_cb(esp_spp_cb_event_t event, esp_spp_cb_param_t *param)
             if (da_callback != NULL) { da_callback(da_ctx, param->data_ind.data, param->data_ind.len); }
             
             // put the received data in the ring buffer
-            xRingbufferSend(xSppBuffer, param->data_ind.data, param->data_ind.len, 0);
-
-            // Set status bit for data available
-            xEventGroupSetBits(xSppEventGroup, SPP_DATA_AVAILABLE_STATUS_EVENTBIT);
+            xSemaphoreTake(spp_clients_lock, portMAX_DELAY);
+            const int client = find_spp_client(param->data_ind.handle);
+            if (client >= 0) { receive_spp_data(client, param->data_ind.data, param->data_ind.len); }
+            xSemaphoreGive(spp_clients_lock);
 
             break;
+        }
 
-        case ESP_SPP_CONG_EVT: // When SPP connection congestion status changed, the event comes, only for ESP_SPP_MODE_CB
-            ESP_LOGD(SPP_TAG, "ESP_SPP_CONG_EVT: %s", (param->cong.cong ? "congested" : "uncongested"));
-            if (param->cong.cong == true) { // check congestion status
-                xEventGroupClearBits(xSppEventGroup, SPP_CTS_STATUS_EVENTBIT); 
-            }
-            else {
-                xEventGroupSetBits(xSppEventGroup, SPP_CTS_STATUS_EVENTBIT);
-            }
+        case ESP_SPP_CONG_EVT: { // When SPP connection congestion status changed, the event comes, only for ESP_SPP_MODE_CB
+            ESP_LOGD(SPP_TAG, "ESP_SPP_CONG_EVT handle=%d: %s", param->cong.handle, (param->cong.cong ? "congested" : "uncongested"));
+            const int client = find_spp_client(param->cong.handle);
+            if (client < 0) { break; }
+            xSemaphoreTake(spp_clients_lock, portMAX_DELAY);
+            spp_clients[client].congested = param->cong.cong;
+            update_spp_client_writable(client);
+            xSemaphoreGive(spp_clients_lock);
             break;
+        }
 
-        case ESP_SPP_WRITE_EVT: // When SPP write operation completes, the event comes, only for ESP_SPP_MODE_CB
+        case ESP_SPP_WRITE_EVT: { // When SPP write operation completes, the event comes, only for ESP_SPP_MODE_CB
             ESP_LOGD(SPP_TAG, "ESP_SPP_WRITE_EVT handle=%d: %s", param->write.handle, (param->write.cong ? "congested" : "uncongested"));
-            xEventGroupSetBits(xSppEventGroup, SPP_WRITE_COMPLETE_STATUS_EVENTBIT);
-            if (param->write.cong == true) { // check congestion status
-                xEventGroupClearBits(xSppEventGroup, SPP_CTS_STATUS_EVENTBIT); 
-            }
-            else {
-                xEventGroupSetBits(xSppEventGroup, SPP_CTS_STATUS_EVENTBIT);
-            }
+            const int client = find_spp_client(param->write.handle);
+            if (client < 0) { break; }
+            xSemaphoreTake(spp_clients_lock, portMAX_DELAY);
+            spp_clients[client].credits += 1; // Write complete
+            spp_clients[client].congested = param->write.cong;
+            update_spp_client_writable(client);
+            xSemaphoreGive(spp_clients_lock);
             break;
+        }
 
-        case ESP_SPP_SRV_OPEN_EVT: // When SPP Server connection open, the event comes
+        case ESP_SPP_SRV_OPEN_EVT: { // When SPP Server connection open, the event comes
             ESP_LOGI(SPP_TAG, "ESP_SPP_SRV_OPEN_EVT handle=%d, new_listen_handle=%d", param->srv_open.handle, param->srv_open.new_listen_handle);
 
-            // Set handle used in btspp_send()
-            spp_connection_handle = param->srv_open.handle;
+            // Take a free client slot used in btspp_send()
+            const int client = find_spp_client(0);
+            if (client < 0) {
+                ESP_LOGW(SPP_TAG, "Too many clients, closing handle=%d", param->srv_open.handle);
+                esp_spp_disconnect(param->srv_open.handle);
+                break;
+            }
+            xSemaphoreTake(spp_clients_lock, portMAX_DELAY);
+            spp_clients[client].handle = param->srv_open.handle;
+            spp_clients[client].congested = false;
+            spp_clients[client].credits = SPP_CLIENT_SEND_CREDITS;
+            spp_clients[client].dropped_msgs = 0;
+            spp_clients[client].pending_len = 0;
+            update_spp_client_writable(client);
+            xSemaphoreGive(spp_clients_lock);
+            boot_timeline_mark(BOOT_EVENT_FIRST_CLIENT);
             break;
+        }
 
         case ESP_SPP_SRV_STOP_EVT: // When SPP server stopped, the event comes
             ESP_LOGI(SPP_TAG, "ESP_SPP_SRV_STOP_EVT");
@@ -537,12 +954,16 @@ void btspp_init(const char* device_name, const uint32_t ringbuf_size) {
 
     // Create event group
     xSppEventGroup = xEventGroupCreate();
-    xEventGroupSetBits(xSppEventGroup, SPP_CTS_STATUS_EVENTBIT | SPP_WRITE_COMPLETE_STATUS_EVENTBIT);
     assert(xSppEventGroup != NULL);
 
+    // Create lock for the client table
+    spp_clients_lock = xSemaphoreCreateMutex();
+    assert(spp_clients_lock != NULL);
+
     // Create ring buffer
     xSppBuffer = xRingbufferCreate(ringbuf_size, RINGBUF_TYPE_BYTEBUF);
     assert(xSppBuffer != NULL);
+    xSppBufferSize = ringbuf_size;
 
 
 
@@ -620,34 +1041,68 @@ void btspp_init(const char* device_name, const uint32_t ringbuf_size) {
 // Wait for CTS event and send data via SPP
 bool btspp_send(const uint8_t* const data, const uint32_t len, const uint32_t timeout_ms) {
 
-    // make sure that a client is connected
-    if (spp_connection_handle == 0) { return -1; }
-
-    // Wait for CTS status
-    EventBits_t status = xEventGroupWaitBits(
-        xSppEventGroup, SPP_CTS_STATUS_EVENTBIT,
-        0, pdTRUE, (timeout_ms == portMAX_DELAY ? portMAX_DELAY : pdMS_TO_TICKS(timeout_ms))
-    );
-
-    // check if the right bit ist set
-    const bool cts_status = (status & SPP_CTS_STATUS_EVENTBIT);
-
-    //  return a timeout if no cts
-    if (!cts_status) { return -2; }
+    // During a transfer everything goes to the transferring client
+    const uint32_t exclusive_handle = spp_exclusive_handle;
+    if (exclusive_handle != 0) { return send_to_spp_client(exclusive_handle, data, len, timeout_ms); }
 
+    // make sure that a client is connected
+    int connected = 0;
+    uint32_t last_handle = 0;
+    for (int i = 0; i < SPP_MAX_CLIENTS; ++i) {
+        if (spp_clients[i].handle != 0) { connected += 1; last_handle = spp_clients[i].handle; }
+    }
+    if (connected == 0) { return false; }
+
+    // A single client is waited for
+    // With more clients, a client that can't keep up misses the message
+    if (connected == 1) { return send_to_spp_client(last_handle, data, len, timeout_ms); }
+
+    // Take a send credit of every client that can take the data
+    int clients[SPP_MAX_CLIENTS];
+    uint32_t handles[SPP_MAX_CLIENTS];
+    uint32_t handle_count = 0;
+    xSemaphoreTake(spp_clients_lock, portMAX_DELAY);
+    for (int i = 0; i < SPP_MAX_CLIENTS; ++i) {
+        spp_client_t* const c = &spp_clients[i];
+        if (c->handle == 0) { continue; }
+        if (c->congested || c->credits == 0) {
+            c->dropped_msgs += 1;
+            continue;
+        }
+        c->credits -= 1;
+        update_spp_client_writable(i);
+        clients[handle_count] = i;
+        handles[handle_count++] = c->handle;
+    }
+    xSemaphoreGive(spp_clients_lock);
 
-    // send data vis spp
-    xEventGroupClearBits(xSppEventGroup, SPP_WRITE_COMPLETE_STATUS_EVENTBIT);
-    esp_spp_write(spp_connection_handle, len, (uint8_t*) data);
-    // esp_spp_write(spp_connection_handle, len, data);
+    // send data via spp, the data is encoded once and copied by the stack for every client
+    bool sent = false;
+    for (uint32_t i = 0; i < handle_count; ++i) {
+        if (write_spp_client(clients[i], handles[i], data, len)) { sent = true; }
+    }
+    return sent;
+}
 
-    // Wait for write complete event
-    status = xEventGroupWaitBits(
-        xSppEventGroup, SPP_WRITE_COMPLETE_STATUS_EVENTBIT,
-        0, pdTRUE, portMAX_DELAY
-    );
+// Send data to the client that sent the data read last
+bool btspp_reply(const uint8_t* const data, const uint32_t len, const uint32_t timeout_ms) {
+    const uint32_t handle = (spp_exclusive_handle != 0 ? spp_exclusive_handle : spp_rx_handle);
+    return send_to_spp_client(handle, data, len, timeout_ms);
+}
 
-    return true;
+// Give the client that sent the data read last the link to itself or share it again
+void btspp_set_exclusive(const bool exclusive) {
+    xSemaphoreTake(spp_clients_lock, portMAX_DELAY);
+    if (exclusive) {
+        spp_exclusive_handle = spp_rx_handle;
+    }
+    else if (spp_exclusive_handle != 0) {
+        // Whatever the transfer left in the ring buffer is not a command
+        spp_exclusive_handle = 0;
+        spp_input_owner = -1;
+        forward_pending_spp_data();
+    }
+    xSemaphoreGive(spp_clients_lock);
 }
 
 
@@ -672,7 +1127,7 @@ int btspp_recv(uint8_t* data, const uint32_t bufsize, const uint32_t timeout_ms)
         memcpy(data, item, xItemSize);
 
         // return item pointer to the ringbuffer
-        vRingbufferReturnItem(xSppBuffer, item);
+        return_spp_item(item, xItemSize);
 
         return xItemSize;
     }
@@ -726,7 +1181,7 @@ int btspp_recv_data(uint8_t* data, const uint32_t bufsize, const uint32_t timeou
         memcpy(buffer, item, xItemSize);
 
         // return item pointer to the ringbuffer
-        vRingbufferReturnItem(xSppBuffer, item);
+        return_spp_item(item, xItemSize);
 
         // Keep track of how much data has already been received
         total_bytes_read += xItemSize;
@@ -760,7 +1215,7 @@ int btspp_recv_data(uint8_t* data, const uint32_t bufsize, const uint32_t timeou
             memcpy(buffer, item, xItemSize);
 
             // return item pointer to the ringbuffer
-            vRingbufferReturnItem(xSppBuffer, item);
+            return_spp_item(item, xItemSize);
 
             // Keep track of how much data has already been received
             total_bytes_read += xItemSize;
@@ -813,7 +1268,7 @@ int btspp_recv_msg(char* msg, const uint32_t bufsize, const char* delimiter, con
             memcpy(buffer, item, xItemSize); // xItemsize should be equal to 1
 
             // return item pointer to the ringbuffer
-            vRingbufferReturnItem(xSppBuffer, item);
+            return_spp_item(item, xItemSize);
 
             // Keep track of how much data has already been received
             total_bytes_read += xItemSize;
@@ -857,17 +1312,61 @@ int btspp_recv_msg(char* msg, const uint32_t bufsize, const char* delimiter, con
 
 
 
-// Register a callback that gets called when new data arrives
-void btspp_register_data_available_callback(btspp_da_cb_t* const callback, void* const ctx) {
-    da_callback = callback;
-    da_ctx = ctx;
+// Size of the ring buffer for received data
+uint32_t btspp_get_recv_buffer_size() {
+    return xSppBufferSize;
 }
 
+// Most bytes held in the ring buffer for received data at the same time since startup
+uint32_t btspp_get_recv_buffer_high_water_mark() {
+    return xSppBufferHighWaterMark;
+}
 
+// Check if a SPP client is connected
+bool btspp_is_connected() {
+    return (btspp_get_client_count() > 0);
+}
 
+// Wait until all clients have received the data sent so far
+bool btspp_flush(const uint32_t timeout_ms) {
+    const int64_t deadline_us = (timeout_ms == portMAX_DELAY ? INT64_MAX : esp_timer_get_time() + timeout_ms * 1000LL);
+    while (true) {
+        bool pending = false;
+        for (int i = 0; i < SPP_MAX_CLIENTS; ++i) {
+            pending = pending || (spp_clients[i].handle != 0 && spp_clients[i].credits < SPP_CLIENT_SEND_CREDITS);
+        }
+        if (!pending) { return true; }
+        if (esp_timer_get_time() >= deadline_us) { return false; }
+        vTaskDelay(1);
+    }
+}
 
+// Number of connected SPP clients
+uint32_t btspp_get_client_count() {
+    uint32_t count = 0;
+    for (int i = 0; i < SPP_MAX_CLIENTS; ++i) {
+        if (spp_clients[i].handle != 0) { count += 1; }
+    }
+    return count;
+}
 
 
 
+// Register a callback that gets called when new data arrives
+void btspp_register_data_available_callback(btspp_da_cb_t* const callback, void* const ctx) {
+    da_callback = callback;
+    da_ctx = ctx;
+}
+
 
 
+// Transport interface for the SLCAN engine
+const transport_t btspp_transport = {
+    .name = "BT-SPP",
+    .send = btspp_send,
+    .recv = btspp_recv,
+    .flush = btspp_flush,
+    .is_connected = btspp_is_connected,
+    .reply = btspp_reply,
+    .set_exclusive = btspp_set_exclusive
+};
@@ -0,0 +1,784 @@
+#include "btspp_ota.h"
+#include "btspp.h"
+
+// Some standard header
+#include <stdio.h> // sscanf, snprintf
+#include <stdlib.h> // malloc, free
+#include <string.h> // memcpy, memcmp, memmove
+
+// Helper for the chunk header
+#include "buffer_access.h"
+
+// Decompressor for compressed images and applier for delta images
+#include "lzss.h"
+#include "delta_patch.h"
+
+// SHA-256 of the written image
+#include "mbedtls/sha256.h"
+
+
+// FreeRTOS
+// Queues for handing buffers between the receiver and the writer task
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+
+
+// Header for debug messages
+#define LOG_LOCAL_LEVEL ESP_LOG_DEBUG
+#include "esp_log.h"
+#define OTA_TAG "BT-OTA"
+
+
+// OTA
+#include "esp_ota_ops.h"
+#include "esp_partition.h"
+#include "esp_system.h" // esp_restart
+
+// Timer API
+#include "esp_timer.h" // esp_timer_get_time
+
+// CRC32 of the chunks
+#include "esp_rom_crc.h"
+
+// Checkpoints of resumable updates
+#include "nvs.h"
+
+
+
+// Windowed OTA protocol (after the host sent "START BT-OTA WINDOWED\r"):
+// 1. Device: "DO FIRMWARE UPLOAD?\r\n"                         Host: "YES\r\n"
+// 2. Device: "FIRMWARE FILESIZE?\r\n"                          Host: "<n>\r\n" or "<n>, SHA256 = <hex>\r\n"
+//    The optional SHA-256 of the firmware image is compared with the written image.
+//    It also identifies the image for resuming an interrupted update.
+// 3. Device: "MAX CHUNK SIZE = <c>, MAX WINDOW = <w>, FORMATS = RAW LZSS DELTA, CHECKS = CRC32\r\n"
+//    Host: "CHUNK SIZE = <c'>, WINDOW = <w'>[, FORMAT = <RAW|LZSS|DELTA>][, CHECKS = CRC32]\r\n"
+//    With LZSS the filesize and offsets refer to the compressed stream (see lzss.h),
+//    which gets decompressed on the fly before it is written to flash.
+//    With DELTA they refer to a patch against the running image (see delta_patch.h).
+//    The patch is only applied if the running image matches the base of the patch
+//    and the SHA-256 of the result is verified before the new image gets activated.
+// 4. Device: "START UPLOAD!\r\n" or "RESUME UPLOAD AT <offset>!\r\n"
+//    RAW images with a SHA-256 are checkpointed every OTA_CHECKPOINT_INTERVAL bytes in NVS.
+//    If the same image is uploaded again after a disconnect, the upload continues at the
+//    last checkpoint: the written part is verified and then rewritten through a new esp_ota handle.
+// 5. Host streams up to <w'> unacknowledged chunks. Each chunk has a 8 byte header:
+//    'O' 'C' | payload length (uint16) | image offset (uint32), little endian
+//    or a 16 byte header with two CRC32s, little endian:
+//    'O' 'D' | payload length (uint16) | image offset (uint32) | data CRC32 (uint32) | header CRC32 (uint32)
+//    The data CRC32 covers the first 8 header bytes and the payload, the header CRC32 the first
+//    12 header bytes. Length and offset are only used after the header CRC32 matched, after a
+//    corrupted header the device answers NAK and searches the stream for the next intact header.
+//    While a NAK is pending, it is repeated every OTA_RESYNC_IDLE_MS in which nothing arrives.
+//    With "CHECKS = CRC32" in the answer of step 3 the device expects 'OD' chunks only.
+// 6. Device: one line per chunk (the chunks a corrupted header hides get no answer)
+//    "ACK <offset>\r\n" as soon as a chunk is taken out of the receive buffer,
+//    also for a chunk that was already received before
+//    "NAK <offset>\r\n" if a CRC32 doesn't match or the chunk was sent after a NAK.
+//    The host goes back to <offset> once (go-back-N), the NAKs for the chunks it sent
+//    before it went back are ignored.
+// 7. Device: "OK!\r\n" after the image has been validated, then the device restarts
+// Errors are answered with "ABORT!\r\n" at any time.
+#define OTA_CHUNK_MAGIC_0 'O'
+#define OTA_CHUNK_MAGIC_1 'C'
+#define OTA_CHUNK_MAGIC_1_CRC 'D'
+#define OTA_CHUNK_HEADER_SIZE (8u)
+#define OTA_CHUNK_CRC_HEADER_SIZE (16u)
+#define OTA_MAX_CHUNK_RETRIES (8u) // Consecutive CRC errors before the update is aborted
+#define OTA_MAX_CHUNK_SIZE (2048u)
+#define OTA_MIN_CHUNK_SIZE (512u)
+#define OTA_MAX_WINDOW (8u)
+#define OTA_WRITE_BUFFER_COUNT (2u) // Double buffering
+#define OTA_RECV_TIMEOUT_MS (5000u)
+#define OTA_RESYNC_IDLE_MS (500u) // The host waits for an answer if nothing arrives after a NAK
+#define OTA_MAX_IDLE_NAKS (OTA_MAX_WINDOW + 2u) // The host ignores up to window - 1 NAKs as answers to dropped chunks
+#define OTA_MSG_MAX_SIZE (128u)
+#define OTA_FLASH_SECTOR_SIZE (4096u)
+#define OTA_CHECKPOINT_INTERVAL (16u * OTA_FLASH_SECTOR_SIZE) // Must be a multiple of the sector size
+#define OTA_NVS_NAMESPACE "bt-ota"
+#define OTA_NVS_CHECKPOINT_KEY "checkpoint"
+#define OTA_IMAGE_HEADER_CHECK_SIZE (sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t) + sizeof(esp_app_desc_t) + 1)
+
+
+// Formats of the transferred image
+typedef enum {
+    OTA_FORMAT_RAW,
+    OTA_FORMAT_LZSS,
+    OTA_FORMAT_DELTA,
+} ota_image_format_t;
+
+
+// Progress of a resumable update, stored in NVS
+typedef struct {
+    uint8_t image_sha256[32]; // Identity of the image
+    uint32_t image_size;
+    uint32_t partition_address;
+    uint32_t offset; // Bytes written and verified
+    uint8_t prefix_sha256[32]; // SHA-256 of the first 'offset' bytes
+} ota_checkpoint_t;
+
+// Buffer handed from the receiver to the writer task
+typedef struct {
+    uint8_t* data;
+    uint32_t len;
+} ota_write_buffer_t;
+
+// State shared between the receiver and the writer task
+typedef struct {
+    const esp_partition_t* running;
+    const esp_partition_t* update_partition;
+    esp_ota_handle_t update_handle;
+    bool ota_started; // esp_ota_begin is called with the first block of the image
+    uint8_t image_header[OTA_IMAGE_HEADER_CHECK_SIZE]; // Collects the image header for the check before esp_ota_begin
+    uint32_t image_header_len;
+    uint32_t image_bytes_written;
+    mbedtls_sha256_context image_sha256;
+    bool has_image_digest; // SHA-256 declared by the host
+    uint8_t image_digest[32];
+    bool resumable; // Checkpointed in NVS
+    uint32_t image_size;
+    ota_image_format_t format;
+    lzss_decoder_t* decoder; // Only for LZSS images
+    delta_patch_t* patch; // Only for DELTA images
+    bool stream_complete; // Set by the writer task when it stops
+    QueueHandle_t free_queue; // Buffers ready to be filled
+    QueueHandle_t full_queue; // Buffers ready to be written (NULL stops the writer)
+    SemaphoreHandle_t writer_done;
+    volatile bool write_error;
+    ota_write_buffer_t buffers[OTA_WRITE_BUFFER_COUNT];
+} ota_writer_t;
+
+static ota_writer_t ota_writer = {};
+
+
+
+// Send "ABORT!" and return false
+static bool ota_abort(const char* reason) {
+    ESP_LOGE(OTA_TAG, "%s", reason);
+    btspp_send_msg("ABORT!\r\n", 2000);
+    return false;
+}
+
+// Receive exactly 'len' bytes
+static bool ota_recv_exact(uint8_t* data, const uint32_t len, const uint32_t timeout_ms) {
+    uint32_t total_bytes_read = 0;
+    while (total_bytes_read < len) {
+        const int bytes_read = btspp_recv(data + total_bytes_read, len - total_bytes_read, timeout_ms);
+        if (bytes_read <= 0) { return false; }
+        total_bytes_read += bytes_read;
+    }
+    return true;
+}
+
+// Drop the payload of a chunk
+static bool ota_skip_bytes(uint32_t len, const uint32_t timeout_ms) {
+    uint8_t data[128];
+    while (len > 0) {
+        const int bytes_read = btspp_recv(data, (len < sizeof(data) ? len : sizeof(data)), timeout_ms);
+        if (bytes_read <= 0) { return false; }
+        len -= bytes_read;
+    }
+    return true;
+}
+
+// Check the magic and the header CRC32 of an 'OD' chunk header
+static bool ota_crc_header_is_intact(const uint8_t* const header) {
+    return header[0] == OTA_CHUNK_MAGIC_0 && header[1] == OTA_CHUNK_MAGIC_1_CRC
+        && esp_rom_crc32_le(0, header, OTA_CHUNK_CRC_HEADER_SIZE - 4) == parse_uint32_1234(header + OTA_CHUNK_CRC_HEADER_SIZE - 4);
+}
+
+// Receive until 'want' bytes of a chunk header are in 'header', '*len' counts the bytes received so far
+// After a NAK the chunks the host sent again can get lost as well, so the NAK is repeated
+// every OTA_RESYNC_IDLE_MS in which nothing arrives.
+static bool ota_recv_header(uint8_t* const header, uint32_t* const len, const uint32_t want, const bool nak_pending, const uint32_t nak_offset, uint32_t* const idle_naks) {
+    while (*len < want) {
+        const int bytes_read = btspp_recv(header + *len, want - *len, (nak_pending ? OTA_RESYNC_IDLE_MS : OTA_RECV_TIMEOUT_MS));
+        if (bytes_read > 0) {
+            *len += bytes_read;
+            continue;
+        }
+        if (!nak_pending || ++(*idle_naks) > OTA_MAX_IDLE_NAKS) { return false; }
+        char msg[24];
+        snprintf(msg, sizeof(msg), "NAK %u\r\n", nak_offset);
+        if (!btspp_send_msg(msg, 2000)) { return false; }
+    }
+    return true;
+}
+
+// Search the stream for the next intact 'OD' chunk header after a corrupted one
+// The first 'len' bytes already in 'header' are searched first
+static bool ota_resync(uint8_t* const header, uint32_t len, const uint32_t nak_offset, uint32_t* const idle_naks) {
+    while (true) {
+        if (!ota_recv_header(header, &len, OTA_CHUNK_CRC_HEADER_SIZE, true, nak_offset, idle_naks)) { return false; }
+        if (ota_crc_header_is_intact(header)) { return true; }
+        memmove(header, header + 1, OTA_CHUNK_CRC_HEADER_SIZE - 1);
+        len = OTA_CHUNK_CRC_HEADER_SIZE - 1;
+    }
+}
+
+// Send a question and wait for the answer
+static int ota_ask(const char* question, char* answer, const uint32_t bufsize) {
+    if (!btspp_send_msg(question, 2000)) { return -1; }
+    return btspp_recv_msg(answer, bufsize, "\r\n", OTA_RECV_TIMEOUT_MS, 100);
+}
+
+
+
+// Parse a SHA-256 given as hex string
+static bool ota_parse_sha256(const char* hex, uint8_t* digest) {
+    if (strlen(hex) != 64) { return false; }
+    for (uint32_t i = 0; i < 32; ++i) {
+        unsigned int value = 0;
+        if (sscanf(hex + 2 * i, "%2x", &value) != 1) { return false; }
+        digest[i] = (uint8_t) value;
+    }
+    return true;
+}
+
+
+
+// Load the checkpoint of an interrupted update
+static bool ota_load_checkpoint(ota_checkpoint_t* checkpoint) {
+    nvs_handle_t handle;
+    if (nvs_open(OTA_NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) { return false; }
+    size_t size = sizeof(ota_checkpoint_t);
+    const esp_err_t err = nvs_get_blob(handle, OTA_NVS_CHECKPOINT_KEY, checkpoint, &size);
+    nvs_close(handle);
+    return (err == ESP_OK && size == sizeof(ota_checkpoint_t));
+}
+
+// Store the progress of the current update
+static bool ota_save_checkpoint() {
+    ota_checkpoint_t checkpoint;
+    memcpy(checkpoint.image_sha256, ota_writer.image_digest, sizeof(checkpoint.image_sha256));
+    checkpoint.image_size = ota_writer.image_size;
+    checkpoint.partition_address = ota_writer.update_partition->address;
+    checkpoint.offset = ota_writer.image_bytes_written;
+
+    // Digest of the prefix without finishing the running hash
+    mbedtls_sha256_context prefix;
+    mbedtls_sha256_init(&prefix);
+    mbedtls_sha256_clone(&prefix, &ota_writer.image_sha256);
+    mbedtls_sha256_finish_ret(&prefix, checkpoint.prefix_sha256);
+    mbedtls_sha256_free(&prefix);
+
+    nvs_handle_t handle;
+    if (nvs_open(OTA_NVS_NAMESPACE, NVS_READWRITE, &handle) != ESP_OK) { return false; }
+    esp_err_t err = nvs_set_blob(handle, OTA_NVS_CHECKPOINT_KEY, &checkpoint, sizeof(checkpoint));
+    if (err == ESP_OK) { err = nvs_commit(handle); }
+    nvs_close(handle);
+    if (err != ESP_OK) {
+        ESP_LOGW(OTA_TAG, "Saving the checkpoint failed (%s)", esp_err_to_name(err));
+        return false;
+    }
+    ESP_LOGD(OTA_TAG, "Checkpoint at %u", checkpoint.offset);
+    return true;
+}
+
+// Forget the checkpoint
+static void ota_clear_checkpoint() {
+    nvs_handle_t handle;
+    if (nvs_open(OTA_NVS_NAMESPACE, NVS_READWRITE, &handle) != ESP_OK) { return; }
+    if (nvs_erase_key(handle, OTA_NVS_CHECKPOINT_KEY) == ESP_OK) { nvs_commit(handle); }
+    nvs_close(handle);
+}
+
+// Start the update again with esp_ota_begin and write the first 'len' bytes of the partition through it
+// esp_ota_write erases the next sector as well when a write ends at a sector boundary,
+// so the next sector is always read before the current one is written.
+static bool ota_rewrite_prefix(const uint32_t len) {
+    uint8_t* const sectors = malloc(2 * OTA_FLASH_SECTOR_SIZE);
+    if (sectors == NULL) { return false; }
+    esp_err_t err = esp_ota_begin(ota_writer.update_partition, OTA_WITH_SEQUENTIAL_WRITES, &ota_writer.update_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(OTA_TAG, "esp_ota_begin failed (%s)", esp_err_to_name(err));
+        free(sectors);
+        return false;
+    }
+    err = esp_partition_read(ota_writer.update_partition, 0, sectors, OTA_FLASH_SECTOR_SIZE);
+    for (uint32_t offset = 0; err == ESP_OK && offset < len; offset += OTA_FLASH_SECTOR_SIZE) {
+        uint8_t* const sector = sectors + (offset / OTA_FLASH_SECTOR_SIZE % 2) * OTA_FLASH_SECTOR_SIZE;
+        uint8_t* const next_sector = sectors + ((offset / OTA_FLASH_SECTOR_SIZE + 1) % 2) * OTA_FLASH_SECTOR_SIZE;
+        if (offset + OTA_FLASH_SECTOR_SIZE < len) { err = esp_partition_read(ota_writer.update_partition, offset + OTA_FLASH_SECTOR_SIZE, next_sector, OTA_FLASH_SECTOR_SIZE); }
+        if (err == ESP_OK) { err = esp_ota_write(ota_writer.update_handle, sector, OTA_FLASH_SECTOR_SIZE); }
+    }
+    free(sectors);
+    if (err != ESP_OK) {
+        ESP_LOGE(OTA_TAG, "Rewriting the image failed (%s)", esp_err_to_name(err));
+        esp_ota_abort(ota_writer.update_handle);
+        return false;
+    }
+    return true;
+}
+
+// Continue an interrupted update of the same image
+// Rehashes the already written part of the partition and returns the offset to continue at
+static uint32_t ota_resume_from_checkpoint() {
+    ota_checkpoint_t checkpoint;
+    if (!ota_load_checkpoint(&checkpoint)) { return 0; }
+    if (memcmp(checkpoint.image_sha256, ota_writer.image_digest, sizeof(checkpoint.image_sha256)) != 0 
+        || checkpoint.image_size != ota_writer.image_size 
+        || checkpoint.partition_address != ota_writer.update_partition->address 
+        || checkpoint.offset == 0 || checkpoint.offset >= checkpoint.image_size 
+        || checkpoint.offset % OTA_CHECKPOINT_INTERVAL != 0) {
+        ota_clear_checkpoint();
+        return 0;
+    }
+
+    // Verify the written part
+    uint8_t block[1024];
+    for (uint32_t offset = 0; offset < checkpoint.offset; offset += sizeof(block)) {
+        const uint32_t len = (checkpoint.offset - offset < sizeof(block) ? checkpoint.offset - offset : sizeof(block));
+        if (esp_partition_read(ota_writer.update_partition, offset, block, len) != ESP_OK) { break; }
+        mbedtls_sha256_update_ret(&ota_writer.image_sha256, block, len);
+    }
+    uint8_t digest[32];
+    mbedtls_sha256_context prefix;
+    mbedtls_sha256_init(&prefix);
+    mbedtls_sha256_clone(&prefix, &ota_writer.image_sha256);
+    mbedtls_sha256_finish_ret(&prefix, digest);
+    mbedtls_sha256_free(&prefix);
+    if (memcmp(digest, checkpoint.prefix_sha256, sizeof(digest)) != 0) {
+        ESP_LOGW(OTA_TAG, "Written part of the image changed, starting over");
+        mbedtls_sha256_starts_ret(&ota_writer.image_sha256, 0);
+        ota_clear_checkpoint();
+        return 0;
+    }
+
+    // The header was checked in the interrupted session
+    // esp_ota_write can't continue in the middle of a partition, so the verified part is written again
+    if (!ota_rewrite_prefix(checkpoint.offset)) {
+        ESP_LOGW(OTA_TAG, "Rewriting the written part of the image failed, starting over");
+        mbedtls_sha256_starts_ret(&ota_writer.image_sha256, 0);
+        ota_clear_checkpoint();
+        return 0;
+    }
+    ota_writer.ota_started = true;
+    ota_writer.image_bytes_written = checkpoint.offset;
+    ESP_LOGI(OTA_TAG, "Resuming update at %u/%u", checkpoint.offset, checkpoint.image_size);
+    return checkpoint.offset;
+}
+
+
+
+// Check the app description of the new image (same checks as the legacy update)
+static bool ota_check_image_header(const uint8_t* data, const uint32_t len, const esp_partition_t* running) {
+    if (len <= sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t) + sizeof(esp_app_desc_t)) {
+        ESP_LOGE(OTA_TAG, "received package is not fit len");
+        return false;
+    }
+
+    // check current version with downloading
+    esp_app_desc_t new_app_info;
+    memcpy(&new_app_info, &data[sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t)], sizeof(esp_app_desc_t));
+    ESP_LOGI(OTA_TAG, "New firmware version: %s", new_app_info.version);
+
+    esp_app_desc_t running_app_info;
+    if (esp_ota_get_partition_description(running, &running_app_info) == ESP_OK) {
+        ESP_LOGI(OTA_TAG, "Running firmware version: %s", running_app_info.version);
+        if (memcmp(new_app_info.version, running_app_info.version, sizeof(new_app_info.version)) == 0) {
+            ESP_LOGW(OTA_TAG, "Current running version is the same as a new. We will continue the update anyway.");
+        }
+    }
+
+    // check current version with last invalid partition
+    const esp_partition_t* last_invalid_app = esp_ota_get_last_invalid_partition();
+    esp_app_desc_t invalid_app_info;
+    if (last_invalid_app != NULL && esp_ota_get_partition_description(last_invalid_app, &invalid_app_info) == ESP_OK) {
+        ESP_LOGI(OTA_TAG, "Last invalid firmware version: %s", invalid_app_info.version);
+        if (memcmp(invalid_app_info.version, new_app_info.version, sizeof(new_app_info.version)) == 0) {
+            ESP_LOGW(OTA_TAG, "New version is the same as invalid version.");
+            ESP_LOGW(OTA_TAG, "Previously, there was an attempt to launch the firmware with %s version, but it failed.", invalid_app_info.version);
+            ESP_LOGW(OTA_TAG, "The firmware has been rolled back to the previous version.");
+            return false;
+        }
+    }
+    return true;
+}
+
+
+
+// Check that a delta patch was made for the running image
+static bool ota_check_delta_base(const esp_partition_t* running) {
+    esp_app_desc_t running_app_info;
+    if (esp_ota_get_partition_description(running, &running_app_info) != ESP_OK) {
+        ESP_LOGE(OTA_TAG, "No app description of the running image");
+        return false;
+    }
+    const uint8_t* base_hash = delta_patch_get_base_hash(ota_writer.patch);
+    if (base_hash == NULL || memcmp(base_hash, running_app_info.app_elf_sha256, DELTA_PATCH_HASH_SIZE) != 0) {
+        ESP_LOGE(OTA_TAG, "Delta patch was made for a different base image");
+        return false;
+    }
+    return true;
+}
+
+// Read a range of the running image (base of delta patches)
+static bool ota_read_running_image(void* const ctx, const uint32_t offset, uint8_t* data, const uint32_t len) {
+    if (offset > ota_writer.running->size || len > ota_writer.running->size - offset) {
+        ESP_LOGE(OTA_TAG, "Delta copy out of range (offset %u, len %u)", offset, len);
+        return false;
+    }
+    const esp_err_t err = esp_partition_read(ota_writer.running, offset, data, len);
+    if (err != ESP_OK) {
+        ESP_LOGE(OTA_TAG, "esp_partition_read failed (%s)", esp_err_to_name(err));
+        return false;
+    }
+    return true;
+}
+
+// Write to flash and hash the image
+static bool ota_write_to_flash(const uint8_t* data, uint32_t len) {
+    while (len > 0) {
+        uint32_t n = len;
+        if (ota_writer.resumable) {
+            // Split the write at the next checkpoint
+            const uint32_t next_checkpoint = (ota_writer.image_bytes_written / OTA_CHECKPOINT_INTERVAL + 1) * OTA_CHECKPOINT_INTERVAL;
+            if (n > next_checkpoint - ota_writer.image_bytes_written) { n = next_checkpoint - ota_writer.image_bytes_written; }
+        }
+        const esp_err_t err = esp_ota_write(ota_writer.update_handle, data, n);
+        if (err != ESP_OK) {
+            ESP_LOGE(OTA_TAG, "esp_ota_write failed (%s)", esp_err_to_name(err));
+            return false;
+        }
+        mbedtls_sha256_update_ret(&ota_writer.image_sha256, data, n);
+        ota_writer.image_bytes_written += n;
+        data += n;
+        len -= n;
+
+        if (ota_writer.resumable && ota_writer.image_bytes_written % OTA_CHECKPOINT_INTERVAL == 0) { ota_save_checkpoint(); }
+    }
+    return true;
+}
+
+// Write a block of the (decompressed or patched) image to flash
+// The image header is collected and checked before the update begins
+static bool ota_write_image_data(void* const ctx, const uint8_t* data, const uint32_t len) {
+    if (ota_writer.ota_started) { return ota_write_to_flash(data, len); }
+
+    // Collect the header
+    uint32_t n = OTA_IMAGE_HEADER_CHECK_SIZE - ota_writer.image_header_len;
+    if (n > len) { n = len; }
+    memcpy(ota_writer.image_header + ota_writer.image_header_len, data, n);
+    ota_writer.image_header_len += n;
+    if (ota_writer.image_header_len < OTA_IMAGE_HEADER_CHECK_SIZE) { return true; }
+
+    if (!ota_check_image_header(ota_writer.image_header, ota_writer.image_header_len, ota_writer.running)) { return false; }
+    if (ota_writer.format == OTA_FORMAT_DELTA && !ota_check_delta_base(ota_writer.running)) { return false; }
+    const esp_err_t err = esp_ota_begin(ota_writer.update_partition, OTA_WITH_SEQUENTIAL_WRITES, &ota_writer.update_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(OTA_TAG, "esp_ota_begin failed (%s)", esp_err_to_name(err));
+        return false;
+    }
+    ESP_LOGI(OTA_TAG, "esp_ota_begin succeeded");
+    ota_writer.ota_started = true;
+
+    return ota_write_to_flash(ota_writer.image_header, ota_writer.image_header_len) 
+        && (n == len || ota_write_to_flash(data + n, len - n));
+}
+
+// Check the end of the image stream
+static bool ota_check_stream_complete() {
+    if (!ota_writer.ota_started) { return false; }
+    if (ota_writer.format == OTA_FORMAT_LZSS && !lzss_decoder_finished(ota_writer.decoder)) { return false; }
+    if (ota_writer.format == OTA_FORMAT_DELTA && !delta_patch_finished(ota_writer.patch)) { return false; }
+
+    uint8_t digest[32];
+    mbedtls_sha256_finish_ret(&ota_writer.image_sha256, digest);
+    if (ota_writer.format == OTA_FORMAT_DELTA && memcmp(digest, delta_patch_get_target_hash(ota_writer.patch), sizeof(digest)) != 0) {
+        ESP_LOGE(OTA_TAG, "SHA-256 of the patched image doesn't match");
+        return false;
+    }
+    if (ota_writer.has_image_digest && memcmp(digest, ota_writer.image_digest, sizeof(digest)) != 0) {
+        ESP_LOGE(OTA_TAG, "SHA-256 of the written image doesn't match");
+        return false;
+    }
+    return true;
+}
+
+// The task for writing received chunks to flash
+static void ota_writer_task(void* args) {
+
+    ota_write_buffer_t* buffer = NULL;
+    while (xQueueReceive(ota_writer.full_queue, &buffer, portMAX_DELAY) == pdTRUE && buffer != NULL) {
+
+        // Keep draining the queue after an error so the receiver never blocks
+        if (!ota_writer.write_error) {
+            bool ok = false;
+            switch (ota_writer.format) {
+                case OTA_FORMAT_LZSS: ok = lzss_decode(ota_writer.decoder, buffer->data, buffer->len, ota_write_image_data, NULL); break;
+                case OTA_FORMAT_DELTA: ok = delta_patch_apply(ota_writer.patch, buffer->data, buffer->len, ota_read_running_image, ota_write_image_data, NULL); break;
+                default: ok = ota_write_image_data(NULL, buffer->data, buffer->len); break;
+            }
+            if (!ok) { ota_writer.write_error = true; }
+        }
+        xQueueSend(ota_writer.free_queue, &buffer, portMAX_DELAY);
+    }
+
+    ota_writer.stream_complete = (!ota_writer.write_error && ota_check_stream_complete());
+    xSemaphoreGive(ota_writer.writer_done);
+    vTaskDelete(NULL);
+}
+
+// Allocate buffers and start the writer task
+static bool ota_writer_start(const uint32_t chunk_size, const ota_image_format_t format, const uint32_t image_size) {
+    ota_writer.write_error = false;
+    ota_writer.ota_started = false;
+    ota_writer.image_header_len = 0;
+    ota_writer.image_bytes_written = 0;
+    ota_writer.format = format;
+    ota_writer.resumable = (format == OTA_FORMAT_RAW && ota_writer.has_image_digest);
+    ota_writer.image_size = image_size;
+    ota_writer.decoder = NULL;
+    ota_writer.patch = NULL;
+    ota_writer.stream_complete = false;
+    mbedtls_sha256_init(&ota_writer.image_sha256);
+    mbedtls_sha256_starts_ret(&ota_writer.image_sha256, 0);
+    if (format == OTA_FORMAT_LZSS) {
+        ota_writer.decoder = malloc(sizeof(lzss_decoder_t));
+        if (ota_writer.decoder == NULL) { return false; }
+        lzss_decoder_init(ota_writer.decoder);
+    }
+    else if (format == OTA_FORMAT_DELTA) {
+        ota_writer.patch = malloc(sizeof(delta_patch_t));
+        if (ota_writer.patch == NULL) { return false; }
+        delta_patch_init(ota_writer.patch);
+    }
+    ota_writer.free_queue = xQueueCreate(OTA_WRITE_BUFFER_COUNT, sizeof(ota_write_buffer_t*));
+    ota_writer.full_queue = xQueueCreate(OTA_WRITE_BUFFER_COUNT + 1, sizeof(ota_write_buffer_t*)); // +1 for the stop marker
+    ota_writer.writer_done = xSemaphoreCreateBinary();
+    if (ota_writer.free_queue == NULL || ota_writer.full_queue == NULL || ota_writer.writer_done == NULL) { return false; }
+
+    for (uint32_t i = 0; i < OTA_WRITE_BUFFER_COUNT; ++i) {
+        ota_writer.buffers[i].data = malloc(chunk_size);
+        ota_writer.buffers[i].len = 0;
+        if (ota_writer.buffers[i].data == NULL) { return false; }
+        ota_write_buffer_t* buffer = &ota_writer.buffers[i];
+        xQueueSend(ota_writer.free_queue, &buffer, 0);
+    }
+
+    // Below the SLCAN task, which receives the chunks
+    return (xTaskCreatePinnedToCore(ota_writer_task, "BT-OTA-WRITER", 4 * 1024, NULL, 14, NULL, 1) == pdPASS);
+}
+
+// Wait until all queued buffers are written, stop the writer task and free everything
+static void ota_writer_stop(const bool task_running) {
+    if (task_running) {
+        ota_write_buffer_t* stop = NULL;
+        xQueueSend(ota_writer.full_queue, &stop, portMAX_DELAY);
+        xSemaphoreTake(ota_writer.writer_done, portMAX_DELAY);
+    }
+    for (uint32_t i = 0; i < OTA_WRITE_BUFFER_COUNT; ++i) {
+        free(ota_writer.buffers[i].data);
+        ota_writer.buffers[i].data = NULL;
+    }
+    free(ota_writer.decoder);
+    ota_writer.decoder = NULL;
+    free(ota_writer.patch);
+    ota_writer.patch = NULL;
+    mbedtls_sha256_free(&ota_writer.image_sha256);
+    if (ota_writer.free_queue != NULL) { vQueueDelete(ota_writer.free_queue); ota_writer.free_queue = NULL; }
+    if (ota_writer.full_queue != NULL) { vQueueDelete(ota_writer.full_queue); ota_writer.full_queue = NULL; }
+    if (ota_writer.writer_done != NULL) { vSemaphoreDelete(ota_writer.writer_done); ota_writer.writer_done = NULL; }
+}
+
+
+
+// Do a OTA updade via Bluetooth SPP with a sliding window
+bool btspp_do_windowed_ota_update() {
+
+    char msg[OTA_MSG_MAX_SIZE];
+    int data_read = 0;
+
+    ESP_LOGI(OTA_TAG, "Starting windowed BT-OTA");
+    const esp_partition_t* running = esp_ota_get_running_partition();
+    const esp_partition_t* update_partition = esp_ota_get_next_update_partition(NULL);
+    if (update_partition == NULL) { return ota_abort("Error: No update partition"); }
+    ESP_LOGI(OTA_TAG, "Writing to partition subtype %d at offset 0x%x", update_partition->subtype, update_partition->address);
+    ota_writer.running = running;
+    ota_writer.update_partition = update_partition;
+
+    // Get ready
+    data_read = ota_ask("DO FIRMWARE UPLOAD?\r\n", msg, sizeof(msg));
+    if (data_read != 5 || strncmp(msg, "YES\r\n", 5) != 0) { return ota_abort("Error: SPP answer error"); }
+
+    // Get firmware filesize
+    uint32_t binary_file_length = 0;
+    char sha256_hex[65] = "";
+    data_read = ota_ask("FIRMWARE FILESIZE?\r\n", msg, sizeof(msg));
+    if (data_read <= 0 || sscanf(msg, "%u, SHA256 = %64s", &binary_file_length, sha256_hex) < 1 || binary_file_length == 0) {
+        return ota_abort("Error: SPP answer error");
+    }
+    ota_writer.has_image_digest = (sha256_hex[0] != '\0');
+    if (ota_writer.has_image_digest && !ota_parse_sha256(sha256_hex, ota_writer.image_digest)) { return ota_abort("Error: Invalid SHA-256"); }
+    if (binary_file_length > update_partition->size) { return ota_abort("Error: Firmware doesn't fit into the update partition"); }
+    ESP_LOGI(OTA_TAG, "Firmware filesize = %u", binary_file_length);
+
+    // Negotiate chunk size and window
+    // All chunks in flight must fit into the receive buffer of btspp
+    uint32_t max_window = btspp_get_recv_buffer_size() / (OTA_CHUNK_CRC_HEADER_SIZE + OTA_MAX_CHUNK_SIZE);
+    if (max_window > 1) { max_window -= 1; } // Leave room for other data
+    if (max_window > OTA_MAX_WINDOW) { max_window = OTA_MAX_WINDOW; }
+    if (max_window == 0) { max_window = 1; }
+    snprintf(msg, sizeof(msg), "MAX CHUNK SIZE = %u, MAX WINDOW = %u, FORMATS = RAW LZSS DELTA, CHECKS = CRC32\r\n", OTA_MAX_CHUNK_SIZE, max_window);
+    uint32_t chunk_size = 0;
+    uint32_t window = 0;
+    char format[8] = "RAW";
+    data_read = ota_ask(msg, msg, sizeof(msg));
+    if (data_read <= 0) { return ota_abort("Error: SPP answer error"); }
+    const int fields = sscanf(msg, "CHUNK SIZE = %u, WINDOW = %u, FORMAT = %7[A-Z]", &chunk_size, &window, format);
+    const bool crc_announced = (strstr(msg, "CHECKS = CRC32") != NULL);
+    if (fields != 2 && fields != 3) { return ota_abort("Error: SPP answer error"); }
+    if (chunk_size < OTA_MIN_CHUNK_SIZE || chunk_size > OTA_MAX_CHUNK_SIZE || window == 0 || window > max_window) {
+        return ota_abort("Error: Invalid chunk size or window");
+    }
+    ota_image_format_t image_format = OTA_FORMAT_RAW;
+    if (strcmp(format, "LZSS") == 0) { image_format = OTA_FORMAT_LZSS; }
+    else if (strcmp(format, "DELTA") == 0) { image_format = OTA_FORMAT_DELTA; }
+    else if (strcmp(format, "RAW") != 0) { return ota_abort("Error: Unsupported image format"); }
+    ESP_LOGI(OTA_TAG, "Chunk size = %u, window = %u, format = %s", chunk_size, window, format);
+
+    // Start the writer task
+    if (!ota_writer_start(chunk_size, image_format, binary_file_length)) {
+        ota_writer_stop(false);
+        return ota_abort("Error: Not enough memory");
+    }
+
+    // Continue an interrupted upload of the same image
+    const uint32_t resume_offset = (ota_writer.resumable ? ota_resume_from_checkpoint() : 0);
+    if (resume_offset == 0) { ota_clear_checkpoint(); }
+
+    ESP_LOGI(OTA_TAG, "Starting upload...");
+    if (resume_offset > 0) { snprintf(msg, sizeof(msg), "RESUME UPLOAD AT %u!\r\n", resume_offset); }
+    else { snprintf(msg, sizeof(msg), "START UPLOAD!\r\n"); }
+    if (!btspp_send_msg(msg, 2000)) {
+        ota_writer_stop(true);
+        if (ota_writer.ota_started) { esp_ota_abort(ota_writer.update_handle); }
+        return false;
+    }
+
+    uint32_t total_bytes_read = resume_offset;
+    bool nak_pending = false;
+    bool crc_chunks = crc_announced; // The host sends 'OD' chunks, so a corrupted header can be resynced
+    uint32_t crc_errors = 0;
+    uint32_t idle_naks = 0;
+    const char* error = NULL;
+    const int64_t start_time = esp_timer_get_time();
+    while (total_bytes_read < binary_file_length) {
+
+        // Chunk header
+        uint8_t header[OTA_CHUNK_CRC_HEADER_SIZE];
+        uint32_t header_len = 0;
+        if (!ota_recv_header(header, &header_len, OTA_CHUNK_HEADER_SIZE, nak_pending, total_bytes_read, &idle_naks)) { error = "Timeout: SPP data read timeout"; break; }
+        bool has_crc = (header[0] == OTA_CHUNK_MAGIC_0 && header[1] == OTA_CHUNK_MAGIC_1_CRC);
+        if (has_crc && !ota_recv_header(header, &header_len, OTA_CHUNK_CRC_HEADER_SIZE, nak_pending, total_bytes_read, &idle_naks)) {
+            error = "Timeout: SPP data read timeout";
+            break;
+        }
+        crc_chunks = (crc_chunks || has_crc);
+
+        // A corrupted header: ask for the chunk again and continue with the next intact header
+        if (crc_chunks && !(has_crc && ota_crc_header_is_intact(header))) {
+            ESP_LOGW(OTA_TAG, "Corrupted chunk header after %u", total_bytes_read);
+            if (++crc_errors > OTA_MAX_CHUNK_RETRIES) { error = "Error: Too many CRC errors"; break; }
+            nak_pending = true;
+            snprintf(msg, sizeof(msg), "NAK %u\r\n", total_bytes_read);
+            if (!btspp_send_msg(msg, 2000)) { error = "Error: SPP data write error"; break; }
+            if (!ota_resync(header, header_len, total_bytes_read, &idle_naks)) { error = "Timeout: SPP data read timeout"; break; }
+            has_crc = true;
+        }
+        else if (!has_crc && (header[0] != OTA_CHUNK_MAGIC_0 || header[1] != OTA_CHUNK_MAGIC_1)) { error = "Error: Invalid chunk header"; break; }
+
+        const uint32_t len = parse_uint16_12(header + 2);
+        const uint32_t offset = parse_uint32_1234(header + 4);
+        if (len == 0 || len > chunk_size || offset + len > binary_file_length) { error = "Error: Unexpected chunk"; break; }
+
+        // Chunks the host sent before it got our NAK are dropped,
+        // a chunk that was already received is acknowledged again
+        if (offset != total_bytes_read) {
+            if (offset > total_bytes_read && !nak_pending) { error = "Error: Unexpected chunk"; break; }
+            if (!ota_skip_bytes(len, OTA_RECV_TIMEOUT_MS)) { error = "Timeout: SPP data read timeout"; break; }
+            snprintf(msg, sizeof(msg), "%s %u\r\n", (offset < total_bytes_read ? "ACK" : "NAK"), total_bytes_read);
+            if (!btspp_send_msg(msg, 2000)) { error = "Error: SPP data write error"; break; }
+            continue;
+        }
+
+        // Get a free buffer (blocks while the writer is busy with both buffers)
+        ota_write_buffer_t* buffer = NULL;
+        if (xQueueReceive(ota_writer.free_queue, &buffer, pdMS_TO_TICKS(OTA_RECV_TIMEOUT_MS)) != pdTRUE) { error = "Timeout: Flash write timeout"; break; }
+        if (!ota_recv_exact(buffer->data, len, OTA_RECV_TIMEOUT_MS)) {
+            xQueueSend(ota_writer.free_queue, &buffer, 0);
+            error = "Timeout: SPP data read timeout";
+            break;
+        }
+        buffer->len = len;
+
+        // Ask for the chunk again if it got corrupted
+        if (has_crc && esp_rom_crc32_le(esp_rom_crc32_le(0, header, OTA_CHUNK_HEADER_SIZE), buffer->data, len) != parse_uint32_1234(header + 8)) {
+            xQueueSend(ota_writer.free_queue, &buffer, 0);
+            ESP_LOGW(OTA_TAG, "CRC error in chunk at %u", offset);
+            if (++crc_errors > OTA_MAX_CHUNK_RETRIES) { error = "Error: Too many CRC errors"; break; }
+            nak_pending = true;
+            snprintf(msg, sizeof(msg), "NAK %u\r\n", total_bytes_read);
+            if (!btspp_send_msg(msg, 2000)) { error = "Error: SPP data write error"; break; }
+            continue;
+        }
+        nak_pending = false;
+        crc_errors = 0;
+        idle_naks = 0;
+
+        // Hand the chunk to the writer and acknowledge it right away
+        xQueueSend(ota_writer.full_queue, &buffer, portMAX_DELAY);
+        total_bytes_read += len;
+        if (ota_writer.write_error) { error = "Error: Flash write error"; break; }
+
+        snprintf(msg, sizeof(msg), "ACK %u\r\n", total_bytes_read);
+        if (!btspp_send_msg(msg, 2000)) { error = "Error: SPP data write error"; break; }
+        ESP_LOGD(OTA_TAG, "Progress: %u/%u", total_bytes_read, binary_file_length);
+    }
+
+    // Wait for the last writes
+    ota_writer_stop(true);
+    if (error == NULL && ota_writer.write_error) { error = "Error: Flash write error"; }
+    if (error == NULL && !ota_writer.stream_complete) {
+        error = "Error: Image is incomplete or corrupted";
+        ota_clear_checkpoint();
+    }
+    if (error != NULL) {
+        // A resumable update keeps its checkpoint and the written data for the next try
+        if (ota_writer.ota_started) { esp_ota_abort(ota_writer.update_handle); }
+        return ota_abort(error);
+    }
+    ota_clear_checkpoint();
+
+    const int64_t duration_us = esp_timer_get_time() - start_time;
+    ESP_LOGI(OTA_TAG, "Total Write binary data length: %u (received %u) in %lld ms", ota_writer.image_bytes_written, total_bytes_read - resume_offset, duration_us / 1000);
+
+    esp_err_t err = esp_ota_end(ota_writer.update_handle);
+    if (err != ESP_OK) {
+        if (err == ESP_ERR_OTA_VALIDATE_FAILED) {
+            ESP_LOGE(OTA_TAG, "Image validation failed, image is corrupted");
+            btspp_send_msg("VALIDATION FAILED, IMAGE IS CORRUPTED!\r\n", 2000);
+        } else {
+            ESP_LOGE(OTA_TAG, "esp_ota_end failed (%s)!", esp_err_to_name(err));
+            btspp_send_msg("OTA ERROR!\r\n", 2000);
+        }
+        return false;
+    }
+
+    err = esp_ota_set_boot_partition(update_partition);
+    if (err != ESP_OK) {
+        ESP_LOGE(OTA_TAG, "esp_ota_set_boot_partition failed (%s)!", esp_err_to_name(err));
+        if (err == ESP_ERR_OTA_VALIDATE_FAILED) { btspp_send_msg("VALIDATION FAILED, IMAGE IS CORRUPTED!\r\n", 2000); }
+        else { btspp_send_msg("OTA ERROR!\r\n", 2000); }
+        return false;
+    }
+
+    btspp_send_msg("OK!\r\n", 2000);
+    ESP_LOGI(OTA_TAG, "Prepare to restart system!");
+    vTaskDelay(pdMS_TO_TICKS(1000));
+    ESP_LOGI(OTA_TAG, "Restarting system...");
+    esp_restart();
+    return true;
+}
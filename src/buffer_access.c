@@ -27,18 +27,9 @@ void convert_endianess_16(const uint8_t* const in, uint8_t* const out, const int
 
     switch (endianness) {
         case B16_ENDIANESS_12:
-        case LITTLE_ENDIAN: {
-            // out[0] = in[0];
-            // out[1] = in[1];
-            *((uint16_t*) out) = *((const uint16_t*) in);
-        }
-        break;
+        case LITTLE_ENDIAN: memcpy(out, in, 2); break;
         case B16_ENDIANESS_21:
-        case BIG_ENDIAN: {
-            out[0] = in[1];
-            out[1] = in[0];
-        }
-        break;
+        case BIG_ENDIAN: copy_uint16_into_buffer_12(parse_uint16_21(in), out); break;
     }
 }
 
@@ -46,38 +37,10 @@ void convert_endianess_32(const uint8_t* const in, uint8_t* const out, const int
     if (in == NULL || out == NULL) { return; }
     
     switch (endianness) {
-        case LITTLE_ENDIAN: {
-            // out[0] = in[0];
-            // out[1] = in[1];
-            // out[2] = in[2];
-            // out[3] = in[3];
-            *((uint32_t*) out) = *((const uint32_t*) in);
-        }
-        break;
-        case BIG_ENDIAN: {
-            // Reorder bytes
-            out[3] = in[0];
-            out[2] = in[1];
-            out[1] = in[2];
-            out[0] = in[3];
-        }
-        break;
-        case MIXED_ENDIAN: {
-            // Reorder bytes
-            out[1] = in[0];
-            out[0] = in[1];
-            out[3] = in[2];
-            out[2] = in[3];
-        }
-        break;
-        case MIDDLE_ENDIAN: {
-            // Reorder bytes
-            out[2] = in[0];
-            out[3] = in[1];
-            out[0] = in[2];
-            out[1] = in[3];
-        }
-        break;
+        case LITTLE_ENDIAN: memcpy(out, in, 4); break;
+        case BIG_ENDIAN: copy_uint32_into_buffer_1234(parse_uint32_4321(in), out); break;
+        case MIXED_ENDIAN: copy_uint32_into_buffer_1234(parse_uint32_2143(in), out); break;
+        case MIDDLE_ENDIAN: copy_uint32_into_buffer_1234(parse_uint32_3412(in), out); break;
     }
 }
 
@@ -86,108 +49,20 @@ void convert_endianess_64(const uint8_t* const in, uint8_t* const out, const int
     
     switch (endianness) {
         case LITTLE_ENDIAN:
-        case B64_ENDIANESS_12345678: {
-            // out[0] = in[0];
-            // out[1] = in[1];
-            // out[2] = in[2];
-            // out[3] = in[3];
-            // out[4] = in[4];
-            // out[5] = in[5];
-            // out[6] = in[6];
-            // out[7] = in[7];
-            *((uint64_t*) out) = *((const uint64_t*) in);
-        }
-        break;
+        case B64_ENDIANESS_12345678: memcpy(out, in, 8); break;
         case BIG_ENDIAN:
-        case B64_ENDIANESS_87654321: {
-            // Reorder bytes
-            out[7] = in[0];
-            out[6] = in[1];
-            out[5] = in[2];
-            out[4] = in[3];
-            out[3] = in[4];
-            out[2] = in[5];
-            out[1] = in[6];
-            out[0] = in[7];
-        }
-        break;
-        case B64_ENDIANESS_56781234: {
-            // Reorder bytes
-            out[4] = in[0];
-            out[5] = in[1];
-            out[6] = in[2];
-            out[7] = in[3];
-            out[0] = in[4];
-            out[1] = in[5];
-            out[2] = in[6];
-            out[3] = in[7];
-        }
-        break;
-        case B64_ENDIANESS_43218765: {
-            // Reorder bytes
-            out[3] = in[0];
-            out[2] = in[1];
-            out[1] = in[2];
-            out[0] = in[3];
-            out[7] = in[4];
-            out[6] = in[5];
-            out[5] = in[6];
-            out[4] = in[7];
-        }
-        break;
-        case B64_ENDIANESS_34127856: {
-            // Reorder bytes
-            out[2] = in[0];
-            out[3] = in[1];
-            out[0] = in[2];
-            out[1] = in[3];
-            out[6] = in[4];
-            out[7] = in[5];
-            out[4] = in[6];
-            out[5] = in[7];
-        }
-        break;
-        case B64_ENDIANESS_65872143: {
-            // Reorder bytes
-            out[5] = in[0];
-            out[4] = in[1];
-            out[7] = in[2];
-            out[6] = in[3];
-            out[1] = in[4];
-            out[0] = in[5];
-            out[3] = in[6];
-            out[2] = in[7];
-        }
-        break;
-        case B64_ENDIANESS_78563412: {
-            // Reorder bytes
-            out[6] = in[0];
-            out[7] = in[1];
-            out[4] = in[2];
-            out[5] = in[3];
-            out[2] = in[4];
-            out[3] = in[5];
-            out[0] = in[6];
-            out[1] = in[7];
-        }
-        break;
-        case B64_ENDIANESS_21436587: {
-            // Reorder bytes
-            out[1] = in[0];
-            out[0] = in[1];
-            out[3] = in[2];
-            out[2] = in[3];
-            out[5] = in[4];
-            out[4] = in[5];
-            out[7] = in[6];
-            out[6] = in[7];
-        }
-        break;
+        case B64_ENDIANESS_87654321: copy_uint64_into_buffer_12345678(parse_uint64_87654321(in), out); break;
+        case B64_ENDIANESS_56781234: copy_uint64_into_buffer_12345678(parse_uint64_56781234(in), out); break;
+        case B64_ENDIANESS_43218765: copy_uint64_into_buffer_12345678(parse_uint64_43218765(in), out); break;
+        case B64_ENDIANESS_34127856: copy_uint64_into_buffer_12345678(parse_uint64_34127856(in), out); break;
+        case B64_ENDIANESS_65872143: copy_uint64_into_buffer_12345678(parse_uint64_65872143(in), out); break;
+        case B64_ENDIANESS_78563412: copy_uint64_into_buffer_12345678(parse_uint64_78563412(in), out); break;
+        case B64_ENDIANESS_21436587: copy_uint64_into_buffer_12345678(parse_uint64_21436587(in), out); break;
     }
 }
 
 
-// Works because ESP32 is Little Endian system
+// Wrappers around the specialized accessors in buffer_access.h
 // make sure data contains enough space
 
 uint8_t parse_uint8 (const uint8_t* const data) {
@@ -195,33 +70,53 @@ uint8_t parse_uint8 (const uint8_t* const data) {
 }
 
 uint16_t parse_uint16(const uint8_t* const data, const int endianness) {
-    uint16_t buffer = 0;
-    convert_endianess_16(data, (uint8_t*)  &buffer, endianness);
-    return buffer;
+    switch (endianness) {
+        case B16_ENDIANESS_12:
+        case LITTLE_ENDIAN: return parse_uint16_12(data);
+        case B16_ENDIANESS_21:
+        case BIG_ENDIAN: return parse_uint16_21(data);
+    }
+    return 0;
 }
 
 uint32_t parse_uint32(const uint8_t* const data, const int endianness) {
-    uint32_t buffer = 0;
-    convert_endianess_32(data, (uint8_t*)  &buffer, endianness);
-    return buffer;
+    switch (endianness) {
+        case LITTLE_ENDIAN: return parse_uint32_1234(data);
+        case BIG_ENDIAN: return parse_uint32_4321(data);
+        case MIXED_ENDIAN: return parse_uint32_2143(data);
+        case MIDDLE_ENDIAN: return parse_uint32_3412(data);
+    }
+    return 0;
 }
 
 uint64_t parse_uint64(const uint8_t* const data, const int endianness) {
-    uint64_t buffer = 0;
-    convert_endianess_64(data, (uint8_t*)  &buffer, endianness);
-    return buffer;
+    switch (endianness) {
+        case LITTLE_ENDIAN:
+        case B64_ENDIANESS_12345678: return parse_uint64_12345678(data);
+        case BIG_ENDIAN:
+        case B64_ENDIANESS_87654321: return parse_uint64_87654321(data);
+        case B64_ENDIANESS_56781234: return parse_uint64_56781234(data);
+        case B64_ENDIANESS_43218765: return parse_uint64_43218765(data);
+        case B64_ENDIANESS_34127856: return parse_uint64_34127856(data);
+        case B64_ENDIANESS_65872143: return parse_uint64_65872143(data);
+        case B64_ENDIANESS_78563412: return parse_uint64_78563412(data);
+        case B64_ENDIANESS_21436587: return parse_uint64_21436587(data);
+    }
+    return 0;
 }
 
 float parse_float (const uint8_t* const data, const int endianness) {
-    float buffer = 0;
-    convert_endianess_32(data, (uint8_t*) &buffer, endianness);
-    return buffer;
+    const uint32_t raw = parse_uint32(data, endianness);
+    float value = 0;
+    memcpy(&value, &raw, sizeof(value));
+    return value;
 }
 
 double parse_double(const uint8_t* const data, const int endianness) {
-    double buffer = 0;
-    convert_endianess_64(data, (uint8_t*) &buffer, endianness);
-    return buffer;
+    const uint64_t raw = parse_uint64(data, endianness);
+    double value = 0;
+    memcpy(&value, &raw, sizeof(value));
+    return value;
 }
 
 
@@ -231,23 +126,244 @@ void copy_uint8_into_buffer (const uint8_t value, uint8_t* data) {
 }
 
 void copy_uint16_into_buffer(const uint16_t value, uint8_t* data, const int endianness) {
-    convert_endianess_16((const uint8_t*) &value, data, endianness);
+    switch (endianness) {
+        case B16_ENDIANESS_12:
+        case LITTLE_ENDIAN: copy_uint16_into_buffer_12(value, data); break;
+        case B16_ENDIANESS_21:
+        case BIG_ENDIAN: copy_uint16_into_buffer_21(value, data); break;
+    }
 }
 
 void copy_uint32_into_buffer(const uint32_t value, uint8_t* data, const int endianness) {
-    convert_endianess_32((const uint8_t*) &value, data, endianness);
+    switch (endianness) {
+        case LITTLE_ENDIAN: copy_uint32_into_buffer_1234(value, data); break;
+        case BIG_ENDIAN: copy_uint32_into_buffer_4321(value, data); break;
+        case MIXED_ENDIAN: copy_uint32_into_buffer_2143(value, data); break;
+        case MIDDLE_ENDIAN: copy_uint32_into_buffer_3412(value, data); break;
+    }
 }
 
 void copy_uint64_into_buffer(const uint64_t value, uint8_t* data, const int endianness) {
-    convert_endianess_64((const uint8_t*) &value, data, endianness);
+    switch (endianness) {
+        case LITTLE_ENDIAN:
+        case B64_ENDIANESS_12345678: copy_uint64_into_buffer_12345678(value, data); break;
+        case BIG_ENDIAN:
+        case B64_ENDIANESS_87654321: copy_uint64_into_buffer_87654321(value, data); break;
+        case B64_ENDIANESS_56781234: copy_uint64_into_buffer_56781234(value, data); break;
+        case B64_ENDIANESS_43218765: copy_uint64_into_buffer_43218765(value, data); break;
+        case B64_ENDIANESS_34127856: copy_uint64_into_buffer_34127856(value, data); break;
+        case B64_ENDIANESS_65872143: copy_uint64_into_buffer_65872143(value, data); break;
+        case B64_ENDIANESS_78563412: copy_uint64_into_buffer_78563412(value, data); break;
+        case B64_ENDIANESS_21436587: copy_uint64_into_buffer_21436587(value, data); break;
+    }
 }
 
 void copy_float_into_buffer (const float value, uint8_t* data, const int endianness) {
-    convert_endianess_32((const uint8_t*) &value, data, endianness);
+    uint32_t raw = 0;
+    memcpy(&raw, &value, sizeof(raw));
+    copy_uint32_into_buffer(raw, data, endianness);
 }
 
 void copy_double_into_buffer(const double value, uint8_t* data, const int endianness) {
-    convert_endianess_64((const uint8_t*) &value, data, endianness);
+    uint64_t raw = 0;
+    memcpy(&raw, &value, sizeof(raw));
+    copy_uint64_into_buffer(raw, data, endianness);
+}
+
+
+
+
+
+
+// Bulk conversion
+// Aligned buffers are processed a word at a time: one native load/store and
+// a permutation of the bytes in registers. Unaligned buffers fall back to the
+// byte wise accessors, since Xtensa can't load unaligned words.
+// The word permutations assume a little endian CPU (like the ESP32).
+
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define BUFFER_ACCESS_WORD_PERMUTATION 1
+#else
+#define BUFFER_ACCESS_WORD_PERMUTATION 0
+#endif
+
+#define ROTATE_32(x) ((uint64_t) (x) << 32 | (uint64_t) (x) >> 32)
+#define SWAP_BYTES_IN_16_BIT_LANES_32(x) ((((x) & 0x00FF00FFu) << 8) | (((x) >> 8) & 0x00FF00FFu))
+#define SWAP_BYTES_IN_16_BIT_LANES_64(x) ((((x) & 0x00FF00FF00FF00FFull) << 8) | (((x) >> 8) & 0x00FF00FF00FF00FFull))
+#define ROTATE_16_IN_32_BIT_LANES_64(x) ((((x) & 0x0000FFFF0000FFFFull) << 16) | (((x) >> 16) & 0x0000FFFF0000FFFFull))
+
+// Byte permutations of a word loaded from the buffer (all of them are their own inverse)
+static inline uint16_t permute_uint16_12(const uint16_t w) { return w; }
+static inline uint16_t permute_uint16_21(const uint16_t w) { return __builtin_bswap16(w); }
+
+static inline uint32_t permute_uint32_1234(const uint32_t w) { return w; }
+static inline uint32_t permute_uint32_4321(const uint32_t w) { return __builtin_bswap32(w); }
+static inline uint32_t permute_uint32_2143(const uint32_t w) { return SWAP_BYTES_IN_16_BIT_LANES_32(w); }
+static inline uint32_t permute_uint32_3412(const uint32_t w) { return (w << 16) | (w >> 16); }
+
+static inline uint64_t permute_uint64_12345678(const uint64_t w) { return w; }
+static inline uint64_t permute_uint64_87654321(const uint64_t w) { return __builtin_bswap64(w); }
+static inline uint64_t permute_uint64_56781234(const uint64_t w) { return ROTATE_32(w); }
+static inline uint64_t permute_uint64_43218765(const uint64_t w) { return ROTATE_32(__builtin_bswap64(w)); }
+static inline uint64_t permute_uint64_34127856(const uint64_t w) { return ROTATE_16_IN_32_BIT_LANES_64(w); }
+static inline uint64_t permute_uint64_65872143(const uint64_t w) { return ROTATE_32(SWAP_BYTES_IN_16_BIT_LANES_64(w)); }
+static inline uint64_t permute_uint64_78563412(const uint64_t w) { return SWAP_BYTES_IN_16_BIT_LANES_64(__builtin_bswap64(w)); }
+static inline uint64_t permute_uint64_21436587(const uint64_t w) { return SWAP_BYTES_IN_16_BIT_LANES_64(w); }
+
+// Workers for one byte order, 'values' points to an array of native words (or floats/doubles of the same size)
+typedef void (bulk_parse_t) (const uint8_t* const data, void* const values, const uint32_t count);
+typedef void (bulk_copy_t) (const void* const values, uint8_t* const data, const uint32_t count);
+
+// memcpy keeps the float/double arrays free of aliasing problems, it compiles to single loads and stores
+#define DEFINE_BULK_WORKERS(TYPE, ORDER) \
+static void bulk_parse_##TYPE##_##ORDER(const uint8_t* const data, void* const values, const uint32_t count) { \
+    uint8_t* const out = (uint8_t*) values; \
+    TYPE##_t value; \
+    if (BUFFER_ACCESS_WORD_PERMUTATION && ((uintptr_t) data % sizeof(TYPE##_t)) == 0) { \
+        const uint8_t* const in = (const uint8_t*) __builtin_assume_aligned(data, sizeof(TYPE##_t)); \
+        for (uint32_t i = 0; i < count; ++i) { \
+            memcpy(&value, in + i * sizeof(TYPE##_t), sizeof(TYPE##_t)); \
+            value = permute_##TYPE##_##ORDER(value); \
+            memcpy(out + i * sizeof(TYPE##_t), &value, sizeof(TYPE##_t)); \
+        } \
+    } \
+    else { \
+        for (uint32_t i = 0; i < count; ++i) { \
+            value = parse_##TYPE##_##ORDER(data + i * sizeof(TYPE##_t)); \
+            memcpy(out + i * sizeof(TYPE##_t), &value, sizeof(TYPE##_t)); \
+        } \
+    } \
+} \
+static void bulk_copy_##TYPE##_##ORDER(const void* const values, uint8_t* const data, const uint32_t count) { \
+    const uint8_t* const in = (const uint8_t*) values; \
+    TYPE##_t value; \
+    if (BUFFER_ACCESS_WORD_PERMUTATION && ((uintptr_t) data % sizeof(TYPE##_t)) == 0) { \
+        uint8_t* const out = (uint8_t*) __builtin_assume_aligned(data, sizeof(TYPE##_t)); \
+        for (uint32_t i = 0; i < count; ++i) { \
+            memcpy(&value, in + i * sizeof(TYPE##_t), sizeof(TYPE##_t)); \
+            value = permute_##TYPE##_##ORDER(value); \
+            memcpy(out + i * sizeof(TYPE##_t), &value, sizeof(TYPE##_t)); \
+        } \
+    } \
+    else { \
+        for (uint32_t i = 0; i < count; ++i) { \
+            memcpy(&value, in + i * sizeof(TYPE##_t), sizeof(TYPE##_t)); \
+            copy_##TYPE##_into_buffer_##ORDER(value, data + i * sizeof(TYPE##_t)); \
+        } \
+    } \
+}
+
+DEFINE_BULK_WORKERS(uint16, 12)
+DEFINE_BULK_WORKERS(uint16, 21)
+
+DEFINE_BULK_WORKERS(uint32, 1234)
+DEFINE_BULK_WORKERS(uint32, 4321)
+DEFINE_BULK_WORKERS(uint32, 2143)
+DEFINE_BULK_WORKERS(uint32, 3412)
+
+DEFINE_BULK_WORKERS(uint64, 12345678)
+DEFINE_BULK_WORKERS(uint64, 87654321)
+DEFINE_BULK_WORKERS(uint64, 56781234)
+DEFINE_BULK_WORKERS(uint64, 43218765)
+DEFINE_BULK_WORKERS(uint64, 34127856)
+DEFINE_BULK_WORKERS(uint64, 65872143)
+DEFINE_BULK_WORKERS(uint64, 78563412)
+DEFINE_BULK_WORKERS(uint64, 21436587)
+
+// Select the workers once per call
+#define SELECT_BULK_WORKER(KIND, TYPE, ORDER) (bulk_##KIND##_##TYPE##_##ORDER)
+
+#define DEFINE_BULK_SELECTORS(KIND) \
+static bulk_##KIND##_t* select_bulk_##KIND##_16(const int endianness) { \
+    switch (endianness) { \
+        case B16_ENDIANESS_12: \
+        case LITTLE_ENDIAN: return SELECT_BULK_WORKER(KIND, uint16, 12); \
+        case B16_ENDIANESS_21: \
+        case BIG_ENDIAN: return SELECT_BULK_WORKER(KIND, uint16, 21); \
+    } \
+    return NULL; \
+} \
+static bulk_##KIND##_t* select_bulk_##KIND##_32(const int endianness) { \
+    switch (endianness) { \
+        case LITTLE_ENDIAN: return SELECT_BULK_WORKER(KIND, uint32, 1234); \
+        case BIG_ENDIAN: return SELECT_BULK_WORKER(KIND, uint32, 4321); \
+        case MIXED_ENDIAN: return SELECT_BULK_WORKER(KIND, uint32, 2143); \
+        case MIDDLE_ENDIAN: return SELECT_BULK_WORKER(KIND, uint32, 3412); \
+    } \
+    return NULL; \
+} \
+static bulk_##KIND##_t* select_bulk_##KIND##_64(const int endianness) { \
+    switch (endianness) { \
+        case LITTLE_ENDIAN: \
+        case B64_ENDIANESS_12345678: return SELECT_BULK_WORKER(KIND, uint64, 12345678); \
+        case BIG_ENDIAN: \
+        case B64_ENDIANESS_87654321: return SELECT_BULK_WORKER(KIND, uint64, 87654321); \
+        case B64_ENDIANESS_56781234: return SELECT_BULK_WORKER(KIND, uint64, 56781234); \
+        case B64_ENDIANESS_43218765: return SELECT_BULK_WORKER(KIND, uint64, 43218765); \
+        case B64_ENDIANESS_34127856: return SELECT_BULK_WORKER(KIND, uint64, 34127856); \
+        case B64_ENDIANESS_65872143: return SELECT_BULK_WORKER(KIND, uint64, 65872143); \
+        case B64_ENDIANESS_78563412: return SELECT_BULK_WORKER(KIND, uint64, 78563412); \
+        case B64_ENDIANESS_21436587: return SELECT_BULK_WORKER(KIND, uint64, 21436587); \
+    } \
+    return NULL; \
+}
+
+DEFINE_BULK_SELECTORS(parse)
+DEFINE_BULK_SELECTORS(copy)
+
+// Unknown byte orders leave the values untouched (like the scalar functions)
+static void bulk_parse(bulk_parse_t* const worker, const uint8_t* const data, void* const values, const uint32_t count) {
+    if (worker == NULL || data == NULL || values == NULL) { return; }
+    worker(data, values, count);
+}
+
+static void bulk_copy(bulk_copy_t* const worker, const void* const values, uint8_t* const data, const uint32_t count) {
+    if (worker == NULL || data == NULL || values == NULL) { return; }
+    worker(values, data, count);
+}
+
+
+
+void parse_uint16_array(const uint8_t* const data, uint16_t* const values, const uint32_t count, const int endianness) {
+    bulk_parse(select_bulk_parse_16(endianness), data, values, count);
+}
+
+void parse_uint32_array(const uint8_t* const data, uint32_t* const values, const uint32_t count, const int endianness) {
+    bulk_parse(select_bulk_parse_32(endianness), data, values, count);
+}
+
+void parse_uint64_array(const uint8_t* const data, uint64_t* const values, const uint32_t count, const int endianness) {
+    bulk_parse(select_bulk_parse_64(endianness), data, values, count);
+}
+
+void parse_float_array (const uint8_t* const data, float* const values, const uint32_t count, const int endianness) {
+    bulk_parse(select_bulk_parse_32(endianness), data, values, count);
+}
+
+void parse_double_array(const uint8_t* const data, double* const values, const uint32_t count, const int endianness) {
+    bulk_parse(select_bulk_parse_64(endianness), data, values, count);
+}
+
+
+
+void copy_uint16_array_into_buffer(const uint16_t* const values, uint8_t* data, const uint32_t count, const int endianness) {
+    bulk_copy(select_bulk_copy_16(endianness), values, data, count);
+}
+
+void copy_uint32_array_into_buffer(const uint32_t* const values, uint8_t* data, const uint32_t count, const int endianness) {
+    bulk_copy(select_bulk_copy_32(endianness), values, data, count);
+}
+
+void copy_uint64_array_into_buffer(const uint64_t* const values, uint8_t* data, const uint32_t count, const int endianness) {
+    bulk_copy(select_bulk_copy_64(endianness), values, data, count);
+}
+
+void copy_float_array_into_buffer (const float* const values, uint8_t* data, const uint32_t count, const int endianness) {
+    bulk_copy(select_bulk_copy_32(endianness), values, data, count);
+}
+
+void copy_double_array_into_buffer(const double* const values, uint8_t* data, const uint32_t count, const int endianness) {
+    bulk_copy(select_bulk_copy_64(endianness), values, data, count);
 }
 
 
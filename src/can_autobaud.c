@@ -0,0 +1,94 @@
+#include "can_autobaud.h"
+
+// FreeRTOS
+#include "freertos/FreeRTOS.h"
+
+// Timer API
+#include "esp_timer.h"
+
+// Header for debug messages
+#include "esp_log.h"
+#define AUTOBAUD_TAG "CAN-AUTOBAUD"
+
+
+
+// Bus errors counted by the driver since it was installed
+static uint32_t get_bus_errors() {
+    twai_status_info_t status_info = {};
+    return (twai_get_status_info(&status_info) == ESP_OK ? status_info.bus_error_count : 0);
+}
+
+// Listen with a single candidate, returns false if the driver refused the timing
+static bool score_candidate(
+    const twai_general_config_t* const general_config, const twai_timing_config_t* const timing_config, 
+    const uint32_t dwell_ms, can_autobaud_score_t* const score
+) {
+    static const twai_filter_config_t filter_config = TWAI_FILTER_CONFIG_ACCEPT_ALL();
+    if (twai_driver_install(general_config, timing_config, &filter_config) != ESP_OK) { return false; }
+    if (twai_start() != ESP_OK) {
+        twai_driver_uninstall();
+        return false;
+    }
+
+    // Every received frame passed the CRC check, so a few of them are enough.
+    // A wrong bitrate mostly shows as stuff and form errors, even without frames on the bus
+    // the wait is only interrupted once per tick to count them.
+    const int64_t end = esp_timer_get_time() + dwell_ms * 1000LL;
+    twai_message_t message = {};
+    score->tested = true;
+    score->frames = 0;
+    score->bus_errors = 0;
+    while (true) {
+        if (esp_timer_get_time() >= end) { break; }
+        if (twai_receive(&message, 1) == ESP_OK) { score->frames += 1; }
+        score->bus_errors = get_bus_errors();
+
+        if (score->frames >= CAN_AUTOBAUD_MIN_FRAMES && score->bus_errors == 0) { break; }
+        if (score->bus_errors >= CAN_AUTOBAUD_MAX_BUS_ERRORS && score->frames == 0) { break; }
+    }
+
+    twai_stop();
+    twai_driver_uninstall();
+    return true;
+}
+
+
+
+// Try the candidates in order
+int32_t can_autobaud_detect(
+    const twai_general_config_t* const general_config, 
+    const twai_timing_config_t* const candidates, const uint32_t count, 
+    const uint32_t dwell_ms, can_autobaud_score_t* const scores
+) {
+    twai_general_config_t listen_config = *general_config;
+    listen_config.mode = TWAI_MODE_LISTEN_ONLY;
+
+    int32_t best = -1;
+    int32_t best_score = 0;
+    const int64_t start = esp_timer_get_time();
+    for (uint32_t i = 0; i < count; ++i) {
+        can_autobaud_score_t score = {};
+        if (!score_candidate(&listen_config, &candidates[i], dwell_ms, &score)) {
+            ESP_LOGW(AUTOBAUD_TAG, "Candidate %u: timing not supported", i);
+        }
+        if (scores != NULL) { scores[i] = score; }
+        ESP_LOGI(AUTOBAUD_TAG, "Candidate %u: %u frames, %u bus errors", i, score.frames, score.bus_errors);
+
+        // Clearly correct, skip the remaining candidates
+        if (score.frames >= CAN_AUTOBAUD_MIN_FRAMES && score.bus_errors == 0) {
+            best = (int32_t) i;
+            for (uint32_t j = i + 1; scores != NULL && j < count; ++j) { scores[j] = (can_autobaud_score_t) {}; }
+            break;
+        }
+
+        // Else keep the candidate with the most frames beyond its bus errors
+        const int32_t candidate_score = (int32_t) score.frames - (int32_t) score.bus_errors;
+        if (score.frames > 0 && candidate_score > best_score) {
+            best = (int32_t) i;
+            best_score = candidate_score;
+        }
+    }
+
+    ESP_LOGI(AUTOBAUD_TAG, "Detection took %lld ms, result: %d", (esp_timer_get_time() - start) / 1000, best);
+    return best;
+}
@@ -0,0 +1,246 @@
+#include "can_bcm.h"
+#include "string.h" // memcpy, memset
+
+// FreeRTOS
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+// Timer API
+#include "esp_timer.h"
+
+// Header for debug messages
+#include "esp_log.h"
+#define BCM_TAG "CAN-BCM"
+
+
+// A cyclic TX job
+typedef struct {
+    bool used;
+    esp_timer_handle_t timer;
+    twai_message_t message;
+} tx_job_t;
+
+// A subscription
+typedef struct {
+    bool used;
+    uint32_t identifier;
+    bool extended;
+    bool content_filter; // Only forward changes in the masked data
+    uint8_t content_mask[8];
+    int64_t throttle_us;
+    bool has_last; // 'last' holds the previous frame
+    twai_message_t last;
+    int64_t last_forwarded_us;
+    bool has_pending; // 'pending' is held back by the throttle
+    twai_message_t pending;
+} rx_filter_t;
+
+// Jobs and filters are changed by the SLCAN task,
+// used by the esp_timer task (TX) and the auto-poll task (RX)
+static struct {
+    SemaphoreHandle_t lock;
+    tx_job_t tx_jobs[CAN_BCM_MAX_TX_JOBS];
+    rx_filter_t rx_filters[CAN_BCM_MAX_RX_FILTERS];
+} bcm = {};
+
+
+
+// Send the frame of a TX job (esp_timer callback)
+static void send_tx_job(void* arg) {
+    tx_job_t* const job = (tx_job_t*) arg;
+    xSemaphoreTake(bcm.lock, portMAX_DELAY);
+    const bool used = job->used;
+    twai_message_t message = job->message;
+    xSemaphoreGive(bcm.lock);
+
+    // Don't block the timer task, a full TX queue drops the frame
+    if (used) { twai_transmit(&message, 0); }
+}
+
+// Find a TX job (lock must be held)
+static tx_job_t* find_tx_job(const uint32_t identifier, const bool extended) {
+    for (uint32_t i = 0; i < CAN_BCM_MAX_TX_JOBS; ++i) {
+        tx_job_t* const job = &bcm.tx_jobs[i];
+        if (job->used && job->message.identifier == identifier && job->message.extd == extended) { return job; }
+    }
+    return NULL;
+}
+
+// Stop and free a TX job (lock must be held)
+static void free_tx_job(tx_job_t* const job) {
+    esp_timer_stop(job->timer);
+    esp_timer_delete(job->timer);
+    job->timer = NULL;
+    job->used = false;
+}
+
+// Find an RX filter (lock must be held)
+static rx_filter_t* find_rx_filter(const uint32_t identifier, const bool extended) {
+    for (uint32_t i = 0; i < CAN_BCM_MAX_RX_FILTERS; ++i) {
+        rx_filter_t* const filter = &bcm.rx_filters[i];
+        if (filter->used && filter->identifier == identifier && filter->extended == extended) { return filter; }
+    }
+    return NULL;
+}
+
+// Check if a frame differs from the previous one in the masked data or DLC
+static bool content_changed(const rx_filter_t* const filter, const twai_message_t* const message) {
+    if (!filter->has_last || filter->last.data_length_code != message->data_length_code) { return true; }
+    for (uint32_t i = 0; i < 8; ++i) {
+        if ((filter->last.data[i] ^ message->data[i]) & filter->content_mask[i]) { return true; }
+    }
+    return false;
+}
+
+
+
+// Initialize the broadcast manager
+void can_bcm_init() {
+    if (bcm.lock == NULL) { bcm.lock = xSemaphoreCreateMutex(); }
+}
+
+// Delete all TX jobs and RX filters
+void can_bcm_reset() {
+    xSemaphoreTake(bcm.lock, portMAX_DELAY);
+    for (uint32_t i = 0; i < CAN_BCM_MAX_TX_JOBS; ++i) {
+        if (bcm.tx_jobs[i].used) { free_tx_job(&bcm.tx_jobs[i]); }
+    }
+    memset(bcm.rx_filters, 0, sizeof(bcm.rx_filters));
+    xSemaphoreGive(bcm.lock);
+}
+
+// Start sending a frame cyclically
+bool can_bcm_add_tx_job(const uint64_t interval_us, const twai_message_t* const message) {
+    if (interval_us == 0) { return false; }
+    xSemaphoreTake(bcm.lock, portMAX_DELAY);
+
+    // Replace an existing job, else take a free slot
+    tx_job_t* job = find_tx_job(message->identifier, message->extd);
+    if (job != NULL) { free_tx_job(job); }
+    for (uint32_t i = 0; i < CAN_BCM_MAX_TX_JOBS && job == NULL; ++i) {
+        if (!bcm.tx_jobs[i].used) { job = &bcm.tx_jobs[i]; }
+    }
+
+    bool success = false;
+    if (job != NULL) {
+        const esp_timer_create_args_t timer_args = {
+            .callback = send_tx_job,
+            .arg = job,
+            .name = "CAN-BCM-TX"
+        };
+        job->message = *message;
+        success = (esp_timer_create(&timer_args, &job->timer) == ESP_OK);
+        if (success && esp_timer_start_periodic(job->timer, interval_us) != ESP_OK) {
+            esp_timer_delete(job->timer);
+            success = false;
+        }
+        job->used = success;
+    }
+
+    xSemaphoreGive(bcm.lock);
+    if (!success) { ESP_LOGW(BCM_TAG, "Unable to add TX job for 0x%X", message->identifier); }
+    return success;
+}
+
+// Change the data of a running TX job
+bool can_bcm_update_tx_job(const twai_message_t* const message) {
+    xSemaphoreTake(bcm.lock, portMAX_DELAY);
+    tx_job_t* const job = find_tx_job(message->identifier, message->extd);
+    if (job != NULL) { job->message = *message; }
+    xSemaphoreGive(bcm.lock);
+    return (job != NULL);
+}
+
+// Stop a TX job
+bool can_bcm_delete_tx_job(const uint32_t identifier, const bool extended) {
+    xSemaphoreTake(bcm.lock, portMAX_DELAY);
+    tx_job_t* const job = find_tx_job(identifier, extended);
+    if (job != NULL) { free_tx_job(job); }
+    xSemaphoreGive(bcm.lock);
+    return (job != NULL);
+}
+
+// Subscribe an identifier
+bool can_bcm_add_rx_filter(const uint64_t throttle_us, const uint32_t identifier, const bool extended, const uint8_t* const content_mask) {
+    xSemaphoreTake(bcm.lock, portMAX_DELAY);
+    rx_filter_t* filter = find_rx_filter(identifier, extended);
+    for (uint32_t i = 0; i < CAN_BCM_MAX_RX_FILTERS && filter == NULL; ++i) {
+        if (!bcm.rx_filters[i].used) { filter = &bcm.rx_filters[i]; }
+    }
+    if (filter != NULL) {
+        memset(filter, 0, sizeof(rx_filter_t));
+        filter->used = true;
+        filter->identifier = identifier;
+        filter->extended = extended;
+        filter->content_filter = (content_mask != NULL);
+        if (content_mask != NULL) { memcpy(filter->content_mask, content_mask, 8); }
+        filter->throttle_us = (int64_t) throttle_us;
+    }
+    xSemaphoreGive(bcm.lock);
+    return (filter != NULL);
+}
+
+// Remove a filter
+bool can_bcm_delete_rx_filter(const uint32_t identifier, const bool extended) {
+    xSemaphoreTake(bcm.lock, portMAX_DELAY);
+    rx_filter_t* const filter = find_rx_filter(identifier, extended);
+    if (filter != NULL) { filter->used = false; }
+    xSemaphoreGive(bcm.lock);
+    return (filter != NULL);
+}
+
+// Check a received frame against the RX filters
+bool can_bcm_filter_frame(const int64_t now_us, const twai_message_t* const message) {
+    xSemaphoreTake(bcm.lock, portMAX_DELAY);
+    rx_filter_t* const filter = find_rx_filter(message->identifier, message->extd);
+    bool forward = false;
+    if (filter != NULL && (!filter->content_filter || content_changed(filter, message))) {
+        if (filter->throttle_us > 0 && filter->has_last && now_us - filter->last_forwarded_us < filter->throttle_us) {
+            // Hold back the latest change until the interval ends
+            filter->pending = *message;
+            filter->has_pending = true;
+        }
+        else {
+            filter->last_forwarded_us = now_us;
+            filter->has_pending = false;
+            forward = true;
+        }
+    }
+    if (filter != NULL) {
+        filter->last = *message;
+        filter->has_last = true;
+    }
+    xSemaphoreGive(bcm.lock);
+    return forward;
+}
+
+// Get a frame held back by a throttle that is due now
+bool can_bcm_take_throttled_frame(const int64_t now_us, twai_message_t* const message) {
+    xSemaphoreTake(bcm.lock, portMAX_DELAY);
+    bool found = false;
+    for (uint32_t i = 0; i < CAN_BCM_MAX_RX_FILTERS && !found; ++i) {
+        rx_filter_t* const filter = &bcm.rx_filters[i];
+        if (filter->used && filter->has_pending && now_us - filter->last_forwarded_us >= filter->throttle_us) {
+            *message = filter->pending;
+            filter->has_pending = false;
+            filter->last_forwarded_us = now_us;
+            found = true;
+        }
+    }
+    xSemaphoreGive(bcm.lock);
+    return found;
+}
+
+// Time when the next held back frame is due
+int64_t can_bcm_get_next_throttle_end() {
+    xSemaphoreTake(bcm.lock, portMAX_DELAY);
+    int64_t next = INT64_MAX;
+    for (uint32_t i = 0; i < CAN_BCM_MAX_RX_FILTERS; ++i) {
+        const rx_filter_t* const filter = &bcm.rx_filters[i];
+        if (filter->used && filter->has_pending && filter->last_forwarded_us + filter->throttle_us < next) {
+            next = filter->last_forwarded_us + filter->throttle_us;
+        }
+    }
+    xSemaphoreGive(bcm.lock);
+    return next;
+}
@@ -0,0 +1,217 @@
+#include "can_capture.h"
+#include "buffer_access.h"
+#include "file_access.h"
+#include "string.h" // memcpy, memset
+#include "stdlib.h" // malloc, free
+
+// FreeRTOS
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+// Header for debug messages
+#include "esp_log.h"
+#define CAPTURE_TAG "CAN-CAPTURE"
+
+
+typedef enum {
+    CAPTURE_IDLE = 0,
+    CAPTURE_ARMED, // Waiting for the trigger, keeping the last 'pre' frames
+    CAPTURE_TRIGGERED, // Capturing the post trigger frames
+    CAPTURE_COMPLETE // Waiting to be saved
+} capture_state_t;
+
+// The capture, the buffer holds the file header followed by the ring of frame records
+// Armed/disarmed by the SLCAN task, fed and saved by the auto-poll task
+static struct {
+    SemaphoreHandle_t lock;
+    capture_state_t state;
+    can_capture_trigger_t trigger;
+    uint32_t pre;
+    uint32_t post;
+    uint8_t* buffer;
+    uint32_t capacity; // pre + 1 + post records
+    uint32_t head; // Oldest record
+    uint32_t count;
+    uint32_t pre_trigger_count;
+    uint32_t remaining; // Post trigger frames still to capture
+    uint8_t source;
+    uint32_t alerts;
+} capture = {};
+
+
+
+// Pointer to a record of the ring
+static inline uint8_t* get_record(const uint32_t index) {
+    return capture.buffer + CAN_CAPTURE_HEADER_SIZE + ((capture.head + index) % capture.capacity) * CAN_CAPTURE_RECORD_SIZE;
+}
+
+// Check a frame against the trigger
+static bool frame_matches_trigger(const uint32_t key, const uint8_t* const data, const uint8_t len) {
+    if (capture.trigger.alerts != 0) { return false; }
+    if ((key ^ capture.trigger.identifier) & capture.trigger.identifier_mask) { return false; }
+    for (uint32_t i = 0; i < 8; ++i) {
+        const uint8_t byte = (i < len ? data[i] : 0);
+        if ((byte ^ capture.trigger.data[i]) & capture.trigger.data_mask[i]) { return false; }
+    }
+    return true;
+}
+
+// Switch to triggered state
+static void fire_trigger(const uint8_t source, const uint32_t alerts) {
+    capture.pre_trigger_count = capture.count - (source == CAN_CAPTURE_SOURCE_FRAME ? 1 : 0);
+    capture.remaining = capture.post;
+    capture.source = source;
+    capture.alerts = alerts;
+    capture.state = (capture.remaining == 0 ? CAPTURE_COMPLETE : CAPTURE_TRIGGERED);
+    ESP_LOGI(CAPTURE_TAG, "Triggered (source %u, %u frames before the trigger)", source, capture.pre_trigger_count);
+}
+
+// Swap two records
+static void swap_records(uint8_t* const a, uint8_t* const b) {
+    uint8_t tmp[CAN_CAPTURE_RECORD_SIZE];
+    memcpy(tmp, a, CAN_CAPTURE_RECORD_SIZE);
+    memcpy(a, b, CAN_CAPTURE_RECORD_SIZE);
+    memcpy(b, tmp, CAN_CAPTURE_RECORD_SIZE);
+}
+
+// Reverse the records [first, last) of the buffer
+static void reverse_records(uint32_t first, uint32_t last) {
+    uint8_t* const records = capture.buffer + CAN_CAPTURE_HEADER_SIZE;
+    while (first + 1 < last) {
+        last -= 1;
+        swap_records(records + first * CAN_CAPTURE_RECORD_SIZE, records + last * CAN_CAPTURE_RECORD_SIZE);
+        first += 1;
+    }
+}
+
+// Rotate the ring in place, so the oldest record is the first one
+static void linearize_records() {
+    if (capture.head == 0) { return; }
+    reverse_records(0, capture.head);
+    reverse_records(capture.head, capture.capacity);
+    reverse_records(0, capture.capacity);
+    capture.head = 0;
+}
+
+// Free the buffer (lock must be held)
+static void release_capture() {
+    free(capture.buffer);
+    capture.buffer = NULL;
+    capture.state = CAPTURE_IDLE;
+}
+
+
+
+void can_capture_init() {
+    if (capture.lock == NULL) {
+        capture.lock = xSemaphoreCreateMutex();
+    }
+}
+
+bool can_capture_arm(const uint32_t pre, const uint32_t post, const can_capture_trigger_t* const trigger) {
+    if (trigger == NULL || pre + 1 + post > CAN_CAPTURE_MAX_FRAMES) { return false; }
+
+    xSemaphoreTake(capture.lock, portMAX_DELAY);
+    release_capture();
+    capture.capacity = pre + 1 + post;
+    capture.buffer = malloc(CAN_CAPTURE_HEADER_SIZE + capture.capacity * CAN_CAPTURE_RECORD_SIZE);
+    if (capture.buffer != NULL) {
+        capture.trigger = *trigger;
+        capture.pre = pre;
+        capture.post = post;
+        capture.head = 0;
+        capture.count = 0;
+        capture.state = CAPTURE_ARMED;
+        ESP_LOGI(CAPTURE_TAG, "Armed (%u frames before and %u after the trigger)", pre, post);
+    }
+    else {
+        ESP_LOGE(CAPTURE_TAG, "Not enough memory for %u frames", capture.capacity);
+    }
+    const bool success = (capture.buffer != NULL);
+    xSemaphoreGive(capture.lock);
+    return success;
+}
+
+void can_capture_disarm() {
+    xSemaphoreTake(capture.lock, portMAX_DELAY);
+    release_capture();
+    xSemaphoreGive(capture.lock);
+}
+
+bool can_capture_is_active() {
+    return (capture.state == CAPTURE_ARMED || capture.state == CAPTURE_TRIGGERED);
+}
+
+bool can_capture_uses_alerts() {
+    return (capture.state == CAPTURE_ARMED && capture.trigger.alerts != 0);
+}
+
+bool can_capture_add_frame(const uint32_t timestamp, const uint32_t identifier, const bool extended, const bool rtr, const uint8_t dlc, const uint8_t* const data) {
+    xSemaphoreTake(capture.lock, portMAX_DELAY);
+    if (capture.state == CAPTURE_ARMED || capture.state == CAPTURE_TRIGGERED) {
+
+        // Store the frame
+        const uint32_t key = identifier | (extended ? CAN_CAPTURE_EXTENDED_ID_FLAG : 0) | (rtr ? CAN_CAPTURE_RTR_FLAG : 0);
+        const uint8_t len = (rtr ? 0 : (dlc > 8 ? 8 : dlc));
+        uint8_t* const record = get_record(capture.count);
+        memset(record, 0, CAN_CAPTURE_RECORD_SIZE);
+        copy_uint32_into_buffer_1234(timestamp, record + 0);
+        copy_uint32_into_buffer_1234(key, record + 4);
+        record[8] = dlc;
+        memcpy(record + 12, data, len);
+        capture.count += 1;
+
+        if (capture.state == CAPTURE_ARMED) {
+            // Check the trigger, only keep the last 'pre' frames while waiting for it
+            if (frame_matches_trigger(key, data, len)) {
+                fire_trigger(CAN_CAPTURE_SOURCE_FRAME, 0);
+            }
+            else if (capture.count > capture.pre) {
+                capture.head = (capture.head + 1) % capture.capacity;
+                capture.count -= 1;
+            }
+        }
+        else if (--capture.remaining == 0) {
+            capture.state = CAPTURE_COMPLETE;
+        }
+    }
+    const bool complete = (capture.state == CAPTURE_COMPLETE);
+    xSemaphoreGive(capture.lock);
+    return complete;
+}
+
+bool can_capture_add_alerts(const uint32_t alerts) {
+    xSemaphoreTake(capture.lock, portMAX_DELAY);
+    if (capture.state == CAPTURE_ARMED && (alerts & capture.trigger.alerts)) {
+        fire_trigger(CAN_CAPTURE_SOURCE_ALERT, alerts & capture.trigger.alerts);
+    }
+    const bool complete = (capture.state == CAPTURE_COMPLETE);
+    xSemaphoreGive(capture.lock);
+    return complete;
+}
+
+int can_capture_save(const char* filename) {
+    xSemaphoreTake(capture.lock, portMAX_DELAY);
+    if (capture.state != CAPTURE_COMPLETE) {
+        xSemaphoreGive(capture.lock);
+        return -1;
+    }
+
+    // Header
+    linearize_records();
+    memcpy(capture.buffer, CAN_CAPTURE_MAGIC, 4);
+    copy_uint16_into_buffer_12(capture.count, capture.buffer + 4);
+    copy_uint16_into_buffer_12(CAN_CAPTURE_RECORD_SIZE, capture.buffer + 6);
+    copy_uint16_into_buffer_12(capture.pre_trigger_count, capture.buffer + 8);
+    capture.buffer[10] = capture.source;
+    capture.buffer[11] = 0;
+    copy_uint32_into_buffer_1234(capture.alerts, capture.buffer + 12);
+
+    const int count = capture.count;
+    const bool success = write_data_to_storage(filename, capture.buffer, CAN_CAPTURE_HEADER_SIZE + count * CAN_CAPTURE_RECORD_SIZE);
+    release_capture();
+    xSemaphoreGive(capture.lock);
+
+    ESP_LOGI(CAPTURE_TAG, "Saved %d frames: %s", count, (success ? "OK" : "FAILED"));
+    return (success ? count : -1);
+}
@@ -0,0 +1,159 @@
+#include "can_rx_ring.h"
+#include "string.h" // memcpy
+
+// FreeRTOS
+#include "freertos/semphr.h"
+
+
+// The ring, the records are only written by the producer and
+// only reused after the consumer released them
+// Indices are guarded by the spinlock (producer and consumer run on different tasks)
+static can_rx_record_t records[CAN_RX_RING_SIZE];
+static struct {
+    portMUX_TYPE spinlock;
+    SemaphoreHandle_t frames_available;
+    uint32_t head; // Oldest record
+    uint32_t count;
+    int64_t epoch_us[2]; // Only changed while no record uses the epoch
+    uint32_t epoch_count[2]; // Records using the epoch
+    uint32_t epoch; // Epoch of new records
+    uint32_t high_water_mark;
+    uint32_t dropped;
+    bool overflow;
+} ring = { .spinlock = portMUX_INITIALIZER_UNLOCKED };
+
+
+
+// Initialize the ring
+void can_rx_ring_init() {
+    if (ring.frames_available == NULL) { ring.frames_available = xSemaphoreCreateBinary(); }
+}
+
+// Remove all frames
+void can_rx_ring_clear() {
+    portENTER_CRITICAL(&ring.spinlock);
+    ring.head = 0;
+    ring.count = 0;
+    ring.epoch_count[0] = 0;
+    ring.epoch_count[1] = 0;
+    portEXIT_CRITICAL(&ring.spinlock);
+}
+
+// Producer: Add a received frame
+bool can_rx_ring_push(const twai_message_t* const message, const int64_t timestamp_us) {
+    bool added = false;
+    portENTER_CRITICAL(&ring.spinlock);
+
+    // Restart an unused epoch, switch to the other one if it is unused and the current one gets old
+    int64_t offset_us = timestamp_us - ring.epoch_us[ring.epoch];
+    if (ring.epoch_count[ring.epoch] > 0 && offset_us > CAN_RX_RING_EPOCH_SWITCH_US && ring.epoch_count[!ring.epoch] == 0) {
+        ring.epoch = !ring.epoch;
+    }
+    if (ring.epoch_count[ring.epoch] == 0) {
+        ring.epoch_us[ring.epoch] = timestamp_us;
+        offset_us = 0;
+    }
+
+    if (ring.count < CAN_RX_RING_SIZE && offset_us >= 0 && offset_us <= CAN_RX_RECORD_TIMESTAMP_MASK) {
+        can_rx_record_t* const record = &records[(ring.head + ring.count) % CAN_RX_RING_SIZE];
+        record->identifier = message->identifier
+            | (message->extd ? CAN_RX_RECORD_EXTENDED_ID_FLAG : 0)
+            | (message->rtr ? CAN_RX_RECORD_RTR_FLAG : 0)
+            | (ring.epoch ? CAN_RX_RECORD_EPOCH_FLAG : 0);
+        record->timestamp_dlc = (uint32_t) offset_us | ((uint32_t) (message->data_length_code & 0x0F) << 28);
+        memcpy(record->data, message->data, 8);
+        ring.count += 1;
+        ring.epoch_count[ring.epoch] += 1;
+        if (ring.count > ring.high_water_mark) { ring.high_water_mark = ring.count; }
+        added = true;
+    }
+    else {
+        ring.dropped += 1;
+        ring.overflow = true;
+    }
+    portEXIT_CRITICAL(&ring.spinlock);
+
+    if (added) { xSemaphoreGive(ring.frames_available); }
+    return added;
+}
+
+// Consumer: Get the oldest frame (-1 if there is none)
+static int32_t peek_oldest() {
+    portENTER_CRITICAL(&ring.spinlock);
+    const int32_t index = (ring.count > 0 ? (int32_t) ring.head : -1);
+    portEXIT_CRITICAL(&ring.spinlock);
+    return index;
+}
+
+// Consumer: Wait for a frame
+int32_t can_rx_ring_wait(const TickType_t timeout) {
+    const int32_t index = peek_oldest();
+    if (index >= 0 || timeout == 0) { return index; }
+
+    // Woken up by a frame or 'can_rx_ring_wake()' (the semaphore may also still
+    // be given for a frame that was already taken, then this returns -1 early)
+    if (xSemaphoreTake(ring.frames_available, timeout) != pdTRUE) { return -1; }
+    return peek_oldest();
+}
+
+// Wake the consumer from 'can_rx_ring_wait()'
+void can_rx_ring_wake() {
+    xSemaphoreGive(ring.frames_available);
+}
+
+// Consumer: Access a frame
+const can_rx_record_t* can_rx_ring_get(const int32_t index) {
+    return &records[index];
+}
+
+// Consumer: Free the oldest frame
+void can_rx_ring_release(const int32_t index) {
+    portENTER_CRITICAL(&ring.spinlock);
+    if (ring.count > 0 && (int32_t) ring.head == index) {
+        ring.epoch_count[records[index].identifier & CAN_RX_RECORD_EPOCH_FLAG ? 1 : 0] -= 1;
+        ring.head = (ring.head + 1) % CAN_RX_RING_SIZE;
+        ring.count -= 1;
+    }
+    portEXIT_CRITICAL(&ring.spinlock);
+}
+
+// Unpack a record
+void can_rx_record_to_message(const can_rx_record_t* const record, twai_message_t* const message) {
+    message->flags = 0;
+    message->extd = (record->identifier & CAN_RX_RECORD_EXTENDED_ID_FLAG ? 1 : 0);
+    message->rtr = (record->identifier & CAN_RX_RECORD_RTR_FLAG ? 1 : 0);
+    message->identifier = record->identifier & 0x1FFFFFFF;
+    message->data_length_code = record->timestamp_dlc >> 28;
+    memcpy(message->data, record->data, 8);
+}
+
+// Consumer: Timestamp of a frame (its epoch doesn't change until it is released)
+int64_t can_rx_ring_get_timestamp(const int32_t index) {
+    const can_rx_record_t* const record = &records[index];
+    const uint32_t epoch = (record->identifier & CAN_RX_RECORD_EPOCH_FLAG ? 1 : 0);
+    return ring.epoch_us[epoch] + (record->timestamp_dlc & CAN_RX_RECORD_TIMESTAMP_MASK);
+}
+
+// Number of buffered frames
+uint32_t can_rx_ring_get_count() {
+    return ring.count;
+}
+
+// Most frames buffered at the same time since startup
+uint32_t can_rx_ring_get_high_water_mark() {
+    return ring.high_water_mark;
+}
+
+// Number of frames dropped because the ring was full since startup
+uint32_t can_rx_ring_get_dropped_count() {
+    return ring.dropped;
+}
+
+// Check if frames were dropped since the last call
+bool can_rx_ring_take_overflow() {
+    portENTER_CRITICAL(&ring.spinlock);
+    const bool overflow = ring.overflow;
+    ring.overflow = false;
+    portEXIT_CRITICAL(&ring.spinlock);
+    return overflow;
+}
@@ -0,0 +1,317 @@
+#include "can_signals.h"
+#include "buffer_access.h"
+#include "string.h" // memcmp, memcpy
+#include "stdlib.h" // qsort, malloc, free
+
+// CRC32 (ROM function)
+#include "esp_rom_crc.h"
+
+// Header for debug messages
+#include "esp_log.h"
+#define SIGNALS_TAG "CAN-SIGNALS"
+
+
+// A signal of the database
+typedef struct {
+    uint32_t identifier; // Bit 31 set for extended frames
+    uint16_t signal_id;
+    uint8_t start_bit;
+    uint8_t length;
+    uint8_t flags;
+    float scale;
+    float offset;
+} can_signal_t;
+
+// A signal compiled into an extraction step:
+// raw = (frame word >> shift) & mask, with the frame word loaded in the signal's byte order
+typedef struct {
+    uint64_t mask;
+    uint64_t sign_bit; // 0 for unsigned signals
+    float scale;
+    float offset;
+    uint16_t signal_id;
+    uint8_t shift;
+    uint8_t min_dlc; // Number of bytes the frame must have
+    bool motorola;
+} can_signal_step_t;
+
+// The extraction plan of a CAN identifier: steps[first] to steps[first + count - 1]
+typedef struct {
+    uint32_t identifier; // Bit 31 set for extended frames
+    uint16_t first;
+    uint16_t count;
+} can_signal_plan_t;
+
+// Compiled database, plans are sorted by identifier
+// Both arrays are allocated for the loaded database (NULL while it is empty)
+static can_signal_step_t* steps = NULL;
+static can_signal_plan_t* plans = NULL;
+static uint32_t signal_count = 0;
+static uint32_t plan_count = 0;
+
+// Statistics of the current window, one entry per step (allocated with the steps)
+static can_signal_stats_t* window_stats = NULL;
+
+// Signals of the database that is being loaded (for sorting)
+static const can_signal_t* sort_signals = NULL;
+
+
+
+// Parse and check a single signal entry
+static bool parse_signal_entry(const uint8_t* const entry, can_signal_t* const signal) {
+    signal->identifier = parse_uint32_1234(entry + 0);
+    signal->signal_id = parse_uint16_12(entry + 4);
+    signal->start_bit = entry[6];
+    signal->length = entry[7];
+    signal->flags = entry[8];
+    const uint32_t scale = parse_uint32_1234(entry + 12);
+    const uint32_t offset = parse_uint32_1234(entry + 16);
+    memcpy(&signal->scale, &scale, sizeof(float));
+    memcpy(&signal->offset, &offset, sizeof(float));
+
+    if (signal->length == 0 || signal->length > 64 || signal->start_bit > 63) { return false; }
+    if (signal->flags & CAN_SIGNALS_FLAG_MOTOROLA) {
+        // Position of the MSB counted from the MSB of the first byte
+        const uint32_t msb = (signal->start_bit / 8) * 8 + (7 - signal->start_bit % 8);
+        return (msb + signal->length <= 64);
+    }
+    return (signal->start_bit + signal->length <= 64);
+}
+
+// Compile a (valid) signal into an extraction step
+static void compile_signal(const can_signal_t* const signal, can_signal_step_t* const step) {
+    uint32_t last_bit = 0; // Last bit of the signal, counted in frame order
+    if (signal->flags & CAN_SIGNALS_FLAG_MOTOROLA) {
+        // Big endian bit numbering, start bit is the MSB
+        const uint32_t msb = (signal->start_bit / 8) * 8 + (7 - signal->start_bit % 8);
+        step->shift = 64 - msb - signal->length;
+        last_bit = msb + signal->length - 1;
+    }
+    else {
+        // Little endian bit numbering, start bit is the LSB
+        step->shift = signal->start_bit;
+        last_bit = signal->start_bit + signal->length - 1;
+    }
+    step->mask = (signal->length == 64 ? UINT64_MAX : ((1ull << signal->length) - 1));
+    step->sign_bit = ((signal->flags & CAN_SIGNALS_FLAG_SIGNED) ? (1ull << (signal->length - 1)) : 0);
+    step->scale = signal->scale;
+    step->offset = signal->offset;
+    step->signal_id = signal->signal_id;
+    step->min_dlc = last_bit / 8 + 1;
+    step->motorola = (signal->flags & CAN_SIGNALS_FLAG_MOTOROLA);
+}
+
+// Order of signals in the compiled database: by identifier, then by position in the upload
+static int compare_signal_order(const void* a, const void* b) {
+    const uint16_t i = *(const uint16_t*) a;
+    const uint16_t j = *(const uint16_t*) b;
+    if (sort_signals[i].identifier != sort_signals[j].identifier) {
+        return (sort_signals[i].identifier < sort_signals[j].identifier ? -1 : 1);
+    }
+    return (int) i - (int) j;
+}
+
+// Find the plan of a CAN identifier (binary search)
+static const can_signal_plan_t* find_plan(const uint32_t key) {
+    uint32_t low = 0;
+    uint32_t high = plan_count;
+    while (low < high) {
+        const uint32_t mid = (low + high) / 2;
+        if (plans[mid].identifier < key) { low = mid + 1; }
+        else { high = mid; }
+    }
+    return (low < plan_count && plans[low].identifier == key ? &plans[low] : NULL);
+}
+
+// Load a frame (padded to 8 bytes) in both byte orders, so all signals can be read with one 64 bit access
+static inline void load_frame(const uint8_t* const data, const uint8_t len, uint64_t* const intel_word, uint64_t* const motorola_word) {
+    uint8_t frame[8] = {};
+    memcpy(frame, data, len);
+    *intel_word = parse_uint64_12345678(frame);
+    *motorola_word = parse_uint64_87654321(frame);
+}
+
+// Run a step on a frame, loaded in both byte orders
+static inline float run_step(const can_signal_step_t* const step, const uint64_t intel_word, const uint64_t motorola_word) {
+    const uint64_t raw = ((step->motorola ? motorola_word : intel_word) >> step->shift) & step->mask;
+    if (step->sign_bit) {
+        // Sign extension
+        return (float) (int64_t) ((raw ^ step->sign_bit) - step->sign_bit) * step->scale + step->offset;
+    }
+    return (float) raw * step->scale + step->offset;
+}
+
+
+
+bool can_signals_load_database(const uint8_t* const data, const uint32_t size) {
+    if (data == NULL || size < CAN_SIGNALS_HEADER_SIZE) { return false; }
+
+    // Check header
+    const uint32_t count = parse_uint16_12(data + 4);
+    const uint32_t entry_size = parse_uint16_12(data + 6);
+    const uint32_t crc = parse_uint32_1234(data + 8);
+    if (memcmp(data, CAN_SIGNALS_MAGIC, 4) != 0) {
+        ESP_LOGE(SIGNALS_TAG, "Invalid magic");
+        return false;
+    }
+    if (entry_size != CAN_SIGNALS_ENTRY_SIZE || count > CAN_SIGNALS_MAX_SIGNALS || size != CAN_SIGNALS_HEADER_SIZE + count * entry_size) {
+        ESP_LOGE(SIGNALS_TAG, "Invalid size (%u signals of %u bytes in %u bytes)", count, entry_size, size);
+        return false;
+    }
+    if (esp_rom_crc32_le(0, data + CAN_SIGNALS_HEADER_SIZE, count * entry_size) != crc) {
+        ESP_LOGE(SIGNALS_TAG, "CRC mismatch");
+        return false;
+    }
+
+    if (count == 0) {
+        can_signals_clear_database();
+        return true;
+    }
+
+    // The new database is built in its own buffers, the current one is kept until it is complete
+    can_signal_t* const new_signals = malloc(count * sizeof(can_signal_t));
+    uint16_t* const new_order = malloc(count * sizeof(uint16_t));
+    can_signal_step_t* const new_steps = malloc(count * sizeof(can_signal_step_t));
+    can_signal_stats_t* const new_window_stats = malloc(count * sizeof(can_signal_stats_t));
+    can_signal_plan_t* new_plans = NULL;
+    bool success = (new_signals != NULL && new_order != NULL && new_steps != NULL && new_window_stats != NULL);
+    if (!success) { ESP_LOGE(SIGNALS_TAG, "Out of memory"); }
+
+    // Check all entries before replacing the current database
+    for (uint32_t i = 0; success && i < count; ++i) {
+        if (!parse_signal_entry(data + CAN_SIGNALS_HEADER_SIZE + i * entry_size, &new_signals[i])) {
+            ESP_LOGE(SIGNALS_TAG, "Invalid signal %u", i);
+            success = false;
+        }
+        new_order[i] = i;
+    }
+
+    // Compile the signals into one extraction plan per identifier
+    uint32_t new_plan_count = 0;
+    if (success) {
+        sort_signals = new_signals;
+        qsort(new_order, count, sizeof(uint16_t), compare_signal_order);
+        sort_signals = NULL;
+        for (uint32_t i = 0; i < count; ++i) {
+            if (i == 0 || new_signals[new_order[i]].identifier != new_signals[new_order[i - 1]].identifier) { new_plan_count += 1; }
+        }
+        new_plans = malloc(new_plan_count * sizeof(can_signal_plan_t));
+        success = (new_plans != NULL);
+        if (!success) { ESP_LOGE(SIGNALS_TAG, "Out of memory"); }
+    }
+    if (success) {
+        uint32_t n = 0;
+        for (uint32_t i = 0; i < count; ++i) {
+            const can_signal_t* const signal = &new_signals[new_order[i]];
+            if (n == 0 || new_plans[n - 1].identifier != signal->identifier) {
+                new_plans[n].identifier = signal->identifier;
+                new_plans[n].first = i;
+                new_plans[n].count = 0;
+                n += 1;
+            }
+            new_plans[n - 1].count += 1;
+            compile_signal(signal, &new_steps[i]);
+        }
+
+        // Replace the current database
+        can_signals_clear_database();
+        steps = new_steps;
+        plans = new_plans;
+        window_stats = new_window_stats;
+        signal_count = count;
+        plan_count = new_plan_count;
+        can_signals_reset_window();
+        ESP_LOGI(SIGNALS_TAG, "Loaded %u signals of %u identifiers", signal_count, plan_count);
+    }
+    else {
+        free(new_steps);
+        free(new_plans);
+        free(new_window_stats);
+    }
+    free(new_signals);
+    free(new_order);
+    return success;
+}
+
+void can_signals_clear_database() {
+    signal_count = 0;
+    plan_count = 0;
+    free(steps);
+    free(plans);
+    free(window_stats);
+    steps = NULL;
+    plans = NULL;
+    window_stats = NULL;
+}
+
+uint32_t can_signals_get_count() {
+    return signal_count;
+}
+
+uint32_t can_signals_decode_frame(const uint32_t identifier, const bool extended, const uint8_t* const data, const uint8_t dlc, can_signal_value_t* const values, const uint32_t max_values) {
+    if (data == NULL || values == NULL) { return 0; }
+
+    const can_signal_plan_t* const plan = find_plan(identifier | (extended ? CAN_SIGNALS_EXTENDED_ID_FLAG : 0));
+    if (plan == NULL) { return 0; }
+
+    // Load the frame once in both byte orders
+    const uint8_t len = (dlc > 8 ? 8 : dlc);
+    uint64_t intel_word = 0;
+    uint64_t motorola_word = 0;
+    load_frame(data, len, &intel_word, &motorola_word);
+
+    uint32_t n = 0;
+    const can_signal_step_t* const end = steps + plan->first + plan->count;
+    for (const can_signal_step_t* step = steps + plan->first; step < end && n < max_values; ++step) {
+        if (step->min_dlc > len) { continue; }
+        values[n].signal_id = step->signal_id;
+        values[n].value = run_step(step, intel_word, motorola_word);
+        n += 1;
+    }
+    return n;
+}
+
+uint32_t can_signals_aggregate_frame(const uint32_t identifier, const bool extended, const uint8_t* const data, const uint8_t dlc) {
+    if (data == NULL) { return 0; }
+    const can_signal_plan_t* const plan = find_plan(identifier | (extended ? CAN_SIGNALS_EXTENDED_ID_FLAG : 0));
+    if (plan == NULL) { return 0; }
+
+    // Load the frame once in both byte orders
+    const uint8_t len = (dlc > 8 ? 8 : dlc);
+    uint64_t intel_word = 0;
+    uint64_t motorola_word = 0;
+    load_frame(data, len, &intel_word, &motorola_word);
+
+    uint32_t n = 0;
+    for (uint32_t i = plan->first; i < plan->first + plan->count; ++i) {
+        if (steps[i].min_dlc > len) { continue; }
+        const float value = run_step(&steps[i], intel_word, motorola_word);
+        can_signal_stats_t* const stats = &window_stats[i];
+        if (stats->count == 0 || value < stats->min) { stats->min = value; }
+        if (stats->count == 0 || value > stats->max) { stats->max = value; }
+        stats->sum += value;
+        stats->last = value;
+        stats->count += 1;
+        n += 1;
+    }
+    return n;
+}
+
+uint32_t can_signals_flush_window(can_signals_stats_cb_t* const callback, void* const ctx) {
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < signal_count; ++i) {
+        if (window_stats[i].count == 0) { continue; }
+        if (callback != NULL) { callback(ctx, &window_stats[i]); }
+        n += 1;
+    }
+    can_signals_reset_window();
+    return n;
+}
+
+void can_signals_reset_window() {
+    for (uint32_t i = 0; i < signal_count; ++i) {
+        window_stats[i].signal_id = steps[i].signal_id;
+        window_stats[i].count = 0;
+        window_stats[i].sum = 0.0;
+    }
+}
@@ -0,0 +1,133 @@
+#include "can_timing.h"
+
+// Header for debug messages
+#include "esp_log.h"
+#define TIMING_TAG "CAN-TIMING"
+
+
+
+// Check if the controller supports a prescaler
+// Even values only, above 128 (ESP32 ECO3) multiples of 4
+static bool brp_is_valid(const uint32_t brp) {
+    if (brp < TWAI_BRP_MIN || brp > TWAI_BRP_MAX || (brp & 0x1) != 0) { return false; }
+    return (brp <= 128 || (brp & 0x3) == 0);
+}
+
+// Absolute difference
+static inline uint64_t difference(const uint64_t a, const uint64_t b) {
+    return (a > b ? a - b : b - a);
+}
+
+// Compare the sample point errors (in 1/1000 permille) of two timings with the same bitrate error
+// Within the tolerance the first one (more time quanta) is kept, else the closer one wins
+static inline bool is_better_sample_point(const uint64_t error, const uint64_t best_error) {
+    const uint64_t tolerance = 1000 * CAN_TIMING_SAMPLE_POINT_TOLERANCE;
+    if (best_error <= tolerance) { return false; }
+    return (error <= tolerance || error < best_error);
+}
+
+
+// Check if the controller supports a timing
+bool can_timing_is_valid(const twai_timing_config_t* const timing) {
+    return brp_is_valid(timing->brp)
+        && timing->tseg_1 >= CAN_TIMING_TSEG_1_MIN && timing->tseg_1 <= CAN_TIMING_TSEG_1_MAX
+        && timing->tseg_2 >= CAN_TIMING_TSEG_2_MIN && timing->tseg_2 <= CAN_TIMING_TSEG_2_MAX
+        && timing->sjw >= 1 && timing->sjw <= CAN_TIMING_SJW_MAX && timing->sjw <= timing->tseg_2;
+}
+
+// Bitrate of a timing
+uint32_t can_timing_get_bitrate(const twai_timing_config_t* const timing) {
+    const uint32_t divider = timing->brp * (1 + timing->tseg_1 + timing->tseg_2);
+    return (divider > 0 ? (CAN_TIMING_CLOCK_HZ + divider / 2) / divider : 0);
+}
+
+// Sample point of a timing
+uint32_t can_timing_get_sample_point(const twai_timing_config_t* const timing) {
+    const uint32_t quanta = 1 + timing->tseg_1 + timing->tseg_2;
+    return (1000 * (1 + timing->tseg_1) + quanta / 2) / quanta;
+}
+
+// Find the timing closest to a bitrate and sample point
+bool can_timing_calculate(const uint32_t bitrate, const uint32_t sample_point, twai_timing_config_t* const timing) {
+    if (bitrate == 0 || bitrate > CAN_TIMING_BITRATE_MAX || sample_point == 0 || sample_point >= 1000) { return false; }
+
+    bool found = false;
+    uint64_t best_bitrate_error = UINT64_MAX;
+    uint64_t best_sample_point_error = UINT64_MAX;
+
+    // Ascending prescalers, so the timing with the most (finest) time quanta comes first
+    for (uint32_t brp = TWAI_BRP_MIN; brp <= TWAI_BRP_MAX; ++brp) {
+        if (!brp_is_valid(brp)) { continue; }
+
+        // Closest number of time quanta for this prescaler
+        const uint32_t quanta = (CAN_TIMING_CLOCK_HZ / brp + bitrate / 2) / bitrate;
+        if (quanta < 1 + CAN_TIMING_TSEG_1_MIN + CAN_TIMING_TSEG_2_MIN) { break; } // Only gets fewer
+        if (quanta > 1 + CAN_TIMING_TSEG_1_MAX + CAN_TIMING_TSEG_2_MAX) { continue; }
+
+        // Closest sample point, keeping both segments in range
+        int32_t tseg_1 = (int32_t) ((quanta * sample_point + 500) / 1000) - 1;
+        if (tseg_1 > CAN_TIMING_TSEG_1_MAX) { tseg_1 = CAN_TIMING_TSEG_1_MAX; }
+        if (tseg_1 < (int32_t) quanta - 1 - CAN_TIMING_TSEG_2_MAX) { tseg_1 = (int32_t) quanta - 1 - CAN_TIMING_TSEG_2_MAX; }
+        if (tseg_1 > (int32_t) quanta - 1 - CAN_TIMING_TSEG_2_MIN) { tseg_1 = (int32_t) quanta - 1 - CAN_TIMING_TSEG_2_MIN; }
+        if (tseg_1 < CAN_TIMING_TSEG_1_MIN) { tseg_1 = CAN_TIMING_TSEG_1_MIN; }
+
+        twai_timing_config_t candidate = {
+            .brp = brp,
+            .tseg_1 = (uint8_t) tseg_1,
+            .tseg_2 = (uint8_t) (quanta - 1 - tseg_1),
+            .sjw = 1,
+            .triple_sampling = false
+        };
+        candidate.sjw = (candidate.tseg_2 < CAN_TIMING_SJW_MAX ? candidate.tseg_2 : CAN_TIMING_SJW_MAX);
+
+        // Compare the exact bitrate (in parts of CAN_TIMING_CLOCK_HZ) to avoid rounding ties
+        const uint64_t bitrate_error = difference(CAN_TIMING_CLOCK_HZ, (uint64_t) bitrate * brp * quanta);
+        const uint64_t sample_point_error = difference(1000 * (1 + tseg_1), sample_point * quanta) * 1000 / quanta;
+        if (bitrate_error < best_bitrate_error || (bitrate_error == best_bitrate_error && is_better_sample_point(sample_point_error, best_sample_point_error))) {
+            *timing = candidate;
+            best_bitrate_error = bitrate_error;
+            best_sample_point_error = sample_point_error;
+            found = true;
+        }
+    }
+
+    // Accept it only within the tolerance
+    if (found && difference(can_timing_get_bitrate(timing), bitrate) * 1000 > (uint64_t) bitrate * CAN_TIMING_MAX_BITRATE_ERROR) {
+        found = false;
+    }
+    if (found) {
+        ESP_LOGI(TIMING_TAG, "%u bit/s, %u permille: brp %u, tseg_1 %u, tseg_2 %u, sjw %u (%u bit/s, %u permille)", 
+            bitrate, sample_point, timing->brp, timing->tseg_1, timing->tseg_2, timing->sjw,
+            can_timing_get_bitrate(timing), can_timing_get_sample_point(timing)
+        );
+    }
+    return found;
+}
+
+// Translate SJA1000 bus timing registers
+bool can_timing_from_btr(const uint8_t btr0, const uint8_t btr1, twai_timing_config_t* const timing) {
+    
+    // The SJA1000 time quantum is 2 * BRP oscillator cycles
+    const uint32_t sja1000_brp = (btr0 & 0x3F) + 1;
+    const twai_timing_config_t translated = {
+        .brp = 2 * sja1000_brp * (CAN_TIMING_CLOCK_HZ / CAN_TIMING_SJA1000_CLOCK_HZ),
+        .tseg_1 = (uint8_t) ((btr1 & 0x0F) + 1),
+        .tseg_2 = (uint8_t) (((btr1 >> 4) & 0x07) + 1),
+        .sjw = (uint8_t) (((btr0 >> 6) & 0x03) + 1),
+        .triple_sampling = ((btr1 & 0x80) != 0)
+    };
+
+    if (can_timing_is_valid(&translated)) {
+        *timing = translated;
+        return true;
+    }
+
+    // Same bitrate and sample point with a prescaler the controller supports
+    const uint32_t quanta = 1 + translated.tseg_1 + translated.tseg_2;
+    const uint32_t bitrate = (CAN_TIMING_SJA1000_CLOCK_HZ / 2 + sja1000_brp * quanta / 2) / (sja1000_brp * quanta);
+    twai_timing_config_t calculated = {};
+    if (!can_timing_calculate(bitrate, can_timing_get_sample_point(&translated), &calculated)) { return false; }
+    calculated.triple_sampling = translated.triple_sampling;
+    *timing = calculated;
+    return true;
+}
@@ -0,0 +1,104 @@
+#include "delta_patch.h"
+#include "buffer_access.h"
+#include "stddef.h" // NULL
+#include "string.h" // memcmp, memset
+
+
+// Copy a range of the base image to the output
+static bool delta_patch_copy(delta_patch_t* const patch, uint32_t offset, uint32_t len, delta_patch_read_cb_t* const read_base, delta_patch_output_cb_t* const callback, void* const ctx) {
+    while (len > 0) {
+        const uint32_t n = (len < DELTA_PATCH_COPY_BUFFER_SIZE ? len : DELTA_PATCH_COPY_BUFFER_SIZE);
+        if (!read_base(ctx, offset, patch->copy_buffer, n)) { return false; }
+        if (!callback(ctx, patch->copy_buffer, n)) { return false; }
+        offset += n;
+        len -= n;
+        patch->total_out += n;
+    }
+    return true;
+}
+
+
+
+void delta_patch_init(delta_patch_t* const patch) {
+    if (patch == NULL) { return; }
+    memset(patch, 0, sizeof(delta_patch_t));
+}
+
+bool delta_patch_apply(delta_patch_t* const patch, const uint8_t* const in, const uint32_t len, delta_patch_read_cb_t* const read_base, delta_patch_output_cb_t* const callback, void* const ctx) {
+    if (patch == NULL || in == NULL || read_base == NULL || callback == NULL) { return false; }
+    if (patch->error) { return false; }
+
+    uint32_t i = 0;
+    while (i < len) {
+
+        // Header
+        if (patch->header_len < DELTA_PATCH_HEADER_SIZE) {
+            patch->header[patch->header_len++] = in[i++];
+            if (patch->header_len == DELTA_PATCH_HEADER_SIZE) {
+                if (memcmp(patch->header, DELTA_PATCH_MAGIC, 4) != 0) { patch->error = true; return false; }
+                patch->target_size = parse_uint32_1234(patch->header + 4);
+            }
+            continue;
+        }
+
+        // Data of an insert operation
+        if (patch->insert_remaining > 0) {
+            const uint32_t available = len - i;
+            const uint32_t n = (available < patch->insert_remaining ? available : patch->insert_remaining);
+            if (!callback(ctx, in + i, n)) { patch->error = true; return false; }
+            patch->insert_remaining -= n;
+            patch->total_out += n;
+            i += n;
+            continue;
+        }
+
+        // Operation header
+        patch->op_header[patch->op_header_len++] = in[i++];
+        if (patch->op_header_len < DELTA_PATCH_OP_HEADER_SIZE) { continue; }
+        patch->op_header_len = 0;
+
+        const uint8_t op = patch->op_header[0];
+        const uint32_t offset = parse_uint32_1234(patch->op_header + 1);
+        const uint32_t op_len = parse_uint32_1234(patch->op_header + 5);
+        if (op_len == 0 || op_len > patch->target_size - patch->total_out) { patch->error = true; return false; }
+
+        if (op == DELTA_PATCH_OP_COPY) {
+            if (!delta_patch_copy(patch, offset, op_len, read_base, callback, ctx)) { patch->error = true; return false; }
+        }
+        else if (op == DELTA_PATCH_OP_INSERT) {
+            patch->insert_remaining = op_len;
+        }
+        else {
+            patch->error = true;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool delta_patch_has_header(const delta_patch_t* const patch) {
+    return (patch != NULL && patch->header_len == DELTA_PATCH_HEADER_SIZE);
+}
+
+uint32_t delta_patch_get_target_size(const delta_patch_t* const patch) {
+    if (!delta_patch_has_header(patch)) { return 0; }
+    return patch->target_size;
+}
+
+const uint8_t* delta_patch_get_base_hash(const delta_patch_t* const patch) {
+    if (!delta_patch_has_header(patch)) { return NULL; }
+    return patch->header + 8;
+}
+
+const uint8_t* delta_patch_get_target_hash(const delta_patch_t* const patch) {
+    if (!delta_patch_has_header(patch)) { return NULL; }
+    return patch->header + 8 + DELTA_PATCH_HASH_SIZE;
+}
+
+bool delta_patch_finished(const delta_patch_t* const patch) {
+    return (delta_patch_has_header(patch) 
+        && !patch->error 
+        && patch->total_out == patch->target_size 
+        && patch->insert_remaining == 0 
+        && patch->op_header_len == 0);
+}
@@ -13,10 +13,16 @@ static const char* TAG = "Filesystem";
 #include "esp_err.h"
 #include "esp_spiffs.h"
 
+// FreeRTOS
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
 #define WL_SECTOR_SIZE CONFIG_WL_SECTOR_SIZE
 
-// Mount path for the partition
+// Mount path for the partition (host tests use a temporary directory)
+#ifndef MOUNT_PATH
 #define MOUNT_PATH "/spiffs"
+#endif
 #define MOUNT_PATH_LEN (sizeof(MOUNT_PATH)-1)
 
 
@@ -30,9 +36,83 @@ static const char* TAG = "Filesystem";
 #define FILENAME_MAX_SIZE (FULL_FILEPATH_MAX_SIZE - BASE_PATH_LEN)
 // static char* s_filename = s_full_filepath + BASE_PATH_LEN;
 
+// Suffix for temporary files used by the atomic write
+#define TMP_SUFFIX ".tmp"
+#define TMP_SUFFIX_LEN (sizeof(TMP_SUFFIX)-1)
+
 
 static bool s_filesystem_mounted = false;
 
+
+// In-RAM shadow of small (config) files
+// The filesystem stays mounted once it is used, so reads of shadowed files are served
+// from RAM and writes of unchanged data are skipped without touching the flash
+#define SHADOW_MAX_FILES 4
+#define SHADOW_MAX_FILE_SIZE 64
+#define SHADOW_FILENAME_MAX_SIZE 32
+
+typedef struct {
+    bool valid;
+    int size;
+    char filename[SHADOW_FILENAME_MAX_SIZE];
+    uint8_t data[SHADOW_MAX_FILE_SIZE];
+} file_shadow_t;
+
+static file_shadow_t s_file_shadows[SHADOW_MAX_FILES] = {};
+static uint32_t s_next_file_shadow = 0;
+
+// The storage functions are used by several tasks (SLCAN commands, config persist task,
+// capture saving in the auto-poll task), the mount state, the shadows and every file access
+// of the helpers below are guarded by this recursive mutex (the helpers call each other).
+// The plain FILE* functions can't hold it for the lifetime of a file.
+static SemaphoreHandle_t s_storage_lock = NULL;
+static StaticSemaphore_t s_storage_lock_buffer;
+static portMUX_TYPE s_storage_lock_spinlock = portMUX_INITIALIZER_UNLOCKED;
+
+static void lock_storage() {
+    // Created on first use, the storage is used before anything could initialize it
+    portENTER_CRITICAL(&s_storage_lock_spinlock);
+    if (s_storage_lock == NULL) { s_storage_lock = xSemaphoreCreateRecursiveMutexStatic(&s_storage_lock_buffer); }
+    portEXIT_CRITICAL(&s_storage_lock_spinlock);
+    xSemaphoreTakeRecursive(s_storage_lock, portMAX_DELAY);
+}
+
+static void unlock_storage() {
+    xSemaphoreGiveRecursive(s_storage_lock);
+}
+
+// Find the shadow of a file (NULL if the file is not shadowed) (lock must be held)
+static file_shadow_t* find_file_shadow(const char* filename) {
+    for (uint32_t i = 0; i < SHADOW_MAX_FILES; ++i) {
+        if (s_file_shadows[i].valid && strcmp(s_file_shadows[i].filename, filename) == 0) {
+            return &s_file_shadows[i];
+        }
+    }
+    return NULL;
+}
+
+// Create or update the shadow of a file (lock must be held)
+static void update_file_shadow(const char* filename, const uint8_t* const buffer, const int bufsize) {
+    if (bufsize > SHADOW_MAX_FILE_SIZE || strlen(filename) >= SHADOW_FILENAME_MAX_SIZE) { return; }
+
+    file_shadow_t* shadow = find_file_shadow(filename);
+    if (shadow == NULL) {
+        // Take the next slot (round robin)
+        shadow = &s_file_shadows[s_next_file_shadow];
+        s_next_file_shadow = (s_next_file_shadow + 1) % SHADOW_MAX_FILES;
+        strcpy(shadow->filename, filename);
+    }
+    memcpy(shadow->data, buffer, bufsize);
+    shadow->size = bufsize;
+    shadow->valid = true;
+}
+
+// Drop the shadow of a file (lock must be held)
+static void invalidate_file_shadow(const char* filename) {
+    file_shadow_t* shadow = find_file_shadow(filename);
+    if (shadow != NULL) { shadow->valid = false; }
+}
+
 // Use this settings to initialize and mount SPIFFS filesystem.
 esp_vfs_spiffs_conf_t s_conf = {
     .base_path = MOUNT_PATH,
@@ -42,7 +122,8 @@ esp_vfs_spiffs_conf_t s_conf = {
 };
 
 
-bool mount_filesystem() {
+// Mount the filesystem (lock must be held)
+static bool mount_filesystem_locked() {
     if (s_filesystem_mounted) { return true; }
     ESP_LOGD(TAG, "Mounting filesystem");
 
@@ -77,29 +158,48 @@ bool mount_filesystem() {
 
 }
 
-bool unmount_filesystem() {
-    if (!s_filesystem_mounted) { return true; }
+bool mount_filesystem() {
+    lock_storage();
+    const bool mounted = mount_filesystem_locked();
+    unlock_storage();
+    return mounted;
+}
 
-    // All done, unmount partition and disable SPIFFS
-    ESP_LOGD(TAG, "Unmounting filesystem");
-    ESP_ERROR_CHECK_WITHOUT_ABORT(esp_vfs_spiffs_unregister(s_conf.partition_label));
-    ESP_LOGV(TAG, "SPIFFS unmounted");
-    s_filesystem_mounted = false;
+bool unmount_filesystem() {
+    lock_storage();
+    if (s_filesystem_mounted) {
+        // All done, unmount partition and disable SPIFFS
+        ESP_LOGD(TAG, "Unmounting filesystem");
+        ESP_ERROR_CHECK_WITHOUT_ABORT(esp_vfs_spiffs_unregister(s_conf.partition_label));
+        ESP_LOGV(TAG, "SPIFFS unmounted");
+        s_filesystem_mounted = false;
+    }
+    unlock_storage();
     return true;
 }
 
 
 
-FILE* open_file(const char* filename, const char* mode) {
-    if (filename == NULL || mode == NULL) { return NULL; }
+
+// prepend root path
+static bool get_full_filepath(const char* filename, char* const full_filepath) {
+    if (filename == NULL) { return false; }
 
     // Just checking
-    const int filename_len = strlen(filename);
-    if (filename_len >= FILENAME_MAX_SIZE) { return NULL; }
+    const size_t filename_len = strlen(filename);
+    if (filename_len >= FILENAME_MAX_SIZE) { return false; }
+
+    strcpy(full_filepath, BASE_PATH);
+    strcpy(full_filepath+BASE_PATH_LEN, filename);
+    return true;
+}
+
+FILE* open_file(const char* filename, const char* mode) {
+    if (filename == NULL || mode == NULL) { return NULL; }
 
     // prepend root path
     char full_filepath[FULL_FILEPATH_MAX_SIZE] = BASE_PATH;
-    strcpy(full_filepath+BASE_PATH_LEN, filename);
+    if (!get_full_filepath(filename, full_filepath)) { return NULL; }
 
     // Open file for reading
     ESP_LOGD(TAG, "Open file '%s'", full_filepath);
@@ -132,9 +232,51 @@ int write_data_to_file(FILE* const file, const uint8_t* const buffer, const int
     return fwrite(buffer, sizeof(uint8_t), bufsize, file);
 }
 
+int seek_in_file(FILE* const file, const long offset) {
+    return fseek(file, offset, SEEK_SET);
+}
 
 
-bool read_file_from_filesystem(const char* filename, char* const buffer, const int bufsize) {
+
+static bool remove_file_from_filesystem_locked(const char* filename) {
+    char full_filepath[FULL_FILEPATH_MAX_SIZE] = BASE_PATH;
+    if (!get_full_filepath(filename, full_filepath)) { return false; }
+    invalidate_file_shadow(filename);
+    return (remove(full_filepath) == 0);
+}
+
+bool remove_file_from_filesystem(const char* filename) {
+    lock_storage();
+    const bool success = remove_file_from_filesystem_locked(filename);
+    unlock_storage();
+    return success;
+}
+
+static bool rename_file_on_filesystem_locked(const char* old_filename, const char* new_filename) {
+    char old_full_filepath[FULL_FILEPATH_MAX_SIZE] = BASE_PATH;
+    char new_full_filepath[FULL_FILEPATH_MAX_SIZE] = BASE_PATH;
+    if (!get_full_filepath(old_filename, old_full_filepath)) { return false; }
+    if (!get_full_filepath(new_filename, new_full_filepath)) { return false; }
+    invalidate_file_shadow(old_filename);
+    invalidate_file_shadow(new_filename);
+
+    if (rename(old_full_filepath, new_full_filepath) != 0) {
+        ESP_LOGE(TAG, "Failed to rename '%s' to '%s': %s", old_full_filepath, new_full_filepath, strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+bool rename_file_on_filesystem(const char* old_filename, const char* new_filename) {
+    lock_storage();
+    const bool success = rename_file_on_filesystem_locked(old_filename, new_filename);
+    unlock_storage();
+    return success;
+}
+
+
+
+static bool read_file_from_filesystem_locked(const char* filename, char* const buffer, const int bufsize) {
     if (filename == NULL || buffer == NULL || bufsize <= 0) { return false; }
     
     FILE* file = open_file(filename, "r");
@@ -169,8 +311,16 @@ bool read_file_from_filesystem(const char* filename, char* const buffer, const i
     return false;
 }
 
-bool write_file_to_filesystem(const char* filename, const char* const buffer) {
+bool read_file_from_filesystem(const char* filename, char* const buffer, const int bufsize) {
+    lock_storage();
+    const bool success = read_file_from_filesystem_locked(filename, buffer, bufsize);
+    unlock_storage();
+    return success;
+}
+
+static bool write_file_to_filesystem_locked(const char* filename, const char* const buffer) {
     if (filename == NULL || buffer == NULL) { return false; }
+    invalidate_file_shadow(filename);
     FILE* file = open_file(filename, "w");
     if (file != NULL) { 
         ESP_LOGI(TAG, "Writing to file '%s'", filename);
@@ -182,7 +332,14 @@ bool write_file_to_filesystem(const char* filename, const char* const buffer) {
     return false;
 }
 
-bool read_data_from_filesystem(const char* filename, uint8_t* const buffer, const int bufsize) {
+bool write_file_to_filesystem(const char* filename, const char* const buffer) {
+    lock_storage();
+    const bool success = write_file_to_filesystem_locked(filename, buffer);
+    unlock_storage();
+    return success;
+}
+
+static bool read_data_from_filesystem_locked(const char* filename, uint8_t* const buffer, const int bufsize) {
     if (filename == NULL || buffer == NULL || bufsize <= 0) { return false; }
     
     FILE* file = open_file(filename, "rb");
@@ -215,8 +372,16 @@ bool read_data_from_filesystem(const char* filename, uint8_t* const buffer, cons
     return false;
 }
 
-bool write_data_to_filesystem(const char* filename, const uint8_t* const buffer, const int bufsize) {
+bool read_data_from_filesystem(const char* filename, uint8_t* const buffer, const int bufsize) {
+    lock_storage();
+    const bool success = read_data_from_filesystem_locked(filename, buffer, bufsize);
+    unlock_storage();
+    return success;
+}
+
+static bool write_data_to_filesystem_locked(const char* filename, const uint8_t* const buffer, const int bufsize) {
     if (filename == NULL || buffer == NULL || bufsize <= 0) { return false; }
+    invalidate_file_shadow(filename);
     
     FILE* file = open_file(filename, "wb");
     if (file != NULL) {
@@ -235,53 +400,221 @@ bool write_data_to_filesystem(const char* filename, const uint8_t* const buffer,
     return false;
 }
 
+bool write_data_to_filesystem(const char* filename, const uint8_t* const buffer, const int bufsize) {
+    lock_storage();
+    const bool success = write_data_to_filesystem_locked(filename, buffer, bufsize);
+    unlock_storage();
+    return success;
+}
+
 
 
 
 
-bool read_file_from_storage(const char* filename, char* const buffer, const int bufsize) {
+// Name of the temporary file used for atomic writes
+static bool get_tmp_filename(const char* filename, char* const tmp_filename) {
+    if (filename == NULL) { return false; }
+    if (strlen(filename) + TMP_SUFFIX_LEN >= FILENAME_MAX_SIZE) { return false; }
+    strcpy(tmp_filename, filename);
+    strcat(tmp_filename, TMP_SUFFIX);
+    return true;
+}
+
+static bool write_data_to_filesystem_atomic_locked(const char* filename, const uint8_t* const buffer, const int bufsize) {
+    if (filename == NULL || buffer == NULL || bufsize <= 0) { return false; }
+
+    char tmp_filename[FILENAME_MAX_SIZE];
+    if (!get_tmp_filename(filename, tmp_filename)) { return false; }
+
+    // 1. Write everything to the temporary file
+    FILE* file = open_file(tmp_filename, "wb");
+    if (file == NULL) { return false; }
+    ESP_LOGI(TAG, "Writing to file '%s' (atomic)", filename);
+    const int bytes_written = write_data_to_file(file, buffer, bufsize);
+    const bool write_ok = (bytes_written == bufsize && !ferror(file));
+    if (close_file(file) != 0 || !write_ok) {
+        ESP_LOGE(TAG, "'%s': Write Error: %s", tmp_filename, strerror(errno));
+        remove_file_from_filesystem(tmp_filename);
+        return false;
+    }
+
+    // 2. Replace the old file (SPIFFS can't rename onto an existing file)
+    // If we crash in between, the temporary file is picked up by 'recover_file_on_filesystem'
+    remove_file_from_filesystem(filename);
+    return rename_file_on_filesystem(tmp_filename, filename);
+}
+
+bool write_data_to_filesystem_atomic(const char* filename, const uint8_t* const buffer, const int bufsize) {
+    lock_storage();
+    const bool success = write_data_to_filesystem_atomic_locked(filename, buffer, bufsize);
+    unlock_storage();
+    return success;
+}
+
+static bool recover_file_on_filesystem_locked(const char* filename) {
+    char tmp_filename[FILENAME_MAX_SIZE];
+    if (!get_tmp_filename(filename, tmp_filename)) { return false; }
+    if (!does_file_exist_on_filesystem(tmp_filename)) { return false; }
+
+    if (does_file_exist_on_filesystem(filename)) {
+        // The old file is still complete, the write was interrupted
+        ESP_LOGW(TAG, "Removing incomplete file '%s'", tmp_filename);
+        remove_file_from_filesystem(tmp_filename);
+        return false;
+    }
+    else {
+        // The old file was already removed, the new one is complete
+        ESP_LOGW(TAG, "Recovering '%s' from '%s'", filename, tmp_filename);
+        return rename_file_on_filesystem(tmp_filename, filename);
+    }
+}
+
+bool recover_file_on_filesystem(const char* filename) {
+    lock_storage();
+    const bool success = recover_file_on_filesystem_locked(filename);
+    unlock_storage();
+    return success;
+}
+
+
+
+
+
+
+
+
+static bool read_file_from_storage_locked(const char* filename, char* const buffer, const int bufsize) {
     if (mount_filesystem()) {
-        const bool success = read_file_from_filesystem(filename, buffer, bufsize);
-        unmount_filesystem();
-        return success;
+        return read_file_from_filesystem(filename, buffer, bufsize);
     }
     return false;
 }
 
-bool write_file_to_storage(const char* filename, const char* const buffer) {
+bool read_file_from_storage(const char* filename, char* const buffer, const int bufsize) {
+    lock_storage();
+    const bool success = read_file_from_storage_locked(filename, buffer, bufsize);
+    unlock_storage();
+    return success;
+}
+
+static bool write_file_to_storage_locked(const char* filename, const char* const buffer) {
+    if (filename == NULL) { return false; }
+    invalidate_file_shadow(filename);
     if (mount_filesystem()) {
-        const bool success = write_file_to_filesystem(filename, buffer);
-        unmount_filesystem();
-        return success;
+        return write_file_to_filesystem(filename, buffer);
     }
     return false;
 }
 
-bool read_data_from_storage(const char* filename, uint8_t* const buffer, const int bufsize) {
+static bool read_data_from_storage_locked(const char* filename, uint8_t* const buffer, const int bufsize) {
+    if (filename == NULL || buffer == NULL || bufsize <= 0) { return false; }
+
+    // Serve from RAM if possible
+    const file_shadow_t* shadow = find_file_shadow(filename);
+    if (shadow != NULL && shadow->size == bufsize) {
+        ESP_LOGD(TAG, "Reading from shadow of file '%s'", filename);
+        memcpy(buffer, shadow->data, bufsize);
+        return true;
+    }
+
     if (mount_filesystem()) {
+        recover_file_on_filesystem(filename);
         const bool success = read_data_from_filesystem(filename, buffer, bufsize);
-        unmount_filesystem();
+        if (success && get_file_size_from_filesystem(filename) == bufsize) {
+            update_file_shadow(filename, buffer, bufsize);
+        }
         return success;
     }
     return false;
 }
 
-bool write_data_to_storage(const char* filename, const uint8_t* const buffer, const int bufsize) {
+static int read_available_data_from_storage_locked(const char* filename, uint8_t* const buffer, const int bufsize) {
+    if (filename == NULL || buffer == NULL || bufsize <= 0) { return -1; }
+
+    // Serve from RAM if possible
+    const file_shadow_t* shadow = find_file_shadow(filename);
+    if (shadow != NULL && shadow->size <= bufsize) {
+        ESP_LOGD(TAG, "Reading from shadow of file '%s'", filename);
+        memcpy(buffer, shadow->data, shadow->size);
+        return shadow->size;
+    }
+
+    if (!mount_filesystem()) { return -1; }
+    recover_file_on_filesystem(filename);
+    if (!does_file_exist_on_filesystem(filename)) { return -1; }
+
+    FILE* file = open_file(filename, "rb");
+    if (file == NULL) { return -1; }
+    ESP_LOGI(TAG, "Reading from file '%s'", filename);
+    const int bytes_read = read_data_from_file(file, buffer, bufsize);
+    const bool complete = (!ferror(file) && fgetc(file) == EOF);
+    close_file(file);
+
+    // Only shadow files that were read completely
+    if (bytes_read > 0 && complete) { update_file_shadow(filename, buffer, bytes_read); }
+    return bytes_read;
+}
+
+static bool write_data_to_storage_locked(const char* filename, const uint8_t* const buffer, const int bufsize) {
+    if (filename == NULL || buffer == NULL || bufsize <= 0) { return false; }
+
+    // Skip the write if the file content doesn't change
+    const file_shadow_t* shadow = find_file_shadow(filename);
+    if (shadow != NULL && shadow->size == bufsize && memcmp(shadow->data, buffer, bufsize) == 0) {
+        ESP_LOGD(TAG, "File '%s' is unchanged", filename);
+        return true;
+    }
+
     if (mount_filesystem()) {
-        const bool success = write_data_to_filesystem(filename, buffer, bufsize);
-        unmount_filesystem();
+        const bool success = write_data_to_filesystem_atomic(filename, buffer, bufsize);
+        if (success) { update_file_shadow(filename, buffer, bufsize); }
+        else { invalidate_file_shadow(filename); }
         return success;
     }
     return false;
 }
 
 
+// Shadowed storage access, the shadows are only used with the storage lock held
+bool write_file_to_storage(const char* filename, const char* const buffer) {
+    lock_storage();
+    const bool success = write_file_to_storage_locked(filename, buffer);
+    unlock_storage();
+    return success;
+}
 
+bool read_data_from_storage(const char* filename, uint8_t* const buffer, const int bufsize) {
+    lock_storage();
+    const bool success = read_data_from_storage_locked(filename, buffer, bufsize);
+    unlock_storage();
+    return success;
+}
+
+int read_available_data_from_storage(const char* filename, uint8_t* const buffer, const int bufsize) {
+    lock_storage();
+    const int bytes_read = read_available_data_from_storage_locked(filename, buffer, bufsize);
+    unlock_storage();
+    return bytes_read;
+}
+
+bool write_data_to_storage(const char* filename, const uint8_t* const buffer, const int bufsize) {
+    lock_storage();
+    const bool success = write_data_to_storage_locked(filename, buffer, bufsize);
+    unlock_storage();
+    return success;
+}
+
+
+
+
+static bool does_file_exist_on_filesystem_locked(const char* filename) {
+    // prepend root path
+    char full_filepath[FULL_FILEPATH_MAX_SIZE] = BASE_PATH;
+    if (!get_full_filepath(filename, full_filepath)) { return false; }
 
-bool does_file_exist_on_filesystem(const char* filename) {
     // Open the file
     FILE *file = NULL;
-    file = fopen(filename,"rb");
+    file = fopen(full_filepath,"rb");
 
     if (file != NULL) {
         // Close the file
@@ -293,19 +626,35 @@ bool does_file_exist_on_filesystem(const char* filename) {
     }
 }
 
-bool does_file_exist_in_storage(const char* filename) {
+bool does_file_exist_on_filesystem(const char* filename) {
+    lock_storage();
+    const bool exists = does_file_exist_on_filesystem_locked(filename);
+    unlock_storage();
+    return exists;
+}
+
+static bool does_file_exist_in_storage_locked(const char* filename) {
     if (mount_filesystem()) {
-        const bool success = does_file_exist_on_filesystem(filename);
-        unmount_filesystem();
-        return success;
+        return does_file_exist_on_filesystem(filename);
     }
     return false;
 }
-int get_file_size_from_filesystem(const char* filename) {
+
+bool does_file_exist_in_storage(const char* filename) {
+    lock_storage();
+    const bool exists = does_file_exist_in_storage_locked(filename);
+    unlock_storage();
+    return exists;
+}
+static int get_file_size_from_filesystem_locked(const char* filename) {
+
+    // prepend root path
+    char full_filepath[FULL_FILEPATH_MAX_SIZE] = BASE_PATH;
+    if (!get_full_filepath(filename, full_filepath)) { return -1; }
 
     // Open the file
     FILE *file = NULL;
-    file = fopen(filename,"rb");
+    file = fopen(full_filepath,"rb");
 
     if (file != NULL) {
 
@@ -326,14 +675,26 @@ int get_file_size_from_filesystem(const char* filename) {
     }
 }
 
-int get_file_size_from_storage(const char* filename) {
+int get_file_size_from_filesystem(const char* filename) {
+    lock_storage();
+    const int size = get_file_size_from_filesystem_locked(filename);
+    unlock_storage();
+    return size;
+}
+
+static int get_file_size_from_storage_locked(const char* filename) {
     if (mount_filesystem()) {
-        const int size = get_file_size_from_filesystem(filename);
-        unmount_filesystem();
-        return size;
+        return get_file_size_from_filesystem(filename);
     }
     return -1;
 }
+
+int get_file_size_from_storage(const char* filename) {
+    lock_storage();
+    const int size = get_file_size_from_storage_locked(filename);
+    unlock_storage();
+    return size;
+}
 int get_file_size(const char* filename) {
     return get_file_size_from_storage(filename);
 }
@@ -341,7 +702,7 @@ int get_file_size(const char* filename) {
 // Use get_file_size to determine the needed buffer size.
 // Allocate a buffer an read the file from the filesystem
 // The returned pointer needs to be freed after use.
-bool read_data_file_from_filesysteme(const char* filename, uint8_t** buffer, int* filesize) {
+static bool read_data_file_from_filesysteme_locked(const char* filename, uint8_t** buffer, int* filesize) {
 
     *filesize = get_file_size_from_filesystem(filename);
     if (*filesize > 0) {
@@ -353,18 +714,29 @@ bool read_data_file_from_filesysteme(const char* filename, uint8_t** buffer, int
     }
 }
 
-// Mount the filesystem
+bool read_data_file_from_filesysteme(const char* filename, uint8_t** buffer, int* filesize) {
+    lock_storage();
+    const bool success = read_data_file_from_filesysteme_locked(filename, buffer, filesize);
+    unlock_storage();
+    return success;
+}
+
+// Mount the filesystem (if not mounted yet)
 // Use get_file_size to determine the needed buffer size.
 // Allocate a buffer an read the file from the filesystem
-// Unmount the filesystem
 // The returned pointer needs to be freed after use.
-bool read_data_file_from_storage(const char* filename, uint8_t** buffer, int* filesize) {
+static bool read_data_file_from_storage_locked(const char* filename, uint8_t** buffer, int* filesize) {
     if (mount_filesystem()) {
-        const bool success = read_data_file_from_filesysteme(filename, buffer, filesize);
-        unmount_filesystem();
-        return success;
+        return read_data_file_from_filesysteme(filename, buffer, filesize);
     }
     return false;
 }
 
+bool read_data_file_from_storage(const char* filename, uint8_t** buffer, int* filesize) {
+    lock_storage();
+    const bool success = read_data_file_from_storage_locked(filename, buffer, filesize);
+    unlock_storage();
+    return success;
+}
+
 
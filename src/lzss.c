@@ -0,0 +1,113 @@
+#include "lzss.h"
+#include "stddef.h" // NULL
+#include "string.h" // memcmp, memset
+
+#define LZSS_WINDOW_MASK (LZSS_WINDOW_SIZE - 1)
+
+
+// Hand the not yet flushed part of the window to the callback
+// The pending bytes never wrap around, the window is flushed whenever 'window_pos' wraps to 0
+static bool lzss_flush(lzss_decoder_t* const decoder, lzss_output_cb_t* const callback, void* const ctx) {
+    if (decoder->pending > 0) {
+        if (!callback(ctx, decoder->window + decoder->flush_pos, decoder->pending)) { return false; }
+    }
+    decoder->flush_pos = decoder->window_pos;
+    decoder->pending = 0;
+    return true;
+}
+
+// Append a byte to the output (flushes the window before it wraps around)
+static bool lzss_put(lzss_decoder_t* const decoder, const uint8_t value, lzss_output_cb_t* const callback, void* const ctx) {
+    decoder->window[decoder->window_pos] = value;
+    decoder->window_pos = (decoder->window_pos + 1) & LZSS_WINDOW_MASK;
+    decoder->total_out += 1;
+    decoder->pending += 1;
+    if (decoder->window_pos == 0) { return lzss_flush(decoder, callback, ctx); }
+    return true;
+}
+
+
+
+void lzss_decoder_init(lzss_decoder_t* const decoder) {
+    if (decoder == NULL) { return; }
+    memset(decoder, 0, sizeof(lzss_decoder_t));
+}
+
+bool lzss_decode(lzss_decoder_t* const decoder, const uint8_t* const in, const uint32_t len, lzss_output_cb_t* const callback, void* const ctx) {
+    if (decoder == NULL || in == NULL || callback == NULL) { return false; }
+    if (decoder->error) { return false; }
+
+    uint32_t i = 0;
+    while (i < len) {
+
+        // Header
+        if (decoder->header_len < LZSS_HEADER_SIZE) {
+            decoder->header[decoder->header_len++] = in[i++];
+            if (decoder->header_len == LZSS_HEADER_SIZE) {
+                if (memcmp(decoder->header, LZSS_MAGIC, 4) != 0) { decoder->error = true; return false; }
+                decoder->expected_size = (uint32_t) decoder->header[4] 
+                    | ((uint32_t) decoder->header[5] << 8) 
+                    | ((uint32_t) decoder->header[6] << 16) 
+                    | ((uint32_t) decoder->header[7] << 24);
+            }
+            continue;
+        }
+
+        // No data allowed after the end of the stream
+        if (decoder->total_out >= decoder->expected_size) { decoder->error = true; return false; }
+
+        // Next flag byte
+        if (decoder->flag_bits_left == 0) {
+            decoder->flags = in[i++];
+            decoder->flag_bits_left = 8;
+            continue;
+        }
+
+        if (decoder->flags & 0x01) {
+            // Literal
+            if (!lzss_put(decoder, in[i++], callback, ctx)) { decoder->error = true; return false; }
+        }
+        else {
+            // Match (two bytes, may be split across blocks)
+            if (!decoder->match_pending) {
+                decoder->match_byte = in[i++];
+                decoder->match_pending = true;
+                continue;
+            }
+            const uint8_t b1 = in[i++];
+            decoder->match_pending = false;
+
+            const uint32_t distance = ((uint32_t) decoder->match_byte | ((uint32_t) (b1 & 0xF0) << 4)) + 1;
+            const uint32_t length = (uint32_t) (b1 & 0x0F) + LZSS_MIN_MATCH;
+            if (distance > decoder->total_out || decoder->total_out + length > decoder->expected_size) {
+                decoder->error = true;
+                return false;
+            }
+
+            // Copy byte by byte, the source may overlap with the output
+            for (uint32_t k = 0; k < length; ++k) {
+                const uint8_t value = decoder->window[(decoder->window_pos - distance) & LZSS_WINDOW_MASK];
+                if (!lzss_put(decoder, value, callback, ctx)) { decoder->error = true; return false; }
+            }
+        }
+        decoder->flags >>= 1;
+        decoder->flag_bits_left -= 1;
+    }
+
+    // Hand out everything decoded from this block
+    if (!lzss_flush(decoder, callback, ctx)) { decoder->error = true; return false; }
+    return true;
+}
+
+uint32_t lzss_decoder_get_expected_size(const lzss_decoder_t* const decoder) {
+    if (decoder == NULL || decoder->header_len < LZSS_HEADER_SIZE) { return 0; }
+    return decoder->expected_size;
+}
+
+bool lzss_decoder_finished(const lzss_decoder_t* const decoder) {
+    if (decoder == NULL) { return false; }
+    return !decoder->error 
+        && decoder->header_len == LZSS_HEADER_SIZE 
+        && decoder->total_out == decoder->expected_size 
+        && !decoder->match_pending;
+}
@@ -15,6 +15,13 @@
 // Header for SLCAN
 #include "slcan.h"
 
+// Header for SLCAN over TCP
+#include "wifi_ap.h"
+#include "transport_tcp.h"
+
+// Header for the boot timeline report
+#include "boot_timeline.h"
+
 
 // Header for debug messages
 #define LOG_LOCAL_LEVEL ESP_LOG_DEBUG
@@ -25,6 +32,7 @@
 
 void app_main(void)
 {
+    boot_timeline_mark(BOOT_EVENT_APP_MAIN);
 
     // Init NVS flash
     esp_err_t ret = nvs_flash_init();
@@ -33,15 +41,29 @@ void app_main(void)
         ret = nvs_flash_init();
     }
     ESP_ERROR_CHECK( ret );
+    boot_timeline_mark(BOOT_EVENT_NVS_READY);
 
     // Hello World
     printf("Hello World!\r\n");
 
+    // Init everything nedded for SLCAN
+    // This comes first so the CAN channel is already capturing (auto-startup)
+    // while the bluetooth controller and stack are brought up
+    slcan_init();
+
     // Init everything nedded for SPP
     btspp_init(HAREWARE_CONFIG_BT_DEVICE_NAME, 10 * BTSPP_MSG_MAX_SIZE);
 
-    // Init everything nedded for SLCAN
-    slcan_init();
+    // Serve SLCAN via TCP instead of SPP
+    #if HARDWARE_CONFIG_TCP_ENABLED
+    if (wifi_ap_init(HARDWARE_CONFIG_WIFI_SSID, HARDWARE_CONFIG_WIFI_PASSWORD, TCP_TRANSPORT_MAX_CLIENTS)
+        && tcp_transport_start(HARDWARE_CONFIG_TCP_PORT)) {
+        slcan_set_transport(&tcp_transport);
+    }
+    #endif
+
+    // Start processing SLCAN commands via SPP
+    slcan_start();
 
     // Nothing more to do
     vTaskDelete(NULL);
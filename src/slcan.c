@@ -1,22 +1,45 @@
 #include "slcan.h"
 
 #include "HardwareConfig.h"
+#include "boot_timeline.h"
 
 // Some more standard header
 #include <stdint.h> // uint<X>_t
 #include <stdio.h> // sscanf, snprintf
-#include <string.h> // strlen, strcmp, strcpy
+#include <string.h> // strlen, strcmp, strcpy, memcmp
+#include <stdlib.h> // malloc, free
 
 
-// Bluetooth SPP
+// Transport (Bluetooth SPP by default)
+#include "transport.h"
 #include "btspp.h"
+#include "btspp_ota.h"
 #include "buffer_access.h"
 #include "file_access.h"
 
+// Decoding of signals
+#include "can_signals.h"
+
+// Triggered capture
+#include "can_capture.h"
+
+// Buffer for received frames
+#include "can_rx_ring.h"
+
+// Broadcast manager (socketcand mode)
+#include "can_bcm.h"
+
+// Automatic bitrate detection
+#include "can_autobaud.h"
+
+// Bit timing calculations ('s' and 'Y' command)
+#include "can_timing.h"
+
 
 // FreeRTOS
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/semphr.h"
 
 // CAN API
 #include "driver/twai.h" // #warning driver/can.h is deprecated, please use driver/twai.h instead
@@ -24,6 +47,12 @@
 // Timer API
 #include "esp_timer.h" // esp_timer_get_time
 
+// Heap API (diagnostics)
+#include "esp_heap_caps.h"
+
+// CRC32 (ROM function)
+#include "esp_rom_crc.h"
+
 
 
 
@@ -34,16 +63,28 @@
 #define SLCAN_TAG "SLCAN"
 
 // Filenames for EEPROM data
-#define TIMING_FILENAME "timing_config.bin"
-#define FILTER_FILENAME "filter_config.bin"
-#define SLCAN_FILENAME "slcan_config.bin"
+#define CONFIG_FILENAME "config.bin"
+#define LEGACY_TIMING_FILENAME "timing_config.bin" // Older firmware versions
+#define LEGACY_FILTER_FILENAME "filter_config.bin" // Older firmware versions
+#define LEGACY_SLCAN_FILENAME "slcan_config.bin" // Older firmware versions
+#define SIGNALS_FILENAME "signals.bin"
+#define CAPTURE_FILENAME "capture.bin"
 
 
 // Constants for CAN-Driver (TWAI-Driver)
 #define CAN_TX_PIN HAREWARE_CONFIG_CAN_TX_PIN // Hardware dependend
 #define CAN_RX_PIN HAREWARE_CONFIG_CAN_RX_PIN // Hardware dependend
 #define CAN_TX_QUEUE_SIZE 10
-#define CAN_RX_QUEUE_SIZE 1024
+#define CAN_RX_QUEUE_SIZE 32 // Drained into the RX ring (see can_rx_ring.h) by the RX task
+#define CAN_RX_POLL_INTERVAL_MS 10 // How often the RX task checks if the channel was closed (one tick)
+
+// Task stacks in bytes, the sizes of the original firmware (not tuned)
+// Only shrink them after the stack high-water marks of the 'I' command were checked on the
+// hardware for the worst cases (OTA update in the SLCAN task, decoded signals and capture
+// saving in the auto-poll task)
+#define SLCAN_TASK_STACK_SIZE (8 * 1024)
+#define AUTO_POLL_TASK_STACK_SIZE (8 * 1024)
+#define CAN_RX_TASK_STACK_SIZE (3 * 1024)
 
 // Configs used for twai_driver_install()
 static twai_timing_config_t timing_config = TWAI_TIMING_CONFIG_500KBITS(); // Saved in EEPROM
@@ -56,6 +97,31 @@ static twai_general_config_t can_config =  {
     .intr_flags = ESP_INTR_FLAG_LEVEL1                                   
 }; // Fixed (Hardware dependend)
 
+// Timings of the standard CAN bit-rates (see 'S' command)
+static const twai_timing_config_t bitrate_timing_table[] = {
+    // S0: 10Kbit, maybe not supported by hardware? (TWAI_TIMING_CONFIG_10KBITS())
+    { .brp = 400, .tseg_1 = 15, .tseg_2 = 4, .sjw = 3, .triple_sampling = false },
+    // S1: 20Kbit, maybe not supported by hardware? (TWAI_TIMING_CONFIG_20KBITS())
+    { .brp = 200, .tseg_1 = 15, .tseg_2 = 4, .sjw = 3, .triple_sampling = false },
+    // S2: 50Kbit (TWAI_TIMING_CONFIG_50KBITS())
+    { .brp = 80, .tseg_1 = 15, .tseg_2 = 4, .sjw = 3, .triple_sampling = false },
+    // S3: 100Kbit (TWAI_TIMING_CONFIG_100KBITS())
+    { .brp = 40, .tseg_1 = 15, .tseg_2 = 4, .sjw = 3, .triple_sampling = false },
+    // S4: 125Kbit (TWAI_TIMING_CONFIG_125KBITS())
+    { .brp = 32, .tseg_1 = 15, .tseg_2 = 4, .sjw = 3, .triple_sampling = false },
+    // S5: 250Kbit (TWAI_TIMING_CONFIG_250KBITS())
+    { .brp = 16, .tseg_1 = 15, .tseg_2 = 4, .sjw = 3, .triple_sampling = false },
+    // S6: 500Kbit (TWAI_TIMING_CONFIG_500KBITS())
+    { .brp = 8, .tseg_1 = 15, .tseg_2 = 4, .sjw = 3, .triple_sampling = false },
+    // S7: 800Kbit (TWAI_TIMING_CONFIG_800KBITS())
+    { .brp = 4, .tseg_1 = 16, .tseg_2 = 8, .sjw = 3, .triple_sampling = false },
+    // S8: 1Mbit (TWAI_TIMING_CONFIG_1MBITS())
+    { .brp = 4, .tseg_1 = 15, .tseg_2 = 4, .sjw = 3, .triple_sampling = false }
+};
+
+// Order in which the automatic bitrate detection tries the 'S' bit-rates (most common first)
+static const uint8_t autobaud_order[] = { 6, 5, 4, 8, 3, 7, 2, 1, 0 };
+
 
 
 
@@ -76,11 +142,63 @@ static slcan_config_t slcan_config = {
     .startup_in_listen_mode = false
 };
 
+// What the auto-poll feature sends for received frames (Saved in EEPROM, see 'D' command)
+#define SIGNAL_OUTPUT_RAW 0 // SLCAN frames only (default)
+#define SIGNAL_OUTPUT_DECODED 1 // Decoded signals only
+#define SIGNAL_OUTPUT_BOTH 2 // SLCAN frames and decoded signals
+#define SIGNAL_OUTPUT_SUMMARY 3 // Statistics of the decoded signals per window
+static uint8_t signal_output_mode = SIGNAL_OUTPUT_RAW;
+
+// Window length for SIGNAL_OUTPUT_SUMMARY (Saved in EEPROM, see 'D' command)
+#define SIGNAL_WINDOW_DEFAULT 1 // seconds
+#define SIGNAL_WINDOW_MAX 3600 // seconds
+static uint16_t signal_window_length = SIGNAL_WINDOW_DEFAULT;
+
+// Decoded signals of one frame are sent in lines of up to this many values
+#define SIGNAL_VALUES_PER_LINE 12
+
+// How often the auto-poll task checks the TWAI alerts while a capture waits for them
+#define CAPTURE_ALERT_POLL_INTERVAL_MS 10
+
+// Protocol spoken via the transport (Saved in EEPROM, see 'K' command)
+#define PROTOCOL_SLCAN 0
+#define PROTOCOL_SOCKETCAND 1 // See 'socketcand_process_cmd'
+static uint8_t protocol = PROTOCOL_SLCAN;
+
+// State of the socketcand mode
+typedef enum {
+    SOCKETCAND_NO_BUS = 0, // Waiting for '< open ... >'
+    SOCKETCAND_BCM, // Only subscribed frames are forwarded (default after '< open ... >')
+    SOCKETCAND_RAW // All frames are forwarded
+} socketcand_mode_t;
+static socketcand_mode_t socketcand_mode = SOCKETCAND_NO_BUS;
+
+// The byte stream SLCAN runs over (see 'slcan_set_transport')
+static const transport_t* transport = &btspp_transport;
+static bool slcan_started = false;
+
+// Answer the client whose command is being processed
+static inline bool send_msg(const char* const msg, const uint32_t timeout_ms) {
+    return transport_send_reply(transport, msg, timeout_ms);
+}
+
+// Send a message to all clients (received frames and other Auto Poll/Send output)
+static inline bool broadcast_msg(const char* const msg, const uint32_t timeout_ms) {
+    return transport_send_msg(transport, msg, timeout_ms);
+}
+
 // Flag thats indicats the status of the can driver
 static bool can_channel_initiated = false; // A baudrate has been set via the 'S' or 's' command
 static bool can_channel_open = false;
 static bool listen_mode_only = false;
 
+// Tasks that run while the CAN channel is open, each gives its semaphore when it
+// stops and is then deleted by 'close_can_channel' (see 'join_channel_task')
+static TaskHandle_t can_rx_task_handle = NULL;
+static SemaphoreHandle_t can_rx_task_stopped = NULL;
+static TaskHandle_t auto_poll_task_handle = NULL;
+static SemaphoreHandle_t auto_poll_task_stopped = NULL;
+
 // Constants for SLCAN messages
 #define CR '\r'
 #define BELL '\b'
@@ -89,35 +207,248 @@ static bool listen_mode_only = false;
 #define ERROR "\b"
 
 
-// Store Timing confiuration in EEPROM
-static void save_timing_config_to_eeprom() {
-    write_data_to_storage(TIMING_FILENAME, (const uint8_t*) &timing_config, sizeof(timing_config));
+// Layout of the config record (Saved in EEPROM)
+// All configs are stored in a single file with a versioned, CRC protected header.
+// New fields must be appended to the payload and the version increased.
+// Older records simply keep the defaults for fields they don't contain.
+//
+// Header (little endian):
+//  0: magic (uint32)
+//  4: version (uint16)
+//  6: payload size (uint16)
+//  8: CRC32 of the payload (uint32)
+// Payload version 1 (little endian):
+//  0: timing brp (uint32)
+//  4: timing tseg_1, tseg_2, sjw, triple_sampling (uint8 each)
+//  8: filter acceptance_code (uint32)
+// 12: filter acceptance_mask (uint32)
+// 16: filter single_filter (uint8)
+// 17: slcan auto_poll_enabled, timestamps_enabled, auto_startup_enabled, startup_in_listen_mode (uint8 each)
+// Payload version 2:
+// 21: signal output mode (uint8)
+// Payload version 3:
+// 22: signal window length in seconds (uint16)
+// Payload version 4:
+// 24: protocol (uint8)
+#define CONFIG_RECORD_MAGIC 0x4E414353u // "SCAN"
+#define CONFIG_RECORD_VERSION 4
+#define CONFIG_RECORD_HEADER_SIZE 12
+#define CONFIG_RECORD_PAYLOAD_SIZE_V1 21
+#define CONFIG_RECORD_PAYLOAD_SIZE_V2 22
+#define CONFIG_RECORD_PAYLOAD_SIZE_V3 24
+#define CONFIG_RECORD_PAYLOAD_SIZE_V4 25
+#define CONFIG_RECORD_PAYLOAD_SIZE CONFIG_RECORD_PAYLOAD_SIZE_V4
+#define CONFIG_RECORD_MAX_SIZE 64
+
+// Serialize all configs into a record, returns the record size
+static int serialize_config_record(uint8_t* const record) {
+    uint8_t* const payload = record + CONFIG_RECORD_HEADER_SIZE;
+
+    // Payload
+    copy_uint32_into_buffer(timing_config.brp, payload + 0, LITTLE_ENDIAN);
+    payload[4] = timing_config.tseg_1;
+    payload[5] = timing_config.tseg_2;
+    payload[6] = timing_config.sjw;
+    payload[7] = timing_config.triple_sampling;
+    copy_uint32_into_buffer(filter_config.acceptance_code, payload + 8, LITTLE_ENDIAN);
+    copy_uint32_into_buffer(filter_config.acceptance_mask, payload + 12, LITTLE_ENDIAN);
+    payload[16] = filter_config.single_filter;
+    payload[17] = slcan_config.auto_poll_enabled;
+    payload[18] = slcan_config.timestamps_enabled;
+    payload[19] = slcan_config.auto_startup_enabled;
+    payload[20] = slcan_config.startup_in_listen_mode;
+    payload[21] = signal_output_mode;
+    copy_uint16_into_buffer(signal_window_length, payload + 22, LITTLE_ENDIAN);
+    payload[24] = protocol;
+
+    // Header
+    copy_uint32_into_buffer(CONFIG_RECORD_MAGIC, record + 0, LITTLE_ENDIAN);
+    copy_uint16_into_buffer(CONFIG_RECORD_VERSION, record + 4, LITTLE_ENDIAN);
+    copy_uint16_into_buffer(CONFIG_RECORD_PAYLOAD_SIZE, record + 6, LITTLE_ENDIAN);
+    copy_uint32_into_buffer(esp_rom_crc32_le(0, payload, CONFIG_RECORD_PAYLOAD_SIZE), record + 8, LITTLE_ENDIAN);
+
+    return CONFIG_RECORD_HEADER_SIZE + CONFIG_RECORD_PAYLOAD_SIZE;
+}
+
+// Check a record and copy its content into the configs
+// Nothing is changed if the record is invalid
+static bool deserialize_config_record(const uint8_t* const record, const int record_size) {
+    if (record_size < CONFIG_RECORD_HEADER_SIZE) { return false; }
+    const uint8_t* const payload = record + CONFIG_RECORD_HEADER_SIZE;
+
+    // Check header
+    const uint32_t magic = parse_uint32(record + 0, LITTLE_ENDIAN);
+    const uint16_t version = parse_uint16(record + 4, LITTLE_ENDIAN);
+    const uint16_t payload_size = parse_uint16(record + 6, LITTLE_ENDIAN);
+    const uint32_t crc = parse_uint32(record + 8, LITTLE_ENDIAN);
+    if (magic != CONFIG_RECORD_MAGIC) {
+        ESP_LOGE(SLCAN_TAG, "Config record: Invalid magic 0x%08X", magic);
+        return false;
+    }
+    if (CONFIG_RECORD_HEADER_SIZE + payload_size > record_size) {
+        ESP_LOGE(SLCAN_TAG, "Config record: Truncated (%d of %u bytes)", record_size, CONFIG_RECORD_HEADER_SIZE + payload_size);
+        return false;
+    }
+    if (esp_rom_crc32_le(0, payload, payload_size) != crc) {
+        ESP_LOGE(SLCAN_TAG, "Config record: CRC mismatch");
+        return false;
+    }
+    if (version > CONFIG_RECORD_VERSION) {
+        ESP_LOGW(SLCAN_TAG, "Config record: Version %u is newer than %u, ignoring unknown fields", version, CONFIG_RECORD_VERSION);
+    }
+
+    // Version 1 fields
+    if (payload_size >= CONFIG_RECORD_PAYLOAD_SIZE_V1) {
+        timing_config.brp = parse_uint32(payload + 0, LITTLE_ENDIAN);
+        timing_config.tseg_1 = payload[4];
+        timing_config.tseg_2 = payload[5];
+        timing_config.sjw = payload[6];
+        timing_config.triple_sampling = payload[7];
+        filter_config.acceptance_code = parse_uint32(payload + 8, LITTLE_ENDIAN);
+        filter_config.acceptance_mask = parse_uint32(payload + 12, LITTLE_ENDIAN);
+        filter_config.single_filter = payload[16];
+        slcan_config.auto_poll_enabled = payload[17];
+        slcan_config.timestamps_enabled = payload[18];
+        slcan_config.auto_startup_enabled = payload[19];
+        slcan_config.startup_in_listen_mode = payload[20];
+    }
+
+    // Version 2 fields
+    if (payload_size >= CONFIG_RECORD_PAYLOAD_SIZE_V2 && payload[21] <= SIGNAL_OUTPUT_SUMMARY) {
+        signal_output_mode = payload[21];
+    }
+
+    // Version 3 fields
+    if (payload_size >= CONFIG_RECORD_PAYLOAD_SIZE_V3) {
+        const uint16_t window_length = parse_uint16(payload + 22, LITTLE_ENDIAN);
+        if (window_length >= 1 && window_length <= SIGNAL_WINDOW_MAX) {
+            signal_window_length = window_length;
+        }
+    }
+
+    // Version 4 fields
+    if (payload_size >= CONFIG_RECORD_PAYLOAD_SIZE_V4 && payload[24] <= PROTOCOL_SOCKETCAND) {
+        protocol = payload[24];
+    }
+
+    // Fields of later versions go here (guarded by payload_size)
+
+    return true;
 }
 
-// Store Filter confiuration in EEPROM
-static void save_filter_config_to_eeprom() {
-    write_data_to_storage(FILTER_FILENAME, (const uint8_t*) &filter_config, sizeof(filter_config));
+// Store all confiurations in EEPROM
+static bool save_configs_to_eeprom() {
+    const int64_t start_time = esp_timer_get_time();
+    uint8_t record[CONFIG_RECORD_MAX_SIZE];
+    const int record_size = serialize_config_record(record);
+    const bool saved = write_data_to_storage(CONFIG_FILENAME, record, record_size);
+    ESP_LOGD(SLCAN_TAG, "Saving configs took %lld us", esp_timer_get_time() - start_time);
+    return saved;
 }
 
-// Store SLCAN confiuration in EEPROM
-static void save_slcan_config_to_eeprom() {
-    write_data_to_storage(SLCAN_FILENAME, (const uint8_t*) &slcan_config, sizeof(slcan_config));
+// Check that the record in EEPROM matches the current configs
+static bool verify_configs_in_eeprom() {
+    uint8_t record[CONFIG_RECORD_MAX_SIZE];
+    uint8_t stored_record[CONFIG_RECORD_MAX_SIZE];
+    const int record_size = serialize_config_record(record);
+    const int stored_record_size = read_available_data_from_storage(CONFIG_FILENAME, stored_record, sizeof(stored_record));
+    return (stored_record_size == record_size && memcmp(record, stored_record, record_size) == 0);
 }
 
 
-// Restore Timing confiuration from EEPROM
-static void restore_timing_config_from_eeprom() {
-    read_data_from_storage(TIMING_FILENAME, (uint8_t*) &timing_config, sizeof(timing_config));
+// Background persistence of the configs
+// Commands only mark the configs as dirty and get their answer immediately.
+// The task writes the config record once no change arrived for the quiet period.
+#define CONFIG_PERSIST_QUIET_PERIOD_MS 500
+static bool configs_dirty = false;
+static SemaphoreHandle_t config_persist_mutex = NULL;
+static TaskHandle_t config_persist_task_handle = NULL;
+
+// Write the configs to EEPROM if they changed
+static void flush_configs_to_eeprom() {
+    if (config_persist_mutex == NULL) { return; }
+    xSemaphoreTake(config_persist_mutex, portMAX_DELAY);
+
+    if (configs_dirty) {
+        configs_dirty = false;
+        if (!save_configs_to_eeprom()) { ESP_LOGE(SLCAN_TAG, "Saving configs failed"); }
+    }
+
+    xSemaphoreGive(config_persist_mutex);
 }
 
-// Restore Filter confiuration from EEPROM
-static void restore_filter_config_from_eeprom() {
-    read_data_from_storage(FILTER_FILENAME, (uint8_t*) &filter_config, sizeof(filter_config));
+// Mark the configs as changed and (re)start the quiet period
+static void mark_configs_dirty() {
+    xSemaphoreTake(config_persist_mutex, portMAX_DELAY);
+    configs_dirty = true;
+    xSemaphoreGive(config_persist_mutex);
+    xTaskNotifyGive(config_persist_task_handle);
 }
 
-// Restore SLCAN confiuration from EEPROM
-static void restore_slcan_config_from_eeprom() {
-    read_data_from_storage(SLCAN_FILENAME, (uint8_t*) &slcan_config, sizeof(slcan_config));
+// The background task for saving configs
+static void config_persist_task(void* args) {
+
+    ESP_LOGI(SLCAN_TAG, "Starting Config-Persist Task");
+
+    while (true) {
+        // Wait for the first change
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        // Coalesce all changes until the quiet period passes without a new one
+        while (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(CONFIG_PERSIST_QUIET_PERIOD_MS)) > 0) {}
+
+        flush_configs_to_eeprom();
+    }
+
+    ESP_LOGI(SLCAN_TAG, "Stopping Config-Persist Task");
+    vTaskDelete(NULL);
+}
+
+// Start the background task for saving configs
+// Lower priority than the SLCAN tasks, so flash writes never delay an answer
+static void start_config_persist_task() {
+    config_persist_mutex = xSemaphoreCreateMutex();
+    assert(config_persist_mutex != NULL);
+    xTaskCreatePinnedToCore(config_persist_task, "SLCAN-PERSIST", 4 * 1024, NULL, 5, &config_persist_task_handle, 1);
+}
+
+
+// Restore all confiurations from EEPROM (a single read at boot)
+// Falls back to the files of older firmware versions if there is no record yet
+static void restore_configs_from_eeprom() {
+    const int64_t start_time = esp_timer_get_time();
+    uint8_t record[CONFIG_RECORD_MAX_SIZE];
+    const int record_size = read_available_data_from_storage(CONFIG_FILENAME, record, sizeof(record));
+
+    if (record_size > 0) {
+        if (!deserialize_config_record(record, record_size)) {
+            ESP_LOGE(SLCAN_TAG, "Invalid config record, using defaults");
+        }
+    }
+    else if (does_file_exist_in_storage(LEGACY_TIMING_FILENAME) || does_file_exist_in_storage(LEGACY_FILTER_FILENAME) || does_file_exist_in_storage(LEGACY_SLCAN_FILENAME)) {
+        // Migrate the raw structs of older firmware versions (only if they have the exact size)
+        ESP_LOGW(SLCAN_TAG, "Migrating legacy config files");
+        if (get_file_size_from_storage(LEGACY_TIMING_FILENAME) == sizeof(timing_config)) {
+            read_data_from_storage(LEGACY_TIMING_FILENAME, (uint8_t*) &timing_config, sizeof(timing_config));
+        }
+        if (get_file_size_from_storage(LEGACY_FILTER_FILENAME) == sizeof(filter_config)) {
+            read_data_from_storage(LEGACY_FILTER_FILENAME, (uint8_t*) &filter_config, sizeof(filter_config));
+        }
+        if (get_file_size_from_storage(LEGACY_SLCAN_FILENAME) == sizeof(slcan_config)) {
+            read_data_from_storage(LEGACY_SLCAN_FILENAME, (uint8_t*) &slcan_config, sizeof(slcan_config));
+        }
+
+        // The legacy files are only removed once the record is safely stored
+        if (save_configs_to_eeprom() && verify_configs_in_eeprom()) {
+            remove_file_from_filesystem(LEGACY_TIMING_FILENAME);
+            remove_file_from_filesystem(LEGACY_FILTER_FILENAME);
+            remove_file_from_filesystem(LEGACY_SLCAN_FILENAME);
+        }
+        else {
+            ESP_LOGE(SLCAN_TAG, "Saving the migrated configs failed, keeping the legacy config files");
+        }
+    }
+    ESP_LOGI(SLCAN_TAG, "Restoring configs took %lld us", esp_timer_get_time() - start_time);
 }
 
 /**
@@ -193,6 +524,193 @@ static int can2sl(const twai_message_t* message, const bool auto_poll_enabled, c
     return msg_len;
 }
 
+/**
+ * @brief Convert a CAN frame to a socketcand frame record
+ * Format: < frame <identifier> <seconds>.<microseconds> <data bytes> >
+ * 
+ * @param [in] message The CAN-Bus frame
+ * @param [in] timestamp_us CAN frame timestamp (microseconds since startup)
+ * @param [out] buffer The record will be written to the this location
+ * @param [in] bufsize Size of the output buffer (should be at least 72 bytes)
+ * @return int Record length 
+ */
+static int can2socketcand(const twai_message_t* message, const int64_t timestamp_us, char* const buffer, const uint32_t bufsize) {
+
+    // check (just in case)
+    if (message == NULL) { return -1; } // invalid pointer
+    if (buffer == NULL) { return -1; } // invalid pointer
+    if (bufsize < 72) { return -1; } // buffer to small (8 + 9 + 21 + 8 * 3 + 2 + 1 == 65)
+
+    // Standard identifiers have 3 digits, extended identifiers 8 (that's how the frame format is told apart)
+    int len = sprintf(buffer, "< frame %0*X %lld.%06lld ", 
+        (message->extd ? 8 : 3), message->identifier, timestamp_us / 1000000LL, timestamp_us % 1000000LL
+    );
+    if (message->rtr == 0) {
+        for (uint32_t i = 0; i < message->data_length_code && i < 8; ++i) {
+            len += sprintf(buffer + len, "%02X ", message->data[i]);
+        }
+    }
+    len += sprintf(buffer + len, ">");
+    return len;
+}
+
+// Forward a received frame in the socketcand mode
+static void send_socketcand_frame(const twai_message_t* message, const int64_t timestamp_us) {
+    if (socketcand_mode == SOCKETCAND_RAW || (socketcand_mode == SOCKETCAND_BCM && can_bcm_filter_frame(timestamp_us, message))) {
+        char record[80];
+        can2socketcand(message, timestamp_us, record, sizeof(record));
+        broadcast_msg(record, 1000);
+    }
+}
+
+// Forward the frames the BCM throttles held back until now
+static void send_throttled_socketcand_frames() {
+    twai_message_t message = {};
+    const int64_t now = esp_timer_get_time();
+    while (socketcand_mode == SOCKETCAND_BCM && can_bcm_take_throttled_frame(now, &message)) {
+        char record[80];
+        can2socketcand(&message, now, record, sizeof(record));
+        broadcast_msg(record, 1000);
+    }
+}
+
+// Send the decoded signals of a CAN frame
+// Format: d<signal id (4 hex)>=<value>,<signal id>=<value>,...[CR]
+static void send_decoded_signals(const twai_message_t* message) {
+    can_signal_value_t values[64];
+    const uint32_t count = can_signals_decode_frame(
+        message->identifier, message->extd, message->data, 
+        (message->rtr ? 0 : message->data_length_code), values, 64
+    );
+
+    char line[16 + SIGNAL_VALUES_PER_LINE * 24];
+    for (uint32_t first = 0; first < count; first += SIGNAL_VALUES_PER_LINE) {
+        int len = sprintf(line, "d");
+        for (uint32_t i = first; i < count && i < first + SIGNAL_VALUES_PER_LINE; ++i) {
+            len += sprintf(line + len, "%s%04X=%g", (i == first ? "" : ","), values[i].signal_id, values[i].value);
+        }
+        sprintf(line + len, "%s", OK);
+        broadcast_msg(line, 1000);
+    }
+}
+
+// Send the statistics of a signal (callback for 'can_signals_flush_window')
+// Format: a<signal id (4 hex)>=<count>,<min>,<max>,<mean>,<last>[CR]
+static void send_signal_stats(void* ctx, const can_signal_stats_t* stats) {
+    char line[16 + 4 * 16];
+    sprintf(line, "a%04X=%u,%g,%g,%g,%g%s", 
+        stats->signal_id, stats->count, stats->min, stats->max, 
+        (float) (stats->sum / stats->count), stats->last, OK
+    );
+    broadcast_msg(line, 1000);
+}
+
+// Save a complete capture and tell the host
+// Format: g<number of frames (4 hex)>[CR], BELL if saving failed
+static void save_capture() {
+    const int count = can_capture_save(CAPTURE_FILENAME);
+    if (count < 0) {
+        broadcast_msg(ERROR, 1000);
+        return;
+    }
+    char line[16];
+    sprintf(line, "g%04X%s", count, OK);
+    broadcast_msg(line, 1000);
+}
+
+// The task that drains the TWAI driver queue into the RX ring
+// Runs while the CAN channel is open, above the auto-poll task so the small driver queue doesn't overflow
+static void can_rx_task(void* args) {
+    twai_message_t message = {};
+    while (can_channel_open) {
+        if (twai_receive(&message, pdMS_TO_TICKS(CAN_RX_POLL_INTERVAL_MS)) == ESP_OK) {
+            can_rx_ring_push(&message, esp_timer_get_time());
+        }
+    }
+
+    // Wait to be deleted by 'close_can_channel'
+    xSemaphoreGive(can_rx_task_stopped);
+    vTaskSuspend(NULL);
+}
+
+// Start the RX task (on the APP-CPU-Core like the other SLCAN tasks)
+static void start_can_rx_task() {
+    xSemaphoreTake(can_rx_task_stopped, 0);
+    xTaskCreatePinnedToCore(can_rx_task, "CAN-RX", CAN_RX_TASK_STACK_SIZE, NULL, 17, &can_rx_task_handle, 1);
+}
+
+// Tasks shown by the 'I' command (tasks that are not running are skipped)
+static const char* const diagnostic_task_names[] = {
+    "SLCAN-TASK", "SLCAN-AUTO-POLL", "CAN-RX", "SLCAN-PERSIST", "SPP-TRANSFER", "BT-OTA-WRITER", 
+    "esp_timer", "BTC_TASK", "BTU_TASK", "hciT", "btController"
+};
+
+// Heap capabilities shown by the 'I' command
+static const struct { const char* name; uint32_t caps; } diagnostic_heap_caps[] = {
+    { "INTERNAL", MALLOC_CAP_INTERNAL },
+    { "8BIT", MALLOC_CAP_8BIT },
+    { "32BIT", MALLOC_CAP_32BIT },
+    { "DMA", MALLOC_CAP_DMA }
+};
+
+// Send the diagnostics report of the 'I' command
+static void send_diagnostics() {
+    char line[64];
+
+    // Stack bytes never used
+    for (uint32_t i = 0; i < sizeof(diagnostic_task_names) / sizeof(diagnostic_task_names[0]); ++i) {
+        const TaskHandle_t task = xTaskGetHandle(diagnostic_task_names[i]);
+        if (task == NULL) { continue; }
+        snprintf(line, sizeof(line), "is%s=%u%s", diagnostic_task_names[i], (uint32_t) uxTaskGetStackHighWaterMark(task), OK);
+        send_msg(line, 1000);
+    }
+
+    // Free, minimum ever free and largest free block
+    for (uint32_t i = 0; i < sizeof(diagnostic_heap_caps) / sizeof(diagnostic_heap_caps[0]); ++i) {
+        const uint32_t caps = diagnostic_heap_caps[i].caps;
+        snprintf(line, sizeof(line), "ih%s=%u,%u,%u%s", diagnostic_heap_caps[i].name, 
+            heap_caps_get_free_size(caps), heap_caps_get_minimum_free_size(caps), heap_caps_get_largest_free_block(caps), OK
+        );
+        send_msg(line, 1000);
+    }
+
+    // High-water mark, size and (for frames) drops
+    snprintf(line, sizeof(line), "irCAN-RX=%u,%u,%u%s", can_rx_ring_get_high_water_mark(), CAN_RX_RING_SIZE, can_rx_ring_get_dropped_count(), OK);
+    send_msg(line, 1000);
+    snprintf(line, sizeof(line), "irSPP-RX=%u,%u%s", btspp_get_recv_buffer_high_water_mark(), btspp_get_recv_buffer_size(), OK);
+    send_msg(line, 1000);
+}
+
+// Take the oldest frame from the RX ring (ESP_ERR_TIMEOUT if there is none)
+static esp_err_t receive_frame(twai_message_t* const message, int64_t* const timestamp_us, const TickType_t timeout) {
+    const int32_t index = can_rx_ring_wait(timeout);
+    if (index < 0) { return ESP_ERR_TIMEOUT; }
+    const can_rx_record_t* const record = can_rx_ring_get(index);
+    can_rx_record_to_message(record, message);
+    *timestamp_us = can_rx_ring_get_timestamp(index);
+    can_rx_ring_release(index);
+    return ESP_OK;
+}
+
+// Log how many frames the RX buffers hold compared to a driver queue of the same size
+static void log_rx_memory_report() {
+    const uint32_t queue_bytes = CAN_RX_QUEUE_SIZE * sizeof(twai_message_t);
+    const uint32_t ring_bytes = sizeof(can_rx_record_t) * CAN_RX_RING_SIZE;
+    const uint32_t total_bytes = queue_bytes + ring_bytes;
+    ESP_LOGI(SLCAN_TAG, "RX memory: driver queue %u * %u bytes + RX ring %u * %u bytes = %u bytes",
+        CAN_RX_QUEUE_SIZE, sizeof(twai_message_t), CAN_RX_RING_SIZE, sizeof(can_rx_record_t), total_bytes
+    );
+    ESP_LOGI(SLCAN_TAG, "RX memory: %u buffered frames, %u as twai_message_t queue (%+d frames)",
+        CAN_RX_QUEUE_SIZE + CAN_RX_RING_SIZE, total_bytes / sizeof(twai_message_t),
+        (int) (CAN_RX_QUEUE_SIZE + CAN_RX_RING_SIZE) - (int) (total_bytes / sizeof(twai_message_t))
+    );
+}
+
+// The auto-poll task also forwards the received frames in the socketcand mode
+static inline bool auto_poll_active() {
+    return slcan_config.auto_poll_enabled || protocol == PROTOCOL_SOCKETCAND;
+}
+
 // The background task for SLCANs auto-poll feature
 static void auto_poll_task(void* args) {
 
@@ -201,53 +719,145 @@ static void auto_poll_task(void* args) {
     // Response buffer for slcan messages
     char response_buffer[64];
     twai_message_t message = {};
+    int64_t timestamp_us = 0;
     esp_err_t err = ESP_OK;
 
+    // Keep received frames in the RX ring until the first SPP client is connected
+    // (e.g. with auto-startup the channel is opened before bluetooth is up)
+    while (can_channel_open && auto_poll_active() && !transport->is_connected()) {
+        if (can_rx_ring_get_count() > 0) {
+            boot_timeline_mark(BOOT_EVENT_FIRST_FRAME);
+        }
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+
+    // Window for SIGNAL_OUTPUT_SUMMARY
+    can_signals_reset_window();
+    int64_t window_end = esp_timer_get_time() + signal_window_length * 1000000LL;
+
     // Run while the CAN channel is open and the auto-poll feature is enabled
-    while (can_channel_open && slcan_config.auto_poll_enabled) { 
+    while (can_channel_open && auto_poll_active()) { 
+
+        // Send the statistics of the signals at the end of each window
+        TickType_t timeout = pdMS_TO_TICKS(1000);
+        if (signal_output_mode == SIGNAL_OUTPUT_SUMMARY) {
+            const int64_t now = esp_timer_get_time();
+            if (now >= window_end) {
+                can_signals_flush_window(send_signal_stats, NULL);
+                window_end += signal_window_length * 1000000LL;
+                if (window_end <= now) { window_end = now + signal_window_length * 1000000LL; } // Missed windows
+            }
+            const TickType_t remaining = pdMS_TO_TICKS((window_end - now) / 1000) + 1;
+            if (remaining < timeout) { timeout = remaining; }
+        }
+
+        // Check the TWAI alerts if the capture waits for them
+        if (can_capture_uses_alerts()) {
+            uint32_t alerts = 0;
+            if (twai_read_alerts(&alerts, 0) == ESP_OK && can_capture_add_alerts(alerts)) {
+                save_capture();
+            }
+            if (timeout > pdMS_TO_TICKS(CAPTURE_ALERT_POLL_INTERVAL_MS)) { timeout = pdMS_TO_TICKS(CAPTURE_ALERT_POLL_INTERVAL_MS); }
+        }
+
+        // Forward the frames held back by the BCM throttles when their interval ends
+        if (protocol == PROTOCOL_SOCKETCAND) {
+            send_throttled_socketcand_frames();
+            const int64_t next_throttle_end = can_bcm_get_next_throttle_end();
+            const int64_t now = esp_timer_get_time();
+            if (next_throttle_end != INT64_MAX) {
+                const TickType_t remaining = (next_throttle_end > now ? pdMS_TO_TICKS((next_throttle_end - now) / 1000) : 0) + 1;
+                if (remaining < timeout) { timeout = remaining; }
+            }
+        }
+
+        // Receive a single CAN frame from the RX ring
+        // Batched output is only flushed once the ring runs empty
+        err = receive_frame(&message, &timestamp_us, 0);
+        if (err == ESP_ERR_TIMEOUT) {
+            transport->flush(0);
+            err = receive_frame(&message, &timestamp_us, timeout);
+        }
 
-        // Receive a single CAN frame from the queue
-        err = twai_receive(&message, pdMS_TO_TICKS(1000));
-        
         if (err == ESP_ERR_TIMEOUT) {
             // If there are no pending frames just continue
             ESP_LOGV(SLCAN_TAG, "Auto-Poll: No pending frames");
             continue;
         }
-        else if (err != ESP_OK) {
-            // Stop the task if 'twai_receive' returns an error
-            ESP_LOGW(SLCAN_TAG, "Auto-Poll: twai_receive ERROR %d", err);
-            btspp_send_msg(ERROR, 1000);
-            break;
-        }
         else {
             ESP_LOGV(SLCAN_TAG, "Auto-Poll: New frame received");
+            boot_timeline_mark(BOOT_EVENT_FIRST_FRAME);
+
+            // A running capture replaces the live output
+            if (can_capture_is_active()) {
+                const bool complete = can_capture_add_frame(
+                    (uint32_t) timestamp_us, message.identifier, message.extd, message.rtr, 
+                    message.data_length_code, message.data
+                );
+                if (complete) { save_capture(); }
+                continue;
+            }
 
-            // converting CAN frame to SLCAN message
-            const int result = can2sl(
-                &message, true, 
-                slcan_config.timestamps_enabled, esp_timer_get_time() % 60000LL, 
-                response_buffer, sizeof(response_buffer)
-            );
+            if (protocol == PROTOCOL_SOCKETCAND) {
+                send_socketcand_frame(&message, timestamp_us);
+                continue;
+            }
+
+            if (signal_output_mode == SIGNAL_OUTPUT_SUMMARY) {
+                can_signals_aggregate_frame(
+                    message.identifier, message.extd, message.data, 
+                    (message.rtr ? 0 : message.data_length_code)
+                );
+                continue;
+            }
 
-            // Sending response
-            btspp_send_msg(response_buffer, 1000);
-            ESP_LOGI(SLCAN_TAG, "Auto-Poll: Responding: (len = %d): %s", result, response_buffer);
+            if (signal_output_mode != SIGNAL_OUTPUT_DECODED) {
+                // converting CAN frame to SLCAN message
+                const int result = can2sl(
+                    &message, true, 
+                    slcan_config.timestamps_enabled, (timestamp_us / 1000) % 60000LL, 
+                    response_buffer, sizeof(response_buffer)
+                );
+
+                // Sending response
+                broadcast_msg(response_buffer, 1000);
+                ESP_LOGI(SLCAN_TAG, "Auto-Poll: Responding: (len = %d): %s", result, response_buffer);
+            }
+            if (signal_output_mode != SIGNAL_OUTPUT_RAW) {
+                send_decoded_signals(&message);
+            }
             continue;
         }
 
 
     }
 
-    // Terminate task
+    // Wait to be deleted by 'close_can_channel'
     ESP_LOGI(SLCAN_TAG, "Stopping Auto-Poll Task");
-    vTaskDelete(NULL);
+    xSemaphoreGive(auto_poll_task_stopped);
+    vTaskSuspend(NULL);
 }
 
 // Start the background task for SLCANs auto-poll feature
 // Restict it to the APP-CPU-Core so it doesn't interfere with the bluetooth task on the Pro-CPU-Core
 static void start_auto_poll_task() {
-    xTaskCreatePinnedToCore(auto_poll_task, "SLCAN-AUTO-POLL", 8 * 1024, NULL, 16, NULL, 1);
+    xSemaphoreTake(auto_poll_task_stopped, 0);
+    xTaskCreatePinnedToCore(auto_poll_task, "SLCAN-AUTO-POLL", AUTO_POLL_TASK_STACK_SIZE, NULL, 16, &auto_poll_task_handle, 1);
+}
+
+// Stop a task of the CAN channel ('can_channel_open' must already be false)
+// The auto-poll task is woken from 'can_rx_ring_wait', the RX task notices the closed
+// channel when its 'twai_receive' times out (within CAN_RX_POLL_INTERVAL_MS).
+// Both tasks run above the SLCAN task on the same core, so once woken they stop
+// before this continues. The wake-up is repeated every tick in case the task
+// was busy (e.g. sending) and went back to waiting afterwards.
+static void join_channel_task(TaskHandle_t* const task, SemaphoreHandle_t stopped) {
+    if (*task == NULL) { return; }
+    do {
+        can_rx_ring_wake();
+    } while (xSemaphoreTake(stopped, 1) != pdTRUE);
+    vTaskDelete(*task);
+    *task = NULL;
 }
 
 // Open the CAN channel
@@ -267,9 +877,13 @@ static bool open_can_channel() {
     }
     listen_mode_only = (can_config.mode == TWAI_MODE_LISTEN_ONLY ? true : false);
     can_channel_open = true;
+    boot_timeline_mark(BOOT_EVENT_CAN_OPEN);
+
+    // start the task that fills the RX ring
+    start_can_rx_task();
 
     // start auto poll task
-    if (slcan_config.auto_poll_enabled) {
+    if (auto_poll_active()) {
         start_auto_poll_task();
     }
 
@@ -279,13 +893,17 @@ static bool open_can_channel() {
 // Close the CAN channel
 static bool close_can_channel() {
 
-    // signal to the auto-poll task
+    // signal to the auto-poll and RX task
     can_channel_open = false;
 
-    if (slcan_config.auto_poll_enabled) {
-        // Wait untill auto poll task is terminated
-        vTaskDelay(pdMS_TO_TICKS(1100));
-    }
+    // Wait untill both tasks are terminated, the auto-poll task first as it reads the RX ring
+    const int64_t close_start = esp_timer_get_time();
+    join_channel_task(&auto_poll_task_handle, auto_poll_task_stopped);
+    join_channel_task(&can_rx_task_handle, can_rx_task_stopped);
+    ESP_LOGD(SLCAN_TAG, "Channel tasks stopped after %lld us", esp_timer_get_time() - close_start);
+
+    // Cyclic frames and subscriptions belong to the open channel
+    can_bcm_reset();
 
     // stop the driver
     twai_stop();
@@ -293,6 +911,9 @@ static bool close_can_channel() {
     // uninstall the driver
     twai_driver_uninstall();
 
+    // Frames still buffered are dropped (like with the driver queue)
+    can_rx_ring_clear();
+
     return true;
 }
 
@@ -337,110 +958,26 @@ static bool slcan_process_cmd(const char* cmd) {
          */
         case 'S': {
             if (cmd_len != 3 || cmd[2] != CR) {
-                btspp_send_msg(ERROR, 1000);
+                send_msg(ERROR, 1000);
                 return false;
             }
             else if (can_channel_open) {
                 // This command is only active if the CAN channel is closed.
-                btspp_send_msg(ERROR, 1000);
+                send_msg(ERROR, 1000);
                 return false;
             }
             else {
                 const char value = cmd[1];
-                switch (value) {
-                    
-                    case '0':
-                        // maybe not supported by hardware?
-                        // timing_config = TWAI_TIMING_CONFIG_10KBITS();
-                        timing_config.brp = 400;
-                        timing_config.tseg_1 = 15;
-                        timing_config.tseg_2 = 4;
-                        timing_config.sjw = 3;
-                        timing_config.triple_sampling = false;
-                        break;
-                    
-                    case '1':
-                        // maybe not supported by hardware?
-                        // timing_config = TWAI_TIMING_CONFIG_20KBITS();
-                        timing_config.brp = 200;
-                        timing_config.tseg_1 = 15;
-                        timing_config.tseg_2 = 4;
-                        timing_config.sjw = 3;
-                        timing_config.triple_sampling = false;
-                        break;
-                    
-                    case '2':
-                        // timing_config = TWAI_TIMING_CONFIG_50KBITS();
-                        timing_config.brp = 80;
-                        timing_config.tseg_1 = 15;
-                        timing_config.tseg_2 = 4;
-                        timing_config.sjw = 3;
-                        timing_config.triple_sampling = false;
-                        break;
-                    
-                    case '3':
-                        // timing_config = TWAI_TIMING_CONFIG_100KBITS();
-                        timing_config.brp = 40;
-                        timing_config.tseg_1 = 15;
-                        timing_config.tseg_2 = 4;
-                        timing_config.sjw = 3;
-                        timing_config.triple_sampling = false;
-                        break;
-                    
-                    case '4':
-                        // timing_config = TWAI_TIMING_CONFIG_125KBITS();
-                        timing_config.brp = 32;
-                        timing_config.tseg_1 = 15;
-                        timing_config.tseg_2 = 4;
-                        timing_config.sjw = 3;
-                        timing_config.triple_sampling = false;
-                        break;
-                    
-                    case '5':
-                        // timing_config = TWAI_TIMING_CONFIG_250KBITS();
-                        timing_config.brp = 16;
-                        timing_config.tseg_1 = 15;
-                        timing_config.tseg_2 = 4;
-                        timing_config.sjw = 3;
-                        timing_config.triple_sampling = false;
-                        break;
-                    
-                    case '6':
-                        // timing_config = TWAI_TIMING_CONFIG_500KBITS();
-                        timing_config.brp = 8;
-                        timing_config.tseg_1 = 15;
-                        timing_config.tseg_2 = 4;
-                        timing_config.sjw = 3;
-                        timing_config.triple_sampling = false;
-                        break;
-                    
-                    case '7':
-                        // timing_config = TWAI_TIMING_CONFIG_800KBITS();
-                        timing_config.brp = 4;
-                        timing_config.tseg_1 = 16;
-                        timing_config.tseg_2 = 8;
-                        timing_config.sjw = 3;
-                        timing_config.triple_sampling = false;
-                        break;
-
-                    case '8':
-                        // timing_config = TWAI_TIMING_CONFIG_1MBITS();
-                        timing_config.brp = 4;
-                        timing_config.tseg_1 = 15;
-                        timing_config.tseg_2 = 4;
-                        timing_config.sjw = 3;
-                        timing_config.triple_sampling = false;
-                        break;
-
-                    default:
-                        // can_channel_initiated = false;
-                        btspp_send_msg(ERROR, 1000);
-                        return false;
+                if (value < '0' || value > '8') {
+                    // can_channel_initiated = false;
+                    send_msg(ERROR, 1000);
+                    return false;
                 }
+                timing_config = bitrate_timing_table[value - '0'];
 
                 can_channel_initiated = true;
-                save_timing_config_to_eeprom();
-                btspp_send_msg(OK, 1000);
+                mark_configs_dirty();
+                send_msg(OK, 1000);
                 return true;
             }
 
@@ -456,12 +993,158 @@ static bool slcan_process_cmd(const char* cmd) {
          * 
          * Example: s031C[CR] - Setup CAN with BTR0=0x03 & BTR1=0x1C which equals to 125Kbit.
          * 
+         * The values refer to a SJA1000 with a 16 MHz oscillator. If the prescaler doesn't fit
+         * the controller, the closest timing for the same bit-rate and sample point is used.
+         * 
          * Returns: CR (Ascii 13) for OK or BELL (Ascii 7) for ERROR.
          */
         case 's': {
-            // Not implemented
-            btspp_send_msg(ERROR, 1000);
-            return false;
+            uint32_t btr = 0;
+            if (cmd_len != 6 || cmd[5] != CR || sscanf(cmd, "s%4x", &btr) != 1) {
+                send_msg(ERROR, 1000);
+                return false;
+            }
+            else if (can_channel_open) {
+                // This command is only active if the CAN channel is closed.
+                send_msg(ERROR, 1000);
+                return false;
+            }
+            else if (!can_timing_from_btr((uint8_t) (btr >> 8), (uint8_t) btr, &timing_config)) {
+                send_msg(ERROR, 1000);
+                return false;
+            }
+            else {
+                can_channel_initiated = true;
+                mark_configs_dirty();
+                send_msg(OK, 1000);
+                return true;
+            }
+        }
+        break;
+
+        /** Ybbbbbbb[CR] or Ybbbbbbb,ppp[CR]
+         * Setup with an arbitrary CAN bit-rate (not part of the CAN232 protocol).
+         * b is the bit-rate in bit/s and p the sample point in permille (both decimal, 
+         * default sample point 875). The closest timing the controller supports is used,
+         * it must be within 1% of the bit-rate. A sample point within 2.5% is accepted
+         * in favour of more time quanta (e.g. Y1000000 gives 20 quanta at 85%).
+         * This command is only active if the CAN channel is closed.
+         * 
+         * Example 1: Y83333[CR]
+         * Setup CAN to 83.3Kbit.
+         * 
+         * Example 2: Y666666,800[CR]
+         * Setup CAN to 666Kbit with the sample point at 80%.
+         * 
+         * Returns: Y, the bit-rate and sample point of the timing and CR (Ascii 13) for OK,
+         * e.g. Y666667,800[CR], or BELL (Ascii 7) for ERROR.
+         */
+        case 'Y': {
+            // Parse bit-rate and sample point
+            uint32_t bitrate = 0;
+            uint32_t sample_point = CAN_TIMING_SAMPLE_POINT_DEFAULT;
+            uint32_t* value = &bitrate;
+            uint32_t digits = 0;
+            bool valid = (cmd_len >= 3 && cmd_len <= 14 && cmd[cmd_len-1] == CR);
+            for (uint32_t i = 1; valid && i < cmd_len - 1; ++i) {
+                if (cmd[i] == ',' && value == &bitrate && digits > 0) {
+                    value = &sample_point;
+                    sample_point = 0;
+                    digits = 0;
+                    continue;
+                }
+                valid = (cmd[i] >= '0' && cmd[i] <= '9' && digits < 7);
+                *value = *value * 10 + (cmd[i] - '0');
+                digits += 1;
+            }
+            valid = valid && (digits > 0);
+
+            twai_timing_config_t calculated = {};
+            if (!valid) {
+                send_msg(ERROR, 1000);
+                return false;
+            }
+            else if (can_channel_open) {
+                // This command is only active if the CAN channel is closed.
+                send_msg(ERROR, 1000);
+                return false;
+            }
+            else if (!can_timing_calculate(bitrate, sample_point, &calculated)) {
+                send_msg(ERROR, 1000);
+                return false;
+            }
+            else {
+                timing_config = calculated;
+                can_channel_initiated = true;
+                mark_configs_dirty();
+
+                sprintf(response_buffer, "Y%u,%u%s", can_timing_get_bitrate(&timing_config), can_timing_get_sample_point(&timing_config), OK);
+                send_msg(response_buffer, 1000);
+                return true;
+            }
+        }
+        break;
+
+        /** B[CR] or Bt[CR]
+         * Automatic bitrate detection (not part of the CAN232 protocol).
+         * Listens with the bit-rates of the S command (most common first: 500K, 250K, 125K, 1M, ...)
+         * and sets up the one that receives valid frames, like the S command would.
+         * The bus is only listened to, so wrong bit-rates don't disturb it. A bit-rate is tried
+         * for up to t milliseconds (decimal, 10 - 5000, default 100), but the detection stops
+         * as soon as a few frames are received without a bus error (well under a second on a busy bus).
+         * This command is only active if the CAN channel is closed.
+         * 
+         * Example 1: B[CR]
+         * Detect the bit-rate of the bus.
+         * 
+         * Example 2: B1000[CR]
+         * Detect the bit-rate of a bus with only a few frames per second.
+         * 
+         * Returns: B and the detected n of the S command plus CR (Ascii 13) for OK, 
+         * e.g. B6[CR] for 500Kbit, or BELL (Ascii 7) for ERROR (e.g. no frames received).
+         */
+        case 'B': {
+            // Parse the optional dwell time
+            uint32_t dwell_ms = CAN_AUTOBAUD_DWELL_DEFAULT;
+            bool valid = (cmd_len >= 2 && cmd_len <= 6 && cmd[cmd_len-1] == CR);
+            if (valid && cmd_len > 2) {
+                dwell_ms = 0;
+                for (uint32_t i = 1; valid && i < cmd_len - 1; ++i) {
+                    valid = (cmd[i] >= '0' && cmd[i] <= '9');
+                    dwell_ms = dwell_ms * 10 + (cmd[i] - '0');
+                }
+                valid = valid && (dwell_ms >= 10 && dwell_ms <= CAN_AUTOBAUD_DWELL_MAX);
+            }
+
+            if (!valid) {
+                send_msg(ERROR, 1000);
+                return false;
+            }
+            else if (can_channel_open) {
+                // This command is only active if the CAN channel is closed.
+                send_msg(ERROR, 1000);
+                return false;
+            }
+            else {
+                twai_timing_config_t candidates[sizeof(autobaud_order)];
+                for (uint32_t i = 0; i < sizeof(autobaud_order); ++i) {
+                    candidates[i] = bitrate_timing_table[autobaud_order[i]];
+                }
+
+                const int32_t detected = can_autobaud_detect(&can_config, candidates, sizeof(autobaud_order), dwell_ms, NULL);
+                if (detected < 0) {
+                    send_msg(ERROR, 1000);
+                    return false;
+                }
+
+                timing_config = candidates[detected];
+                can_channel_initiated = true;
+                mark_configs_dirty();
+
+                sprintf(response_buffer, "B%u%s", autobaud_order[detected], OK);
+                send_msg(response_buffer, 1000);
+                return true;
+            }
         }
         break;
 
@@ -476,21 +1159,21 @@ static bool slcan_process_cmd(const char* cmd) {
          */
         case 'O': {
             if (cmd_len != 2 || cmd[1] != CR) {
-                btspp_send_msg(ERROR, 1000);
+                send_msg(ERROR, 1000);
                 return false;
             }
             else if (!can_channel_initiated || can_channel_open) {
                 // This command is only active if the CAN channel is closed and
                 // has been set up prior with either the S or s command (i.e. initiated).
-                btspp_send_msg(ERROR, 1000);
+                send_msg(ERROR, 1000);
                 return false;
             }
             else {
                 // Open in normal mode
                 can_config.mode = TWAI_MODE_NORMAL;
 
-                if (open_can_channel()) { btspp_send_msg(OK, 1000); }
-                else { btspp_send_msg(ERROR, 1000); }
+                if (open_can_channel()) { send_msg(OK, 1000); }
+                else { send_msg(ERROR, 1000); }
                 return true;
             }
         }
@@ -509,21 +1192,21 @@ static bool slcan_process_cmd(const char* cmd) {
          */
         case 'L': {
             if (cmd_len != 2 || cmd[1] != CR) {
-                btspp_send_msg(ERROR, 1000);
+                send_msg(ERROR, 1000);
                 return false;
             }
             else if (!can_channel_initiated || can_channel_open) {
                 // This command is only active if the CAN channel is closed and
                 // has been set up prior with either the S or s command (i.e. initiated).
-                btspp_send_msg(ERROR, 1000);
+                send_msg(ERROR, 1000);
                 return false;
             }
             else {
                 // Open in listen only mode
                 can_config.mode = TWAI_MODE_LISTEN_ONLY;
 
-                if (open_can_channel()) { btspp_send_msg(OK, 1000); }
-                else { btspp_send_msg(ERROR, 1000); }
+                if (open_can_channel()) { send_msg(OK, 1000); }
+                else { send_msg(ERROR, 1000); }
                 return true;
             }
         }
@@ -539,17 +1222,20 @@ static bool slcan_process_cmd(const char* cmd) {
          */
         case 'C': {
             if (cmd_len != 2 || cmd[1] != CR) {
-                btspp_send_msg(ERROR, 1000);
+                send_msg(ERROR, 1000);
                 return false;
             }
             else if (!can_channel_open) {
                 // This command is only active if the CAN channel is open.
-                btspp_send_msg(ERROR, 1000);
+                send_msg(ERROR, 1000);
                 return false;
             }
             else {
-                if (close_can_channel()) { btspp_send_msg(OK, 1000); }
-                else { btspp_send_msg(ERROR, 1000); }
+                // Write pending config changes while the channel is closed
+                flush_configs_to_eeprom();
+
+                if (close_can_channel()) { send_msg(OK, 1000); }
+                else { send_msg(ERROR, 1000); }
                 return true;
             }
         }
@@ -579,12 +1265,12 @@ static bool slcan_process_cmd(const char* cmd) {
          */
         case 't': {
             if (cmd_len < 5) {
-                btspp_send_msg(ERROR, 1000);
+                send_msg(ERROR, 1000);
                 return false;
             }
             else if (!can_channel_open || listen_mode_only) {
                 // This command is only active if the CAN232 is open in normal mode.
-                btspp_send_msg(ERROR, 1000);
+                send_msg(ERROR, 1000);
                 return false;
             }
             else {
@@ -600,19 +1286,19 @@ static bool slcan_process_cmd(const char* cmd) {
 
                 // check identifier
                 if (result != 1 || identifier > 0x7FF) {
-                    btspp_send_msg(ERROR, 1000);
+                    send_msg(ERROR, 1000);
                     return false;
                 }
 
                 // check dlc 
                 if (dlc > 8) {
-                    btspp_send_msg(ERROR, 1000);
+                    send_msg(ERROR, 1000);
                     return false;   
                 }
 
                 // check cmd length
                 if (cmd_len != 6 + 2*dlc || cmd[6 + 2*dlc -1] != CR) { 
-                    btspp_send_msg(ERROR, 1000);
+                    send_msg(ERROR, 1000);
                     return false; 
                 }
 
@@ -633,7 +1319,7 @@ static bool slcan_process_cmd(const char* cmd) {
 
                     // check
                     if (result != 1) {
-                        btspp_send_msg(ERROR, 1000);
+                        send_msg(ERROR, 1000);
                         return false;
                     }
                     else {
@@ -644,16 +1330,16 @@ static bool slcan_process_cmd(const char* cmd) {
                 // Send can frame
                 esp_err_t err = twai_transmit(&message, 10);
                 if (err != ESP_OK) {
-                    btspp_send_msg(ERROR, 1000);
+                    send_msg(ERROR, 1000);
                     return false;
                 }
                 else {
                     if (slcan_config.auto_poll_enabled) {
-                        btspp_send_msg(zOK, 1000);
+                        send_msg(zOK, 1000);
                         return false;
                     }
                     else {
-                        btspp_send_msg(OK, 1000);
+                        send_msg(OK, 1000);
                         return false;
                     }
                 }
@@ -683,12 +1369,12 @@ static bool slcan_process_cmd(const char* cmd) {
          */
         case 'T': {
             if (cmd_len < 10) {
-                btspp_send_msg(ERROR, 1000);
+                send_msg(ERROR, 1000);
                 return false;
             }
             else if (!can_channel_open || listen_mode_only) {
                 // This command is only active if the CAN232 is open in normal mode.
-                btspp_send_msg(ERROR, 1000);
+                send_msg(ERROR, 1000);
                 return false;
             }
             else {
@@ -704,19 +1390,19 @@ static bool slcan_process_cmd(const char* cmd) {
 
                 // check identifier
                 if (result != 1 || identifier > 0x1FFFFFFF) {
-                    btspp_send_msg(ERROR, 1000);
+                    send_msg(ERROR, 1000);
                     return false;
                 }
 
                 // check dlc 
                 if (dlc > 8) {
-                    btspp_send_msg(ERROR, 1000);
+                    send_msg(ERROR, 1000);
                     return false;   
                 }
 
                 // check cmd length
                 if (cmd_len != 11 + 2*dlc || cmd[10 + 2*dlc] != CR) { 
-                    btspp_send_msg(ERROR, 1000);
+                    send_msg(ERROR, 1000);
                     return false; 
                 }
 
@@ -738,7 +1424,7 @@ static bool slcan_process_cmd(const char* cmd) {
 
                     // check
                     if (result != 1) {
-                        btspp_send_msg(ERROR, 1000);
+                        send_msg(ERROR, 1000);
                         return false;
                     }
                     else {
@@ -749,16 +1435,16 @@ static bool slcan_process_cmd(const char* cmd) {
                 // Send can frame
                 esp_err_t err = twai_transmit(&message, 10);
                 if (err != ESP_OK) {
-                    btspp_send_msg(ERROR, 1000);
+                    send_msg(ERROR, 1000);
                     return false;
                 }
                 else {
                     if (slcan_config.auto_poll_enabled) {
-                        btspp_send_msg(zOK, 1000);
+                        send_msg(zOK, 1000);
                         return false;
                     }
                     else {
-                        btspp_send_msg(OK, 1000);
+                        send_msg(OK, 1000);
                         return false;
                     }
                 }
@@ -785,12 +1471,12 @@ static bool slcan_process_cmd(const char* cmd) {
          */
         case 'r': {
             if (cmd_len != 6 || cmd[5] != CR) {
-                btspp_send_msg(ERROR, 1000);
+                send_msg(ERROR, 1000);
                 return false;
             }
             else if (!can_channel_open || listen_mode_only) {
                 // This command is only active if the CAN232 is open in normal mode.
-                btspp_send_msg(ERROR, 1000);
+                send_msg(ERROR, 1000);
                 return false;
             }
             else {
@@ -806,13 +1492,13 @@ static bool slcan_process_cmd(const char* cmd) {
 
                 // check identifier
                 if (result != 1 || identifier > 0x7FF) {
-                    btspp_send_msg(ERROR, 1000);
+                    send_msg(ERROR, 1000);
                     return false;
                 }
 
                 // check dlc 
                 if (dlc > 8) {
-                    btspp_send_msg(ERROR, 1000);
+                    send_msg(ERROR, 1000);
                     return false;   
                 }
 
@@ -827,16 +1513,16 @@ static bool slcan_process_cmd(const char* cmd) {
                 // Send can frame
                 esp_err_t err = twai_transmit(&message, 10);
                 if (err != ESP_OK) {
-                    btspp_send_msg(ERROR, 1000);
+                    send_msg(ERROR, 1000);
                     return false;
                 }
                 else {
                     if (slcan_config.auto_poll_enabled) {
-                        btspp_send_msg(zOK, 1000);
+                        send_msg(zOK, 1000);
                         return false;
                     }
                     else {
-                        btspp_send_msg(OK, 1000);
+                        send_msg(OK, 1000);
                         return false;
                     }
                 }
@@ -863,12 +1549,12 @@ static bool slcan_process_cmd(const char* cmd) {
          */
         case 'R': {
             if (cmd_len != 11 || cmd[10] != CR) {
-                btspp_send_msg(ERROR, 1000);
+                send_msg(ERROR, 1000);
                 return false;
             }
             else if (!can_channel_open || listen_mode_only) {
                 // This command is only active if the CAN232 is open in normal mode.
-                btspp_send_msg(ERROR, 1000);
+                send_msg(ERROR, 1000);
                 return false;
             }
             else {
@@ -884,13 +1570,13 @@ static bool slcan_process_cmd(const char* cmd) {
 
                 // check identifier
                 if (result != 1 || identifier > 0x1FFFFFFF) {
-                    btspp_send_msg(ERROR, 1000);
+                    send_msg(ERROR, 1000);
                     return false;
                 }
 
                 // check dlc 
                 if (dlc > 8) {
-                    btspp_send_msg(ERROR, 1000);
+                    send_msg(ERROR, 1000);
                     return false;   
                 }
 
@@ -905,16 +1591,16 @@ static bool slcan_process_cmd(const char* cmd) {
                 // Send can frame
                 esp_err_t err = twai_transmit(&message, 10);
                 if (err != ESP_OK) {
-                    btspp_send_msg(ERROR, 1000);
+                    send_msg(ERROR, 1000);
                     return false;
                 }
                 else {
                     if (slcan_config.auto_poll_enabled) {
-                        btspp_send_msg(zOK, 1000);
+                        send_msg(zOK, 1000);
                         return false;
                     }
                     else {
-                        btspp_send_msg(OK, 1000);
+                        send_msg(OK, 1000);
                         return false;
                     }
                 }
@@ -941,42 +1627,43 @@ static bool slcan_process_cmd(const char* cmd) {
          */
         case 'P': {
             if (cmd_len != 2 || cmd[1] != CR) {
-                btspp_send_msg(ERROR, 1000);
+                send_msg(ERROR, 1000);
                 return false;
             }
             else if (!can_channel_open || slcan_config.auto_poll_enabled) {
                 // This command is only active if the CAN channel is open.
                 // NOTE: This command is disabled in the new AUTO POLL/SEND
                 // feature from version V1220. It will then reply BELL if used.
-                btspp_send_msg(ERROR, 1000);
+                send_msg(ERROR, 1000);
                 return false;
             }
             else {
 
-                // Receive a single CAN frame from the queue
+                // Receive a single CAN frame from the RX ring
                 twai_message_t message = {};
-                const esp_err_t err = twai_receive(&message, 0);
+                int64_t timestamp_us = 0;
+                const esp_err_t err = receive_frame(&message, &timestamp_us, 0);
 
                 
                 if (err == ESP_ERR_TIMEOUT) {
                     // If there are no pending frames it returns only CR
-                    btspp_send_msg(OK, 1000);
+                    send_msg(OK, 1000);
                     return true;
                 }
                 else if (err != ESP_OK) {
-                    btspp_send_msg(ERROR, 1000);
+                    send_msg(ERROR, 1000);
                     return false;
                 }
                 else {
                     // converting CAN frame to SLCAN message
                     const int result = can2sl(
                         &message, false, 
-                        slcan_config.timestamps_enabled, esp_timer_get_time() % 60000LL, 
+                        slcan_config.timestamps_enabled, (timestamp_us / 1000) % 60000LL, 
                         response_buffer, sizeof(response_buffer)
                     );
 
                     // Sending response
-                    btspp_send_msg(response_buffer, 1000);
+                    send_msg(response_buffer, 1000);
                     ESP_LOGI(SLCAN_TAG, "Responding: (len = %d): %s", result, response_buffer);
                     return true;
                 }
@@ -1003,53 +1690,54 @@ static bool slcan_process_cmd(const char* cmd) {
          */
         case 'A': {
             if (cmd_len != 2 || cmd[1] != CR) {
-                btspp_send_msg(ERROR, 1000);
+                send_msg(ERROR, 1000);
                 return false;
             }
             else if (!can_channel_open || slcan_config.auto_poll_enabled) {
                 // This command is only active if the CAN channel is open.
                 // NOTE: This command is disabled in the new AUTO POLL/SEND
                 // feature from version V1220. It will then reply BELL if used.
-                btspp_send_msg(ERROR, 1000);
+                send_msg(ERROR, 1000);
                 return false;
             }
             else {
 
-                // Receive a single CAN frame from the queue
+                // Receive a single CAN frame from the RX ring
                 twai_message_t message = {};
+                int64_t timestamp_us = 0;
                 esp_err_t err = ESP_OK;
                 int result = 0;
 
                 do {
 
-                    // Receive a single CAN frame from the queue
-                    err = twai_receive(&message, 0);
+                    // Receive a single CAN frame from the RX ring
+                    err = receive_frame(&message, &timestamp_us, 0);
                     
                     if (err == ESP_ERR_TIMEOUT) {
                         // Stop if there are no more pending frames 
                         break;
                     }
                     else if (err != ESP_OK) {
-                        btspp_send_msg(ERROR, 1000);
+                        send_msg(ERROR, 1000);
                         return false;
                     }
                     else {
                         // converting CAN frame to SLCAN message
                         result = can2sl(
                             &message, false, 
-                            slcan_config.timestamps_enabled, esp_timer_get_time() % 60000LL, 
+                            slcan_config.timestamps_enabled, (timestamp_us / 1000) % 60000LL, 
                             response_buffer, sizeof(response_buffer)
                         );
 
                         // Sending response
-                        btspp_send_msg(response_buffer, 1000);
+                        send_msg(response_buffer, 1000);
                         ESP_LOGI(SLCAN_TAG, "Responding (len = %d): %s", result, response_buffer);
 
                     }
                 } 
                 while (err == ESP_OK);
 
-                btspp_send_msg("A"OK, 1000);
+                send_msg("A"OK, 1000);
                 return true;
             } 
         }
@@ -1081,12 +1769,12 @@ static bool slcan_process_cmd(const char* cmd) {
          */
         case 'F': {
             if (cmd_len != 2 || cmd[1] != CR) {
-                btspp_send_msg(ERROR, 1000);
+                send_msg(ERROR, 1000);
                 return false;
             }
             else if (!can_channel_open) {
                 // This command is only active if the CAN channel is open.
-                btspp_send_msg(ERROR, 1000);
+                send_msg(ERROR, 1000);
                 return false;
             }
             else {
@@ -1099,23 +1787,23 @@ static bool slcan_process_cmd(const char* cmd) {
                 err = twai_get_status_info(&status_info);
                 if (err != ESP_OK) {
                     // something went wrong
-                    btspp_send_msg(ERROR, 1000);
+                    send_msg(ERROR, 1000);
                     return false;
                 }
 
                 // Read TWAI driver alerts
                 err = twai_read_alerts(&alerts, 0);
 
-                if (err != ESP_OK || err != ESP_ERR_TIMEOUT) {
+                if (err != ESP_OK && err != ESP_ERR_TIMEOUT) {
                     // something went wrong
-                    btspp_send_msg(ERROR, 1000);
+                    send_msg(ERROR, 1000);
                     return false;
                 }
                 else {
 
                     // Status flags
                     const uint8_t status_flags = ( \
-                          0x01 * (alerts & TWAI_ALERT_RX_QUEUE_FULL ? 1 : 0) \
+                          0x01 * (alerts & TWAI_ALERT_RX_QUEUE_FULL || can_rx_ring_take_overflow() ? 1 : 0) \
                         + 0x02 * (status_info.msgs_to_tx >= CAN_TX_QUEUE_SIZE ? 1 : 0) \
                         + 0x04 * (alerts & TWAI_ALERT_ERR_ACTIVE ? 1 : 0) \
                         + 0x08 * (alerts & TWAI_ALERT_RX_FIFO_OVERRUN ? 1 : 0) \
@@ -1126,7 +1814,7 @@ static bool slcan_process_cmd(const char* cmd) {
                     );
 
                     sprintf(response_buffer, "F%02X"OK, (const uint32_t) status_flags);
-                    btspp_send_msg(response_buffer, 1000);
+                    send_msg(response_buffer, 1000);
                     return true;
                 }
             }
@@ -1154,19 +1842,153 @@ static bool slcan_process_cmd(const char* cmd) {
          */
         case 'X': {
             if (cmd_len != 3 || cmd[2] != CR || !(cmd[1] == '0' || cmd[1] == '1')) {
-                btspp_send_msg(ERROR, 1000);
+                send_msg(ERROR, 1000);
                 return false;
             }
             else if (can_channel_open) {
                 // This command is only active if the CAN channel is closed.
-                btspp_send_msg(ERROR, 1000);
+                send_msg(ERROR, 1000);
                 return false;
             }
             else {
                 slcan_config.auto_poll_enabled = (bool) (cmd[1] - '0');
-                save_slcan_config_to_eeprom();
+                mark_configs_dirty();
+
+                send_msg(OK, 1000);
+                return true;
+            }
+        }
+        break;
+
+        /** Dn[CR] or D3t[CR]
+         * Signal output setting (not part of the CAN232 protocol).
+         * Selects what the Auto Poll/Send feature sends for received frames.
+         * Signals are decoded with the signal database, which is uploaded with
+         * "START SIGNAL-UPLOAD <size>[CR]" (see 'upload_signal_database').
+         * Decoded signals are sent as: d<signal id>=<value>,<signal id>=<value>,...[CR]
+         * with the signal id as 4 hex digits.
+         * Signal statistics are sent at the end of each window, one line per signal
+         * with values in the window: a<signal id>=<count>,<min>,<max>,<mean>,<last>[CR]
+         * t is the window length in seconds (decimal, 1 - 3600, default 1),
+         * D3[CR] keeps the current window length.
+         * This command is only active if the CAN channel is closed.
+         * The value will be saved in EEPROM.
+         * 
+         * Example 1: D0[CR]
+         * Send CAN frames only (default).
+         * 
+         * Example 2: D1[CR]
+         * Send decoded signals only.
+         * 
+         * Example 3: D2[CR]
+         * Send CAN frames and decoded signals.
+         * 
+         * Example 4: D310[CR]
+         * Send only the statistics of the decoded signals every 10 seconds.
+         * 
+         * Returns: CR (Ascii 13) for OK or BELL (Ascii 7) for ERROR.
+         */
+        case 'D': {
+            // Parse the optional window length
+            uint32_t window_length = signal_window_length;
+            bool valid = (cmd_len >= 3 && cmd[cmd_len-1] == CR && cmd[1] >= '0' && cmd[1] <= '3');
+            if (valid && cmd_len > 3) {
+                valid = (cmd[1] == '3' && cmd_len <= 7);
+                window_length = 0;
+                for (uint32_t i = 2; valid && i < cmd_len - 1; ++i) {
+                    valid = (cmd[i] >= '0' && cmd[i] <= '9');
+                    window_length = window_length * 10 + (cmd[i] - '0');
+                }
+                valid = valid && (window_length >= 1 && window_length <= SIGNAL_WINDOW_MAX);
+            }
+
+            if (!valid) {
+                send_msg(ERROR, 1000);
+                return false;
+            }
+            else if (can_channel_open) {
+                // This command is only active if the CAN channel is closed.
+                send_msg(ERROR, 1000);
+                return false;
+            }
+            else {
+                signal_output_mode = (uint8_t) (cmd[1] - '0');
+                signal_window_length = (uint16_t) window_length;
+                mark_configs_dirty();
+
+                send_msg(OK, 1000);
+                return true;
+            }
+        }
+        break;
+
+        /** G0[CR], G1pppqqqiiiiiiiimmmmmmmm[CR], G2pppqqqiiiiiiiimmmmmmmmddddddddddddddddkkkkkkkkkkkkkkkk[CR] or G3pppqqqaaaaaaaa[CR]
+         * Triggered capture (not part of the CAN232 protocol).
+         * The last ppp frames are kept in RAM. When the trigger matches, qqq more
+         * frames are captured and the whole window is saved as "capture.bin"
+         * (see can_capture.h for the format). It can be fetched with "START BT-DOWNLOAD capture.bin".
+         * While the capture runs, received frames are not sent by the Auto Poll/Send feature.
+         * When the capture is complete, g<number of frames (4 hex)>[CR] is sent
+         * and the normal output continues.
+         * This command is only active if the Auto Poll/Send feature is enabled.
+         * 
+         * ppp              - Number of frames before the trigger in hex
+         * qqq              - Number of frames after the trigger in hex (ppp + 1 + qqq <= 1024)
+         * iiiiiiii         - Identifier in hex, bit 31 set for extended frames, bit 30 for RTR frames
+         * mmmmmmmm         - Identifier mask in hex, a frame matches if (frame ^ iiiiiiii) & mmmmmmmm == 0
+         * dddddddddddddddd - Data pattern in hex (first byte first)
+         * kkkkkkkkkkkkkkkk - Data mask in hex (first byte first)
+         * aaaaaaaa         - TWAI alerts in hex (see TWAI_ALERT_*), alerts are also consumed by the 'F' command
+         * 
+         * Example 1: G0[CR]
+         * Stop the capture.
+         * 
+         * Example 2: G106406400000123FFFFFFFF[CR]
+         * Capture 100 frames before and after the first standard frame with the identifier 0x123.
+         * 
+         * Example 3: G20000C8800001FFFFFFFFFF0200000000000000FF00000000000000[CR]
+         * Capture 200 frames after the first extended data frame 0x1FF with 0x02 as first data byte.
+         * 
+         * Example 4: G310010000000100[CR]
+         * Capture 256 frames before and after the first bus error (TWAI_ALERT_BUS_ERROR = 0x100).
+         * 
+         * Returns: CR (Ascii 13) for OK or BELL (Ascii 7) for ERROR.
+         */
+        case 'G': {
+            can_capture_trigger_t trigger = {};
+            uint32_t pre = 0, post = 0, data = 0, data_mask = 0;
+            bool valid = false;
+            if (cmd_len == 3 && cmd[1] == '0' && cmd[2] == CR) {
+                can_capture_disarm();
+                send_msg(OK, 1000);
+                return true;
+            }
+            else if (cmd_len == 25 && cmd[1] == '1' && cmd[24] == CR) {
+                valid = (sscanf(cmd, "G1%3x%3x%8x%8x", &pre, &post, &trigger.identifier, &trigger.identifier_mask) == 4);
+            }
+            else if (cmd_len == 57 && cmd[1] == '2' && cmd[56] == CR) {
+                valid = (sscanf(cmd, "G2%3x%3x%8x%8x", &pre, &post, &trigger.identifier, &trigger.identifier_mask) == 4);
+                valid = valid && (sscanf(cmd + 24, "%8x%8x", &data, &data_mask) == 2);
+                copy_uint32_into_buffer(data, trigger.data + 0, BIG_ENDIAN);
+                copy_uint32_into_buffer(data_mask, trigger.data_mask + 0, BIG_ENDIAN);
+                valid = valid && (sscanf(cmd + 40, "%8x%8x", &data, &data_mask) == 2);
+                copy_uint32_into_buffer(data, trigger.data + 4, BIG_ENDIAN);
+                copy_uint32_into_buffer(data_mask, trigger.data_mask + 4, BIG_ENDIAN);
+            }
+            else if (cmd_len == 17 && cmd[1] == '3' && cmd[16] == CR) {
+                valid = (sscanf(cmd, "G3%3x%3x%8x", &pre, &post, &trigger.alerts) == 3 && trigger.alerts != 0);
+            }
 
-                btspp_send_msg(OK, 1000);
+            if (!valid || !slcan_config.auto_poll_enabled) {
+                send_msg(ERROR, 1000);
+                return false;
+            }
+            else if (!can_capture_arm(pre, post, &trigger)) {
+                send_msg(ERROR, 1000);
+                return false;
+            }
+            else {
+                send_msg(OK, 1000);
                 return true;
             }
         }
@@ -1189,19 +2011,19 @@ static bool slcan_process_cmd(const char* cmd) {
          */
         case 'W': {
             if (cmd_len != 3 || cmd[2] != CR || !(cmd[1] == '0' || cmd[1] == '1')) {
-                btspp_send_msg(ERROR, 1000);
+                send_msg(ERROR, 1000);
                 return false;
             }
             else if (!can_channel_initiated || can_channel_open) {
                 // Command can only be sent if CAN232 is initiated but not open.
-                btspp_send_msg(ERROR, 1000);
+                send_msg(ERROR, 1000);
                 return false;
             }
             else {
                 filter_config.single_filter = (bool) (cmd[1] - '0');
-                save_filter_config_to_eeprom();
+                mark_configs_dirty();
 
-                btspp_send_msg(OK, 1000);
+                send_msg(OK, 1000);
                 return true;
             }
         }
@@ -1223,12 +2045,12 @@ static bool slcan_process_cmd(const char* cmd) {
          */
         case 'M': {
             if (cmd_len != 10 || cmd[9] != CR) {
-                btspp_send_msg(ERROR, 1000);
+                send_msg(ERROR, 1000);
                 return false;
             }
             else if (!can_channel_initiated || can_channel_open) {
                 // Command can only be sent if CAN232 is initiated but not open.
-                btspp_send_msg(ERROR, 1000);
+                send_msg(ERROR, 1000);
                 return false;
             }
             else {
@@ -1237,7 +2059,7 @@ static bool slcan_process_cmd(const char* cmd) {
                 uint32_t acceptance_code = 0;
                 int result = sscanf(cmd, "M%08x"OK, &acceptance_code);
                 if (result != 1) {
-                    btspp_send_msg(ERROR, 1000);
+                    send_msg(ERROR, 1000);
                     return false; 
                 }
 
@@ -1246,8 +2068,8 @@ static bool slcan_process_cmd(const char* cmd) {
                 acceptance_code = parse_uint32((uint8_t*) &acceptance_code, BIG_ENDIAN);
                 
                 filter_config.acceptance_code = acceptance_code;
-                save_filter_config_to_eeprom();
-                btspp_send_msg(OK, 1000);
+                mark_configs_dirty();
+                send_msg(OK, 1000);
                 return true;
             }
         }
@@ -1268,12 +2090,12 @@ static bool slcan_process_cmd(const char* cmd) {
          */
         case 'm': {
             if (cmd_len != 10 || cmd[9] != CR) {
-                btspp_send_msg(ERROR, 1000);
+                send_msg(ERROR, 1000);
                 return false;
             }
             else if (!can_channel_initiated || can_channel_open) {
                 // Command can only be sent if CAN232 is initiated but not open.
-                btspp_send_msg(ERROR, 1000);
+                send_msg(ERROR, 1000);
                 return false;
             }
             else {
@@ -1282,7 +2104,7 @@ static bool slcan_process_cmd(const char* cmd) {
                 uint32_t acceptance_mask = 0;
                 int result = sscanf(cmd, "m%08x"OK, &acceptance_mask);
                 if (result != 1) {
-                    btspp_send_msg(ERROR, 1000);
+                    send_msg(ERROR, 1000);
                     return false; 
                 }
 
@@ -1291,8 +2113,8 @@ static bool slcan_process_cmd(const char* cmd) {
                 acceptance_mask = parse_uint32((uint8_t*) &acceptance_mask, BIG_ENDIAN);
                 
                 filter_config.acceptance_mask = acceptance_mask;
-                save_filter_config_to_eeprom();
-                btspp_send_msg(OK, 1000);
+                mark_configs_dirty();
+                send_msg(OK, 1000);
                 return true;
             }
         }
@@ -1311,11 +2133,40 @@ static bool slcan_process_cmd(const char* cmd) {
          */
         case 'V': {
             if (cmd_len != 2 || cmd[1] != CR) {
-                btspp_send_msg(ERROR, 1000);
+                send_msg(ERROR, 1000);
                 return false;
             }
             else {
-                btspp_send_msg("V01D0"OK, 1000);
+                send_msg("V01D0"OK, 1000);
+                return true;
+            }
+        }
+        break;
+
+        /** I[CR]
+         * Diagnostics (not part of the CAN232 protocol).
+         * Shows how much of the task stacks, the heap and the receive buffers has been used.
+         * This command is active always.
+         * 
+         * Example: I[CR]
+         * Get the diagnostics report
+         * 
+         * Returns: One line per value, then I and CR (Ascii 13) for OK:
+         * is<task>=<stack bytes never used>[CR] for each running project (and bluetooth) task
+         * ih<capability>=<free bytes>,<minimum free bytes since startup>,<largest free block>[CR] 
+         * for the heap capabilities INTERNAL, 8BIT, 32BIT and DMA
+         * irCAN-RX=<most frames buffered>,<ring size>,<frames dropped>[CR] for the RX ring
+         * irSPP-RX=<most bytes buffered>,<buffer size>[CR] for the SPP receive buffer
+         * E.g. isSLCAN-TASK=2410[CR]ihINTERNAL=81240,60112,65536[CR]...I[CR]
+         */
+        case 'I': {
+            if (cmd_len != 2 || cmd[1] != CR) {
+                send_msg(ERROR, 1000);
+                return false;
+            }
+            else {
+                send_diagnostics();
+                send_msg("I"OK, 1000);
                 return true;
             }
         }
@@ -1339,11 +2190,11 @@ static bool slcan_process_cmd(const char* cmd) {
          */
         case 'N': {
             if (cmd_len != 2 || cmd[1] != CR) {
-                btspp_send_msg(ERROR, 1000);
+                send_msg(ERROR, 1000);
                 return false;
             }
             else {
-                btspp_send_msg("N1118"OK, 1000);
+                send_msg("N1118"OK, 1000);
                 return true;
             }
         }
@@ -1383,19 +2234,19 @@ static bool slcan_process_cmd(const char* cmd) {
          */
         case 'Z': {
             if (cmd_len != 3 || cmd[2] != CR || !(cmd[1] == '0' || cmd[1] == '1')) {
-                btspp_send_msg(ERROR, 1000);
+                send_msg(ERROR, 1000);
                 return false;
             }
             else if (can_channel_open) {
                 // This command is only active if the CAN channel is closed.
-                btspp_send_msg(ERROR, 1000);
+                send_msg(ERROR, 1000);
                 return false;
             }
             else {
                 slcan_config.timestamps_enabled = (bool) (cmd[1] - '0');
-                save_slcan_config_to_eeprom();
+                mark_configs_dirty();
 
-                btspp_send_msg(OK, 1000);
+                send_msg(OK, 1000);
                 return true;
             }
         }
@@ -1430,12 +2281,12 @@ static bool slcan_process_cmd(const char* cmd) {
          */
         case 'Q': {
             if (cmd_len != 3 || cmd[2] != CR || !(cmd[1] == '0' || cmd[1] == '1' || cmd[1] == '2')) {
-                btspp_send_msg(ERROR, 1000);
+                send_msg(ERROR, 1000);
                 return false;
             }
             else if (!can_channel_open) {
                 // This command is only active if the CAN channel is closed.
-                btspp_send_msg(ERROR, 1000);
+                send_msg(ERROR, 1000);
                 return false;
             }
             else {
@@ -1453,12 +2304,49 @@ static bool slcan_process_cmd(const char* cmd) {
                         slcan_config.startup_in_listen_mode = true;
                         break;
                     default:
-                        btspp_send_msg(ERROR, 1000);
+                        send_msg(ERROR, 1000);
                         return false;
                 }
                 
-                save_slcan_config_to_eeprom();
-                btspp_send_msg(OK, 1000);
+                // Auto startup must survive a power cycle right after this command
+                mark_configs_dirty();
+                flush_configs_to_eeprom();
+                send_msg(OK, 1000);
+                return true;
+            }
+        }
+        break;
+
+        /** Kn[CR]
+         * Protocol selection (not part of the CAN232 protocol).
+         * The setting is saved in EEPROM.
+         * This command is only active if the CAN channel is closed.
+         * 
+         * Example 1: K0[CR]
+         * Speak SLCAN (default).
+         * 
+         * Example 2: K1[CR]
+         * Speak the socketcand protocol (rawmode and bcmmode) from the next message on.
+         * The device greets new clients with "< hi >", "< slcan >" switches back to SLCAN.
+         * 
+         * Returns: CR (Ascii 13) for OK or BELL (Ascii 7) for ERROR.
+         */
+        case 'K': {
+            if (cmd_len != 3 || cmd[2] != CR || !(cmd[1] == '0' || cmd[1] == '1')) {
+                send_msg(ERROR, 1000);
+                return false;
+            }
+            else if (can_channel_open) {
+                // This command is only active if the CAN channel is closed.
+                send_msg(ERROR, 1000);
+                return false;
+            }
+            else {
+                protocol = (uint8_t) (cmd[1] - '0');
+                socketcand_mode = SOCKETCAND_NO_BUS;
+                mark_configs_dirty();
+
+                send_msg(OK, 1000);
                 return true;
             }
         }
@@ -1466,7 +2354,7 @@ static bool slcan_process_cmd(const char* cmd) {
 
         // switch default
         default: {
-            btspp_send_msg(ERROR, 1000);
+            send_msg(ERROR, 1000);
             return false;
         }
         break;
@@ -1477,6 +2365,299 @@ static bool slcan_process_cmd(const char* cmd) {
 
 
 
+// Split a socketcand message into its elements, returns the number of elements
+// The message must look like "< element element ... >", the brackets are not returned
+static uint32_t split_socketcand_message(char* const msg, char** elements, const uint32_t max_elements) {
+    char* saveptr = NULL;
+    uint32_t count = 0;
+    const char* first = strtok_r(msg, " \t\r\n", &saveptr);
+    if (first == NULL || strcmp(first, "<") != 0) { return 0; }
+    for (char* element = strtok_r(NULL, " \t\r\n", &saveptr); element != NULL; element = strtok_r(NULL, " \t\r\n", &saveptr)) {
+        if (count == max_elements) { return 0; }
+        elements[count++] = element;
+    }
+    if (count == 0 || strcmp(elements[count-1], ">") != 0) { return 0; }
+    return count - 1;
+}
+
+// Parse a number element
+static bool parse_socketcand_number(const char* const element, const int base, uint32_t* const value) {
+    char* end = NULL;
+    *value = strtoul(element, &end, base);
+    return (end != element && *end == '\0');
+}
+
+// Parse an identifier element (3 digits or less for standard, 8 digits for extended frames)
+static bool parse_socketcand_identifier(const char* const element, twai_message_t* const message) {
+    const uint32_t len = strlen(element);
+    uint32_t identifier = 0;
+    if (!parse_socketcand_number(element, 16, &identifier)) { return false; }
+    message->extd = (len == 8);
+    message->identifier = identifier;
+    return (len <= 3 && identifier <= 0x7FF) || (len == 8 && identifier <= 0x1FFFFFFF);
+}
+
+// Parse the elements "<identifier> <dlc> <data bytes>" of a frame
+static bool parse_socketcand_frame(char** elements, const uint32_t count, twai_message_t* const message) {
+    uint32_t dlc = 0;
+    if (count < 2 || !parse_socketcand_identifier(elements[0], message) || !parse_socketcand_number(elements[1], 16, &dlc)) { return false; }
+    if (dlc > 8 || count != 2 + dlc) { return false; }
+    message->data_length_code = dlc;
+    for (uint32_t i = 0; i < dlc; ++i) {
+        uint32_t value = 0;
+        if (!parse_socketcand_number(elements[2 + i], 16, &value) || value > 0xFF) { return false; }
+        message->data[i] = value;
+    }
+    return true;
+}
+
+// Parse the elements "<seconds> <microseconds>" of an interval
+static bool parse_socketcand_interval(char** elements, uint64_t* const interval_us) {
+    uint32_t seconds = 0, microseconds = 0;
+    if (!parse_socketcand_number(elements[0], 10, &seconds) || !parse_socketcand_number(elements[1], 10, &microseconds)) { return false; }
+    *interval_us = seconds * 1000000ULL + microseconds;
+    return true;
+}
+
+// Forget the state of a socketcand client
+static void socketcand_reset() {
+    socketcand_mode = SOCKETCAND_NO_BUS;
+    can_bcm_reset();
+}
+
+/**
+ * @brief Process a received socketcand message (see 'K' command)
+ * Compatible with the rawmode and bcmmode of socketcand, the device has a single bus.
+ * Cyclic frames and content filters are handled on the device (see can_bcm.h).
+ * Timestamps of received frames are seconds since startup.
+ * 
+ * < open <bus> >                                       Open the CAN channel, switches to bcmmode. Returns < ok >
+ * < rawmode >                                          Forward all received frames. Returns < ok >
+ * < bcmmode >                                          Only forward subscribed frames. Returns < ok >
+ * < echo >                                             Returns < echo >
+ * < send <id> <dlc> <data bytes> >                     Send a frame (rawmode and bcmmode)
+ * < add <sec> <usec> <id> <dlc> <data bytes> >         Send a frame cyclically (bcmmode)
+ * < update <id> <dlc> <data bytes> >                   Change the data of a cyclic frame (bcmmode)
+ * < delete <id> >                                      Stop a cyclic frame (bcmmode)
+ * < subscribe <sec> <usec> <id> >                      Forward a frame, at most once per interval (bcmmode)
+ * < filter <sec> <usec> <id> <dlc> <mask bytes> >      Forward a frame if the masked data changed (bcmmode)
+ * < unsubscribe <id> >                                 Stop forwarding a frame (bcmmode)
+ * < slcan >                                            Close the CAN channel and switch back to SLCAN (not part of socketcand). Returns < ok >
+ * 
+ * Identifiers with 8 hex digits are extended, all others standard.
+ * Received frames: < frame <id> <sec>.<usec> <data bytes> >
+ * Errors: < error <reason> >
+ * 
+ * @param cmd socketcand message
+ * @return true Success
+ * @return false Error
+ */
+static bool socketcand_process_cmd(const char* cmd) {
+
+    // Its better to check
+    if (cmd == NULL) { return false; }
+    ESP_LOGI(SLCAN_TAG, "Processing: %s", cmd);
+
+    // Split the message
+    char buffer[128];
+    strncpy(buffer, cmd, sizeof(buffer) - 1);
+    buffer[sizeof(buffer) - 1] = '\0';
+    char* elements[20];
+    const uint32_t count = split_socketcand_message(buffer, elements, 20);
+    if (count == 0) {
+        send_msg("< error malformed message >", 1000);
+        return false;
+    }
+    const char* const command = elements[0];
+    char** const args = elements + 1;
+    const uint32_t arg_count = count - 1;
+
+    twai_message_t message = {};
+    uint64_t interval_us = 0;
+
+    // Commands without a bus
+    if (strcmp(command, "echo") == 0 && arg_count == 0) {
+        send_msg("< echo >", 1000);
+        return true;
+    }
+    else if (strcmp(command, "open") == 0 && arg_count == 1) {
+        if (socketcand_mode != SOCKETCAND_NO_BUS) {
+            send_msg("< error bus already open >", 1000);
+            return false;
+        }
+        if (!can_channel_open) {
+            can_config.mode = TWAI_MODE_NORMAL;
+            if (!open_can_channel()) {
+                send_msg("< error could not open bus >", 1000);
+                return false;
+            }
+        }
+        ESP_LOGI(SLCAN_TAG, "socketcand: Bus %s opened", args[0]);
+        socketcand_mode = SOCKETCAND_BCM;
+        send_msg("< ok >", 1000);
+        return true;
+    }
+    else if (strcmp(command, "slcan") == 0 && arg_count == 0) {
+        socketcand_reset();
+        if (can_channel_open) { close_can_channel(); }
+        protocol = PROTOCOL_SLCAN;
+        mark_configs_dirty();
+        send_msg("< ok >", 1000);
+        return true;
+    }
+    else if (socketcand_mode == SOCKETCAND_NO_BUS) {
+        send_msg("< error no bus open >", 1000);
+        return false;
+    }
+
+    // Commands in rawmode and bcmmode
+    if (strcmp(command, "rawmode") == 0 && arg_count == 0) {
+        socketcand_mode = SOCKETCAND_RAW;
+        send_msg("< ok >", 1000);
+        return true;
+    }
+    else if (strcmp(command, "bcmmode") == 0 && arg_count == 0) {
+        socketcand_mode = SOCKETCAND_BCM;
+        send_msg("< ok >", 1000);
+        return true;
+    }
+    else if (strcmp(command, "send") == 0) {
+        if (!parse_socketcand_frame(args, arg_count, &message)) {
+            send_msg("< error invalid frame >", 1000);
+            return false;
+        }
+        if (listen_mode_only || twai_transmit(&message, 10) != ESP_OK) {
+            send_msg("< error could not send frame >", 1000);
+            return false;
+        }
+        return true;
+    }
+    else if (socketcand_mode != SOCKETCAND_BCM) {
+        send_msg("< error unknown command >", 1000);
+        return false;
+    }
+
+    // Commands in bcmmode
+    bool valid = false;
+    bool success = false;
+    if (strcmp(command, "add") == 0) {
+        valid = (arg_count >= 4 && parse_socketcand_interval(args, &interval_us) && parse_socketcand_frame(args + 2, arg_count - 2, &message));
+        success = valid && !listen_mode_only && can_bcm_add_tx_job(interval_us, &message);
+    }
+    else if (strcmp(command, "update") == 0) {
+        valid = parse_socketcand_frame(args, arg_count, &message);
+        success = valid && can_bcm_update_tx_job(&message);
+    }
+    else if (strcmp(command, "delete") == 0) {
+        valid = (arg_count == 1 && parse_socketcand_identifier(args[0], &message));
+        success = valid && can_bcm_delete_tx_job(message.identifier, message.extd);
+    }
+    else if (strcmp(command, "subscribe") == 0) {
+        valid = (arg_count == 3 && parse_socketcand_interval(args, &interval_us) && parse_socketcand_identifier(args[2], &message));
+        success = valid && can_bcm_add_rx_filter(interval_us, message.identifier, message.extd, NULL);
+    }
+    else if (strcmp(command, "filter") == 0) {
+        // The data bytes are the content mask (missing bytes are not checked)
+        valid = (arg_count >= 4 && parse_socketcand_interval(args, &interval_us) && parse_socketcand_frame(args + 2, arg_count - 2, &message));
+        success = valid && can_bcm_add_rx_filter(interval_us, message.identifier, message.extd, message.data);
+    }
+    else if (strcmp(command, "unsubscribe") == 0) {
+        valid = (arg_count == 1 && parse_socketcand_identifier(args[0], &message));
+        success = valid && can_bcm_delete_rx_filter(message.identifier, message.extd);
+    }
+    else {
+        send_msg("< error unknown command >", 1000);
+        return false;
+    }
+
+    if (!valid) {
+        send_msg("< error invalid arguments >", 1000);
+    }
+    else if (!success) {
+        send_msg("< error command failed >", 1000);
+    }
+    return success;
+}
+
+
+
+// Receive a new signal database and save it in EEPROM
+// Protocol (after the host sent "START SIGNAL-UPLOAD <size>[CR]"):
+// 1. Device: "READY\r\n"
+// 2. Host: <size> bytes signal database (see can_signals.h), size 0 removes all signals
+// 3. Device: "OK!\r\n" if the database is valid, "ABORT!\r\n" otherwise
+// Only possible while the CAN channel is closed.
+static bool upload_signal_database(const char* size_str) {
+    uint32_t size = 0;
+    if (can_channel_open || sscanf(size_str, "%u", &size) != 1 || size > CAN_SIGNALS_MAX_DATABASE_SIZE) {
+        send_msg("ABORT!\r\n", 1000);
+        return false;
+    }
+    if (size == 0) {
+        can_signals_clear_database();
+        remove_file_from_filesystem(SIGNALS_FILENAME);
+        send_msg("OK!\r\n", 1000);
+        return true;
+    }
+
+    uint8_t* database = malloc(size);
+    if (database == NULL) {
+        send_msg("ABORT!\r\n", 1000);
+        return false;
+    }
+    send_msg("READY\r\n", 1000);
+
+    uint32_t total_bytes_read = 0;
+    while (total_bytes_read < size) {
+        const int bytes_read = transport->recv(database + total_bytes_read, size - total_bytes_read, 5000);
+        if (bytes_read <= 0) { break; }
+        total_bytes_read += bytes_read;
+    }
+
+    const bool success = (total_bytes_read == size && can_signals_load_database(database, size) && write_data_to_storage(SIGNALS_FILENAME, database, size));
+    free(database);
+    send_msg((success ? "OK!\r\n" : "ABORT!\r\n"), 1000);
+    return success;
+}
+
+// Restore the signal database from EEPROM
+static void restore_signal_database() {
+    uint8_t* database = malloc(CAN_SIGNALS_MAX_DATABASE_SIZE);
+    if (database == NULL) { return; }
+    const int size = read_available_data_from_storage(SIGNALS_FILENAME, database, CAN_SIGNALS_MAX_DATABASE_SIZE);
+    if (size > 0 && !can_signals_load_database(database, size)) {
+        ESP_LOGE(SLCAN_TAG, "Invalid signal database");
+    }
+    free(database);
+}
+
+// Run the bluetooth OTA update or file download if 'request' is the command for it
+// (they use the SPP functions directly), returns false for other messages
+static bool process_btspp_transfer_cmd(char* const request, const int data_len) {
+
+    // Check if the message is the command for starting 
+    // the bluetooth OTA update process
+    if ((strncmp(request, "START BT-OTA\r", 13) == 0) && (strlen(request) == 13)) {
+        flush_configs_to_eeprom(); // The update ends with a restart
+        btspp_do_ota_update();
+    }
+    // Same for the windowed OTA update process
+    else if (strcmp(request, BTSPP_OTA_WINDOWED_START_CMD) == 0) {
+        flush_configs_to_eeprom(); // The update ends with a restart
+        btspp_do_windowed_ota_update();
+    }
+    // Check if the message is the command for starting
+    // the bluetooth file download (e.g. of a capture log)
+    else if ((strncmp(request, "START BT-DOWNLOAD ", 18) == 0) && (request[data_len-1] == CR)) {
+        request[data_len-1] = '\0'; // strip CR
+        btspp_do_file_download(request + 18);
+    }
+    else {
+        return false;
+    }
+    return true;
+}
+
 // The task for receiving and processing SLCAN messages
 static void slcan_task(void* args) {
 
@@ -1484,24 +2665,62 @@ static void slcan_task(void* args) {
 
     char request[128] = "";
     int data_len = 0;
+    bool socketcand_connected = false;
 
     while (true) {
 
-        // Wait for a message via bluetooth SPP
-        data_len = btspp_recv_msg(request, sizeof(request), OK, 1000, 0);
+        // socketcand mode: greet a new client, forget the state of a client that left
+        if (protocol == PROTOCOL_SOCKETCAND) {
+            const bool connected = transport->is_connected();
+            if (connected && !socketcand_connected) {
+                broadcast_msg("< hi >", 1000);
+                transport->flush(0);
+            }
+            else if (!connected && socketcand_connected) {
+                socketcand_reset();
+            }
+            socketcand_connected = connected;
+
+            // Messages end with '>' (polled more often, so the greeting isn't late)
+            data_len = transport_recv_msg(transport, request, sizeof(request), ">", 100, 1000);
+            if (data_len > 0) {
+                socketcand_process_cmd(request);
+                transport->flush(0);
+            }
+            continue;
+        }
+        socketcand_connected = false;
+
+        // Wait for a message via the transport
+        // (a command split over several packets is waited for up to 1s)
+        data_len = transport_recv_msg(transport, request, sizeof(request), OK, 1000, 1000);
 
         if (data_len > 0) {
             ESP_LOGV(SLCAN_TAG, "Checking for BT-OTA cmd...");
+
+            // The bluetooth OTA update and file download use the SPP functions directly
+            const bool via_btspp = (transport == &btspp_transport);
+
+            // Transfers span several messages, the requesting client has the link to itself until they end
+            // (so the other clients neither get the transfer data nor mix their commands into it)
+            const bool transfer = (strncmp(request, "START BT-", 9) == 0 || strncmp(request, "START SIGNAL-UPLOAD ", 20) == 0);
+            if (transfer) { transport_set_exclusive(transport, true); }
             
-            // Check if the message is the command for starting 
-            // the bluetooth OTA update process
-            if ((strncmp(request, "START BT-OTA\r", 13) == 0) && (strlen(request) == 13)) {
-                btspp_do_ota_update();
+            // The bluetooth OTA update and file download
+            if (via_btspp && process_btspp_transfer_cmd(request, data_len)) {}
+            // Check if the message is the command for uploading a signal database
+            else if ((strncmp(request, "START SIGNAL-UPLOAD ", 20) == 0) && (request[data_len-1] == CR)) {
+                request[data_len-1] = '\0'; // strip CR
+                upload_signal_database(request + 20);
             }
             // Process the message as a SLCAN command
             else {
                 slcan_process_cmd(request);
             }
+            if (transfer) { transport_set_exclusive(transport, false); }
+
+            // Hand the responses to the link
+            transport->flush(0);
         }
     }
 
@@ -1512,17 +2731,53 @@ static void slcan_task(void* args) {
 // Start the task for receiving and processing SLCAN messages
 // Restict it to the APP-CPU-Core so it doesn't interfere with the bluetooth task on the Pro-CPU-Core
 static void start_slcan_task() {
-    xTaskCreatePinnedToCore(slcan_task, "SLCAN-TASK", 8 * 1024, NULL, 15, NULL, 1);
+    xTaskCreatePinnedToCore(slcan_task, "SLCAN-TASK", SLCAN_TASK_STACK_SIZE, NULL, 15, NULL, 1);
+}
+
+// The task for the bluetooth OTA update and file download while SLCAN runs over another transport
+// (e.g. TCP), so a firmware update stays possible via SPP. Other commands are answered with ERROR.
+static void spp_transfer_task(void* args) {
+
+    ESP_LOGI(SLCAN_TAG, "Starting SPP Transfer Task");
+
+    char request[128] = "";
+    while (true) {
+        const int data_len = transport_recv_msg(&btspp_transport, request, sizeof(request), OK, 1000, 1000);
+        if (data_len <= 0) { continue; }
+
+        btspp_set_exclusive(true);
+        if (!process_btspp_transfer_cmd(request, data_len)) {
+            transport_send_reply(&btspp_transport, ERROR, 1000);
+        }
+        btspp_set_exclusive(false);
+        btspp_transport.flush(0);
+    }
+}
+
+// Start the task above if SLCAN doesn't run over SPP
+static void start_spp_transfer_task() {
+    if (transport == &btspp_transport) { return; }
+    xTaskCreatePinnedToCore(spp_transfer_task, "SPP-TRANSFER", SLCAN_TASK_STACK_SIZE, NULL, 15, NULL, 1);
 }
 
 
 // Initilize SLCAN (Restore configs from EEPROM and auto-startup)
+// Runs before bluetooth is initialized, so the first frames after power-on are not lost
 bool slcan_init() {
 
     // Restore configs
-    restore_timing_config_from_eeprom();
-    restore_filter_config_from_eeprom();
-    restore_slcan_config_from_eeprom();
+    restore_configs_from_eeprom();
+    restore_signal_database();
+    can_capture_init();
+    can_bcm_init();
+    can_rx_ring_init();
+    can_rx_task_stopped = xSemaphoreCreateBinary();
+    auto_poll_task_stopped = xSemaphoreCreateBinary();
+    log_rx_memory_report();
+    boot_timeline_mark(BOOT_EVENT_CONFIG_RESTORED);
+
+    // Start the task for saving changed configs
+    start_config_persist_task();
 
     // Do auto-startup if enabled
     if (slcan_config.auto_startup_enabled) {
@@ -1542,8 +2797,25 @@ bool slcan_init() {
         open_can_channel();
     }
 
+    return true;
+}
+
+// Start processing SLCAN commands
+bool slcan_set_transport(const transport_t* const new_transport) {
+    if (new_transport == NULL || slcan_started) { return false; }
+    transport = new_transport;
+    ESP_LOGI(SLCAN_TAG, "Transport: %s", transport->name);
+    return true;
+}
+
+bool slcan_start() {
+    slcan_started = true;
+
     // Start the task for receiving and processing SLCAN messages
     start_slcan_task();
 
+    // Keep the bluetooth OTA update and file download available with another transport
+    start_spp_transfer_task();
+
     return true;
 }
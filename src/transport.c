@@ -0,0 +1,55 @@
+#include "transport.h"
+
+// Some standard header
+#include <string.h> // strlen, strncmp
+
+
+
+// Send a string
+bool transport_send_msg(const transport_t* const transport, const char* const msg, const uint32_t timeout_ms) {
+    return transport->send((const uint8_t*) msg, strlen(msg), timeout_ms);
+}
+
+// Send a string to the client that sent the data read last
+bool transport_send_reply(const transport_t* const transport, const char* const msg, const uint32_t timeout_ms) {
+    if (transport->reply == NULL) { return transport_send_msg(transport, msg, timeout_ms); }
+    return transport->reply((const uint8_t*) msg, strlen(msg), timeout_ms);
+}
+
+// Give the client that sent the data read last the link to itself or share it again
+void transport_set_exclusive(const transport_t* const transport, const bool exclusive) {
+    if (transport->set_exclusive != NULL) { transport->set_exclusive(exclusive); }
+}
+
+
+// Read single characters until a delimiter string is detected
+int transport_recv_msg(const transport_t* const transport, char* msg, const uint32_t bufsize, const char* delimiter, const uint32_t timeout_ms, const uint32_t delay_ms) {
+
+    // Its better to check
+    if (msg == NULL || delimiter == NULL || bufsize == 0) { return -1; }
+
+    int total_bytes_read = 0; // Keep track of how many bytes have been read
+    int free_buffer_space = bufsize - 1; // Save one space for the '\0'
+    const int delimiter_len = strlen(delimiter);
+
+    while (free_buffer_space > 0) {
+
+        // Wait longer for the first character, shorter for the next characters
+        const uint32_t time_to_wait_ms = (total_bytes_read > 0 ? delay_ms : timeout_ms);
+        if (transport->recv((uint8_t*) msg + total_bytes_read, 1, time_to_wait_ms) != 1) { break; }
+        total_bytes_read += 1;
+        free_buffer_space -= 1;
+
+        // check if the end of the message contains the delimiter
+        if (total_bytes_read >= delimiter_len && strncmp(msg + total_bytes_read - delimiter_len, delimiter, delimiter_len) == 0) {
+            msg[total_bytes_read] = '\0';
+            return total_bytes_read;
+        }
+    }
+
+    // We get here if the buffer is full or a timeout occured
+    msg[total_bytes_read] = '\0';
+    if (free_buffer_space == 0) { return -4; } // buffer full
+    else if (total_bytes_read == 0) { return -2; } // timeout on first character
+    else { return -3; } // timeout on intermediate character
+}
@@ -0,0 +1,97 @@
+#include "transport_loopback.h"
+
+// Some standard header
+#include <string.h> // memcpy
+
+// FreeRTOS
+#include "freertos/FreeRTOS.h"
+#include "freertos/ringbuf.h"
+
+
+
+// Ringbuffers for both directions
+static RingbufHandle_t to_engine = NULL; // Host -> SLCAN engine
+static RingbufHandle_t from_engine = NULL; // SLCAN engine -> host
+static bool connected = false;
+
+
+
+// Read up to 'bufsize' bytes from a ringbuffer
+static int read_from_ringbuffer(RingbufHandle_t ringbuf, uint8_t* data, const uint32_t bufsize, const uint32_t timeout_ms) {
+    if (ringbuf == NULL || data == NULL) { return -1; }
+
+    size_t item_size = 0;
+    uint8_t* item = xRingbufferReceiveUpTo(
+        ringbuf, &item_size,
+        (timeout_ms == portMAX_DELAY ? portMAX_DELAY : pdMS_TO_TICKS(timeout_ms)),
+        bufsize
+    );
+    if (item == NULL) { return -2; } // Timeout
+
+    memcpy(data, item, item_size);
+    vRingbufferReturnItem(ringbuf, item);
+    return item_size;
+}
+
+// Write data into a ringbuffer
+static bool write_to_ringbuffer(RingbufHandle_t ringbuf, const uint8_t* const data, const uint32_t len, const uint32_t timeout_ms) {
+    if (ringbuf == NULL) { return false; }
+    return (xRingbufferSend(
+        ringbuf, data, len,
+        (timeout_ms == portMAX_DELAY ? portMAX_DELAY : pdMS_TO_TICKS(timeout_ms))
+    ) == pdTRUE);
+}
+
+
+
+// Transport interface
+static bool loopback_send(const uint8_t* const data, const uint32_t len, const uint32_t timeout_ms) {
+    return connected && write_to_ringbuffer(from_engine, data, len, timeout_ms);
+}
+
+static int loopback_recv(uint8_t* data, const uint32_t bufsize, const uint32_t timeout_ms) {
+    return read_from_ringbuffer(to_engine, data, bufsize, timeout_ms);
+}
+
+static bool loopback_flush(const uint32_t timeout_ms) {
+    // Sent data is in the ringbuffer right away
+    (void) timeout_ms;
+    return true;
+}
+
+static bool loopback_is_connected() {
+    return connected;
+}
+
+const transport_t loopback_transport = {
+    .name = "LOOPBACK",
+    .send = loopback_send,
+    .recv = loopback_recv,
+    .flush = loopback_flush,
+    .is_connected = loopback_is_connected
+};
+
+
+
+// Create the buffers for both directions
+bool loopback_transport_init(const uint32_t bufsize) {
+    if (to_engine == NULL) { to_engine = xRingbufferCreate(bufsize, RINGBUF_TYPE_BYTEBUF); }
+    if (from_engine == NULL) { from_engine = xRingbufferCreate(bufsize, RINGBUF_TYPE_BYTEBUF); }
+    connected = (to_engine != NULL && from_engine != NULL);
+    return connected;
+}
+
+// Host side: send data to the SLCAN engine
+bool loopback_transport_write(const uint8_t* const data, const uint32_t len, const uint32_t timeout_ms) {
+    return write_to_ringbuffer(to_engine, data, len, timeout_ms);
+}
+
+// Host side: read data sent by the SLCAN engine
+int loopback_transport_read(uint8_t* data, const uint32_t bufsize, const uint32_t timeout_ms) {
+    return read_from_ringbuffer(from_engine, data, bufsize, timeout_ms);
+}
+
+// Host side: connect or disconnect
+void loopback_transport_set_connected(const bool is_connected) {
+    connected = is_connected && (to_engine != NULL && from_engine != NULL);
+}
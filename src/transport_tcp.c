@@ -0,0 +1,435 @@
+#include "transport_tcp.h"
+
+// Some standard header
+#include <string.h> // memcpy, memmove
+#include <errno.h>
+#include <time.h> // clock_gettime
+#include <pthread.h>
+#include <unistd.h> // close
+#include <fcntl.h>
+
+// BSD sockets (lwIP on the ESP32)
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h> // TCP_NODELAY
+
+// Header for debug messages
+#ifdef ESP_PLATFORM
+#include "esp_log.h"
+#else
+#include <stdio.h>
+#define ESP_LOGI(tag, format, ...) printf("I (%s) " format "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) printf("W (%s) " format "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGE(tag, format, ...) printf("E (%s) " format "\n", tag, ##__VA_ARGS__)
+#endif
+#define TCP_TAG "TCP"
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0 // lwIP has no SIGPIPE
+#endif
+
+
+// Constants
+#define TCP_TX_BATCH_SIZE 1440 // One segment (CONFIG_LWIP_TCP_MSS)
+#define TCP_TX_BUFFER_SIZE (2 * TCP_TX_BATCH_SIZE) // Per client
+#define TCP_RX_BUFFER_SIZE 1024
+
+// A connected socket
+typedef struct {
+    int socket; // -1 if the slot is free
+    bool failed; // Write error, the socket is shut down and gets closed by the receiving task
+    uint8_t tx[TCP_TX_BUFFER_SIZE]; // Data not written to the socket yet
+    uint32_t tx_len;
+    uint32_t dropped_msgs; // Messages the client missed because it was too slow
+    // Received data is held back while the receive queue holds data of another client
+    uint8_t rx_pending[TCP_RX_BUFFER_SIZE];
+    uint32_t rx_pending_len;
+} tcp_client_t;
+
+// Server state, everything is guarded by 'lock'
+// Sockets are only closed by the task calling 'tcp_recv' (or by 'tcp_transport_stop'),
+// so a socket is never closed while that task waits for it in select()
+// The receive queue only holds data of one client at a time, so answers can go back to it
+static int listen_socket = -1;
+static tcp_client_t clients[TCP_TRANSPORT_MAX_CLIENTS];
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static uint8_t rx_queue[TCP_RX_BUFFER_SIZE];
+static uint32_t rx_pos = 0;
+static uint32_t rx_len = 0;
+static int queue_client = -1; // Client whose data is in the receive queue
+static int input_owner = -1; // Client whose partial command is in the receive queue
+static int reply_client = -1; // Client that sent the data read last
+static int exclusive_client = -1; // Client that has the link to itself (-1 if none, -2 if it disconnected)
+
+
+
+// Milliseconds since an unspecified point
+static int64_t get_time_ms() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t) now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+// Wait until a socket is readable (or writable), returns false on timeout
+static bool wait_for_socket(const int socket, const bool writable, const uint32_t timeout_ms) {
+    fd_set fds;
+    FD_ZERO(&fds);
+    FD_SET(socket, &fds);
+    struct timeval timeout = { .tv_sec = timeout_ms / 1000, .tv_usec = (timeout_ms % 1000) * 1000 };
+    return select(socket + 1, (writable ? NULL : &fds), (writable ? &fds : NULL), NULL, &timeout) > 0;
+}
+
+// Check if a client is connected (lock must be held)
+static inline bool is_client_connected(const int client) {
+    return (clients[client].socket >= 0 && !clients[client].failed);
+}
+
+// Number of connected clients (lock must be held)
+static uint32_t count_clients() {
+    uint32_t count = 0;
+    for (int i = 0; i < TCP_TRANSPORT_MAX_CLIENTS; ++i) {
+        if (is_client_connected(i)) { count += 1; }
+    }
+    return count;
+}
+
+// Close a client (lock must be held, only from the receiving task)
+static void close_client(const int client) {
+    if (clients[client].socket < 0) { return; }
+    ESP_LOGI(TCP_TAG, "Client %d disconnected (%u messages dropped)", client, clients[client].dropped_msgs);
+    close(clients[client].socket);
+    clients[client].socket = -1;
+    clients[client].failed = false;
+    clients[client].tx_len = 0;
+    clients[client].rx_pending_len = 0;
+    if (input_owner == client) { input_owner = -1; }
+    if (reply_client == client) { reply_client = -1; }
+    if (exclusive_client == client) { exclusive_client = -2; }
+    if (queue_client == client) {
+        // Data of a closed client is lost
+        queue_client = -1;
+        rx_pos = 0;
+        rx_len = 0;
+    }
+}
+
+// Stop using a client after a write error (lock must be held)
+// The receiving task sees the end of the stream and closes the socket
+static void fail_client(const int client) {
+    shutdown(clients[client].socket, SHUT_RDWR);
+    clients[client].failed = true;
+    clients[client].tx_len = 0;
+}
+
+// Write as much buffered data to the socket as possible without blocking (lock must be held)
+static void write_out(const int client) {
+    tcp_client_t* const c = &clients[client];
+    if (!is_client_connected(client) || c->tx_len == 0) { return; }
+    const int sent = send(c->socket, c->tx, c->tx_len, MSG_DONTWAIT | MSG_NOSIGNAL);
+    if (sent > 0) {
+        memmove(c->tx, c->tx + sent, c->tx_len - sent);
+        c->tx_len -= sent;
+    }
+    else if (sent < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+        fail_client(client);
+    }
+}
+
+// Accept a new client (lock must be held)
+static void accept_client() {
+    const int socket = accept(listen_socket, NULL, NULL);
+    if (socket < 0) { return; }
+
+    // Send small messages (a single frame) right away, batching is done here
+    const int nodelay = 1;
+    setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+
+    int client = -1;
+    for (int i = 0; i < TCP_TRANSPORT_MAX_CLIENTS && client < 0; ++i) {
+        if (clients[i].socket < 0) { client = i; }
+    }
+    if (client >= 0) {
+        clients[client].socket = socket;
+        clients[client].failed = false;
+        clients[client].tx_len = 0;
+        clients[client].dropped_msgs = 0;
+        clients[client].rx_pending_len = 0;
+        ESP_LOGI(TCP_TAG, "Client %d connected", client);
+    }
+    else {
+        ESP_LOGW(TCP_TAG, "Too many clients");
+        close(socket);
+    }
+}
+
+// Check if a client may put data into the receive queue right now (lock must be held)
+// During a transfer only the transferring client, otherwise the client that is in the
+// middle of a command or whose data is in the queue, or any client if the queue is empty
+static bool may_queue(const int client) {
+    if (exclusive_client != -1) { return (exclusive_client == client); }
+    if (input_owner >= 0) { return (input_owner == client); }
+    return (rx_len == 0 || queue_client == client);
+}
+
+// Put received data into the receive queue, the client owns the input until it sends a line end
+// (lock must be held)
+static void queue_received_data(const int client, const uint8_t* const data, const uint32_t len) {
+    if (len == 0) { return; }
+    if (rx_pos > 0) {
+        // Make room at the end
+        memmove(rx_queue, rx_queue + rx_pos, rx_len - rx_pos);
+        rx_len -= rx_pos;
+        rx_pos = 0;
+    }
+    memcpy(rx_queue + rx_len, data, len);
+    rx_len += len;
+    queue_client = client;
+    const uint8_t last = data[len - 1];
+    input_owner = (last == '\r' || last == '\n' ? -1 : client);
+}
+
+// Queue the data held back for other clients (if they may, lock must be held)
+static void queue_pending_data() {
+    for (int i = 0; i < TCP_TRANSPORT_MAX_CLIENTS; ++i) {
+        tcp_client_t* const c = &clients[i];
+        if (c->rx_pending_len == 0 || !may_queue(i)) { continue; }
+        if (c->rx_pending_len > TCP_RX_BUFFER_SIZE - (rx_len - rx_pos)) { break; } // Later
+        queue_received_data(i, c->rx_pending, c->rx_pending_len);
+        c->rx_pending_len = 0;
+    }
+}
+
+// Read from a readable client (lock must be held)
+static void read_client(const int client) {
+    tcp_client_t* const c = &clients[client];
+    uint8_t buffer[TCP_RX_BUFFER_SIZE];
+    const bool queue = may_queue(client);
+    const uint32_t space = (queue ? TCP_RX_BUFFER_SIZE - (rx_len - rx_pos) : TCP_RX_BUFFER_SIZE - c->rx_pending_len);
+    if (space == 0) { return; }
+
+    const int received = recv(c->socket, buffer, space, MSG_DONTWAIT);
+    if (received == 0 || (received < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+        close_client(client);
+        return;
+    }
+    if (received < 0) { return; }
+    if (queue) {
+        queue_received_data(client, buffer, received);
+    }
+    else {
+        memcpy(c->rx_pending + c->rx_pending_len, buffer, received);
+        c->rx_pending_len += received;
+    }
+}
+
+// Append data to the send buffer of a client (lock must be held)
+// 'wait': wait until the client can take the data instead of dropping it
+static bool send_to_client(const int client, const uint8_t* const data, const uint32_t len, const bool wait, const int64_t deadline) {
+    tcp_client_t* const c = &clients[client];
+
+    // Make room
+    if (c->tx_len + len > TCP_TX_BUFFER_SIZE) { write_out(client); }
+    while (wait && is_client_connected(client) && c->tx_len + len > TCP_TX_BUFFER_SIZE && get_time_ms() < deadline) {
+        wait_for_socket(c->socket, true, deadline - get_time_ms());
+        write_out(client);
+    }
+    if (!is_client_connected(client)) { return false; }
+    if (c->tx_len + len > TCP_TX_BUFFER_SIZE) {
+        c->dropped_msgs += 1;
+        return false;
+    }
+
+    // Batch
+    memcpy(c->tx + c->tx_len, data, len);
+    c->tx_len += len;
+    if (c->tx_len >= TCP_TX_BATCH_SIZE) { write_out(client); }
+    return true;
+}
+
+
+
+// Transport interface
+static bool tcp_send(const uint8_t* const data, const uint32_t len, const uint32_t timeout_ms) {
+    if (len > TCP_TX_BUFFER_SIZE) { return false; }
+    const int64_t deadline = get_time_ms() + timeout_ms;
+    bool sent = false;
+
+    pthread_mutex_lock(&lock);
+    if (exclusive_client != -1) {
+        // During a transfer everything goes to the transferring client
+        sent = (exclusive_client >= 0 && send_to_client(exclusive_client, data, len, true, deadline));
+    }
+    else {
+        // A single client is waited for, with more clients a client that can't keep up misses the message
+        const bool wait = (count_clients() == 1);
+        for (int i = 0; i < TCP_TRANSPORT_MAX_CLIENTS; ++i) {
+            if (is_client_connected(i) && send_to_client(i, data, len, wait, deadline)) { sent = true; }
+        }
+    }
+    pthread_mutex_unlock(&lock);
+    return sent;
+}
+
+static bool tcp_reply(const uint8_t* const data, const uint32_t len, const uint32_t timeout_ms) {
+    if (len > TCP_TX_BUFFER_SIZE) { return false; }
+    const int64_t deadline = get_time_ms() + timeout_ms;
+    pthread_mutex_lock(&lock);
+    const int client = (exclusive_client != -1 ? exclusive_client : reply_client);
+    const bool sent = (client >= 0 && is_client_connected(client) && send_to_client(client, data, len, true, deadline));
+    pthread_mutex_unlock(&lock);
+    return sent;
+}
+
+static void tcp_set_exclusive(const bool exclusive) {
+    pthread_mutex_lock(&lock);
+    if (exclusive) {
+        exclusive_client = reply_client;
+    }
+    else {
+        exclusive_client = -1;
+        input_owner = -1;
+    }
+    pthread_mutex_unlock(&lock);
+}
+
+static int tcp_recv(uint8_t* data, const uint32_t bufsize, const uint32_t timeout_ms) {
+    if (data == NULL) { return -1; }
+    const int64_t deadline = get_time_ms() + timeout_ms;
+
+    pthread_mutex_lock(&lock);
+    while (true) {
+
+        // Clients that failed while sending
+        for (int i = 0; i < TCP_TRANSPORT_MAX_CLIENTS; ++i) {
+            if (clients[i].failed) { close_client(i); }
+        }
+        queue_pending_data();
+
+        // Return queued data
+        if (rx_len > rx_pos) {
+            const uint32_t len = (rx_len - rx_pos < bufsize ? rx_len - rx_pos : bufsize);
+            memcpy(data, rx_queue + rx_pos, len);
+            rx_pos += len;
+            if (rx_pos == rx_len) { rx_pos = 0; rx_len = 0; }
+            reply_client = queue_client;
+            pthread_mutex_unlock(&lock);
+            return len;
+        }
+        const int64_t remaining = deadline - get_time_ms();
+        if (listen_socket < 0) { pthread_mutex_unlock(&lock); return -1; }
+        if (remaining < 0) { pthread_mutex_unlock(&lock); return -2; } // Timeout
+
+        // Wait for new clients and data (clients that can't buffer more data are skipped)
+        fd_set fds;
+        FD_ZERO(&fds);
+        FD_SET(listen_socket, &fds);
+        int max_socket = listen_socket;
+        int sockets[TCP_TRANSPORT_MAX_CLIENTS];
+        for (int i = 0; i < TCP_TRANSPORT_MAX_CLIENTS; ++i) {
+            sockets[i] = clients[i].socket;
+            if (sockets[i] < 0 || (!may_queue(i) && clients[i].rx_pending_len == TCP_RX_BUFFER_SIZE)) { sockets[i] = -1; continue; }
+            FD_SET(sockets[i], &fds);
+            if (sockets[i] > max_socket) { max_socket = sockets[i]; }
+        }
+        const int listen_fd = listen_socket;
+
+        // Senders may use the clients while this task waits, but they never close a socket
+        pthread_mutex_unlock(&lock);
+        struct timeval timeout = { .tv_sec = remaining / 1000, .tv_usec = (remaining % 1000) * 1000 };
+        const int ready = select(max_socket + 1, &fds, NULL, NULL, &timeout);
+        pthread_mutex_lock(&lock);
+        if (ready <= 0 || listen_socket != listen_fd) { continue; }
+
+        if (FD_ISSET(listen_fd, &fds)) { accept_client(); }
+        for (int i = 0; i < TCP_TRANSPORT_MAX_CLIENTS; ++i) {
+            if (sockets[i] >= 0 && clients[i].socket == sockets[i] && FD_ISSET(sockets[i], &fds)) { read_client(i); }
+        }
+    }
+}
+
+static bool tcp_flush(const uint32_t timeout_ms) {
+    const int64_t deadline = get_time_ms() + timeout_ms;
+    pthread_mutex_lock(&lock);
+    while (true) {
+        int pending_socket = -1;
+        for (int i = 0; i < TCP_TRANSPORT_MAX_CLIENTS; ++i) {
+            write_out(i);
+            if (is_client_connected(i) && clients[i].tx_len > 0) { pending_socket = clients[i].socket; }
+        }
+
+        const int64_t remaining = deadline - get_time_ms();
+        if (pending_socket < 0 || remaining <= 0) {
+            pthread_mutex_unlock(&lock);
+            return (pending_socket < 0);
+        }
+        wait_for_socket(pending_socket, true, remaining);
+    }
+}
+
+static bool tcp_is_connected() {
+    return (tcp_transport_get_client_count() > 0);
+}
+
+const transport_t tcp_transport = {
+    .name = "TCP",
+    .send = tcp_send,
+    .recv = tcp_recv,
+    .flush = tcp_flush,
+    .is_connected = tcp_is_connected,
+    .reply = tcp_reply,
+    .set_exclusive = tcp_set_exclusive
+};
+
+
+
+// Open the server socket
+bool tcp_transport_start(const uint16_t port) {
+    if (listen_socket >= 0) { return true; }
+    for (int i = 0; i < TCP_TRANSPORT_MAX_CLIENTS; ++i) { clients[i].socket = -1; }
+
+    listen_socket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (listen_socket < 0) {
+        ESP_LOGE(TCP_TAG, "Unable to create socket: errno %d", errno);
+        return false;
+    }
+    const int reuse = 1;
+    setsockopt(listen_socket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    struct sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(port);
+    if (bind(listen_socket, (struct sockaddr*) &address, sizeof(address)) != 0 || listen(listen_socket, TCP_TRANSPORT_MAX_CLIENTS) != 0) {
+        ESP_LOGE(TCP_TAG, "Unable to listen on port %u: errno %d", port, errno);
+        close(listen_socket);
+        listen_socket = -1;
+        return false;
+    }
+
+    ESP_LOGI(TCP_TAG, "Listening on port %u", port);
+    return true;
+}
+
+// Close the server and all client sockets
+void tcp_transport_stop() {
+    pthread_mutex_lock(&lock);
+    for (int i = 0; i < TCP_TRANSPORT_MAX_CLIENTS; ++i) { close_client(i); }
+    if (listen_socket >= 0) {
+        close(listen_socket);
+        listen_socket = -1;
+    }
+    rx_pos = 0;
+    rx_len = 0;
+    queue_client = -1;
+    exclusive_client = -1;
+    pthread_mutex_unlock(&lock);
+}
+
+// Number of connected clients
+uint32_t tcp_transport_get_client_count() {
+    pthread_mutex_lock(&lock);
+    const uint32_t count = count_clients();
+    pthread_mutex_unlock(&lock);
+    return count;
+}
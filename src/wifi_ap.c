@@ -0,0 +1,75 @@
+#include "wifi_ap.h"
+
+// Some standard header
+#include <string.h> // strlen, strncpy
+
+// Wi-Fi
+#include "esp_wifi.h"
+#include "esp_netif.h"
+#include "esp_event.h"
+
+// Header for debug messages
+#include "esp_log.h"
+#define WIFI_TAG "WIFI"
+
+
+
+// Log stations joining and leaving
+static void wifi_event_handler(void* arg, esp_event_base_t event_base, int32_t event_id, void* event_data) {
+    if (event_id == WIFI_EVENT_AP_STACONNECTED) {
+        const wifi_event_ap_staconnected_t* const event = (const wifi_event_ap_staconnected_t*) event_data;
+        ESP_LOGI(WIFI_TAG, "Station " MACSTR " joined, AID=%d", MAC2STR(event->mac), event->aid);
+    }
+    else if (event_id == WIFI_EVENT_AP_STADISCONNECTED) {
+        const wifi_event_ap_stadisconnected_t* const event = (const wifi_event_ap_stadisconnected_t*) event_data;
+        ESP_LOGI(WIFI_TAG, "Station " MACSTR " left, AID=%d", MAC2STR(event->mac), event->aid);
+    }
+}
+
+// Start a Wi-Fi access point
+bool wifi_ap_init(const char* const ssid, const char* const password, const uint8_t max_connections) {
+    esp_err_t err = ESP_OK;
+
+    // Network interface and default event loop
+    if ((err = esp_netif_init()) != ESP_OK) {
+        ESP_LOGE(WIFI_TAG, "%s netif init failed: %s", __func__, esp_err_to_name(err));
+        return false;
+    }
+    if ((err = esp_event_loop_create_default()) != ESP_OK && err != ESP_ERR_INVALID_STATE) {
+        ESP_LOGE(WIFI_TAG, "%s event loop failed: %s", __func__, esp_err_to_name(err));
+        return false;
+    }
+    esp_netif_create_default_wifi_ap();
+
+    // Driver
+    const wifi_init_config_t init_config = WIFI_INIT_CONFIG_DEFAULT();
+    if ((err = esp_wifi_init(&init_config)) != ESP_OK) {
+        ESP_LOGE(WIFI_TAG, "%s wifi init failed: %s", __func__, esp_err_to_name(err));
+        return false;
+    }
+    esp_event_handler_register(WIFI_EVENT, ESP_EVENT_ANY_ID, wifi_event_handler, NULL);
+
+    // Access point
+    wifi_config_t wifi_config = {};
+    strncpy((char*) wifi_config.ap.ssid, ssid, sizeof(wifi_config.ap.ssid));
+    wifi_config.ap.ssid_len = strlen(ssid);
+    wifi_config.ap.channel = 1;
+    wifi_config.ap.max_connection = max_connections;
+    if (password != NULL && strlen(password) >= 8) {
+        strncpy((char*) wifi_config.ap.password, password, sizeof(wifi_config.ap.password));
+        wifi_config.ap.authmode = WIFI_AUTH_WPA2_PSK;
+    }
+    else {
+        wifi_config.ap.authmode = WIFI_AUTH_OPEN;
+    }
+
+    if ((err = esp_wifi_set_mode(WIFI_MODE_AP)) != ESP_OK
+        || (err = esp_wifi_set_config(ESP_IF_WIFI_AP, &wifi_config)) != ESP_OK
+        || (err = esp_wifi_start()) != ESP_OK) {
+        ESP_LOGE(WIFI_TAG, "%s start failed: %s", __func__, esp_err_to_name(err));
+        return false;
+    }
+
+    ESP_LOGI(WIFI_TAG, "Access point \"%s\" started", ssid);
+    return true;
+}
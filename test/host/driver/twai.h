@@ -0,0 +1,51 @@
+#ifndef HOST_TWAI_H
+#define HOST_TWAI_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+
+// Host stand-in for the ESP-IDF 4.3 TWAI driver (unit tests only)
+// Transmitted frames are recorded in 'host_twai_sent'.
+
+#define TWAI_BRP_MIN 2
+#define TWAI_BRP_MAX 128
+
+typedef struct {
+    union {
+        struct {
+            uint32_t extd: 1;
+            uint32_t rtr: 1;
+            uint32_t ss: 1;
+            uint32_t self: 1;
+            uint32_t dlc_non_comp: 1;
+            uint32_t reserved: 27;
+        };
+        uint32_t flags;
+    };
+    uint32_t identifier;
+    uint8_t data_length_code;
+    uint8_t data[8];
+} twai_message_t;
+
+typedef struct {
+    uint32_t brp;
+    uint8_t tseg_1;
+    uint8_t tseg_2;
+    uint8_t sjw;
+    bool triple_sampling;
+} twai_timing_config_t;
+
+#define HOST_TWAI_SENT_MAX 1024
+static twai_message_t host_twai_sent[HOST_TWAI_SENT_MAX];
+static uint32_t host_twai_sent_count = 0;
+
+static inline esp_err_t twai_transmit(const twai_message_t* message, TickType_t timeout) {
+    (void) timeout;
+    if (host_twai_sent_count >= HOST_TWAI_SENT_MAX) { return ESP_ERR_TIMEOUT; }
+    host_twai_sent[host_twai_sent_count++] = *message;
+    return ESP_OK;
+}
+
+#endif // HOST_TWAI_H
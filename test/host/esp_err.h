@@ -0,0 +1,23 @@
+#ifndef HOST_ESP_ERR_H
+#define HOST_ESP_ERR_H
+
+// Host stand-in for ESP-IDF (unit tests only)
+
+typedef int esp_err_t;
+
+#define ESP_OK 0
+#define ESP_FAIL -1
+#define ESP_ERR_NO_MEM 0x101
+#define ESP_ERR_INVALID_ARG 0x102
+#define ESP_ERR_INVALID_STATE 0x103
+#define ESP_ERR_INVALID_SIZE 0x104
+#define ESP_ERR_NOT_FOUND 0x105
+#define ESP_ERR_TIMEOUT 0x107
+
+static inline const char* esp_err_to_name(esp_err_t code) {
+    return (code == ESP_OK ? "ESP_OK" : "ERROR");
+}
+
+#define ESP_ERROR_CHECK_WITHOUT_ABORT(x) (x)
+
+#endif // HOST_ESP_ERR_H
@@ -0,0 +1,12 @@
+#ifndef HOST_ESP_LOG_H
+#define HOST_ESP_LOG_H
+
+// Host stand-in for ESP-IDF (unit tests only), logging is discarded
+
+#define ESP_LOGE(tag, format, ...) ((void) (tag))
+#define ESP_LOGW(tag, format, ...) ((void) (tag))
+#define ESP_LOGI(tag, format, ...) ((void) (tag))
+#define ESP_LOGD(tag, format, ...) ((void) (tag))
+#define ESP_LOGV(tag, format, ...) ((void) (tag))
+
+#endif // HOST_ESP_LOG_H
@@ -0,0 +1,17 @@
+#ifndef HOST_ESP_ROM_CRC_H
+#define HOST_ESP_ROM_CRC_H
+
+#include <stdint.h>
+
+// Host stand-in for ESP-IDF (unit tests only)
+// CRC-32 as in the ROM (and zlib.crc32 used by the scripts)
+static inline uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t* buf, uint32_t len) {
+    crc = ~crc;
+    while (len-- > 0) {
+        crc ^= *buf++;
+        for (int k = 0; k < 8; ++k) { crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u))); }
+    }
+    return ~crc;
+}
+
+#endif // HOST_ESP_ROM_CRC_H
@@ -0,0 +1,44 @@
+#ifndef HOST_ESP_SPIFFS_H
+#define HOST_ESP_SPIFFS_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <sys/stat.h> // mkdir
+#include "esp_err.h"
+
+// Host stand-in for ESP-IDF (unit tests only)
+// The "partition" is the base path directory on the host, mounts are counted in 'host_spiffs_mount_count'.
+
+typedef struct {
+    const char* base_path;
+    const char* partition_label;
+    size_t max_files;
+    bool format_if_mount_failed;
+} esp_vfs_spiffs_conf_t;
+
+static bool host_spiffs_mounted = false;
+static int host_spiffs_mount_count = 0;
+
+static inline esp_err_t esp_vfs_spiffs_register(const esp_vfs_spiffs_conf_t* conf) {
+    if (host_spiffs_mounted) { return ESP_ERR_INVALID_STATE; }
+    mkdir(conf->base_path, 0700);
+    host_spiffs_mounted = true;
+    host_spiffs_mount_count += 1;
+    return ESP_OK;
+}
+
+static inline esp_err_t esp_vfs_spiffs_unregister(const char* partition_label) {
+    (void) partition_label;
+    if (!host_spiffs_mounted) { return ESP_ERR_INVALID_STATE; }
+    host_spiffs_mounted = false;
+    return ESP_OK;
+}
+
+static inline esp_err_t esp_spiffs_info(const char* partition_label, size_t* total, size_t* used) {
+    (void) partition_label;
+    *total = 1024 * 1024;
+    *used = 0;
+    return ESP_OK;
+}
+
+#endif // HOST_ESP_SPIFFS_H
@@ -0,0 +1,100 @@
+#ifndef HOST_ESP_TIMER_H
+#define HOST_ESP_TIMER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h> // calloc, free
+#include "esp_err.h"
+
+// Host stand-in for ESP-IDF (unit tests only)
+// The time only moves with 'host_timer_advance()', which also runs the due timer callbacks.
+
+typedef void (*esp_timer_cb_t)(void* arg);
+
+typedef enum { ESP_TIMER_TASK } esp_timer_dispatch_t;
+
+typedef struct {
+    esp_timer_cb_t callback;
+    void* arg;
+    esp_timer_dispatch_t dispatch_method;
+    const char* name;
+    bool skip_unhandled_events;
+} esp_timer_create_args_t;
+
+typedef struct host_timer {
+    esp_timer_create_args_t args;
+    bool running;
+    uint64_t period_us;
+    int64_t next_us;
+} *esp_timer_handle_t;
+
+#define HOST_TIMER_MAX 64
+static int64_t host_time_us = 0;
+static esp_timer_handle_t host_timers[HOST_TIMER_MAX];
+
+static inline int64_t esp_timer_get_time(void) {
+    return host_time_us;
+}
+
+static inline esp_err_t esp_timer_create(const esp_timer_create_args_t* args, esp_timer_handle_t* handle) {
+    for (int i = 0; i < HOST_TIMER_MAX; ++i) {
+        if (host_timers[i] == NULL) {
+            host_timers[i] = (esp_timer_handle_t) calloc(1, sizeof(struct host_timer));
+            host_timers[i]->args = *args;
+            *handle = host_timers[i];
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NO_MEM;
+}
+
+static inline esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period_us) {
+    if (timer == NULL || timer->running) { return ESP_ERR_INVALID_STATE; }
+    timer->running = true;
+    timer->period_us = period_us;
+    timer->next_us = host_time_us + (int64_t) period_us;
+    return ESP_OK;
+}
+
+static inline esp_err_t esp_timer_stop(esp_timer_handle_t timer) {
+    if (timer == NULL || !timer->running) { return ESP_ERR_INVALID_STATE; }
+    timer->running = false;
+    return ESP_OK;
+}
+
+static inline esp_err_t esp_timer_delete(esp_timer_handle_t timer) {
+    for (int i = 0; i < HOST_TIMER_MAX; ++i) {
+        if (host_timers[i] == timer && timer != NULL) {
+            free(timer);
+            host_timers[i] = NULL;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_INVALID_ARG;
+}
+
+// Number of existing timers
+static inline int host_timer_count(void) {
+    int count = 0;
+    for (int i = 0; i < HOST_TIMER_MAX; ++i) { count += (host_timers[i] != NULL); }
+    return count;
+}
+
+// Move the time forward, running the periodic callbacks in time order
+static inline void host_timer_advance(const int64_t us) {
+    const int64_t end = host_time_us + us;
+    while (true) {
+        esp_timer_handle_t next = NULL;
+        for (int i = 0; i < HOST_TIMER_MAX; ++i) {
+            esp_timer_handle_t timer = host_timers[i];
+            if (timer != NULL && timer->running && timer->next_us <= end && (next == NULL || timer->next_us < next->next_us)) { next = timer; }
+        }
+        if (next == NULL) { break; }
+        host_time_us = next->next_us;
+        next->next_us += (int64_t) next->period_us;
+        next->args.callback(next->args.arg);
+    }
+    host_time_us = end;
+}
+
+#endif // HOST_ESP_TIMER_H
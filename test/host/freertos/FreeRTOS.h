@@ -0,0 +1,26 @@
+#ifndef HOST_FREERTOS_H
+#define HOST_FREERTOS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Host stand-in for FreeRTOS (unit tests only, single threaded)
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS pdTRUE
+#define portMAX_DELAY ((TickType_t) 0xFFFFFFFF)
+#define configTICK_RATE_HZ 100
+#define portTICK_PERIOD_MS (1000 / configTICK_RATE_HZ)
+#define pdMS_TO_TICKS(ms) ((TickType_t) (((TickType_t) (ms) * configTICK_RATE_HZ) / 1000))
+
+typedef struct { int owner; } portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED { 0 }
+#define portENTER_CRITICAL(mux) ((void) (mux))
+#define portEXIT_CRITICAL(mux) ((void) (mux))
+
+#endif // HOST_FREERTOS_H
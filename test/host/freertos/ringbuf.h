@@ -0,0 +1,55 @@
+#ifndef HOST_RINGBUF_H
+#define HOST_RINGBUF_H
+
+#include <stdlib.h> // calloc
+#include <string.h> // memmove, memcpy
+#include "freertos/FreeRTOS.h"
+
+// Host stand-in for FreeRTOS (unit tests only, single threaded)
+// Byte buffers only, a full buffer or an empty buffer returns at once instead of waiting.
+
+typedef enum { RINGBUF_TYPE_NOSPLIT, RINGBUF_TYPE_ALLOWSPLIT, RINGBUF_TYPE_BYTEBUF } RingbufferType_t;
+
+typedef struct host_ringbuf {
+    size_t size;
+    size_t count;
+    size_t taken; // Bytes handed out by the last receive
+    uint8_t* data;
+} *RingbufHandle_t;
+
+static inline RingbufHandle_t xRingbufferCreate(size_t size, RingbufferType_t type) {
+    (void) type;
+    RingbufHandle_t ringbuf = (RingbufHandle_t) calloc(1, sizeof(struct host_ringbuf));
+    ringbuf->size = size;
+    ringbuf->data = (uint8_t*) calloc(1, size);
+    return ringbuf;
+}
+
+static inline BaseType_t xRingbufferSend(RingbufHandle_t ringbuf, const void* data, size_t size, TickType_t timeout) {
+    (void) timeout;
+    if (ringbuf->count + size > ringbuf->size) { return pdFALSE; }
+    memcpy(ringbuf->data + ringbuf->count, data, size);
+    ringbuf->count += size;
+    return pdTRUE;
+}
+
+static inline void* xRingbufferReceiveUpTo(RingbufHandle_t ringbuf, size_t* item_size, TickType_t timeout, size_t max_size) {
+    (void) timeout;
+    if (ringbuf->count == 0 || max_size == 0) { return NULL; }
+    ringbuf->taken = (ringbuf->count < max_size ? ringbuf->count : max_size);
+    *item_size = ringbuf->taken;
+    return ringbuf->data;
+}
+
+static inline void vRingbufferReturnItem(RingbufHandle_t ringbuf, void* item) {
+    (void) item;
+    memmove(ringbuf->data, ringbuf->data + ringbuf->taken, ringbuf->count - ringbuf->taken);
+    ringbuf->count -= ringbuf->taken;
+    ringbuf->taken = 0;
+}
+
+static inline size_t xRingbufferGetCurFreeSize(RingbufHandle_t ringbuf) {
+    return ringbuf->size - ringbuf->count;
+}
+
+#endif // HOST_RINGBUF_H
@@ -0,0 +1,56 @@
+#ifndef HOST_SEMPHR_H
+#define HOST_SEMPHR_H
+
+#include <stdlib.h> // calloc
+#include "freertos/FreeRTOS.h"
+
+// Host stand-in for FreeRTOS (unit tests only, single threaded)
+// Nothing else can give a semaphore while a test waits, so takes never block.
+
+typedef struct host_semaphore {
+    UBaseType_t count;
+    UBaseType_t max_count;
+    UBaseType_t recursion; // Takes not given back yet (recursive mutexes)
+    UBaseType_t recursive_takes; // All takes so far (recursive mutexes)
+} *SemaphoreHandle_t;
+
+typedef struct { int unused; } StaticSemaphore_t;
+
+static inline SemaphoreHandle_t host_semaphore_create(const UBaseType_t max_count, const UBaseType_t count) {
+    SemaphoreHandle_t semaphore = (SemaphoreHandle_t) calloc(1, sizeof(struct host_semaphore));
+    semaphore->max_count = max_count;
+    semaphore->count = count;
+    return semaphore;
+}
+
+#define xSemaphoreCreateBinary() host_semaphore_create(1, 0)
+#define xSemaphoreCreateMutex() host_semaphore_create(1, 1)
+#define xSemaphoreCreateRecursiveMutexStatic(buffer) ((void) (buffer), host_semaphore_create(1, 1))
+
+static inline BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t timeout) {
+    (void) timeout;
+    if (semaphore->count == 0) { return pdFALSE; }
+    semaphore->count -= 1;
+    return pdTRUE;
+}
+
+static inline BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+    if (semaphore->count >= semaphore->max_count) { return pdFALSE; }
+    semaphore->count += 1;
+    return pdTRUE;
+}
+
+static inline BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t semaphore, TickType_t timeout) {
+    (void) timeout;
+    semaphore->recursion += 1;
+    semaphore->recursive_takes += 1;
+    return pdTRUE;
+}
+
+static inline BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t semaphore) {
+    if (semaphore->recursion == 0) { return pdFALSE; }
+    semaphore->recursion -= 1;
+    return pdTRUE;
+}
+
+#endif // HOST_SEMPHR_H
@@ -0,0 +1,245 @@
+// Host tests of buffer_access (pio test -e native -f test_buffer_access)
+// The benchmarks report the cost per call of the specialized and the generic 64 bit accessors
+// and the throughput of the bulk array functions.
+#include <unity.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "../../src/buffer_access.c"
+
+
+// All byte orders, the digits give the position of each byte of the value in the buffer
+static const int orders_16[] = { B16_ENDIANESS_12, B16_ENDIANESS_21 };
+static const int orders_32[] = { B32_ENDIANESS_1234, B32_ENDIANESS_4321, B32_ENDIANESS_2143, B32_ENDIANESS_3412 };
+static const int orders_64[] = {
+    B64_ENDIANESS_12345678, B64_ENDIANESS_87654321, B64_ENDIANESS_56781234, B64_ENDIANESS_43218765,
+    B64_ENDIANESS_34127856, B64_ENDIANESS_65872143, B64_ENDIANESS_78563412, B64_ENDIANESS_21436587,
+};
+#define COUNT(array) (sizeof(array) / sizeof(array[0]))
+
+// Reference encoding of 'value' with 'size' bytes in the given order
+static void reference_encode(const uint64_t value, const int order, const uint32_t size, uint8_t* const data) {
+    int digits = order;
+    for (int i = (int) size - 1; i >= 0; --i) {
+        const int position = digits % 10;
+        digits /= 10;
+        data[i] = (uint8_t) (value >> (8 * (position - 1)));
+    }
+}
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static const uint64_t test_value = 0x8877665544332211ull;
+
+
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// Specialized and generic accessors agree with the reference for every order and alignment
+void test_scalar_accessors(void) {
+    uint8_t expected[16], data[16];
+    for (uint32_t offset = 0; offset < 8; ++offset) {
+        for (uint32_t k = 0; k < COUNT(orders_16); ++k) {
+            reference_encode(test_value, orders_16[k], 2, expected);
+            TEST_ASSERT_EQUAL_HEX16((uint16_t) test_value, parse_uint16(expected, orders_16[k]));
+            memset(data, 0, sizeof(data));
+            copy_uint16_into_buffer((uint16_t) test_value, data + offset, orders_16[k]);
+            TEST_ASSERT_EQUAL_MEMORY(expected, data + offset, 2);
+        }
+        for (uint32_t k = 0; k < COUNT(orders_32); ++k) {
+            reference_encode(test_value, orders_32[k], 4, expected);
+            memcpy(data + offset, expected, 4);
+            TEST_ASSERT_EQUAL_HEX32((uint32_t) test_value, parse_uint32(data + offset, orders_32[k]));
+            memset(data, 0, sizeof(data));
+            copy_uint32_into_buffer((uint32_t) test_value, data + offset, orders_32[k]);
+            TEST_ASSERT_EQUAL_MEMORY(expected, data + offset, 4);
+        }
+        for (uint32_t k = 0; k < COUNT(orders_64); ++k) {
+            reference_encode(test_value, orders_64[k], 8, expected);
+            memcpy(data + offset, expected, 8);
+            TEST_ASSERT_EQUAL_HEX64(test_value, parse_uint64(data + offset, orders_64[k]));
+            memset(data, 0, sizeof(data));
+            copy_uint64_into_buffer(test_value, data + offset, orders_64[k]);
+            TEST_ASSERT_EQUAL_MEMORY(expected, data + offset, 8);
+        }
+    }
+
+    // Aliases and the specialized functions
+    reference_encode(test_value, 4321, 4, expected);
+    TEST_ASSERT_EQUAL_HEX32((uint32_t) test_value, parse_uint32_4321(expected));
+    TEST_ASSERT_EQUAL_HEX32((uint32_t) test_value, parse_uint32(expected, BIG_ENDIAN));
+    reference_encode(test_value, 87654321, 8, expected);
+    TEST_ASSERT_EQUAL_HEX64(test_value, parse_uint64(expected, BIG_ENDIAN));
+    reference_encode(test_value, 21, 2, expected);
+    TEST_ASSERT_EQUAL_HEX16((uint16_t) test_value, parse_uint16(expected, BIG_ENDIAN));
+}
+
+void test_float_double(void) {
+    uint8_t data[8];
+    copy_float_into_buffer(-1.5f, data, BIG_ENDIAN);
+    TEST_ASSERT_EQUAL_HEX8(0xBF, data[0]);
+    TEST_ASSERT_EQUAL_HEX8(0xC0, data[1]);
+    TEST_ASSERT_TRUE(parse_float(data, BIG_ENDIAN) == -1.5f);
+    copy_double_into_buffer(1e100, data, B64_ENDIANESS_34127856);
+    TEST_ASSERT_TRUE(parse_double(data, B64_ENDIANESS_34127856) == 1e100);
+}
+
+void test_convert_endianess(void) {
+    uint8_t in[8], out[8], expected[8];
+    for (uint32_t k = 0; k < COUNT(orders_64); ++k) {
+        reference_encode(test_value, orders_64[k], 8, in);
+        convert_endianess_64(in, out, orders_64[k]);
+        reference_encode(test_value, 12345678, 8, expected);
+        TEST_ASSERT_EQUAL_MEMORY(expected, out, 8);
+    }
+    for (uint32_t k = 0; k < COUNT(orders_32); ++k) {
+        reference_encode(test_value, orders_32[k], 4, in);
+        convert_endianess_32(in, out, orders_32[k]);
+        reference_encode(test_value, 1234, 4, expected);
+        TEST_ASSERT_EQUAL_MEMORY(expected, out, 4);
+    }
+}
+
+// Cost per call of the 64 bit accessors for all eight orders
+#define BENCH_VALUES 4096
+#define BENCH_ROUNDS 2000
+
+#define BENCH_SPECIALIZED(ORDER) { \
+    uint64_t sum = 0; \
+    const double start = now_ns(); \
+    for (uint32_t r = 0; r < BENCH_ROUNDS; ++r) { \
+        for (uint32_t i = 0; i < BENCH_VALUES; ++i) { sum += parse_uint64_##ORDER(buffer + 1 + 8 * i); } \
+    } \
+    specialized = (now_ns() - start) / ((double) BENCH_ROUNDS * BENCH_VALUES); \
+    sink += sum; \
+}
+
+void test_benchmark_uint64(void) {
+    static uint8_t buffer[8 * BENCH_VALUES + 1]; // Odd offset: unaligned values
+    for (uint32_t i = 0; i < sizeof(buffer); ++i) { buffer[i] = (uint8_t) (i * 31); }
+
+    // Called through a volatile pointer so the order can't be resolved at compile time
+    uint64_t (* volatile generic_parse)(const uint8_t* const, const int) = parse_uint64;
+    volatile uint64_t sink = 0;
+
+    for (uint32_t k = 0; k < COUNT(orders_64); ++k) {
+        double specialized = 0;
+        switch (orders_64[k]) {
+            case B64_ENDIANESS_12345678: BENCH_SPECIALIZED(12345678); break;
+            case B64_ENDIANESS_87654321: BENCH_SPECIALIZED(87654321); break;
+            case B64_ENDIANESS_56781234: BENCH_SPECIALIZED(56781234); break;
+            case B64_ENDIANESS_43218765: BENCH_SPECIALIZED(43218765); break;
+            case B64_ENDIANESS_34127856: BENCH_SPECIALIZED(34127856); break;
+            case B64_ENDIANESS_65872143: BENCH_SPECIALIZED(65872143); break;
+            case B64_ENDIANESS_78563412: BENCH_SPECIALIZED(78563412); break;
+            case B64_ENDIANESS_21436587: BENCH_SPECIALIZED(21436587); break;
+        }
+
+        uint64_t sum = 0;
+        const double start = now_ns();
+        for (uint32_t r = 0; r < BENCH_ROUNDS; ++r) {
+            for (uint32_t i = 0; i < BENCH_VALUES; ++i) { sum += generic_parse(buffer + 1 + 8 * i, orders_64[k]); }
+        }
+        const double generic = (now_ns() - start) / ((double) BENCH_ROUNDS * BENCH_VALUES);
+        sink += sum;
+
+        char message[96];
+        snprintf(message, sizeof(message), "parse_uint64 %08d: specialized %.2f ns/call, generic %.2f ns/call", orders_64[k], specialized, generic);
+        TEST_MESSAGE(message);
+    }
+}
+
+// Bulk functions match the scalar accessors for every order, alignment and count
+#define BULK_MAX_COUNT 37
+
+#define CHECK_BULK(TYPE, SIZE, ORDERS) \
+    for (uint32_t k = 0; k < COUNT(ORDERS); ++k) { \
+        for (uint32_t offset = 0; offset < 8; ++offset) { \
+            for (uint32_t count = 0; count <= BULK_MAX_COUNT; count += (count < 9 ? 1 : 7)) { \
+                static uint8_t expected[BULK_MAX_COUNT * 8 + 16], data[BULK_MAX_COUNT * 8 + 16]; \
+                TYPE##_t values[BULK_MAX_COUNT + 1], parsed[BULK_MAX_COUNT + 1]; \
+                for (uint32_t i = 0; i < count; ++i) { \
+                    values[i] = (TYPE##_t) (test_value * (i + 1) + i); \
+                    reference_encode(values[i], ORDERS[k], SIZE, expected + offset + SIZE * i); \
+                } \
+                memset(data, 0xA5, sizeof(data)); \
+                copy_##TYPE##_array_into_buffer(values, data + offset, count, ORDERS[k]); \
+                TEST_ASSERT_EQUAL_MEMORY(expected + offset, data + offset, SIZE * count); \
+                TEST_ASSERT_EQUAL_HEX8(0xA5, data[offset + SIZE * count]); \
+                parse_##TYPE##_array(data + offset, parsed, count, ORDERS[k]); \
+                TEST_ASSERT_EQUAL_MEMORY(values, parsed, sizeof(TYPE##_t) * count); \
+            } \
+        } \
+    }
+
+void test_bulk_arrays(void) {
+    CHECK_BULK(uint16, 2, orders_16)
+    CHECK_BULK(uint32, 4, orders_32)
+    CHECK_BULK(uint64, 8, orders_64)
+
+    float floats[5] = { 0.0f, -1.5f, 3.25f, 1e30f, -1e-30f }, parsed_floats[5];
+    double doubles[5] = { 0.0, -1.5, 3.25, 1e300, -1e-300 }, parsed_doubles[5];
+    uint8_t data[41];
+    copy_float_array_into_buffer(floats, data + 1, 5, BIG_ENDIAN);
+    TEST_ASSERT_TRUE(parse_float(data + 5, BIG_ENDIAN) == -1.5f);
+    parse_float_array(data + 1, parsed_floats, 5, BIG_ENDIAN);
+    TEST_ASSERT_EQUAL_MEMORY(floats, parsed_floats, sizeof(floats));
+    copy_double_array_into_buffer(doubles, data, 5, B64_ENDIANESS_65872143);
+    TEST_ASSERT_TRUE(parse_double(data + 8, B64_ENDIANESS_65872143) == -1.5);
+    parse_double_array(data, parsed_doubles, 5, B64_ENDIANESS_65872143);
+    TEST_ASSERT_EQUAL_MEMORY(doubles, parsed_doubles, sizeof(doubles));
+}
+
+// Throughput of the bulk functions against one generic call per value
+#define BULK_BENCH_BYTES (64 * 1024)
+#define BULK_BENCH_ROUNDS 400
+
+#define BENCH_BULK(TYPE, SIZE, ORDERS) \
+    for (uint32_t k = 0; k < COUNT(ORDERS); ++k) { \
+        static TYPE##_t values[BULK_BENCH_BYTES / SIZE]; \
+        const uint32_t count = BULK_BENCH_BYTES / SIZE; \
+        double mb_s[3]; \
+        for (uint32_t variant = 0; variant < 3; ++variant) { \
+            const uint8_t* const data = buffer + (variant == 1 ? 1 : 0); \
+            const double start = now_ns(); \
+            for (uint32_t r = 0; r < BULK_BENCH_ROUNDS; ++r) { \
+                if (variant < 2) { parse_##TYPE##_array(data, values, count, ORDERS[k]); } \
+                else { for (uint32_t i = 0; i < count; ++i) { values[i] = generic_##TYPE(data + SIZE * i, ORDERS[k]); } } \
+                sink += values[r % count]; \
+            } \
+            mb_s[variant] = (double) BULK_BENCH_BYTES * BULK_BENCH_ROUNDS / (now_ns() - start) * 1e3; \
+        } \
+        char message[128]; \
+        snprintf(message, sizeof(message), "parse_" #TYPE "_array %08d: aligned %.0f MB/s, unaligned %.0f MB/s, per value calls %.0f MB/s", \
+            ORDERS[k], mb_s[0], mb_s[1], mb_s[2]); \
+        TEST_MESSAGE(message); \
+    }
+
+void test_benchmark_bulk(void) {
+    static uint8_t buffer[BULK_BENCH_BYTES + 8] __attribute__((aligned(8)));
+    for (uint32_t i = 0; i < sizeof(buffer); ++i) { buffer[i] = (uint8_t) (i * 31); }
+    uint16_t (* volatile generic_uint16)(const uint8_t* const, const int) = parse_uint16;
+    uint32_t (* volatile generic_uint32)(const uint8_t* const, const int) = parse_uint32;
+    uint64_t (* volatile generic_uint64)(const uint8_t* const, const int) = parse_uint64;
+    volatile uint64_t sink = 0;
+
+    BENCH_BULK(uint16, 2, orders_16)
+    BENCH_BULK(uint32, 4, orders_32)
+    BENCH_BULK(uint64, 8, orders_64)
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_scalar_accessors);
+    RUN_TEST(test_float_double);
+    RUN_TEST(test_convert_endianess);
+    RUN_TEST(test_benchmark_uint64);
+    RUN_TEST(test_bulk_arrays);
+    RUN_TEST(test_benchmark_bulk);
+    return UNITY_END();
+}
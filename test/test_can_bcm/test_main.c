@@ -0,0 +1,171 @@
+// Host tests of the broadcast manager (pio test -e native -f test_can_bcm)
+// TX jobs run on the esp_timer stand-in (host_timer_advance), their frames end up in host_twai_sent.
+#include <unity.h>
+
+#include "../../src/can_bcm.c"
+
+
+static twai_message_t make_frame(const uint32_t identifier, const bool extended, const uint8_t dlc, const uint8_t first_byte) {
+    twai_message_t message = {};
+    message.identifier = identifier;
+    message.extd = extended;
+    message.data_length_code = dlc;
+    message.data[0] = first_byte;
+    return message;
+}
+
+
+
+void setUp(void) {
+    can_bcm_init();
+    can_bcm_reset();
+    host_twai_sent_count = 0;
+}
+void tearDown(void) {}
+
+// A job sends its frame once per interval, the first one after one interval
+void test_tx_job_interval(void) {
+    const twai_message_t frame = make_frame(0x123, false, 2, 0xAA);
+    TEST_ASSERT_TRUE(can_bcm_add_tx_job(100000, &frame));
+    host_timer_advance(99999);
+    TEST_ASSERT_EQUAL_UINT32(0, host_twai_sent_count);
+    host_timer_advance(1);
+    TEST_ASSERT_EQUAL_UINT32(1, host_twai_sent_count);
+    host_timer_advance(1000000);
+    TEST_ASSERT_EQUAL_UINT32(11, host_twai_sent_count);
+    TEST_ASSERT_EQUAL_HEX32(0x123, host_twai_sent[10].identifier);
+    TEST_ASSERT_EQUAL_HEX8(0xAA, host_twai_sent[10].data[0]);
+}
+
+// Updated data goes out with the next frame, the timing is kept
+void test_tx_job_update(void) {
+    twai_message_t frame = make_frame(0x123, false, 2, 0x01);
+    TEST_ASSERT_TRUE(can_bcm_add_tx_job(10000, &frame));
+    host_timer_advance(15000);
+    frame.data[0] = 0x02;
+    TEST_ASSERT_TRUE(can_bcm_update_tx_job(&frame));
+    host_timer_advance(5000);
+    TEST_ASSERT_EQUAL_UINT32(2, host_twai_sent_count);
+    TEST_ASSERT_EQUAL_HEX8(0x01, host_twai_sent[0].data[0]);
+    TEST_ASSERT_EQUAL_HEX8(0x02, host_twai_sent[1].data[0]);
+
+    // Only a running job can be updated
+    const twai_message_t other = make_frame(0x123, true, 2, 0x03);
+    TEST_ASSERT_FALSE(can_bcm_update_tx_job(&other));
+}
+
+// Adding a job for the same identifier replaces it, deleting stops it and frees its timer
+void test_tx_job_replace_and_delete(void) {
+    const twai_message_t frame = make_frame(0x7FF, false, 0, 0);
+    TEST_ASSERT_FALSE(can_bcm_add_tx_job(0, &frame));
+    TEST_ASSERT_TRUE(can_bcm_add_tx_job(10000, &frame));
+    TEST_ASSERT_TRUE(can_bcm_add_tx_job(20000, &frame));
+    TEST_ASSERT_EQUAL_INT(1, host_timer_count());
+    host_timer_advance(40000);
+    TEST_ASSERT_EQUAL_UINT32(2, host_twai_sent_count);
+
+    TEST_ASSERT_TRUE(can_bcm_delete_tx_job(0x7FF, false));
+    TEST_ASSERT_FALSE(can_bcm_delete_tx_job(0x7FF, false));
+    TEST_ASSERT_EQUAL_INT(0, host_timer_count());
+    host_timer_advance(100000);
+    TEST_ASSERT_EQUAL_UINT32(2, host_twai_sent_count);
+}
+
+// The job table holds CAN_BCM_MAX_TX_JOBS jobs, a reset frees all of them
+void test_tx_job_table(void) {
+    for (uint32_t i = 0; i < CAN_BCM_MAX_TX_JOBS; ++i) {
+        const twai_message_t frame = make_frame(i, true, 1, i);
+        TEST_ASSERT_TRUE(can_bcm_add_tx_job(1000, &frame));
+    }
+    const twai_message_t frame = make_frame(0x100, true, 1, 0);
+    TEST_ASSERT_FALSE(can_bcm_add_tx_job(1000, &frame));
+    TEST_ASSERT_EQUAL_INT(CAN_BCM_MAX_TX_JOBS, host_timer_count());
+    can_bcm_reset();
+    TEST_ASSERT_EQUAL_INT(0, host_timer_count());
+    TEST_ASSERT_TRUE(can_bcm_add_tx_job(1000, &frame));
+}
+
+// Only subscribed frames are forwarded, standard and extended identifiers are distinct
+void test_rx_subscription(void) {
+    TEST_ASSERT_TRUE(can_bcm_add_rx_filter(0, 0x100, false, NULL));
+    const twai_message_t standard = make_frame(0x100, false, 1, 0);
+    const twai_message_t extended = make_frame(0x100, true, 1, 0);
+    TEST_ASSERT_TRUE(can_bcm_filter_frame(0, &standard));
+    TEST_ASSERT_TRUE(can_bcm_filter_frame(1, &standard)); // Without content filter every frame
+    TEST_ASSERT_FALSE(can_bcm_filter_frame(2, &extended));
+    TEST_ASSERT_TRUE(can_bcm_delete_rx_filter(0x100, false));
+    TEST_ASSERT_FALSE(can_bcm_delete_rx_filter(0x100, false));
+    TEST_ASSERT_FALSE(can_bcm_filter_frame(3, &standard));
+}
+
+// A content filter only forwards changes in the masked bits or of the DLC
+void test_rx_content_filter(void) {
+    const uint8_t mask[8] = { 0x0F };
+    TEST_ASSERT_TRUE(can_bcm_add_rx_filter(0, 0x200, false, mask));
+    twai_message_t frame = make_frame(0x200, false, 2, 0x01);
+    TEST_ASSERT_TRUE(can_bcm_filter_frame(0, &frame)); // First frame
+    TEST_ASSERT_FALSE(can_bcm_filter_frame(1, &frame));
+    frame.data[0] = 0x11; // Unmasked bits
+    TEST_ASSERT_FALSE(can_bcm_filter_frame(2, &frame));
+    frame.data[1] = 0xFF; // Unmasked byte
+    TEST_ASSERT_FALSE(can_bcm_filter_frame(3, &frame));
+    frame.data[0] = 0x12;
+    TEST_ASSERT_TRUE(can_bcm_filter_frame(4, &frame));
+    frame.data_length_code = 3;
+    TEST_ASSERT_TRUE(can_bcm_filter_frame(5, &frame));
+}
+
+// A throttle forwards at most one frame per interval, the last change held back follows when it ends
+void test_rx_throttle(void) {
+    TEST_ASSERT_TRUE(can_bcm_add_rx_filter(100000, 0x300, false, NULL));
+    twai_message_t frame = make_frame(0x300, false, 1, 1);
+    twai_message_t taken;
+    TEST_ASSERT_EQUAL_INT64(INT64_MAX, can_bcm_get_next_throttle_end());
+    TEST_ASSERT_TRUE(can_bcm_filter_frame(1000, &frame));
+    frame.data[0] = 2;
+    TEST_ASSERT_FALSE(can_bcm_filter_frame(20000, &frame));
+    frame.data[0] = 3;
+    TEST_ASSERT_FALSE(can_bcm_filter_frame(50000, &frame));
+    TEST_ASSERT_EQUAL_INT64(101000, can_bcm_get_next_throttle_end());
+
+    TEST_ASSERT_FALSE(can_bcm_take_throttled_frame(100999, &taken));
+    TEST_ASSERT_TRUE(can_bcm_take_throttled_frame(101000, &taken));
+    TEST_ASSERT_EQUAL_HEX8(3, taken.data[0]);
+    TEST_ASSERT_FALSE(can_bcm_take_throttled_frame(200000, &taken));
+    TEST_ASSERT_EQUAL_INT64(INT64_MAX, can_bcm_get_next_throttle_end());
+
+    // The interval restarts with the released frame
+    frame.data[0] = 4;
+    TEST_ASSERT_FALSE(can_bcm_filter_frame(150000, &frame));
+    TEST_ASSERT_TRUE(can_bcm_filter_frame(201000, &frame));
+    TEST_ASSERT_FALSE(can_bcm_take_throttled_frame(400000, &taken)); // Forwarded directly, nothing held back
+}
+
+// A filter that is replaced starts over
+void test_rx_filter_replace(void) {
+    const uint8_t mask[8] = { 0xFF };
+    TEST_ASSERT_TRUE(can_bcm_add_rx_filter(0, 0x400, true, mask));
+    const twai_message_t frame = make_frame(0x400, true, 1, 5);
+    TEST_ASSERT_TRUE(can_bcm_filter_frame(0, &frame));
+    TEST_ASSERT_FALSE(can_bcm_filter_frame(1, &frame));
+    TEST_ASSERT_TRUE(can_bcm_add_rx_filter(0, 0x400, true, mask));
+    TEST_ASSERT_TRUE(can_bcm_filter_frame(2, &frame));
+
+    // The table holds CAN_BCM_MAX_RX_FILTERS filters
+    can_bcm_reset();
+    for (uint32_t i = 0; i < CAN_BCM_MAX_RX_FILTERS; ++i) { TEST_ASSERT_TRUE(can_bcm_add_rx_filter(0, i, false, NULL)); }
+    TEST_ASSERT_FALSE(can_bcm_add_rx_filter(0, 0x7FF, false, NULL));
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_tx_job_interval);
+    RUN_TEST(test_tx_job_update);
+    RUN_TEST(test_tx_job_replace_and_delete);
+    RUN_TEST(test_tx_job_table);
+    RUN_TEST(test_rx_subscription);
+    RUN_TEST(test_rx_content_filter);
+    RUN_TEST(test_rx_throttle);
+    RUN_TEST(test_rx_filter_replace);
+    return UNITY_END();
+}
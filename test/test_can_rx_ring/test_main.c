@@ -0,0 +1,196 @@
+// Host tests of the RX ring (pio test -e native -f test_can_rx_ring)
+// The benchmark reports how many frames per second go through push/wait/get/release.
+#include <unity.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "../../src/can_rx_ring.c"
+
+
+static twai_message_t make_frame(const uint32_t identifier, const bool extended, const uint8_t dlc) {
+    twai_message_t message = {};
+    message.identifier = identifier;
+    message.extd = extended;
+    message.data_length_code = dlc;
+    for (uint32_t i = 0; i < 8; ++i) { message.data[i] = (uint8_t) (identifier + i); }
+    return message;
+}
+
+// Take the oldest frame
+static bool take_frame(twai_message_t* const message, int64_t* const timestamp_us) {
+    const int32_t index = can_rx_ring_wait(0);
+    if (index < 0) { return false; }
+    can_rx_record_to_message(can_rx_ring_get(index), message);
+    *timestamp_us = can_rx_ring_get_timestamp(index);
+    can_rx_ring_release(index);
+    return true;
+}
+
+
+
+void setUp(void) {
+    can_rx_ring_init();
+    can_rx_ring_clear();
+    can_rx_ring_take_overflow();
+}
+void tearDown(void) {}
+
+// Frames come out in order and unchanged
+void test_round_trip(void) {
+    twai_message_t frames[4] = { make_frame(0x123, false, 8), make_frame(0x1FFFFFFF, true, 0), make_frame(0x7FF, false, 15), make_frame(0, true, 3) };
+    frames[1].rtr = 1;
+    for (uint32_t i = 0; i < 4; ++i) { TEST_ASSERT_TRUE(can_rx_ring_push(&frames[i], 1000 + i)); }
+    TEST_ASSERT_EQUAL_UINT32(4, can_rx_ring_get_count());
+
+    for (uint32_t i = 0; i < 4; ++i) {
+        twai_message_t message;
+        int64_t timestamp_us;
+        TEST_ASSERT_TRUE(take_frame(&message, &timestamp_us));
+        TEST_ASSERT_EQUAL_HEX32(frames[i].identifier, message.identifier);
+        TEST_ASSERT_EQUAL_UINT32(frames[i].extd, message.extd);
+        TEST_ASSERT_EQUAL_UINT32(frames[i].rtr, message.rtr);
+        TEST_ASSERT_EQUAL_UINT32(frames[i].data_length_code, message.data_length_code);
+        TEST_ASSERT_EQUAL_MEMORY(frames[i].data, message.data, 8);
+        TEST_ASSERT_EQUAL_INT64(1000 + i, timestamp_us);
+    }
+    TEST_ASSERT_EQUAL_INT32(-1, can_rx_ring_wait(0));
+}
+
+// A full ring drops new frames and reports it once
+void test_full_ring(void) {
+    const twai_message_t frame = make_frame(0x100, false, 1);
+    const uint32_t dropped = can_rx_ring_get_dropped_count();
+    for (uint32_t i = 0; i < CAN_RX_RING_SIZE; ++i) { TEST_ASSERT_TRUE(can_rx_ring_push(&frame, i)); }
+    TEST_ASSERT_FALSE(can_rx_ring_push(&frame, CAN_RX_RING_SIZE));
+    TEST_ASSERT_EQUAL_UINT32(dropped + 1, can_rx_ring_get_dropped_count());
+    TEST_ASSERT_EQUAL_UINT32(CAN_RX_RING_SIZE, can_rx_ring_get_high_water_mark());
+    TEST_ASSERT_TRUE(can_rx_ring_take_overflow());
+    TEST_ASSERT_FALSE(can_rx_ring_take_overflow());
+
+    // Space again after a release, the indices wrap around
+    twai_message_t message;
+    int64_t timestamp_us;
+    TEST_ASSERT_TRUE(take_frame(&message, &timestamp_us));
+    TEST_ASSERT_TRUE(can_rx_ring_push(&frame, CAN_RX_RING_SIZE + 1));
+    for (uint32_t i = 1; i < CAN_RX_RING_SIZE; ++i) {
+        TEST_ASSERT_TRUE(take_frame(&message, &timestamp_us));
+        TEST_ASSERT_EQUAL_INT64(i, timestamp_us);
+    }
+    TEST_ASSERT_TRUE(take_frame(&message, &timestamp_us));
+    TEST_ASSERT_EQUAL_INT64(CAN_RX_RING_SIZE + 1, timestamp_us);
+}
+
+// Only the oldest frame can be released
+void test_release_oldest_only(void) {
+    const twai_message_t frame = make_frame(0x100, false, 1);
+    TEST_ASSERT_TRUE(can_rx_ring_push(&frame, 0));
+    TEST_ASSERT_TRUE(can_rx_ring_push(&frame, 1));
+    const int32_t index = can_rx_ring_wait(0);
+    can_rx_ring_release(index + 1);
+    TEST_ASSERT_EQUAL_UINT32(2, can_rx_ring_get_count());
+    can_rx_ring_release(index);
+    TEST_ASSERT_EQUAL_UINT32(1, can_rx_ring_get_count());
+}
+
+// A frame buffered far longer than the 28 bit timestamp range (~268 s) keeps its timestamp
+void test_timestamp_long_buffered(void) {
+    const twai_message_t frame = make_frame(0x100, false, 1);
+    const int64_t start_us = 5000000000LL; // ~83 min after startup
+    TEST_ASSERT_TRUE(can_rx_ring_push(&frame, start_us));
+    TEST_ASSERT_TRUE(can_rx_ring_push(&frame, start_us + 200000000LL)); // Switches the epoch
+    TEST_ASSERT_TRUE(can_rx_ring_push(&frame, start_us + 260000000LL));
+
+    twai_message_t message;
+    int64_t timestamp_us;
+    TEST_ASSERT_TRUE(take_frame(&message, &timestamp_us));
+    TEST_ASSERT_EQUAL_INT64(start_us, timestamp_us);
+
+    // The first epoch is free again, so frames can follow much later
+    TEST_ASSERT_TRUE(can_rx_ring_push(&frame, start_us + 1000000000LL));
+    TEST_ASSERT_TRUE(take_frame(&message, &timestamp_us));
+    TEST_ASSERT_EQUAL_INT64(start_us + 200000000LL, timestamp_us);
+    TEST_ASSERT_TRUE(take_frame(&message, &timestamp_us));
+    TEST_ASSERT_EQUAL_INT64(start_us + 260000000LL, timestamp_us);
+    TEST_ASSERT_TRUE(take_frame(&message, &timestamp_us));
+    TEST_ASSERT_EQUAL_INT64(start_us + 1000000000LL, timestamp_us);
+}
+
+// A frame that can't be stored relative to either epoch is dropped and reported
+void test_timestamp_out_of_range(void) {
+    const twai_message_t frame = make_frame(0x100, false, 1);
+    const uint32_t dropped = can_rx_ring_get_dropped_count();
+    TEST_ASSERT_TRUE(can_rx_ring_push(&frame, 0));
+    TEST_ASSERT_TRUE(can_rx_ring_push(&frame, 150000000LL)); // Second epoch
+    TEST_ASSERT_TRUE(can_rx_ring_push(&frame, 150000000LL + CAN_RX_RECORD_TIMESTAMP_MASK));
+    TEST_ASSERT_FALSE(can_rx_ring_push(&frame, 150000000LL + CAN_RX_RECORD_TIMESTAMP_MASK + 1));
+    TEST_ASSERT_EQUAL_UINT32(dropped + 1, can_rx_ring_get_dropped_count());
+    TEST_ASSERT_TRUE(can_rx_ring_take_overflow());
+
+    // Frames that are taken in time all have exact timestamps
+    twai_message_t message;
+    int64_t timestamp_us;
+    TEST_ASSERT_TRUE(take_frame(&message, &timestamp_us));
+    TEST_ASSERT_EQUAL_INT64(0, timestamp_us);
+    TEST_ASSERT_TRUE(take_frame(&message, &timestamp_us));
+    TEST_ASSERT_EQUAL_INT64(150000000LL, timestamp_us);
+    TEST_ASSERT_TRUE(take_frame(&message, &timestamp_us));
+    TEST_ASSERT_EQUAL_INT64(150000000LL + CAN_RX_RECORD_TIMESTAMP_MASK, timestamp_us);
+}
+
+// Steady traffic over an hour: the epochs alternate and every timestamp is exact
+void test_timestamp_steady_traffic(void) {
+    const twai_message_t frame = make_frame(0x100, false, 1);
+    twai_message_t message;
+    int64_t timestamp_us;
+    const int64_t step_us = 7777777; // ~7.8 s
+    TEST_ASSERT_TRUE(can_rx_ring_push(&frame, 0));
+    for (int64_t t = step_us; t < 3600000000LL; t += step_us) {
+        TEST_ASSERT_TRUE(can_rx_ring_push(&frame, t));
+        TEST_ASSERT_TRUE(take_frame(&message, &timestamp_us)); // One frame always stays buffered
+        TEST_ASSERT_EQUAL_INT64(t - step_us, timestamp_us);
+    }
+}
+
+// The consumer can be woken without a frame
+void test_wake(void) {
+    can_rx_ring_wake();
+    TEST_ASSERT_EQUAL_INT32(-1, can_rx_ring_wait(10));
+}
+
+// Benchmark: frames through the ring (single threaded, push and take alternating in bursts)
+void test_benchmark(void) {
+    const twai_message_t frame = make_frame(0x123, false, 8);
+    const uint32_t rounds = 20000;
+    const uint32_t burst = 64;
+    uint64_t sum = 0;
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (uint32_t r = 0; r < rounds; ++r) {
+        for (uint32_t i = 0; i < burst; ++i) { can_rx_ring_push(&frame, (int64_t) r * burst + i); }
+        for (uint32_t i = 0; i < burst; ++i) {
+            const int32_t index = can_rx_ring_wait(0);
+            twai_message_t message;
+            can_rx_record_to_message(can_rx_ring_get(index), &message);
+            sum += can_rx_ring_get_timestamp(index) + message.data[7];
+            can_rx_ring_release(index);
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    const double seconds = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) * 1e-9;
+    char message[96];
+    snprintf(message, sizeof(message), "%.1f M frames/s (checksum %llu)", rounds * burst / seconds * 1e-6, (unsigned long long) sum);
+    TEST_MESSAGE(message);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_round_trip);
+    RUN_TEST(test_full_ring);
+    RUN_TEST(test_release_oldest_only);
+    RUN_TEST(test_timestamp_long_buffered);
+    RUN_TEST(test_timestamp_out_of_range);
+    RUN_TEST(test_timestamp_steady_traffic);
+    RUN_TEST(test_wake);
+    RUN_TEST(test_benchmark);
+    return UNITY_END();
+}
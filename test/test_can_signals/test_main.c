@@ -0,0 +1,290 @@
+// Host tests of the signal decoder (pio test -e native -f test_can_signals)
+// The decoded values are compared with hand made vectors and with a bit by bit reference decoder.
+// The benchmark compares the compiled extraction plans with the reference decoder (signals/s).
+#include <unity.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../../src/buffer_access.c"
+#include "../../src/can_signals.c"
+
+
+// Signal database builder
+typedef struct {
+    uint32_t identifier;
+    uint16_t signal_id;
+    uint8_t start_bit;
+    uint8_t length;
+    uint8_t flags;
+    float scale;
+    float offset;
+} test_signal_t;
+
+static uint8_t database[CAN_SIGNALS_MAX_DATABASE_SIZE + CAN_SIGNALS_ENTRY_SIZE];
+
+static uint32_t build_database(const test_signal_t* const signals, const uint32_t count) {
+    memset(database, 0, sizeof(database));
+    memcpy(database, CAN_SIGNALS_MAGIC, 4);
+    copy_uint16_into_buffer_12((uint16_t) count, database + 4);
+    copy_uint16_into_buffer_12(CAN_SIGNALS_ENTRY_SIZE, database + 6);
+    for (uint32_t i = 0; i < count; ++i) {
+        uint8_t* const entry = database + CAN_SIGNALS_HEADER_SIZE + i * CAN_SIGNALS_ENTRY_SIZE;
+        copy_uint32_into_buffer_1234(signals[i].identifier, entry + 0);
+        copy_uint16_into_buffer_12(signals[i].signal_id, entry + 4);
+        entry[6] = signals[i].start_bit;
+        entry[7] = signals[i].length;
+        entry[8] = signals[i].flags;
+        copy_float_into_buffer(signals[i].scale, entry + 12, LITTLE_ENDIAN);
+        copy_float_into_buffer(signals[i].offset, entry + 16, LITTLE_ENDIAN);
+    }
+    const uint32_t size = CAN_SIGNALS_HEADER_SIZE + count * CAN_SIGNALS_ENTRY_SIZE;
+    copy_uint32_into_buffer_1234(esp_rom_crc32_le(0, database + CAN_SIGNALS_HEADER_SIZE, size - CAN_SIGNALS_HEADER_SIZE), database + 8);
+    return size;
+}
+
+// Reference decoder: walks the signal bit by bit (DBC bit numbering)
+static float reference_decode(const test_signal_t* const signal, const uint8_t* const data) {
+    uint64_t raw = 0;
+    uint32_t bit = signal->start_bit;
+    for (uint32_t k = 0; k < signal->length; ++k) {
+        const uint64_t value = (data[bit / 8] >> (bit % 8)) & 1;
+        if (signal->flags & CAN_SIGNALS_FLAG_MOTOROLA) {
+            // MSB first, continue with the MSB of the next byte after bit 0 of a byte
+            raw = (raw << 1) | value;
+            bit = (bit % 8 == 0 ? bit + 15 : bit - 1);
+        }
+        else {
+            raw |= value << k;
+            bit += 1;
+        }
+    }
+    if ((signal->flags & CAN_SIGNALS_FLAG_SIGNED) && signal->length < 64 && (raw >> (signal->length - 1)) & 1) {
+        raw |= UINT64_MAX << signal->length;
+    }
+    const double value = ((signal->flags & CAN_SIGNALS_FLAG_SIGNED) ? (double) (int64_t) raw : (double) raw);
+    return (float) value * signal->scale + signal->offset;
+}
+
+static uint32_t random_state = 1;
+static uint32_t random_uint32(void) {
+    random_state = random_state * 1103515245u + 12345u;
+    return random_state >> 8;
+}
+
+// A random signal that fits into a frame of 8 bytes
+static void random_signal(test_signal_t* const signal, const uint32_t identifier, const uint16_t signal_id) {
+    signal->identifier = identifier;
+    signal->signal_id = signal_id;
+    signal->flags = random_uint32() % 4;
+    signal->length = 1 + random_uint32() % 64;
+    if (signal->flags & CAN_SIGNALS_FLAG_MOTOROLA) {
+        const uint32_t msb = random_uint32() % (65 - signal->length); // Counted from the MSB of the first byte
+        signal->start_bit = (msb / 8) * 8 + (7 - msb % 8);
+    }
+    else {
+        signal->start_bit = random_uint32() % (65 - signal->length);
+    }
+    signal->scale = (random_uint32() % 2 ? 1.0f : 0.125f);
+    signal->offset = (float) (random_uint32() % 100) - 50.0f;
+}
+
+
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// Hand made vectors
+void test_known_vectors(void) {
+    const test_signal_t signals[] = {
+        { 0x100, 1, 8, 16, 0, 0.5f, -10.0f },                                   // Intel, bytes 1-2
+        { 0x100, 2, 7, 12, CAN_SIGNALS_FLAG_MOTOROLA, 1.0f, 0.0f },              // Motorola, first 12 bits
+        { 0x100, 3, 23, 8, CAN_SIGNALS_FLAG_MOTOROLA | CAN_SIGNALS_FLAG_SIGNED, 1.0f, 0.0f }, // Byte 2 signed
+        { 0x100, 4, 28, 4, CAN_SIGNALS_FLAG_SIGNED, 1.0f, 0.0f },                // High nibble of byte 3 signed
+        { 0x100, 5, 12, 10, CAN_SIGNALS_FLAG_MOTOROLA, 1.0f, 0.0f },             // Motorola across bytes 1-2
+        { 0x200 | CAN_SIGNALS_EXTENDED_ID_FLAG, 6, 0, 64, 0, 1.0f, 0.0f },        // Whole extended frame
+    };
+    TEST_ASSERT_TRUE(can_signals_load_database(database, build_database(signals, 6)));
+    TEST_ASSERT_EQUAL_UINT32(6, can_signals_get_count());
+
+    const uint8_t frame[8] = { 0xAB, 0x34, 0xFE, 0x80, 0, 0, 0, 0x01 };
+    can_signal_value_t values[8];
+    TEST_ASSERT_EQUAL_UINT32(5, can_signals_decode_frame(0x100, false, frame, 8, values, 8));
+    TEST_ASSERT_EQUAL_UINT16(1, values[0].signal_id);
+    TEST_ASSERT_FLOAT_WITHIN(0.0f, 0xFE34 * 0.5f - 10.0f, values[0].value);
+    TEST_ASSERT_FLOAT_WITHIN(0.0f, 0xAB3, values[1].value);
+    TEST_ASSERT_FLOAT_WITHIN(0.0f, -2.0f, values[2].value);
+    TEST_ASSERT_FLOAT_WITHIN(0.0f, -8.0f, values[3].value);
+    // Bits 4-0 of byte 1 (0x14) and bits 7-3 of byte 2 (0x1F)
+    TEST_ASSERT_FLOAT_WITHIN(0.0f, (0x14 << 5) | 0x1F, values[4].value);
+
+    // Identifiers with the extended flag don't match standard frames
+    TEST_ASSERT_EQUAL_UINT32(0, can_signals_decode_frame(0x200, false, frame, 8, values, 8));
+    TEST_ASSERT_EQUAL_UINT32(1, can_signals_decode_frame(0x200, true, frame, 8, values, 8));
+    TEST_ASSERT_FLOAT_WITHIN(0.0f, (float) 0x01000000FE8034ABull, values[0].value);
+
+    // Signals beyond the DLC are skipped
+    TEST_ASSERT_EQUAL_UINT32(1, can_signals_decode_frame(0x100, false, frame, 2, values, 8));
+    TEST_ASSERT_EQUAL_UINT16(2, values[0].signal_id);
+    TEST_ASSERT_EQUAL_UINT16(1, can_signals_decode_frame(0x100, false, frame, 8, values, 1));
+}
+
+// Random signals against the bit by bit reference
+void test_reference(void) {
+    enum { SIGNALS = 200, IDENTIFIERS = 20 };
+    static test_signal_t signals[SIGNALS];
+    for (uint32_t i = 0; i < SIGNALS; ++i) { random_signal(&signals[i], 0x100 + random_uint32() % IDENTIFIERS, (uint16_t) i); }
+    TEST_ASSERT_TRUE(can_signals_load_database(database, build_database(signals, SIGNALS)));
+
+    for (uint32_t round = 0; round < 2000; ++round) {
+        uint8_t frame[8];
+        for (uint32_t k = 0; k < 8; ++k) { frame[k] = (uint8_t) random_uint32(); }
+        const uint32_t identifier = 0x100 + round % IDENTIFIERS;
+        can_signal_value_t values[SIGNALS];
+        const uint32_t count = can_signals_decode_frame(identifier, false, frame, 8, values, SIGNALS);
+
+        // Values come in upload order
+        uint32_t n = 0;
+        for (uint32_t i = 0; i < SIGNALS; ++i) {
+            if (signals[i].identifier != identifier) { continue; }
+            TEST_ASSERT_TRUE(n < count);
+            TEST_ASSERT_EQUAL_UINT16(signals[i].signal_id, values[n].signal_id);
+            TEST_ASSERT_FLOAT_WITHIN(0.0f, reference_decode(&signals[i], frame), values[n].value);
+            n += 1;
+        }
+        TEST_ASSERT_EQUAL_UINT32(n, count);
+    }
+}
+
+// Invalid databases are rejected and the current one is kept
+void test_invalid_database(void) {
+    test_signal_t signal = { 0x123, 7, 0, 8, 0, 1.0f, 0.0f };
+    TEST_ASSERT_TRUE(can_signals_load_database(database, build_database(&signal, 1)));
+
+    signal.length = 0;
+    TEST_ASSERT_FALSE(can_signals_load_database(database, build_database(&signal, 1)));
+    signal.length = 9; signal.start_bit = 56;
+    TEST_ASSERT_FALSE(can_signals_load_database(database, build_database(&signal, 1)));
+    signal.length = 2; signal.start_bit = 56; signal.flags = CAN_SIGNALS_FLAG_MOTOROLA; // Bit 56 is the last bit in Motorola order
+    TEST_ASSERT_FALSE(can_signals_load_database(database, build_database(&signal, 1)));
+
+    signal.length = 8; signal.flags = 0;
+    uint32_t size = build_database(&signal, 1);
+    database[CAN_SIGNALS_HEADER_SIZE] ^= 1;
+    TEST_ASSERT_FALSE(can_signals_load_database(database, size));
+    size = build_database(&signal, 1);
+    TEST_ASSERT_FALSE(can_signals_load_database(database, size - 1));
+    database[0] = 'X';
+    TEST_ASSERT_FALSE(can_signals_load_database(database, size));
+    TEST_ASSERT_FALSE(can_signals_load_database(database, 4));
+
+    // Still the first database
+    const uint8_t frame[1] = { 0x42 };
+    can_signal_value_t value;
+    TEST_ASSERT_EQUAL_UINT32(1, can_signals_decode_frame(0x123, false, frame, 1, &value, 1));
+    TEST_ASSERT_EQUAL_UINT16(7, value.signal_id);
+
+    can_signals_clear_database();
+    TEST_ASSERT_EQUAL_UINT32(0, can_signals_get_count());
+    TEST_ASSERT_EQUAL_UINT32(0, can_signals_decode_frame(0x123, false, frame, 1, &value, 1));
+}
+
+// Statistics of a window
+static can_signal_stats_t reported[4];
+static uint32_t reported_count = 0;
+static void collect_stats(void* ctx, const can_signal_stats_t* stats) {
+    (void) ctx;
+    reported[reported_count++] = *stats;
+}
+
+void test_window_stats(void) {
+    const test_signal_t signals[] = {
+        { 0x10, 1, 0, 8, CAN_SIGNALS_FLAG_SIGNED, 1.0f, 0.0f },
+        { 0x10, 2, 8, 8, 0, 1.0f, 0.0f },
+        { 0x20, 3, 0, 8, 0, 1.0f, 0.0f },
+    };
+    TEST_ASSERT_TRUE(can_signals_load_database(database, build_database(signals, 3)));
+    const uint8_t frames[3][2] = { { 5, 1 }, { 0xFD, 2 }, { 10 } };
+    TEST_ASSERT_EQUAL_UINT32(2, can_signals_aggregate_frame(0x10, false, frames[0], 2));
+    TEST_ASSERT_EQUAL_UINT32(2, can_signals_aggregate_frame(0x10, false, frames[1], 2));
+    TEST_ASSERT_EQUAL_UINT32(1, can_signals_aggregate_frame(0x10, false, frames[2], 1));
+
+    reported_count = 0;
+    TEST_ASSERT_EQUAL_UINT32(2, can_signals_flush_window(collect_stats, NULL));
+    TEST_ASSERT_EQUAL_UINT32(2, reported_count);
+    TEST_ASSERT_EQUAL_UINT16(1, reported[0].signal_id);
+    TEST_ASSERT_EQUAL_UINT32(3, reported[0].count);
+    TEST_ASSERT_FLOAT_WITHIN(0.0f, -3.0f, reported[0].min);
+    TEST_ASSERT_FLOAT_WITHIN(0.0f, 10.0f, reported[0].max);
+    TEST_ASSERT_FLOAT_WITHIN(0.0f, 10.0f, reported[0].last);
+    TEST_ASSERT_FLOAT_WITHIN(0.0f, 12.0f, (float) reported[0].sum);
+    TEST_ASSERT_EQUAL_UINT16(2, reported[1].signal_id);
+    TEST_ASSERT_EQUAL_UINT32(2, reported[1].count);
+
+    // The next window starts empty
+    TEST_ASSERT_EQUAL_UINT32(0, can_signals_flush_window(collect_stats, NULL));
+}
+
+// Compiled plans against the bit by bit reference, same signals and frames
+void test_benchmark(void) {
+    enum { SIGNALS = CAN_SIGNALS_MAX_SIGNALS, IDENTIFIERS = 64, FRAMES = 1024, ROUNDS = 200 };
+    static test_signal_t signals[SIGNALS];
+    static uint16_t by_identifier[IDENTIFIERS][SIGNALS]; // Signals of each identifier for the reference
+    static uint32_t identifier_count[IDENTIFIERS];
+    static uint8_t frames[FRAMES][8];
+    memset(identifier_count, 0, sizeof(identifier_count));
+    for (uint32_t i = 0; i < SIGNALS; ++i) {
+        const uint32_t k = random_uint32() % IDENTIFIERS;
+        random_signal(&signals[i], 0x100 + k, (uint16_t) i);
+        by_identifier[k][identifier_count[k]++] = (uint16_t) i;
+    }
+    for (uint32_t f = 0; f < FRAMES; ++f) {
+        for (uint32_t k = 0; k < 8; ++k) { frames[f][k] = (uint8_t) random_uint32(); }
+    }
+    TEST_ASSERT_TRUE(can_signals_load_database(database, build_database(signals, SIGNALS)));
+
+    can_signal_value_t values[SIGNALS];
+    volatile float sink = 0;
+    uint64_t decoded = 0;
+    struct timespec t0, t1, t2;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (uint32_t r = 0; r < ROUNDS; ++r) {
+        for (uint32_t f = 0; f < FRAMES; ++f) {
+            const uint32_t n = can_signals_decode_frame(0x100 + f % IDENTIFIERS, false, frames[f], 8, values, SIGNALS);
+            if (n > 0) { sink += values[n - 1].value; }
+            decoded += n;
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    uint64_t reference_decoded = 0;
+    for (uint32_t r = 0; r < ROUNDS; ++r) {
+        for (uint32_t f = 0; f < FRAMES; ++f) {
+            const uint32_t k = f % IDENTIFIERS;
+            for (uint32_t i = 0; i < identifier_count[k]; ++i) {
+                values[i].signal_id = signals[by_identifier[k][i]].signal_id;
+                values[i].value = reference_decode(&signals[by_identifier[k][i]], frames[f]);
+            }
+            if (identifier_count[k] > 0) { sink += values[identifier_count[k] - 1].value; }
+            reference_decoded += identifier_count[k];
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t2);
+    TEST_ASSERT_EQUAL_UINT32((uint32_t) reference_decoded, (uint32_t) decoded);
+
+    const double plan_s = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) * 1e-9;
+    const double reference_s = (t2.tv_sec - t1.tv_sec) + (t2.tv_nsec - t1.tv_nsec) * 1e-9;
+    char message[128];
+    snprintf(message, sizeof(message), "%u signals on %u identifiers: plans %.1f M signals/s, bit loop %.1f M signals/s",
+        SIGNALS, IDENTIFIERS, decoded / plan_s * 1e-6, reference_decoded / reference_s * 1e-6);
+    TEST_MESSAGE(message);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_known_vectors);
+    RUN_TEST(test_reference);
+    RUN_TEST(test_invalid_database);
+    RUN_TEST(test_window_stats);
+    RUN_TEST(test_benchmark);
+    return UNITY_END();
+}
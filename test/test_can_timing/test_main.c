@@ -0,0 +1,130 @@
+// Host tests of the bit timing calculations (pio test -e native -f test_can_timing)
+// Reference values: the ESP-IDF TWAI_TIMING_CONFIG_* macros and the Lawicel CAN232 BTR table (16 MHz SJA1000).
+#include <unity.h>
+
+#include "../../src/can_timing.c"
+
+
+typedef struct {
+    uint32_t bitrate;
+    uint32_t sample_point;
+    uint32_t brp;
+    uint8_t tseg_1;
+    uint8_t tseg_2;
+} timing_reference_t;
+
+static void check_calculate(const timing_reference_t* const reference) {
+    twai_timing_config_t timing = {};
+    char message[64];
+    snprintf(message, sizeof(message), "%u bit/s, %u permille", reference->bitrate, reference->sample_point);
+    TEST_ASSERT_TRUE_MESSAGE(can_timing_calculate(reference->bitrate, reference->sample_point, &timing), message);
+    TEST_ASSERT_TRUE_MESSAGE(can_timing_is_valid(&timing), message);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(reference->brp, timing.brp, message);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(reference->tseg_1, timing.tseg_1, message);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(reference->tseg_2, timing.tseg_2, message);
+}
+
+
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// Same timings as the ESP-IDF macros for their sample points
+void test_idf_macros(void) {
+    const timing_reference_t references[] = {
+        {   25000, 800, 128, 16, 8 },
+        {   50000, 800,  80, 15, 4 },
+        {  100000, 800,  40, 15, 4 },
+        {  125000, 800,  32, 15, 4 },
+        {  250000, 800,  16, 15, 4 },
+        {  500000, 800,   8, 15, 4 },
+        {  800000, 680,   4, 16, 8 },
+        { 1000000, 800,   4, 15, 4 }
+    };
+    for (uint32_t i = 0; i < sizeof(references) / sizeof(references[0]); ++i) { check_calculate(&references[i]); }
+}
+
+// Within the sample point tolerance more time quanta win over a closer sample point
+void test_prefer_more_quanta(void) {
+    const timing_reference_t references[] = {
+        { 1000000, 875,   4, 16, 3 }, // 20 tq at 850 instead of 8 tq at 875
+        {  500000, 875,   8, 16, 3 },
+        {  250000, 875,  16, 16, 3 },
+        {   33333, 875, 120, 16, 3 },
+        {   83333, 875,  48, 16, 3 }, // 20 tq at 850 instead of 16 tq at 875
+        {  666666, 875,   6, 16, 3 }  // 20 tq at 850 instead of 15 tq at 867
+    };
+    for (uint32_t i = 0; i < sizeof(references) / sizeof(references[0]); ++i) { check_calculate(&references[i]); }
+}
+
+// Outside the tolerance the closest sample point wins
+void test_closest_sample_point(void) {
+    // 1 Mbit/s at 700 permille: 20 tq gives 700 exactly
+    const timing_reference_t exact = { 1000000, 700, 4, 13, 6 };
+    check_calculate(&exact);
+
+    // 1 Mbit/s at 950 permille: 20 tq reach 850 at most (tseg_1 <= 16), 10 tq reach 900
+    const timing_reference_t high = { 1000000, 950, 8, 8, 1 };
+    check_calculate(&high);
+}
+
+// Bitrates the controller can't reach closely enough and invalid arguments
+void test_invalid(void) {
+    twai_timing_config_t timing = {};
+    TEST_ASSERT_FALSE(can_timing_calculate(1000001, 875, &timing));
+    TEST_ASSERT_FALSE(can_timing_calculate(10000, 875, &timing));
+    TEST_ASSERT_FALSE(can_timing_calculate(5000000, 875, &timing));
+    TEST_ASSERT_FALSE(can_timing_calculate(0, 875, &timing));
+    TEST_ASSERT_FALSE(can_timing_calculate(500000, 0, &timing));
+    TEST_ASSERT_FALSE(can_timing_calculate(500000, 1000, &timing));
+}
+
+// Lawicel BTR table: the segments are kept, the bitrate matches
+void test_btr_table(void) {
+    const struct { uint8_t btr0; uint8_t btr1; uint32_t bitrate; uint32_t brp; } references[] = {
+        { 0x09, 0x1C,   50000, 100 },
+        { 0x04, 0x1C,  100000,  50 },
+        { 0x03, 0x1C,  125000,  40 },
+        { 0x01, 0x1C,  250000,  20 },
+        { 0x00, 0x1C,  500000,  10 },
+        { 0x00, 0x16,  800000,  10 },
+        { 0x00, 0x14, 1000000,  10 },
+        { 0x0B, 0x2F,   33333, 120 },
+        { 0x03, 0x6F,   83333,  40 }
+    };
+    for (uint32_t i = 0; i < sizeof(references) / sizeof(references[0]); ++i) {
+        twai_timing_config_t timing = {};
+        TEST_ASSERT_TRUE(can_timing_from_btr(references[i].btr0, references[i].btr1, &timing));
+        TEST_ASSERT_EQUAL_UINT32(references[i].bitrate, can_timing_get_bitrate(&timing));
+        TEST_ASSERT_EQUAL_UINT32(references[i].brp, timing.brp);
+        TEST_ASSERT_EQUAL_UINT32((references[i].btr1 & 0x0F) + 1, timing.tseg_1);
+        TEST_ASSERT_EQUAL_UINT32(((references[i].btr1 >> 4) & 0x07) + 1, timing.tseg_2);
+    }
+
+    // SJW and triple sampling are taken over
+    twai_timing_config_t timing = {};
+    TEST_ASSERT_TRUE(can_timing_from_btr(0x40, 0x9C, &timing));
+    TEST_ASSERT_EQUAL_UINT32(500000, can_timing_get_bitrate(&timing));
+    TEST_ASSERT_EQUAL_UINT32(2, timing.sjw);
+    TEST_ASSERT_TRUE(timing.triple_sampling);
+
+    // A SJW above TSEG2 is invalid, so the timing is calculated (keeping triple sampling)
+    TEST_ASSERT_TRUE(can_timing_from_btr(0x80, 0x9C, &timing));
+    TEST_ASSERT_EQUAL_UINT32(500000, can_timing_get_bitrate(&timing));
+    TEST_ASSERT_TRUE(can_timing_is_valid(&timing));
+    TEST_ASSERT_TRUE(timing.triple_sampling);
+
+    // 10 and 20 kbit/s need prescalers above the controller's maximum
+    TEST_ASSERT_FALSE(can_timing_from_btr(0x31, 0x1C, &timing));
+    TEST_ASSERT_FALSE(can_timing_from_btr(0x18, 0x1C, &timing));
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_idf_macros);
+    RUN_TEST(test_prefer_more_quanta);
+    RUN_TEST(test_closest_sample_point);
+    RUN_TEST(test_invalid);
+    RUN_TEST(test_btr_table);
+    return UNITY_END();
+}
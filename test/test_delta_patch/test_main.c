@@ -0,0 +1,263 @@
+// Host tests of the streaming delta patch applier (pio test -e native -f test_delta_patch)
+// Patches are made like 'delta_make_patch' in scripts/btspp_ota_update.py.
+// Set DELTA_TEST_BASE and DELTA_TEST_TARGET to two firmware .bin files to also report the patch size for them.
+#include <unity.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../../src/buffer_access.c"
+#include "../../src/delta_patch.c"
+
+
+// Patch maker (same parameters as the script, the header hashes are left zero)
+#define BLOCK_SIZE 16
+#define INDEX_STEP 4
+#define MIN_COPY 32
+#define INDEX_SIZE (1u << 20)
+
+static uint32_t block_hash(const uint8_t* p) {
+    uint32_t h = 2166136261u;
+    for (int k = 0; k < BLOCK_SIZE; ++k) { h = (h ^ p[k]) * 16777619u; }
+    return h & (INDEX_SIZE - 1);
+}
+
+static uint32_t append_op(uint8_t* patch, uint32_t len, const uint8_t op, const uint32_t offset, const uint32_t op_len) {
+    patch[len] = op;
+    copy_uint32_into_buffer_1234(offset, patch + len + 1);
+    copy_uint32_into_buffer_1234(op_len, patch + len + 5);
+    return len + DELTA_PATCH_OP_HEADER_SIZE;
+}
+
+static uint32_t append_insert(uint8_t* patch, uint32_t len, const uint8_t* data, const uint32_t n) {
+    len = append_op(patch, len, DELTA_PATCH_OP_INSERT, 0, n);
+    memcpy(patch + len, data, n);
+    return len + n;
+}
+
+static uint8_t* make_patch(const uint8_t* base, const uint32_t base_len, const uint8_t* image, const uint32_t n, uint32_t* patch_len) {
+    // First position of each indexed block (-1 = none), collisions keep the first one
+    int32_t* index = malloc(sizeof(int32_t) * INDEX_SIZE);
+    memset(index, 0xFF, sizeof(int32_t) * INDEX_SIZE);
+    for (uint32_t j = 0; j + BLOCK_SIZE <= base_len; j += INDEX_STEP) {
+        const uint32_t h = block_hash(base + j);
+        if (index[h] < 0) { index[h] = (int32_t) j; }
+    }
+
+    uint8_t* patch = malloc(DELTA_PATCH_HEADER_SIZE + n + (n / MIN_COPY + 2) * DELTA_PATCH_OP_HEADER_SIZE);
+    memset(patch, 0, DELTA_PATCH_HEADER_SIZE);
+    memcpy(patch, DELTA_PATCH_MAGIC, 4);
+    copy_uint32_into_buffer_1234(n, patch + 4);
+    uint32_t len = DELTA_PATCH_HEADER_SIZE;
+
+    uint32_t insert_start = 0;
+    uint32_t i = 0;
+    while (i + BLOCK_SIZE <= n) {
+        const int32_t found = index[block_hash(image + i)];
+        if (found < 0 || memcmp(base + found, image + i, BLOCK_SIZE) != 0) { i += 1; continue; }
+
+        // Extend forwards and backwards into the pending insert
+        uint32_t j = (uint32_t) found;
+        uint32_t length = BLOCK_SIZE;
+        while (i + length < n && j + length < base_len && image[i + length] == base[j + length]) { length += 1; }
+        while (i > insert_start && j > 0 && image[i - 1] == base[j - 1]) { i -= 1; j -= 1; length += 1; }
+        if (length < MIN_COPY) { i += 1; continue; }
+
+        if (i > insert_start) { len = append_insert(patch, len, image + insert_start, i - insert_start); }
+        len = append_op(patch, len, DELTA_PATCH_OP_COPY, j, length);
+        i += length;
+        insert_start = i;
+    }
+    if (insert_start < n) { len = append_insert(patch, len, image + insert_start, n - insert_start); }
+
+    free(index);
+    *patch_len = len;
+    return patch;
+}
+
+
+// Base image access and output collector
+typedef struct {
+    const uint8_t* base;
+    uint32_t base_len;
+    uint8_t* out;
+    uint32_t out_len;
+    uint32_t capacity;
+} context_t;
+
+static bool read_base(void* const ctx, const uint32_t offset, uint8_t* data, const uint32_t len) {
+    const context_t* const context = (const context_t*) ctx;
+    if (offset > context->base_len || len > context->base_len - offset) { return false; }
+    memcpy(data, context->base + offset, len);
+    return true;
+}
+
+static bool collect(void* const ctx, const uint8_t* data, const uint32_t len) {
+    context_t* const context = (context_t*) ctx;
+    if (context->out_len + len > context->capacity) { return false; }
+    memcpy(context->out + context->out_len, data, len);
+    context->out_len += len;
+    return true;
+}
+
+// Apply a patch in blocks of 'block_size' bytes
+static bool apply(const uint8_t* base, const uint32_t base_len, const uint8_t* patch, const uint32_t patch_len, const uint32_t block_size, context_t* const context, const uint32_t capacity) {
+    static delta_patch_t state;
+    delta_patch_init(&state);
+    context->base = base;
+    context->base_len = base_len;
+    context->out = malloc(capacity + 1);
+    context->out_len = 0;
+    context->capacity = capacity;
+    for (uint32_t pos = 0; pos < patch_len; pos += block_size) {
+        const uint32_t n = (patch_len - pos < block_size ? patch_len - pos : block_size);
+        if (!delta_patch_apply(&state, patch + pos, n, read_base, collect, context)) { return false; }
+    }
+    return delta_patch_finished(&state);
+}
+
+// Pseudo random data
+static uint8_t* make_data(const uint32_t n, uint32_t seed) {
+    uint8_t* data = malloc(n + 1);
+    for (uint32_t i = 0; i < n; ++i) {
+        seed = seed * 1103515245u + 12345u;
+        data[i] = (uint8_t) (seed >> 16);
+    }
+    return data;
+}
+
+static void check_round_trip(const uint8_t* base, const uint32_t base_len, const uint8_t* image, const uint32_t n, uint32_t* patch_size) {
+    uint32_t patch_len = 0;
+    uint8_t* patch = make_patch(base, base_len, image, n, &patch_len);
+    static const uint32_t block_sizes[] = { 1, 9, 100, 4096, 1u << 24 };
+    for (uint32_t b = 0; b < sizeof(block_sizes) / sizeof(block_sizes[0]); ++b) {
+        context_t context;
+        TEST_ASSERT_TRUE(apply(base, base_len, patch, patch_len, block_sizes[b], &context, n));
+        TEST_ASSERT_EQUAL_UINT32(n, context.out_len);
+        TEST_ASSERT_EQUAL_MEMORY(image, context.out, n);
+        free(context.out);
+    }
+    if (patch_size != NULL) { *patch_size = patch_len; }
+    free(patch);
+}
+
+
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// Same image: one copy operation
+void test_identical(void) {
+    uint8_t* base = make_data(100000, 1);
+    uint32_t patch_size = 0;
+    check_round_trip(base, 100000, base, 100000, &patch_size);
+    TEST_ASSERT_EQUAL_UINT32(DELTA_PATCH_HEADER_SIZE + DELTA_PATCH_OP_HEADER_SIZE, patch_size);
+    free(base);
+}
+
+// A few changed, inserted and removed ranges (like a small code change that moves the rest)
+void test_small_change(void) {
+    const uint32_t n = 256 * 1024;
+    uint8_t* base = make_data(n, 2);
+    uint8_t* image = malloc(n + 4096);
+    uint32_t len = 0;
+    memcpy(image, base, 50000); len = 50000;
+    memcpy(image + len, "new code", 8); len += 8; // Insert
+    memcpy(image + len, base + 50000, 100000); len += 100000;
+    memcpy(image + len, base + 150100, 60000); len += 60000; // 100 bytes removed
+    for (uint32_t k = 0; k < 2000; ++k) { image[len + k] = (uint8_t) (k * 7); } len += 2000; // Replaced
+    memcpy(image + len, base + 212100, n - 212100); len += n - 212100;
+
+    uint32_t patch_size = 0;
+    check_round_trip(base, n, image, len, &patch_size);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(DELTA_PATCH_HEADER_SIZE + 2008 + 8 * DELTA_PATCH_OP_HEADER_SIZE, patch_size);
+    free(base);
+    free(image);
+}
+
+// Nothing in common: the whole image is inserted
+void test_unrelated(void) {
+    uint8_t* base = make_data(20000, 3);
+    uint8_t* image = make_data(30000, 4);
+    uint32_t patch_size = 0;
+    check_round_trip(base, 20000, image, 30000, &patch_size);
+    TEST_ASSERT_EQUAL_UINT32(DELTA_PATCH_HEADER_SIZE + DELTA_PATCH_OP_HEADER_SIZE + 30000, patch_size);
+    free(base);
+    free(image);
+}
+
+// Corrupted patches are rejected
+void test_errors(void) {
+    uint8_t* base = make_data(1000, 5);
+    uint8_t patch[DELTA_PATCH_HEADER_SIZE + 2 * DELTA_PATCH_OP_HEADER_SIZE] = {};
+    context_t context;
+    memcpy(patch, DELTA_PATCH_MAGIC, 4);
+    copy_uint32_into_buffer_1234(100, patch + 4);
+
+    // Copy beyond the target size
+    append_op(patch, DELTA_PATCH_HEADER_SIZE, DELTA_PATCH_OP_COPY, 0, 101);
+    TEST_ASSERT_FALSE(apply(base, 1000, patch, DELTA_PATCH_HEADER_SIZE + DELTA_PATCH_OP_HEADER_SIZE, 1000, &context, 100));
+    free(context.out);
+
+    // Copy beyond the base image
+    append_op(patch, DELTA_PATCH_HEADER_SIZE, DELTA_PATCH_OP_COPY, 950, 100);
+    TEST_ASSERT_FALSE(apply(base, 1000, patch, DELTA_PATCH_HEADER_SIZE + DELTA_PATCH_OP_HEADER_SIZE, 1000, &context, 100));
+    free(context.out);
+
+    // Unknown operation
+    append_op(patch, DELTA_PATCH_HEADER_SIZE, 'X', 0, 100);
+    TEST_ASSERT_FALSE(apply(base, 1000, patch, DELTA_PATCH_HEADER_SIZE + DELTA_PATCH_OP_HEADER_SIZE, 1000, &context, 100));
+    free(context.out);
+
+    // Incomplete target
+    append_op(patch, DELTA_PATCH_HEADER_SIZE, DELTA_PATCH_OP_COPY, 0, 99);
+    TEST_ASSERT_FALSE(apply(base, 1000, patch, DELTA_PATCH_HEADER_SIZE + DELTA_PATCH_OP_HEADER_SIZE, 1000, &context, 100));
+    TEST_ASSERT_EQUAL_UINT32(99, context.out_len);
+    free(context.out);
+
+    // Wrong magic
+    patch[3] = '2';
+    append_op(patch, DELTA_PATCH_HEADER_SIZE, DELTA_PATCH_OP_COPY, 0, 100);
+    TEST_ASSERT_FALSE(apply(base, 1000, patch, DELTA_PATCH_HEADER_SIZE + DELTA_PATCH_OP_HEADER_SIZE, 1000, &context, 100));
+    free(context.out);
+    free(base);
+}
+
+static uint8_t* read_file(const char* filename, uint32_t* len) {
+    FILE* file = fopen(filename, "rb");
+    TEST_ASSERT_NOT_NULL(file);
+    fseek(file, 0, SEEK_END);
+    *len = (uint32_t) ftell(file);
+    fseek(file, 0, SEEK_SET);
+    uint8_t* data = malloc(*len + 1);
+    TEST_ASSERT_EQUAL_UINT32(*len, fread(data, 1, *len, file));
+    fclose(file);
+    return data;
+}
+
+// Patch size for real builds (DELTA_TEST_BASE=old.bin DELTA_TEST_TARGET=new.bin)
+void test_images(void) {
+    const char* const base_filename = getenv("DELTA_TEST_BASE");
+    const char* const target_filename = getenv("DELTA_TEST_TARGET");
+    if (base_filename == NULL || target_filename == NULL) { TEST_IGNORE_MESSAGE("DELTA_TEST_BASE/DELTA_TEST_TARGET not set"); }
+    uint32_t base_len = 0, n = 0;
+    uint8_t* base = read_file(base_filename, &base_len);
+    uint8_t* image = read_file(target_filename, &n);
+    uint32_t patch_size = 0;
+    check_round_trip(base, base_len, image, n, &patch_size);
+
+    char message[96];
+    snprintf(message, sizeof(message), "%u byte image, %u byte patch (%.1f%%)", n, patch_size, 100.0 * patch_size / n);
+    TEST_MESSAGE(message);
+    free(base);
+    free(image);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_identical);
+    RUN_TEST(test_small_change);
+    RUN_TEST(test_unrelated);
+    RUN_TEST(test_errors);
+    RUN_TEST(test_images);
+    return UNITY_END();
+}
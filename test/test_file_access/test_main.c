@@ -0,0 +1,240 @@
+// Host tests of the storage functions (pio test -e native -f test_file_access)
+// The SPIFFS partition is a temporary directory, so the shadows are checked by changing files behind their back.
+// The benchmark is a micro-benchmark of the storage helpers only: it compares shadowed and file
+// reads of a config record on the host filesystem. It doesn't measure the latency of SLCAN
+// commands (parsing, transport, answer) and doesn't reproduce the flash access times of the device.
+#include <unity.h>
+#include <stdio.h>
+#include <time.h>
+
+#define MOUNT_PATH "/tmp/slcan_test_storage"
+#include "../../src/file_access.c"
+
+
+// Write a file directly, bypassing the storage functions and their shadows
+static void write_behind_back(const char* const filename, const uint8_t* const data, const int len) {
+    char path[128];
+    snprintf(path, sizeof(path), "%s/%s", MOUNT_PATH, filename);
+    FILE* const file = fopen(path, "wb");
+    TEST_ASSERT_NOT_NULL(file);
+    TEST_ASSERT_EQUAL_INT(len, fwrite(data, 1, len, file));
+    fclose(file);
+}
+
+// Read a file directly
+static int read_behind_back(const char* const filename, uint8_t* const data, const int bufsize) {
+    char path[128];
+    snprintf(path, sizeof(path), "%s/%s", MOUNT_PATH, filename);
+    FILE* const file = fopen(path, "rb");
+    if (file == NULL) { return -1; }
+    const int len = fread(data, 1, bufsize, file);
+    fclose(file);
+    return len;
+}
+
+static const char* const test_files[] = { "config.bin", "other.bin", "large.bin", "text.txt", "missing.bin", "config.bin.tmp" };
+
+
+
+void setUp(void) {
+    mount_filesystem();
+    for (uint32_t i = 0; i < sizeof(test_files) / sizeof(test_files[0]); ++i) { remove_file_from_filesystem(test_files[i]); }
+    unmount_filesystem();
+    memset(s_file_shadows, 0, sizeof(s_file_shadows));
+    host_spiffs_mount_count = 0;
+}
+void tearDown(void) {
+    // Every storage function gives the lock back
+    TEST_ASSERT_EQUAL_UINT32(0, s_storage_lock->recursion);
+}
+
+// The filesystem is mounted once and stays mounted
+void test_stays_mounted(void) {
+    const uint8_t data[8] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+    uint8_t read[8] = {};
+    for (uint32_t i = 0; i < 10; ++i) {
+        TEST_ASSERT_TRUE(write_data_to_storage("config.bin", data, sizeof(data)));
+        TEST_ASSERT_TRUE(read_data_from_storage("config.bin", read, sizeof(read)));
+        TEST_ASSERT_TRUE(does_file_exist_in_storage("config.bin"));
+    }
+    TEST_ASSERT_EQUAL_INT(1, host_spiffs_mount_count);
+}
+
+// Written data is read back from the shadow
+void test_shadow_serves_reads(void) {
+    const uint8_t data[16] = { 0x10, 0x11, 0x12 };
+    const uint8_t other[16] = { 0xFF };
+    uint8_t read[16] = {};
+    TEST_ASSERT_TRUE(write_data_to_storage("config.bin", data, sizeof(data)));
+    TEST_ASSERT_EQUAL_INT(sizeof(data), read_behind_back("config.bin", read, sizeof(read)));
+    TEST_ASSERT_EQUAL_MEMORY(data, read, sizeof(data));
+
+    write_behind_back("config.bin", other, sizeof(other));
+    TEST_ASSERT_TRUE(read_data_from_storage("config.bin", read, sizeof(read)));
+    TEST_ASSERT_EQUAL_MEMORY(data, read, sizeof(data));
+    TEST_ASSERT_EQUAL_INT(sizeof(data), read_available_data_from_storage("config.bin", read, 64));
+    TEST_ASSERT_EQUAL_MEMORY(data, read, sizeof(data));
+}
+
+// A file read from the filesystem is shadowed afterwards
+void test_shadow_after_read(void) {
+    const uint8_t data[4] = { 'a', 'b', 'c', 'd' };
+    const uint8_t other[4] = { 'w', 'x', 'y', 'z' };
+    uint8_t read[4] = {};
+    write_behind_back("config.bin", data, sizeof(data));
+    TEST_ASSERT_TRUE(read_data_from_storage("config.bin", read, sizeof(read)));
+    TEST_ASSERT_EQUAL_MEMORY(data, read, sizeof(data));
+    write_behind_back("config.bin", other, sizeof(other));
+    TEST_ASSERT_TRUE(read_data_from_storage("config.bin", read, sizeof(read)));
+    TEST_ASSERT_EQUAL_MEMORY(data, read, sizeof(data));
+}
+
+// Writing unchanged data doesn't touch the filesystem, changed data is written
+void test_unchanged_write_skipped(void) {
+    const uint8_t data[8] = { 1 };
+    const uint8_t other[8] = { 2 };
+    const uint8_t changed[8] = { 3 };
+    uint8_t read[8] = {};
+    TEST_ASSERT_TRUE(write_data_to_storage("config.bin", data, sizeof(data)));
+    write_behind_back("config.bin", other, sizeof(other));
+
+    TEST_ASSERT_TRUE(write_data_to_storage("config.bin", data, sizeof(data)));
+    read_behind_back("config.bin", read, sizeof(read));
+    TEST_ASSERT_EQUAL_MEMORY(other, read, sizeof(read)); // Skipped
+
+    TEST_ASSERT_TRUE(write_data_to_storage("config.bin", changed, sizeof(changed)));
+    read_behind_back("config.bin", read, sizeof(read));
+    TEST_ASSERT_EQUAL_MEMORY(changed, read, sizeof(read));
+}
+
+// Files above SHADOW_MAX_FILE_SIZE are always read from the filesystem
+void test_large_file_not_shadowed(void) {
+    uint8_t data[SHADOW_MAX_FILE_SIZE + 1];
+    uint8_t read[sizeof(data)];
+    memset(data, 0x55, sizeof(data));
+    TEST_ASSERT_TRUE(write_data_to_storage("large.bin", data, sizeof(data)));
+    data[0] = 0xAA;
+    write_behind_back("large.bin", data, sizeof(data));
+    TEST_ASSERT_TRUE(read_data_from_storage("large.bin", read, sizeof(read)));
+    TEST_ASSERT_EQUAL_HEX8(0xAA, read[0]);
+}
+
+// A text write through the storage functions drops the shadow
+void test_text_write_invalidates_shadow(void) {
+    const uint8_t data[4] = { 'o', 'l', 'd', '!' };
+    uint8_t read[4] = {};
+    TEST_ASSERT_TRUE(write_data_to_storage("text.txt", data, sizeof(data)));
+    TEST_ASSERT_TRUE(write_file_to_storage("text.txt", "new!"));
+    TEST_ASSERT_TRUE(read_data_from_storage("text.txt", read, sizeof(read)));
+    TEST_ASSERT_EQUAL_MEMORY("new!", read, sizeof(read));
+}
+
+// Removing a file drops its shadow, so writing the old content again isn't skipped
+void test_remove_invalidates_shadow(void) {
+    const uint8_t data[4] = { 'd', 'a', 't', 'a' };
+    uint8_t read[4] = {};
+    TEST_ASSERT_TRUE(write_data_to_storage("config.bin", data, sizeof(data)));
+    TEST_ASSERT_TRUE(remove_file_from_filesystem("config.bin"));
+    TEST_ASSERT_FALSE(read_data_from_storage("config.bin", read, sizeof(read)));
+    TEST_ASSERT_TRUE(write_data_to_storage("config.bin", data, sizeof(data)));
+    TEST_ASSERT_EQUAL_INT(sizeof(data), read_behind_back("config.bin", read, sizeof(read)));
+}
+
+// Every helper takes the storage lock and gives it back
+#define TEST_ASSERT_LOCKED(call) do { \
+        const UBaseType_t takes = s_storage_lock->recursive_takes; \
+        TEST_ASSERT_TRUE(call); \
+        TEST_ASSERT_GREATER_THAN_UINT32(takes, s_storage_lock->recursive_takes); \
+        TEST_ASSERT_EQUAL_UINT(0, s_storage_lock->recursion); \
+    } while (0)
+
+void test_helpers_take_lock(void) {
+    const uint8_t data[4] = { 1, 2, 3, 4 };
+    uint8_t read[4] = {};
+    uint8_t* file_data = NULL;
+    int filesize = 0;
+    TEST_ASSERT_LOCKED(write_data_to_filesystem("other.bin", data, sizeof(data)));
+    TEST_ASSERT_LOCKED(write_data_to_filesystem_atomic("other.bin", data, sizeof(data)));
+    TEST_ASSERT_LOCKED(read_data_from_filesystem("other.bin", read, sizeof(read)));
+    TEST_ASSERT_LOCKED(does_file_exist_on_filesystem("other.bin"));
+    TEST_ASSERT_LOCKED(does_file_exist_in_storage("other.bin"));
+    TEST_ASSERT_LOCKED(get_file_size_from_filesystem("other.bin") == sizeof(data));
+    TEST_ASSERT_LOCKED(get_file_size_from_storage("other.bin") == sizeof(data));
+    TEST_ASSERT_LOCKED(read_data_file_from_storage("other.bin", &file_data, &filesize));
+    free(file_data);
+    TEST_ASSERT_LOCKED(!recover_file_on_filesystem("other.bin"));
+    TEST_ASSERT_LOCKED(write_file_to_filesystem("text.txt", "txt"));
+    TEST_ASSERT_LOCKED(read_file_from_storage("text.txt", (char*) read, sizeof(read)));
+    TEST_ASSERT_LOCKED(rename_file_on_filesystem("text.txt", "missing.bin"));
+    TEST_ASSERT_LOCKED(remove_file_from_filesystem("missing.bin"));
+}
+
+// Missing files and partial reads
+void test_read_available(void) {
+    uint8_t read[64];
+    TEST_ASSERT_EQUAL_INT(-1, read_available_data_from_storage("missing.bin", read, sizeof(read)));
+    TEST_ASSERT_FALSE(read_data_from_storage("missing.bin", read, sizeof(read)));
+    const uint8_t data[10] = { 9, 8, 7, 6, 5, 4, 3, 2, 1, 0 };
+    write_behind_back("other.bin", data, sizeof(data));
+    TEST_ASSERT_EQUAL_INT(sizeof(data), read_available_data_from_storage("other.bin", read, sizeof(read)));
+    TEST_ASSERT_EQUAL_MEMORY(data, read, sizeof(data));
+    TEST_ASSERT_EQUAL_INT(-1, read_available_data_from_storage("missing.bin", read, 4)); // Not created by the reads
+}
+
+// An interrupted atomic write is finished or rolled back when the file is read
+void test_recover_interrupted_write(void) {
+    const uint8_t old_data[4] = { 'o', 'l', 'd', 0 };
+    const uint8_t new_data[4] = { 'n', 'e', 'w', 0 };
+    uint8_t read[4] = {};
+
+    // Crash after the old file was removed: the temporary file is complete
+    write_behind_back("config.bin.tmp", new_data, sizeof(new_data));
+    TEST_ASSERT_TRUE(read_data_from_storage("config.bin", read, sizeof(read)));
+    TEST_ASSERT_EQUAL_MEMORY(new_data, read, sizeof(read));
+    TEST_ASSERT_EQUAL_INT(-1, read_behind_back("config.bin.tmp", read, sizeof(read)));
+
+    // Crash before: the old file is kept
+    memset(s_file_shadows, 0, sizeof(s_file_shadows));
+    write_behind_back("config.bin", old_data, sizeof(old_data));
+    write_behind_back("config.bin.tmp", new_data, sizeof(new_data));
+    TEST_ASSERT_TRUE(read_data_from_storage("config.bin", read, sizeof(read)));
+    TEST_ASSERT_EQUAL_MEMORY(old_data, read, sizeof(read));
+    TEST_ASSERT_EQUAL_INT(-1, read_behind_back("config.bin.tmp", read, sizeof(read)));
+}
+
+// Micro-benchmark: config record reads from the shadow vs from the file (host filesystem)
+void test_benchmark_reads(void) {
+    const uint8_t data[32] = { 1, 2, 3 };
+    uint8_t read[32];
+    const uint32_t iterations = 20000;
+    struct timespec t0, t1, t2;
+    TEST_ASSERT_TRUE(write_data_to_storage("config.bin", data, sizeof(data)));
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (uint32_t i = 0; i < iterations; ++i) { read_data_from_storage("config.bin", read, sizeof(read)); }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    for (uint32_t i = 0; i < iterations; ++i) { read_data_from_filesystem("config.bin", read, sizeof(read)); }
+    clock_gettime(CLOCK_MONOTONIC, &t2);
+
+    const double shadow_us = ((t1.tv_sec - t0.tv_sec) * 1e6 + (t1.tv_nsec - t0.tv_nsec) * 1e-3) / iterations;
+    const double file_us = ((t2.tv_sec - t1.tv_sec) * 1e6 + (t2.tv_nsec - t1.tv_nsec) * 1e-3) / iterations;
+    char message[96];
+    snprintf(message, sizeof(message), "config read: shadow %.3f us, file %.3f us (host)", shadow_us, file_us);
+    TEST_MESSAGE(message);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_stays_mounted);
+    RUN_TEST(test_shadow_serves_reads);
+    RUN_TEST(test_shadow_after_read);
+    RUN_TEST(test_unchanged_write_skipped);
+    RUN_TEST(test_large_file_not_shadowed);
+    RUN_TEST(test_text_write_invalidates_shadow);
+    RUN_TEST(test_remove_invalidates_shadow);
+    RUN_TEST(test_helpers_take_lock);
+    RUN_TEST(test_read_available);
+    RUN_TEST(test_recover_interrupted_write);
+    RUN_TEST(test_benchmark_reads);
+    return UNITY_END();
+}
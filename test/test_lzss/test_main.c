@@ -0,0 +1,259 @@
+// Host tests of the streaming LZSS decompressor (pio test -e native -f test_lzss)
+// Round trips data through a compressor that works like 'lzss_compress' in scripts/btspp_ota_update.py.
+// Set LZSS_TEST_IMAGE to a firmware .bin to also report the ratio and decompression speed for it.
+#include <unity.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../../src/lzss.c"
+
+
+// Compressor (greedy, longest match among the last 32 positions with the same 3 byte prefix)
+#define MAX_CANDIDATES 32
+#define HASH_SIZE 65536
+
+static uint32_t prefix_hash(const uint8_t* p) {
+    return ((uint32_t) p[0] << 8 ^ (uint32_t) p[1] << 4 ^ p[2]) & (HASH_SIZE - 1);
+}
+
+static uint8_t* compress(const uint8_t* data, const uint32_t n, uint32_t* out_len) {
+    uint8_t* out = malloc(LZSS_HEADER_SIZE + n + n / 8 + 16);
+    int32_t (*candidates)[MAX_CANDIDATES] = malloc(sizeof(int32_t[MAX_CANDIDATES]) * HASH_SIZE);
+    uint8_t* counts = calloc(HASH_SIZE, 1);
+    memcpy(out, LZSS_MAGIC, 4);
+    for (int k = 0; k < 4; ++k) { out[4 + k] = (uint8_t) (n >> (8 * k)); }
+    uint32_t len = LZSS_HEADER_SIZE;
+
+    uint32_t i = 0;
+    while (i < n) {
+        const uint32_t flags_pos = len++;
+        uint8_t flags = 0;
+        for (int bit = 0; bit < 8 && i < n; ++bit) {
+            uint32_t best_len = 0, best_dist = 0;
+            const uint32_t max_len = (n - i < LZSS_MAX_MATCH ? n - i : LZSS_MAX_MATCH);
+            if (max_len >= LZSS_MIN_MATCH) {
+                const uint32_t h = prefix_hash(data + i);
+                for (int c = counts[h] - 1; c >= 0; --c) {
+                    const uint32_t p = (uint32_t) candidates[h][c];
+                    if (i - p > LZSS_WINDOW_SIZE) { break; }
+                    uint32_t length = 0;
+                    while (length < max_len && data[p + length] == data[i + length]) { length++; }
+                    if (length > best_len) { best_len = length; best_dist = i - p; }
+                    if (length == max_len) { break; }
+                }
+            }
+
+            uint32_t step = 1;
+            if (best_len >= LZSS_MIN_MATCH) {
+                const uint32_t d = best_dist - 1;
+                out[len++] = (uint8_t) d;
+                out[len++] = (uint8_t) (((d >> 8) << 4) | (best_len - LZSS_MIN_MATCH));
+                step = best_len;
+            }
+            else {
+                flags |= 1 << bit;
+                out[len++] = data[i];
+            }
+
+            for (uint32_t k = i; k < i + step && k + LZSS_MIN_MATCH <= n; ++k) {
+                const uint32_t h = prefix_hash(data + k);
+                if (counts[h] == MAX_CANDIDATES) {
+                    memmove(candidates[h], candidates[h] + 1, sizeof(int32_t) * (MAX_CANDIDATES - 1));
+                    counts[h] -= 1;
+                }
+                candidates[h][counts[h]++] = (int32_t) k;
+            }
+            i += step;
+        }
+        out[flags_pos] = flags;
+    }
+    free(candidates);
+    free(counts);
+    *out_len = len;
+    return out;
+}
+
+
+// Output collector
+typedef struct {
+    uint8_t* data;
+    uint32_t len;
+    uint32_t capacity;
+    uint32_t calls;
+    uint32_t max_block;
+} output_t;
+
+static bool collect(void* const ctx, const uint8_t* data, const uint32_t len) {
+    output_t* const output = (output_t*) ctx;
+    output->calls += 1;
+    if (len > output->max_block) { output->max_block = len; }
+    if (output->len + len > output->capacity) { return false; } // More output than expected
+    memcpy(output->data + output->len, data, len);
+    output->len += len;
+    return true;
+}
+
+// Decompress in blocks of 'block_size' input bytes
+static bool decompress(const uint8_t* stream, const uint32_t stream_len, const uint32_t block_size, output_t* const output, const uint32_t capacity) {
+    static lzss_decoder_t decoder;
+    lzss_decoder_init(&decoder);
+    output->data = malloc(capacity + 1);
+    output->len = 0;
+    output->capacity = capacity;
+    output->calls = 0;
+    output->max_block = 0;
+    for (uint32_t pos = 0; pos < stream_len; pos += block_size) {
+        const uint32_t n = (stream_len - pos < block_size ? stream_len - pos : block_size);
+        if (!lzss_decode(&decoder, stream + pos, n, collect, output)) { return false; }
+    }
+    return lzss_decoder_finished(&decoder);
+}
+
+// Test data: text-like runs mixed with noise
+static uint8_t* make_data(const uint32_t n, const uint32_t seed) {
+    uint8_t* data = malloc(n + 1);
+    uint32_t state = seed;
+    static const char words[] = "slcan twai frame identifier bluetooth spp ota window ";
+    for (uint32_t i = 0; i < n; ++i) {
+        state = state * 1103515245u + 12345u;
+        data[i] = ((state >> 16) % 4 == 0) ? (uint8_t) (state >> 24) : (uint8_t) words[i % (sizeof(words) - 1)];
+    }
+    return data;
+}
+
+static void check_round_trip(const uint8_t* data, const uint32_t n, const uint32_t block_size) {
+    uint32_t stream_len = 0;
+    uint8_t* stream = compress(data, n, &stream_len);
+    output_t output;
+    char message[96];
+    snprintf(message, sizeof(message), "%u bytes in blocks of %u", n, block_size);
+    TEST_ASSERT_TRUE_MESSAGE(decompress(stream, stream_len, block_size, &output, n), message);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(n, output.len, message);
+    TEST_ASSERT_EQUAL_MEMORY_MESSAGE(data, output.data, n, message);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(LZSS_WINDOW_SIZE, output.max_block);
+    free(output.data);
+    free(stream);
+}
+
+
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// Sizes around the window size, every block boundary position
+void test_round_trip_sizes(void) {
+    static const uint32_t sizes[] = { 1, 2, 17, 4095, 4096, 4097, 8191, 8192, 8193, 12288, 65536 };
+    static const uint32_t block_sizes[] = { 1, 7, 512, 4096, 1u << 20 };
+    for (uint32_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+        uint8_t* data = make_data(sizes[i], i + 1);
+        for (uint32_t j = 0; j < sizeof(block_sizes) / sizeof(block_sizes[0]); ++j) {
+            check_round_trip(data, sizes[i], block_sizes[j]);
+        }
+        free(data);
+    }
+}
+
+// Literals only, every block ends where the window wraps
+void test_literals_at_window_boundary(void) {
+    static const uint32_t sizes[] = { 4096, 8192 };
+    for (uint32_t s = 0; s < 2; ++s) {
+        const uint32_t n = sizes[s];
+        const uint32_t stream_len = LZSS_HEADER_SIZE + n + n / 8;
+        uint8_t* stream = malloc(stream_len);
+        uint8_t* data = make_data(n, 99);
+        memcpy(stream, LZSS_MAGIC, 4);
+        for (int k = 0; k < 4; ++k) { stream[4 + k] = (uint8_t) (n >> (8 * k)); }
+        uint32_t len = LZSS_HEADER_SIZE;
+        for (uint32_t i = 0; i < n; ++i) {
+            if (i % 8 == 0) { stream[len++] = 0xFF; }
+            stream[len++] = data[i];
+        }
+        // Blocks of 9 * 512 bytes end exactly on the window boundaries
+        output_t output;
+        TEST_ASSERT_TRUE(decompress(stream, len, 9 * 512, &output, n));
+        TEST_ASSERT_EQUAL_UINT32(n, output.len);
+        TEST_ASSERT_EQUAL_MEMORY(data, output.data, n);
+        free(output.data);
+        free(stream);
+        free(data);
+    }
+}
+
+// Long runs (overlapping matches with distance 1)
+void test_runs(void) {
+    uint8_t* data = malloc(10000);
+    memset(data, 0xAA, 5000);
+    memset(data + 5000, 0x00, 5000);
+    check_round_trip(data, 10000, 100);
+    uint32_t stream_len = 0;
+    uint8_t* stream = compress(data, 10000, &stream_len);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(10000 / 8, stream_len);
+    free(stream);
+    free(data);
+}
+
+// Corrupted streams are rejected
+void test_errors(void) {
+    static lzss_decoder_t decoder;
+    output_t output = { .data = malloc(64), .capacity = 64 };
+
+    // Wrong magic
+    lzss_decoder_init(&decoder);
+    TEST_ASSERT_FALSE(lzss_decode(&decoder, (const uint8_t*) "LZS2\x01\0\0\0\xFF" "a", 10, collect, &output));
+    TEST_ASSERT_FALSE(lzss_decoder_finished(&decoder));
+
+    // Match before the start of the output
+    lzss_decoder_init(&decoder);
+    TEST_ASSERT_FALSE(lzss_decode(&decoder, (const uint8_t*) "LZS1\x04\0\0\0\x01" "a\x05\x00", 12, collect, &output));
+
+    // Data after the end of the stream
+    lzss_decoder_init(&decoder);
+    TEST_ASSERT_FALSE(lzss_decode(&decoder, (const uint8_t*) "LZS1\x01\0\0\0\xFF" "ab", 11, collect, &output));
+
+    // Truncated stream
+    lzss_decoder_init(&decoder);
+    TEST_ASSERT_TRUE(lzss_decode(&decoder, (const uint8_t*) "LZS1\x02\0\0\0\xFF" "a", 10, collect, &output));
+    TEST_ASSERT_FALSE(lzss_decoder_finished(&decoder));
+    free(output.data);
+}
+
+// Ratio and speed for a real image (LZSS_TEST_IMAGE=firmware.bin)
+void test_image(void) {
+    const char* const filename = getenv("LZSS_TEST_IMAGE");
+    if (filename == NULL) { TEST_IGNORE_MESSAGE("LZSS_TEST_IMAGE not set"); }
+    FILE* file = fopen(filename, "rb");
+    TEST_ASSERT_NOT_NULL(file);
+    fseek(file, 0, SEEK_END);
+    const uint32_t n = (uint32_t) ftell(file);
+    fseek(file, 0, SEEK_SET);
+    uint8_t* data = malloc(n);
+    TEST_ASSERT_EQUAL_UINT32(n, fread(data, 1, n, file));
+    fclose(file);
+
+    uint32_t stream_len = 0;
+    uint8_t* stream = compress(data, n, &stream_len);
+    output_t output;
+    const clock_t start = clock();
+    TEST_ASSERT_TRUE(decompress(stream, stream_len, 4096, &output, n));
+    const double seconds = (double) (clock() - start) / CLOCKS_PER_SEC;
+    TEST_ASSERT_EQUAL_MEMORY(data, output.data, n);
+
+    char message[128];
+    snprintf(message, sizeof(message), "%u -> %u bytes (%.1f%%), decompressed at %.1f MB/s",
+        n, stream_len, 100.0 * stream_len / n, n / (seconds > 0 ? seconds : 1e-9) / 1e6);
+    TEST_MESSAGE(message);
+    free(output.data);
+    free(stream);
+    free(data);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_round_trip_sizes);
+    RUN_TEST(test_literals_at_window_boundary);
+    RUN_TEST(test_runs);
+    RUN_TEST(test_errors);
+    RUN_TEST(test_image);
+    return UNITY_END();
+}
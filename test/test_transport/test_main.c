@@ -0,0 +1,120 @@
+// Host tests of the transport helpers over the loopback transport (pio test -e native -f test_transport)
+// The benchmark reports how many SLCAN commands per second transport_recv_msg splits off a loopback link.
+#include <unity.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "../../src/transport.c"
+#include "../../src/transport_loopback.c"
+
+
+static const transport_t* const transport = &loopback_transport;
+
+// Read everything the engine side sent
+static int read_all(char* const buffer, const uint32_t bufsize) {
+    int total = 0;
+    int n = 0;
+    while ((n = loopback_transport_read((uint8_t*) buffer + total, bufsize - 1 - total, 0)) > 0) { total += n; }
+    buffer[total] = '\0';
+    return total;
+}
+
+
+
+void setUp(void) {
+    TEST_ASSERT_TRUE(loopback_transport_init(256));
+    loopback_transport_set_connected(true);
+    char buffer[256];
+    read_all(buffer, sizeof(buffer));
+    while (transport->recv((uint8_t*) buffer, sizeof(buffer), 0) > 0) {}
+}
+void tearDown(void) {}
+
+// Commands written by the host come out one by one
+void test_recv_msg(void) {
+    const char* const commands = "V\rS6\rO\r";
+    TEST_ASSERT_TRUE(loopback_transport_write((const uint8_t*) commands, strlen(commands), 0));
+    char msg[16];
+    TEST_ASSERT_EQUAL_INT(2, transport_recv_msg(transport, msg, sizeof(msg), "\r", 0, 0));
+    TEST_ASSERT_EQUAL_STRING("V\r", msg);
+    TEST_ASSERT_EQUAL_INT(3, transport_recv_msg(transport, msg, sizeof(msg), "\r", 0, 0));
+    TEST_ASSERT_EQUAL_STRING("S6\r", msg);
+    TEST_ASSERT_EQUAL_INT(2, transport_recv_msg(transport, msg, sizeof(msg), "\r", 0, 0));
+    TEST_ASSERT_EQUAL_STRING("O\r", msg);
+
+    // Timeout on the first character
+    TEST_ASSERT_EQUAL_INT(-2, transport_recv_msg(transport, msg, sizeof(msg), "\r", 0, 0));
+
+    // Timeout on an intermediate character (the rest of the command is still missing)
+    TEST_ASSERT_TRUE(loopback_transport_write((const uint8_t*) "t12", 3, 0));
+    TEST_ASSERT_EQUAL_INT(-3, transport_recv_msg(transport, msg, sizeof(msg), "\r", 0, 0));
+    TEST_ASSERT_EQUAL_STRING("t12", msg);
+
+    // Buffer full
+    TEST_ASSERT_TRUE(loopback_transport_write((const uint8_t*) "t1230\r", 6, 0));
+    TEST_ASSERT_EQUAL_INT(-4, transport_recv_msg(transport, msg, 4, "\r", 0, 0));
+    TEST_ASSERT_EQUAL_INT(3, transport_recv_msg(transport, msg, sizeof(msg), "\r", 0, 0));
+
+    // Longer delimiters
+    TEST_ASSERT_TRUE(loopback_transport_write((const uint8_t*) "< open can0 >", 13, 0));
+    TEST_ASSERT_EQUAL_INT(13, transport_recv_msg(transport, msg, sizeof(msg), " >", 0, 0));
+
+    TEST_ASSERT_EQUAL_INT(-1, transport_recv_msg(transport, NULL, sizeof(msg), "\r", 0, 0));
+}
+
+// The loopback link has a single client: replies fall back to 'send', exclusive use does nothing
+void test_send_and_reply(void) {
+    char buffer[64];
+    TEST_ASSERT_NULL(transport->reply);
+    TEST_ASSERT_NULL(transport->set_exclusive);
+    TEST_ASSERT_TRUE(transport_send_msg(transport, "z\r", 0));
+    transport_set_exclusive(transport, true);
+    TEST_ASSERT_TRUE(transport_send_reply(transport, "\a", 0));
+    transport_set_exclusive(transport, false);
+    TEST_ASSERT_TRUE(transport->flush(0));
+    TEST_ASSERT_EQUAL_INT(3, read_all(buffer, sizeof(buffer)));
+    TEST_ASSERT_EQUAL_STRING("z\r\a", buffer);
+
+    // Nothing is sent while disconnected
+    loopback_transport_set_connected(false);
+    TEST_ASSERT_FALSE(transport->is_connected());
+    TEST_ASSERT_FALSE(transport_send_msg(transport, "z\r", 0));
+    loopback_transport_set_connected(true);
+    TEST_ASSERT_TRUE(transport->is_connected());
+    TEST_ASSERT_EQUAL_INT(0, read_all(buffer, sizeof(buffer)));
+
+    // A full buffer is reported
+    for (int i = 0; i < 256 / 8; ++i) { TEST_ASSERT_TRUE(transport_send_msg(transport, "t1230\r\r\r", 0)); }
+    TEST_ASSERT_FALSE(transport_send_msg(transport, "z\r", 0));
+}
+
+// Commands per second through transport_recv_msg
+void test_benchmark_recv_msg(void) {
+    const char* const command = "t12380011223344556677\r";
+    const uint32_t len = strlen(command);
+    const uint32_t batch = 256 / len;
+    const uint32_t rounds = 20000;
+    char msg[32];
+    uint32_t received = 0;
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (uint32_t r = 0; r < rounds; ++r) {
+        for (uint32_t i = 0; i < batch; ++i) { loopback_transport_write((const uint8_t*) command, len, 0); }
+        while (transport_recv_msg(transport, msg, sizeof(msg), "\r", 0, 0) == (int) len) { received += 1; }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    TEST_ASSERT_EQUAL_UINT32(rounds * batch, received);
+
+    const double seconds = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) * 1e-9;
+    char message[96];
+    snprintf(message, sizeof(message), "%.2f M commands/s (%u bytes each)", received / seconds * 1e-6, len);
+    TEST_MESSAGE(message);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_recv_msg);
+    RUN_TEST(test_send_and_reply);
+    RUN_TEST(test_benchmark_recv_msg);
+    return UNITY_END();
+}
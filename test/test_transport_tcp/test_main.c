@@ -0,0 +1,219 @@
+// Host tests of the TCP transport over local sockets (pio test -e native -f test_transport_tcp)
+// The benchmark sends frames from a second thread (like the auto-poll task) while the test thread
+// keeps receiving (like the SLCAN task) and two clients read, it reports the frames per second.
+#include <unity.h>
+#include <stdio.h>
+#include <time.h>
+#include <stdatomic.h>
+#include <arpa/inet.h>
+
+#include "../../src/transport.c"
+#include "../../src/transport_tcp.c"
+
+#define TEST_PORT 28561
+
+
+// Connect a client to the transport and let the transport accept it
+static int connect_client() {
+    const int s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    struct sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(TEST_PORT);
+    TEST_ASSERT_EQUAL_INT(0, connect(s, (struct sockaddr*) &address, sizeof(address)));
+    const uint32_t count = tcp_transport_get_client_count();
+    uint8_t data[16];
+    for (int i = 0; i < 100 && tcp_transport_get_client_count() == count; ++i) { tcp_recv(data, sizeof(data), 10); }
+    TEST_ASSERT_EQUAL_UINT32(count + 1, tcp_transport_get_client_count());
+    return s;
+}
+
+// Read what a client got within 'timeout_ms'
+static int read_client_data(const int s, char* const buffer, const uint32_t bufsize, const uint32_t timeout_ms) {
+    int total = 0;
+    while (total < (int) bufsize - 1 && wait_for_socket(s, false, timeout_ms)) {
+        const int n = recv(s, buffer + total, bufsize - 1 - total, 0);
+        if (n <= 0) { break; }
+        total += n;
+    }
+    buffer[total] = '\0';
+    return total;
+}
+
+static void write_client(const int s, const char* const data) {
+    TEST_ASSERT_EQUAL_INT(strlen(data), send(s, data, strlen(data), MSG_NOSIGNAL));
+}
+
+
+
+void setUp(void) {
+    TEST_ASSERT_TRUE(tcp_transport_start(TEST_PORT));
+}
+void tearDown(void) {
+    tcp_transport_stop();
+}
+
+// Answers only go to the client that sent the command, everything else to all clients
+void test_reply_and_broadcast(void) {
+    const int a = connect_client();
+    const int b = connect_client();
+    char msg[64];
+    char buffer[64];
+
+    write_client(b, "V\r");
+    TEST_ASSERT_EQUAL_INT(2, transport_recv_msg(&tcp_transport, msg, sizeof(msg), "\r", 1000, 1000));
+    TEST_ASSERT_EQUAL_STRING("V\r", msg);
+    TEST_ASSERT_TRUE(transport_send_reply(&tcp_transport, "V1013\r", 1000));
+    TEST_ASSERT_TRUE(tcp_transport.send((const uint8_t*) "t1230\r", 6, 1000));
+    TEST_ASSERT_TRUE(tcp_transport.flush(1000));
+
+    TEST_ASSERT_EQUAL_INT(6, read_client_data(a, buffer, sizeof(buffer), 100));
+    TEST_ASSERT_EQUAL_STRING("t1230\r", buffer);
+    TEST_ASSERT_EQUAL_INT(12, read_client_data(b, buffer, sizeof(buffer), 100));
+    TEST_ASSERT_EQUAL_STRING("V1013\rt1230\r", buffer);
+
+    close(a);
+    close(b);
+}
+
+// A command split over several packets isn't mixed with the command of another client
+void test_split_command(void) {
+    const int a = connect_client();
+    const int b = connect_client();
+    char msg[64];
+    char buffer[64];
+
+    write_client(a, "t12");
+    uint8_t data[64];
+    TEST_ASSERT_EQUAL_INT(3, tcp_recv(data, sizeof(data), 1000));
+    write_client(b, "C\r");
+    TEST_ASSERT_EQUAL_INT(-2, tcp_recv(data, sizeof(data), 50)); // Held back
+    write_client(a, "30\r");
+    TEST_ASSERT_EQUAL_INT(3, tcp_recv(data, sizeof(data), 1000));
+    TEST_ASSERT_EQUAL_MEMORY("30\r", data, 3);
+    TEST_ASSERT_EQUAL_INT(2, transport_recv_msg(&tcp_transport, msg, sizeof(msg), "\r", 1000, 1000));
+    TEST_ASSERT_EQUAL_STRING("C\r", msg);
+    TEST_ASSERT_TRUE(transport_send_reply(&tcp_transport, "\r", 1000));
+    TEST_ASSERT_TRUE(tcp_transport.flush(1000));
+    TEST_ASSERT_EQUAL_INT(0, read_client_data(a, buffer, sizeof(buffer), 50));
+    TEST_ASSERT_EQUAL_INT(1, read_client_data(b, buffer, sizeof(buffer), 100));
+
+    close(a);
+    close(b);
+}
+
+// During a transfer only the transferring client is served
+void test_exclusive(void) {
+    const int a = connect_client();
+    const int b = connect_client();
+    char msg[64];
+    char buffer[64];
+
+    write_client(a, "START SIGNAL-UPLOAD 4\r");
+    TEST_ASSERT_EQUAL_INT(22, transport_recv_msg(&tcp_transport, msg, sizeof(msg), "\r", 1000, 1000));
+    transport_set_exclusive(&tcp_transport, true);
+    write_client(b, "O\r");
+    write_client(a, "abcd");
+    uint8_t data[64];
+    TEST_ASSERT_EQUAL_INT(4, tcp_recv(data, sizeof(data), 1000));
+    TEST_ASSERT_EQUAL_MEMORY("abcd", data, 4);
+    TEST_ASSERT_EQUAL_INT(-2, tcp_recv(data, sizeof(data), 50));
+    TEST_ASSERT_TRUE(tcp_transport.send((const uint8_t*) "OK\r", 3, 1000));
+    TEST_ASSERT_TRUE(tcp_transport.flush(1000));
+    transport_set_exclusive(&tcp_transport, false);
+
+    TEST_ASSERT_EQUAL_INT(3, read_client_data(a, buffer, sizeof(buffer), 100));
+    TEST_ASSERT_EQUAL_INT(0, read_client_data(b, buffer, sizeof(buffer), 50));
+    TEST_ASSERT_EQUAL_INT(2, transport_recv_msg(&tcp_transport, msg, sizeof(msg), "\r", 1000, 1000));
+    TEST_ASSERT_EQUAL_STRING("O\r", msg);
+
+    close(a);
+    close(b);
+}
+
+// A client that leaves is closed by the receiving side, the others keep working
+void test_disconnect(void) {
+    const int a = connect_client();
+    const int b = connect_client();
+    char buffer[64];
+
+    close(a);
+    uint8_t data[16];
+    for (int i = 0; i < 100 && tcp_transport_get_client_count() == 2; ++i) { tcp_recv(data, sizeof(data), 10); }
+    TEST_ASSERT_EQUAL_UINT32(1, tcp_transport_get_client_count());
+    TEST_ASSERT_TRUE(tcp_transport.send((const uint8_t*) "t1230\r", 6, 1000));
+    TEST_ASSERT_TRUE(tcp_transport.flush(1000));
+    TEST_ASSERT_EQUAL_INT(6, read_client_data(b, buffer, sizeof(buffer), 100));
+
+    close(b);
+}
+
+
+
+// Benchmark: a sender thread and two reading clients, the test thread keeps receiving
+#define BENCHMARK_FRAMES 500000
+static atomic_bool benchmark_done = false;
+static uint32_t benchmark_sent = 0;
+
+static void* benchmark_sender(void* args) {
+    (void) args;
+    const char* const frame = "t12380011223344556677\r";
+    for (uint32_t i = 0; i < BENCHMARK_FRAMES; ++i) {
+        if (tcp_transport.send((const uint8_t*) frame, strlen(frame), 1000)) { benchmark_sent += 1; }
+    }
+    tcp_transport.flush(1000);
+    benchmark_done = true;
+    return NULL;
+}
+
+static void* benchmark_reader(void* args) {
+    const int s = *(const int*) args;
+    static __thread char buffer[16384];
+    uint64_t total = 0;
+    int n = 0;
+    while ((n = recv(s, buffer, sizeof(buffer), 0)) > 0) { total += n; }
+    return (void*) (uintptr_t) total;
+}
+
+void test_benchmark_send(void) {
+    int sockets[2] = { connect_client(), connect_client() };
+    pthread_t readers[2];
+    for (int i = 0; i < 2; ++i) { pthread_create(&readers[i], NULL, benchmark_reader, &sockets[i]); }
+
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    pthread_t sender;
+    pthread_create(&sender, NULL, benchmark_sender, NULL);
+    uint8_t data[64];
+    while (!benchmark_done) { tcp_recv(data, sizeof(data), 10); }
+    pthread_join(sender, NULL);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    for (int i = 0; i < 2; ++i) { shutdown(sockets[i], SHUT_WR); }
+    tcp_transport_stop(); // Ends the readers
+    uint64_t received[2];
+    for (int i = 0; i < 2; ++i) {
+        void* total;
+        pthread_join(readers[i], &total);
+        received[i] = (uintptr_t) total;
+        close(sockets[i]);
+    }
+
+    const double seconds = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) * 1e-9;
+    const uint32_t len = 22;
+    char message[128];
+    snprintf(message, sizeof(message), "%.2f M frames/s sent, clients got %.2f / %.2f M frames/s",
+        benchmark_sent / seconds * 1e-6, received[0] / len / seconds * 1e-6, received[1] / len / seconds * 1e-6);
+    TEST_MESSAGE(message);
+    TEST_ASSERT_EQUAL_UINT32(BENCHMARK_FRAMES, benchmark_sent);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_reply_and_broadcast);
+    RUN_TEST(test_split_command);
+    RUN_TEST(test_exclusive);
+    RUN_TEST(test_disconnect);
+    RUN_TEST(test_benchmark_send);
+    return UNITY_END();
+}